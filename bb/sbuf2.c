@@ -800,6 +800,24 @@ void *SBUF2_FUNC(sbuf2getuserptr)(SBUF2 *sb)
     return sb->userptr;
 }
 
+int SBUF2_FUNC(sbuf2pending)(SBUF2 *sb)
+{
+    int n;
+
+    if (sb == NULL)
+        return -1;
+
+    n = sb->rhd - sb->rtl;
+#if SBUF2_UNGETC
+    n += sb->ungetc_buf_len;
+#endif
+#if WITH_SSL
+    if (sb->ssl != NULL)
+        n += SSL_pending(sb->ssl);
+#endif
+    return n;
+}
+
 #if WITH_SSL
 #  ifdef my_ssl_println
 #    undef my_ssl_println
@@ -45,6 +45,7 @@
 #include "thdpool.h"
 #include "thread_util.h"
 #include "thread_malloc.h"
+#include "comdb2_atomic.h"
 
 #include "debug_switches.h"
 
@@ -79,10 +80,21 @@ struct thd {
 
     int on_freelist;
 
+    /* Home shard if the work queue is sharded (modulo nshards) */
+    unsigned shard;
+
     LINKC_T(struct thd) thdlist_linkv;
     LINKC_T(struct thd) freelist_linkv;
 };
 
+/* One lane of a sharded work queue, see thdpool_set_queue_shards().  Padded
+ * so that neighbouring shard locks don't share a cache line. */
+struct queue_shard {
+    pthread_mutex_t mutex;
+    pool_t *pool;
+    LISTC_T(struct workitem) queue;
+} __attribute__((aligned(64)));
+
 struct thdpool {
     char *name;
 
@@ -134,6 +146,16 @@ struct thdpool {
     pool_t *pool;
     LISTC_T(struct workitem) queue;
 
+    /* Optional sharded work queue.  Once nshards is set new work is queued
+     * on shards[] instead, and once all threads are busy both enqueue and
+     * dequeue go through the shard locks only.  nqueued and nfree are kept
+     * with atomics so that path can read them without the pool mutex. */
+    int nshards;
+    struct queue_shard *shards;
+    unsigned nqueued;
+    unsigned nfree;
+    unsigned num_steals;
+
     int exit_on_create_fail;
 
     /* slow enqueue request to block until we have an available thread */
@@ -295,6 +317,67 @@ void thdpool_set_dump_on_full(struct thdpool *pool, int onoff)
     pool->dump_on_full = onoff;
 }
 
+/* Split the work queue into nshards separately locked lists.  This can only
+ * be done once per pool; anything already on the single queue still gets
+ * drained first. */
+int thdpool_set_queue_shards(struct thdpool *pool, int nshards)
+{
+    struct queue_shard *shards;
+    int ii;
+
+    if (nshards < 2) {
+        logmsg(LOGMSG_ERROR, "%s(%s): need at least 2 shards\n", __func__,
+               pool->name);
+        return -1;
+    }
+
+    shards = calloc(nshards, sizeof(struct queue_shard));
+    if (!shards) {
+        logmsg(LOGMSG_ERROR, "%s(%s): out of memory\n", __func__, pool->name);
+        return -1;
+    }
+    for (ii = 0; ii < nshards; ii++) {
+        shards[ii].pool = pool_init(sizeof(struct workitem), 0);
+        if (!shards[ii].pool) {
+            logmsg(LOGMSG_ERROR, "%s(%s): pool_init failed\n", __func__,
+                   pool->name);
+            while (--ii >= 0)
+                pool_free(shards[ii].pool);
+            free(shards);
+            return -1;
+        }
+        pthread_mutex_init(&shards[ii].mutex, NULL);
+        listc_init(&shards[ii].queue, offsetof(struct workitem, linkv));
+    }
+
+    LOCK(&pool->mutex)
+    {
+        if (pool->nshards) {
+            errUNLOCK(&pool->mutex);
+            logmsg(LOGMSG_ERROR, "%s(%s): queue is already split %d ways\n",
+                   __func__, pool->name, pool->nshards);
+            for (ii = 0; ii < nshards; ii++) {
+                pool_free(shards[ii].pool);
+                pthread_mutex_destroy(&shards[ii].mutex);
+            }
+            free(shards);
+            return -1;
+        }
+        pool->shards = shards;
+        /* publish shards before anyone sees nshards */
+        XCHANGE(pool->nshards, nshards);
+    }
+    UNLOCK(&pool->mutex);
+
+    return 0;
+}
+
+/* Items queued across the legacy queue and all shards */
+static inline unsigned queue_size(struct thdpool *pool)
+{
+    return listc_size(&pool->queue) + ATOMIC_ADD(pool->nqueued, 0);
+}
+
 void thdpool_print_stats(FILE *fh, struct thdpool *pool)
 {
     LOCK(&pool->mutex)
@@ -321,7 +404,13 @@ void thdpool_print_stats(FILE *fh, struct thdpool *pool)
         logmsgf(LOGMSG_USER, fh, "  Work queue peak size      : %u\n", pool->peakqueue);
         logmsgf(LOGMSG_USER, fh, "  Work queue maximum size   : %u\n", pool->maxqueue);
         logmsgf(LOGMSG_USER, fh, "  Work queue current size   : %u\n",
-                listc_size(&pool->queue));
+                queue_size(pool));
+        if (pool->nshards) {
+            logmsgf(LOGMSG_USER, fh, "  Work queue shards         : %d\n",
+                    pool->nshards);
+            logmsgf(LOGMSG_USER, fh, "  Num work items stolen     : %u\n",
+                    pool->num_steals);
+        }
         logmsgf(LOGMSG_USER, fh, "  Long wait alarm threshold : %u ms\n", pool->longwaitms);
         logmsgf(LOGMSG_USER, fh, "  Thread linger time        : %u seconds\n",
                 pool->lingersecs);
@@ -439,6 +528,12 @@ void thdpool_process_message(struct thdpool *pool, char *line, int lline,
         }
         logmsg(LOGMSG_USER, "Pool [%s] thread maximum queued time %u ms\n", pool->name,
                pool->maxqueueagems);
+    } else if (tokcmp(tok, ltok, "qshards") == 0) {
+        tok = segtok(line, lline, &st, &ltok);
+        if (ltok > 0 && thdpool_set_queue_shards(pool, toknum(tok, ltok)) == 0) {
+            logmsg(LOGMSG_USER, "Pool [%s] work queue split into %d shards\n",
+                   pool->name, pool->nshards);
+        }
     } else if (tokcmp(tok, ltok, "exit_on_error") == 0) {
         tok = segtok(line, lline, &st, &ltok);
         if (ltok == 0)
@@ -474,6 +569,7 @@ void thdpool_process_message(struct thdpool *pool, char *line, int lline,
         logmsg(LOGMSG_USER, "  stacksz # -            set thread stack size in bytes\n");
         logmsg(LOGMSG_USER, "  maxqover #-            set maximum client forced queued items above maxq\n");
         logmsg(LOGMSG_USER, "  maxagems #-            set maximum age in ms for in-queue time\n");
+        logmsg(LOGMSG_USER, "  qshards # -            split the work queue into # shards\n");
         logmsg(LOGMSG_USER, "  exit_on_error on/off - enable/disable exit on thread errors \n");
         logmsg(LOGMSG_USER, "  dump_on_full on/off -  enable/disable dumping status on full queue\n");
     }
@@ -499,6 +595,56 @@ void thdpool_resume(struct thdpool *pool)
     UNLOCK(&pool->mutex);
 }
 
+/* Take the oldest item from the queue shards, starting with this thread's
+ * home shard and then stealing from the others.  Expired items are freed
+ * here.  Doesn't need pool->mutex.  Returns 0 if there is no work. */
+static int get_sharded_work(struct thd *thd, struct workitem *work)
+{
+    struct thdpool *pool = thd->pool;
+    int nshards = pool->nshards;
+    int ii = 0;
+
+    while (ii < nshards) {
+        struct queue_shard *shard = &pool->shards[(thd->shard + ii) % nshards];
+        struct workitem *next = NULL;
+
+        if (listc_size(&shard->queue) == 0) {
+            ii++;
+            continue;
+        }
+        LOCK(&shard->mutex)
+        {
+            next = listc_rtl(&shard->queue);
+            if (next) {
+                memcpy(work, next, sizeof(*work));
+                pool_relablk(shard->pool, next);
+            }
+        }
+        UNLOCK(&shard->mutex);
+        if (!next) {
+            ii++;
+            continue;
+        }
+        ATOMIC_ADD(pool->nqueued, -1);
+
+        if (pool->maxqueueagems > 0 &&
+            time_epochms() - work->queue_time_ms > pool->maxqueueagems) {
+            free(work->persistent_info);
+            work->persistent_info = NULL;
+            work->work_fn(pool, work->work, NULL, THD_FREE);
+            ATOMIC_ADD(pool->num_timeout, 1);
+            continue;
+        }
+
+        if (ii > 0)
+            ATOMIC_ADD(pool->num_steals, 1);
+        ATOMIC_ADD(pool->num_dequeued, 1);
+        return 1;
+    }
+
+    return 0;
+}
+
 /* Get the next item of work for this thread to do.  Returns 0 if there
  * is no work. */
 static int get_work_ll(struct thd *thd, struct workitem *work)
@@ -520,17 +666,27 @@ static int get_work_ll(struct thd *thd, struct workitem *work)
                 }
                 thd->work.work_fn(thd->pool, next->work, NULL, THD_FREE);
                 pool_relablk(thd->pool->pool, next);
-                thd->pool->num_timeout++;
+                ATOMIC_ADD(thd->pool->num_timeout, 1);
                 continue;
             }
 
             memcpy(work, next, sizeof(*work));
             pool_relablk(thd->pool->pool, next);
-            thd->pool->num_dequeued++;
+            ATOMIC_ADD(thd->pool->num_dequeued, 1);
             thd->work.persistent_info = next->persistent_info;
             return 1;
         }
 
+        if (thd->pool->nshards && get_sharded_work(thd, work)) {
+            thd->work.persistent_info = work->persistent_info;
+            if (thd->on_freelist) {
+                listc_rfl(&thd->pool->freelist, thd);
+                thd->on_freelist = 0;
+                ATOMIC_ADD(thd->pool->nfree, -1);
+            }
+            return 1;
+        }
+
         return 0;
     }
 }
@@ -575,6 +731,22 @@ static void *thdpool_thd(void *voidarg)
     while (1) {
         int diffms;
 
+        /* With a sharded queue a busy pool hands queued work straight to
+         * whichever thread finishes first; the pool lock is only needed to
+         * go to sleep.  A new thread takes its first item, handed over in
+         * thd->work, under the lock. */
+        if (pool->nshards && work.work_fn && !work.persistent_info &&
+            !pool->wait && !pool->stopped && get_sharded_work(thd, &work)) {
+            if (work.persistent_info) {
+                LOCK(&pool->mutex)
+                {
+                    thd->work.persistent_info = work.persistent_info;
+                }
+                UNLOCK(&pool->mutex);
+            }
+            goto run_work;
+        }
+
         LOCK(&pool->mutex)
         {
             if (work.persistent_info) {
@@ -608,8 +780,10 @@ static void *thdpool_thd(void *voidarg)
                 if (pool->stopped || thr_exit) {
                     /* Thread exiting - remove from pools lists */
                     listc_rfl(&pool->thdlist, thd);
-                    if (thd->on_freelist)
+                    if (thd->on_freelist) {
                         listc_rfl(&pool->freelist, thd);
+                        ATOMIC_ADD(pool->nfree, -1);
+                    }
                     pool->num_exits++;
                     errUNLOCK(&pool->mutex);
 
@@ -624,6 +798,12 @@ static void *thdpool_thd(void *voidarg)
                 if (!thd->on_freelist) {
                     listc_atl(&pool->freelist, thd);
                     thd->on_freelist = 1;
+                    ATOMIC_ADD(pool->nfree, 1);
+                    /* A sharded enqueue that checked nfree before we got
+                     * here won't wake us, so look at the shards once more
+                     * now that we are visible on the free list. */
+                    if (pool->nshards)
+                        continue;
                 }
                 if (ts) {
                     rc = pthread_cond_timedwait(&thd->cond, &pool->mutex, ts);
@@ -647,6 +827,7 @@ static void *thdpool_thd(void *voidarg)
         }
         UNLOCK(&pool->mutex);
 
+    run_work:
         diffms = time_epochms() - work.queue_time_ms;
         if (diffms > pool->longwaitms) {
             logmsg(LOGMSG_WARN, "%s(%s): long wait %d ms\n", __func__, pool->name,
@@ -681,6 +862,86 @@ thread_exit:
     return NULL;
 }
 
+/* Queue a work item on a shard.  Producers stick to one shard per thread so
+ * that they mostly don't meet each other on a shard lock. */
+static int shard_push(struct thdpool *pool, thdpool_work_fn work_fn,
+                      void *work, char *persistent_info)
+{
+    static unsigned next_hint;
+    static __thread unsigned shard_hint;
+    struct queue_shard *shard;
+    struct workitem *item;
+
+    if (shard_hint == 0)
+        shard_hint = ATOMIC_ADD(next_hint, 1);
+    shard = &pool->shards[shard_hint % pool->nshards];
+
+    LOCK(&shard->mutex)
+    {
+        item = pool_getablk(shard->pool);
+        if (!item) {
+            errUNLOCK(&shard->mutex);
+            logmsg(LOGMSG_ERROR, "%s(%s):pool_getablk failed\n", __func__,
+                   pool->name);
+            return -1;
+        }
+        item->work = work;
+        item->work_fn = work_fn;
+        item->persistent_info = persistent_info;
+        item->queue_time_ms = time_epochms();
+        item->available = 1;
+        listc_abl(&shard->queue, item);
+    }
+    UNLOCK(&shard->mutex);
+
+    return 0;
+}
+
+/* Enqueue on a sharded pool without taking the pool mutex.  This is only
+ * attempted when every thread is busy and the pool can't grow, which is
+ * exactly when the pool mutex is most contended; anything else (free threads,
+ * thread creation, a full queue and its alarms) goes through the locked
+ * path.  Returns 0 if the work was queued, 1 to fall back. */
+static int enqueue_sharded(struct thdpool *pool, thdpool_work_fn work_fn,
+                           void *work, char *persistent_info)
+{
+    unsigned nqueued;
+
+    if (pool->stopped || pool->wait || pool->maxnthd == 0 ||
+        listc_size(&pool->thdlist) < pool->maxnthd ||
+        ATOMIC_ADD(pool->nfree, 0) > 0)
+        return 1;
+
+    nqueued = ATOMIC_ADD(pool->nqueued, 1);
+    if (nqueued > pool->maxqueue ||
+        shard_push(pool, work_fn, work, persistent_info) != 0) {
+        ATOMIC_ADD(pool->nqueued, -1);
+        return 1;
+    }
+    ATOMIC_ADD(pool->num_enqueued, 1);
+    if (nqueued > pool->peakqueue)
+        pool->peakqueue = nqueued;
+
+    /* A thread may have gone on the free list after our check above.  It
+     * bumps nfree before its last look at the shards, so either it sees our
+     * item or we see it here and wake it. */
+    if (ATOMIC_ADD(pool->nfree, 0) > 0) {
+        LOCK(&pool->mutex)
+        {
+            struct thd *thd = listc_rtl(&pool->freelist);
+            if (thd) {
+                thd->on_freelist = 0;
+                ATOMIC_ADD(pool->nfree, -1);
+                pthread_cond_signal(&thd->cond);
+            }
+        }
+        UNLOCK(&pool->mutex);
+    }
+
+    comdb2bma_yield_all();
+    return 0;
+}
+
 int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
                     int queue_override, char *persistent_info)
 {
@@ -689,6 +950,10 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
     size_t mem_sz;
     extern comdb2bma blobmem;
 
+    if (pool->nshards &&
+        enqueue_sharded(pool, work_fn, work, persistent_info) == 0)
+        return 0;
+
     LOCK(&pool->mutex)
     {
         struct thd *thd;
@@ -734,6 +999,8 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
      * work item to the new thread. */
     again:
         thd = listc_rtl(&pool->freelist);
+        if (thd)
+            ATOMIC_ADD(pool->nfree, -1);
         if (!thd && (pool->maxnthd == 0 ||
                      listc_size(&pool->thdlist) < pool->maxnthd)) {
             int rc;
@@ -749,6 +1016,7 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
 
             pthread_cond_init(&thd->cond, NULL);
             thd->pool = pool;
+            thd->shard = pool->num_creates;
             listc_atl(&pool->thdlist, thd);
 
 #ifdef MONITOR_STACK
@@ -805,24 +1073,24 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
             pool->num_passed++;
         } else {
             /* queue work */
-            if (listc_size(&pool->queue) >= pool->maxqueue) {
+            if (queue_size(pool) >= pool->maxqueue) {
                 if (queue_override &&
                     (!pool->maxqueueoverride ||
-                     listc_size(&pool->queue) <
+                     queue_size(pool) <
                          (pool->maxqueue + pool->maxqueueoverride))) {
-                    if (thdpool_alarm_on_queing(listc_size(&pool->queue))) {
+                    if (thdpool_alarm_on_queing(queue_size(pool))) {
                         int now = time_epoch();
 
                         if (now > pool->last_queue_alarm ||
-                            listc_size(&pool->queue) > pool->last_alarm_max) {
+                            queue_size(pool) > pool->last_alarm_max) {
                             logmsg(LOGMSG_USER, "%d Queing sql, queue size=%d. "
                                             "max_queue=%d "
                                             "max_queue_override=%d\n",
-                                    __LINE__, listc_size(&pool->queue),
+                                    __LINE__, queue_size(pool),
                                     pool->maxqueue, pool->maxqueueoverride);
 
                             pool->last_queue_alarm = now;
-                            pool->last_alarm_max = listc_size(&pool->queue);
+                            pool->last_alarm_max = queue_size(pool);
                         }
                     }
                 } else {
@@ -830,7 +1098,7 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
                         logmsg(LOGMSG_USER, "%d FAILED to queue sql, queue "
                                         "size=%d. max_queue=%d "
                                         "max_queue_override=%d\n",
-                                __LINE__, listc_size(&pool->queue),
+                                __LINE__, queue_size(pool),
                                 pool->maxqueue, pool->maxqueueoverride);
                     }
 
@@ -873,6 +1141,24 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
                     return -1;
                 }
             }
+            if (pool->nshards) {
+                /* Workers check the shards again under the pool mutex
+                 * before they sleep, so this can't be missed. */
+                ATOMIC_ADD(pool->nqueued, 1);
+                if (shard_push(pool, work_fn, work, persistent_info) != 0) {
+                    ATOMIC_ADD(pool->nqueued, -1);
+                    pool->num_failed_dispatches++;
+                    errUNLOCK(&pool->mutex);
+                    return -1;
+                }
+                ATOMIC_ADD(pool->num_enqueued, 1);
+                if (queue_size(pool) > pool->peakqueue) {
+                    pool->peakqueue = queue_size(pool);
+                }
+                errUNLOCK(&pool->mutex);
+                comdb2bma_yield_all();
+                return 0;
+            }
             item = pool_getablk(pool->pool);
             if (!item) {
                 pool->num_failed_dispatches++;
@@ -881,7 +1167,7 @@ int thdpool_enqueue(struct thdpool *pool, thdpool_work_fn work_fn, void *work,
                         pool->name);
                 return -1;
             }
-            pool->num_enqueued++;
+            ATOMIC_ADD(pool->num_enqueued, 1);
             listc_abl(&pool->queue, item);
 
             if (listc_size(&pool->queue) > pool->peakqueue) {
@@ -915,5 +1201,5 @@ int thdpool_get_nthds(struct thdpool *pool) { return pool->thdlist.count; }
 
 int thdpool_get_nqueuedworks(struct thdpool *pool)
 {
-    return listc_size(&pool->queue);
+    return queue_size(pool);
 }
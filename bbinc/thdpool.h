@@ -72,6 +72,7 @@ void thdpool_set_maxqueueagems(struct thdpool *pool, unsigned maxqueueagems);
 void thdpool_set_maxqueueoverride(struct thdpool *pool,
                                   unsigned maxqueueoverride);
 void thdpool_set_mem_size(struct thdpool *pool, size_t sz_bytes);
+int thdpool_set_queue_shards(struct thdpool *pool, int nshards);
 
 void thdpool_print_stats(FILE *fh, struct thdpool *pool);
 
@@ -110,6 +110,9 @@ DEF_ATTR(LOWDISKTHRESHOLD, lowdiskthreshold, PERCENT, 95)
 DEF_ATTR(SQLBULKSZ, sqlbulksz, BYTES, 2 * 1024 * 1024)
 DEF_ATTR(ZLIBLEVEL, zlib_level, QUANTITY, 6)
 DEF_ATTR(ZTRACE, ztrace, QUANTITY, 0)
+DEF_ATTR(ZSTDLEVEL, zstd_level, QUANTITY, 3)
+DEF_ATTR(ZSTD_DICT_SIZE, zstd_dict_size, BYTES, 16 * 1024)
+DEF_ATTR(ZSTD_DICT_SAMPLES, zstd_dict_samples, QUANTITY, 20000)
 DEF_ATTR(PANICLOGSNAP, paniclogsnap, BOOLEAN, 1)
 DEF_ATTR(UPDATEGENIDS, updategenids, BOOLEAN, 0)
 DEF_ATTR(ROUND_ROBIN_STRIPES, round_robin_stripes, BOOLEAN, 0)
@@ -196,6 +199,8 @@ DEF_ATTR(REPMETHODMAXSLEEP, repmethodmaxsleep, SECS, 300)
 
 DEF_ATTR(TEMPTABLE_MEM_THRESHOLD, temptable_mem_threshold, QUANTITY, 512)
 
+DEF_ATTR(TEMPTABLE_MEM_BUDGET, temptable_mem_budget, BYTES, 1048576)
+
 DEF_ATTR(TEMPTABLE_CACHESZ, temptable_cachesz, BYTES, 262144)
 
 /* the number of bits allocated for the participant stripe id.  The remaining
@@ -227,6 +232,13 @@ DEF_ATTR(DEBUGBERKDBCURSOR, dbgberkdbcursor, BOOLEAN, 0)
 
 DEF_ATTR(BULK_SQL_THRESHOLD, bulk_sql_threshold, QUANTITY, 2)
 
+/* rows unpacked per batch from a bulk data buffer; 0 unpacks one at a time */
+DEF_ATTR(BULK_SQL_BATCH_ROWS, bulk_sql_batch_rows, QUANTITY, 64)
+
+/* workers for an unordered sql scan of a striped table; 0 scans serially */
+DEF_ATTR(PARALLEL_SCAN_THREADS, parallel_scan_threads, QUANTITY, 0)
+DEF_ATTR(PARALLEL_SCAN_MIN_SIZE, parallel_scan_min_size, BYTES, 268435456)
+
 DEF_ATTR(DEBUG_BDB_LOCK_STACK, debug_bdb_lock_stack, BOOLEAN, 0)
 
 DEF_ATTR(LLMETA, llmeta, BOOLEAN, 1)
@@ -366,6 +378,9 @@ DEF_ATTR(SC_USE_NUM_THREADS, sc_use_num_threads, QUANTITY, 0)
 DEF_ATTR(SC_NO_REBUILD_THR_SLEEP, sc_no_rebuild_thr_sleep, QUANTITY, 10)
 /* force delay schemachange after every record inserted -- to have sc backoff */
 DEF_ATTR(SC_FORCE_DELAY, sc_force_delay, BOOLEAN, 0)
+/* convert this many records per transaction and add their index keys in
+ * key order -- 0 adds keys one record per transaction */
+DEF_ATTR(SC_SORTED_KEYS_BATCH, sc_sorted_keys_batch, QUANTITY, 0)
 
 /* use vtag_to_ondisk_vermap conversion function from vtag_to_ondisk */
 DEF_ATTR(USE_VTAG_ONDISK_VERMAP, use_vtag_ondisk_vermap, BOOLEAN, 1)
@@ -516,6 +531,7 @@ DEF_ATTR(REQUEST_DURABLE_LSN_TRACE, request_durable_lsn_trace, BOOLEAN, 0)
 DEF_ATTR(MASTER_LEASE_SET_TRACE, master_lease_set_trace, BOOLEAN, 0)
 DEF_ATTR(RECEIVE_START_LSN_REQUEST_TRACE, receive_start_lsn_request_trace, BOOLEAN, 0)
 DEF_ATTR(WAIT_FOR_SEQNUM_TRACE, wait_for_seqnum_trace, BOOLEAN, 0)
+DEF_ATTR(GROUP_COMMIT_WAIT, group_commit_wait, BOOLEAN, 0)
 DEF_ATTR(STARTUP_SYNC_ATTEMPTS, startup_sync_attempts, QUANTITY, 5)
 DEF_ATTR(DEBUG_TIMEPART_CRON, dbg_timepart_cron, BOOLEAN, 0)
 DEF_ATTR(DEBUG_TIMEPART_SQLITE, dbg_timepart_SQLITE, BOOLEAN, 0)
@@ -656,6 +672,18 @@ DEF_ATTR(DELAY_LOCK_TABLE_RECORD_C, delay_lock_table_record_c, MSECS, 0)
      maximum number of sql queries we can queue without alerting when
      SQL_QUEUEING_DISABLE_TRACE is on
 
+  BDB_ATTR_GROUP_COMMIT_WAIT
+     committing threads share one wait for replication: a single thread
+     waits for the highest seqnum of everyone waiting to commit, and wakes
+     all of them when it is acknowledged
+
+  BDB_ATTR_ZSTD_DICT_SIZE
+     size of the dictionary trained for a table's records when a schema
+     change rebuilds it with zstd compression; 0 disables training
+
+  BDB_ATTR_ZSTD_DICT_SAMPLES
+     maximum number of records sampled to train a zstd dictionary
+
   MASTER_REJECT_SQL_IGNORE_SANC
      normally master rejects sql if there are coherent(connected) nodes that
      are also in the sanc list.
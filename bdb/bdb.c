@@ -284,6 +284,54 @@ void bdb_get_cache_stats(bdb_state_type *bdb_state, uint64_t *hits,
     free(mpool_stats);
 }
 
+int bdb_get_cache_file_stats(bdb_state_type *bdb_state,
+                             struct bdb_cache_file_stats **stats, int *nfiles)
+{
+    DB_MPOOL_STAT *mpool_stats;
+    DB_MPOOL_FSTAT **fsp = NULL, **i;
+    struct bdb_cache_file_stats *out;
+    int n = 0, rc;
+
+    *stats = NULL;
+    *nfiles = 0;
+
+    BDB_READLOCK("bdb_get_cache_file_stats");
+    rc = bdb_state->dbenv->memp_stat(bdb_state->dbenv, &mpool_stats, &fsp, 0);
+    BDB_RELLOCK();
+    if (rc)
+        return -1;
+    free(mpool_stats);
+
+    for (i = fsp; i != NULL && *i != NULL; ++i)
+        n++;
+    out = calloc(n ? n : 1, sizeof(struct bdb_cache_file_stats));
+    if (out == NULL) {
+        free(fsp);
+        return -1;
+    }
+    for (n = 0, i = fsp; i != NULL && *i != NULL; ++i, ++n) {
+        out[n].filename = strdup((*i)->file_name);
+        out[n].pagesize = (*i)->st_pagesize;
+        out[n].hits = (*i)->st_cache_hit;
+        out[n].misses = (*i)->st_cache_miss;
+        out[n].pages_in = (*i)->st_page_in;
+        out[n].pages_out = (*i)->st_page_out;
+        out[n].promoted = (*i)->st_page_promote;
+    }
+    free(fsp);
+
+    *stats = out;
+    *nfiles = n;
+    return 0;
+}
+
+void bdb_free_cache_file_stats(struct bdb_cache_file_stats *stats, int nfiles)
+{
+    for (int i = 0; i < nfiles; i++)
+        free(stats[i].filename);
+    free(stats);
+}
+
 void add_dummy(bdb_state_type *bdb_state)
 {
     if (bdb_state->exiting)
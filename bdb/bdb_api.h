@@ -279,7 +279,10 @@ enum COMPRESS {
     BDB_COMPRESS_ZLIB = 1,
     BDB_COMPRESS_RLE8 = 2,
     BDB_COMPRESS_CRLE = 3,
-    BDB_COMPRESS_LZ4 = 4
+    BDB_COMPRESS_LZ4 = 4,
+    BDB_COMPRESS_ZSTD = 5,
+    /* on disk only: zstd frame compressed with the table's dictionary */
+    BDB_COMPRESS_ZSTD_DICT = 6
 };
 
 int bdb_compr2algo(const char *a);
@@ -1051,6 +1054,17 @@ void bdb_set_odh_options(bdb_state_type *bdb_state, int odh, int compression,
 void bdb_get_compr_flags(bdb_state_type *bdb_state, int *odh, int *compr,
                          int *blob_compr);
 
+/* zstd dictionaries for record compression.  train builds one from a sample
+ * of from's records, copy shares the dictionary of another handle, load reads
+ * it back from llmeta and save writes the handle's dictionary (or its absence)
+ * to llmeta. */
+int bdb_zstd_dict_train(bdb_state_type *bdb_state, bdb_state_type *from);
+int bdb_zstd_dict_copy(bdb_state_type *bdb_state, bdb_state_type *from);
+int bdb_zstd_dict_load(bdb_state_type *bdb_state, tran_type *tran,
+                       int newdict);
+int bdb_zstd_dict_save(bdb_state_type *bdb_state, tran_type *tran,
+                       int newdict);
+
 /* delete a table from disk.  must already be closed but NOT freed */
 int bdb_del(bdb_state_type *bdb_state, tran_type *tran, int *bdberr);
 int bdb_del_temp(bdb_state_type *bdb_state, tran_type *tran, int *bdberr);
@@ -1157,6 +1171,20 @@ int bdb_reinit(bdb_state_type *bdb_state, tran_type *tran, int *bdberr);
 void bdb_get_cache_stats(bdb_state_type *bdb_state, uint64_t *hits,
                          uint64_t *misses, uint64_t *reads, uint64_t *writes,
                          uint64_t *thits, uint64_t *tmisses);
+
+/* bufferpool counters for one file */
+struct bdb_cache_file_stats {
+    char *filename;
+    int pagesize;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t pages_in;
+    uint64_t pages_out;
+    uint64_t promoted; /* pages promoted out of scan probation */
+};
+int bdb_get_cache_file_stats(bdb_state_type *bdb_state,
+                             struct bdb_cache_file_stats **stats, int *nfiles);
+void bdb_free_cache_file_stats(struct bdb_cache_file_stats *stats, int nfiles);
 void bdb_thread_event(bdb_state_type *bdb_state, int event);
 
 void bdb_stripe_get(bdb_state_type *bdb_state);
@@ -1778,6 +1806,11 @@ int bdb_get_table_csonparameters(const char *table, char **value, int *len);
 int bdb_set_table_csonparameters(void *parent_tran, const char *table,
                                  const char *value, int len);
 int bdb_del_table_csonparameters(void *parent_tran, const char *table);
+int bdb_get_table_zstd_dict(tran_type *tran, const char *table, int newdict,
+                            char **dict, int *len);
+int bdb_set_table_zstd_dict(tran_type *tran, const char *table, int newdict,
+                            const char *dict, int len);
+int bdb_del_table_zstd_dict(tran_type *tran, const char *table, int newdict);
 int bdb_clear_table_parameter(void *parent_tran, const char *table,
                               const char *parameter);
 int bdb_get_table_parameter(const char *table, const char *parameter,
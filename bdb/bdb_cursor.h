@@ -194,4 +194,18 @@ int bdb_get_context_from_lsn(bdb_state_type *bdb_state, void *lsnp,
 
 int bdb_direct_count(bdb_cursor_ifn_t *, int ixnum, int64_t *count);
 
+/* Unordered scan of all data stripes of a table by up to nthreads workers,
+ * see stripescan.c.  bdb_stripe_scan_next returns 1 and a row that stays
+ * valid until the next call, 0 at the end, or -1 with bdberr set.
+ * bdb_stripe_scan_pause stops the workers before the caller lets go of its
+ * curtran; the next bdb_stripe_scan_next starts them again. */
+typedef struct bdb_stripe_scan bdb_stripe_scan_t;
+
+bdb_stripe_scan_t *bdb_stripe_scan_open(bdb_state_type *bdb_state,
+                                        int nthreads, int *bdberr);
+int bdb_stripe_scan_next(bdb_stripe_scan_t *scan, unsigned long long *genid,
+                         void **dta, int *dtalen, uint8_t *ver, int *bdberr);
+void bdb_stripe_scan_pause(bdb_stripe_scan_t *scan);
+void bdb_stripe_scan_close(bdb_stripe_scan_t *scan);
+
 #endif
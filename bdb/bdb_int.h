@@ -1012,6 +1012,7 @@ struct bdb_state_tag {
     pthread_cond_t durable_lsn_wait;
 
     uint16_t *fld_hints;
+    struct bdb_zstd_dict *zstd_dict; /* trained dictionary for records */
 };
 
 /* define our net user types */
@@ -1253,11 +1254,15 @@ int bdb_cget(bdb_state_type *bdb_state, DBC *dbcp, DBT *key, DBT *data,
 void init_odh(bdb_state_type *bdb_state, struct odh *odh, void *rec,
               size_t reclen, int dtanum);
 
+void bdb_zstd_dict_free(bdb_state_type *bdb_state);
+
 int bdb_pack(bdb_state_type *bdb_state, const struct odh *odh, void *to,
              size_t tolen, void **recptr, uint32_t *recsize, void **freeptr);
 
 int bdb_unpack(bdb_state_type *bdb_state, const void *from, size_t fromlen,
                void *to, size_t tolen, struct odh *odh, void **freeptr);
+int bdb_unpack_length(bdb_state_type *bdb_state, const void *from,
+                      size_t fromlen);
 
 int ip_updates_enabled_sc(bdb_state_type *bdb_state);
 int ip_updates_enabled(bdb_state_type *bdb_state);
@@ -541,6 +541,9 @@ bdb_berkdb_t *bdb_berkdb_open(bdb_cursor_impl_t *cur, int type, int maxdata,
 static void reset_bulk_bt(bdb_realdb_tag_t *bt)
 {
     bt->bulkptr = NULL;
+    bt->nrows = 0;
+    bt->currow = 0;
+    bt->batchrows = 0;
     bt->lastdtasize = 0;
     bt->lastdta = NULL;
     bt->use_bulk = 0;
@@ -627,6 +630,10 @@ static int bdb_berkdb_close_real(bdb_berkdb_t *pberkdb, int *bdberr)
         thread_free(bt->odh_tmp);
     if (bt->bulk.data)
         thread_free(bt->bulk.data);
+    if (bt->rows)
+        thread_free(bt->rows);
+    if (bt->rowmem)
+        thread_free(bt->rowmem);
     if (bt->data.data)
         thread_free(bt->data.data);
 
@@ -743,6 +750,176 @@ static int process_bulk_odh(bdb_berkdb_t *pberkdb, int *bdberr)
     return 0;
 }
 
+/* first batch of a scan; keeps LIMIT queries from unpacking rows they
+   never look at */
+#define BULK_FIRST_BATCH_ROWS 4
+
+/**
+ * Unpack a batch of records from the bulk buffer in one pass, starting at
+ * bulkptr.  The first batch of a scan is BULK_FIRST_BATCH_ROWS records, and
+ * each one after that twice the last, up to bulk_sql_batch_rows.
+ * Compressed payloads are decompressed straight into their row's slot of
+ * rowmem, and payloads shorter than lrl (vtag_to_ondisk expands them in
+ * place) are copied there; the rest are used from the bulk buffer.
+ */
+static int bulk_unpack_batch(bdb_berkdb_t *pberkdb, int *bdberr)
+{
+    bdb_berkdb_impl_t *berkdb = pberkdb->impl;
+    bdb_realdb_tag_t *bt = &berkdb->u.rl;
+    bdb_state_type *bdb_state = berkdb->cur->state;
+    int max = bdb_state->attr->bulk_sql_batch_rows;
+    int used = 0;
+    int rc;
+
+    if (bt->batchrows == 0)
+        max = MIN(max, BULK_FIRST_BATCH_ROWS);
+    else
+        max = MIN(max, bt->batchrows * 2);
+    bt->batchrows = max;
+    bt->nrows = bt->currow = 0;
+
+    if (bt->maxrows < max) {
+        bdb_bulk_row_t *rows = thread_malloc(max * sizeof(bdb_bulk_row_t));
+        if (!rows) {
+            logmsg(LOGMSG_ERROR, "%s: malloc %d rows\n", __func__, max);
+            *bdberr = BDBERR_MALLOC;
+            return -1;
+        }
+        if (bt->rows)
+            thread_free(bt->rows);
+        bt->rows = rows;
+        bt->maxrows = max;
+    }
+    if (bt->rowmemsz < max * bdb_state->lrl) {
+        char *rowmem = thread_malloc(max * bdb_state->lrl);
+        if (!rowmem) {
+            logmsg(LOGMSG_ERROR, "%s: malloc %d rows\n", __func__, max);
+            *bdberr = BDBERR_MALLOC;
+            return -1;
+        }
+        if (bt->rowmem)
+            thread_free(bt->rowmem);
+        bt->rowmem = rowmem;
+        bt->rowmemsz = max * bdb_state->lrl;
+    }
+
+    while (bt->bulkptr && bt->nrows < max) {
+        bdb_bulk_row_t *row = &bt->rows[bt->nrows];
+        void *bulkptr = bt->bulkptr;
+        void *key, *dta;
+        int keysize, dtasize, len, need;
+        char *slot;
+        struct odh odh;
+
+        DB_MULTIPLE_KEY_NEXT(bt->bulkptr, &bt->bulk, key, keysize, dta,
+                             dtasize);
+        if (!bt->bulkptr)
+            break;
+
+        len = bdb_unpack_length(bdb_state, dta, dtasize);
+        if (len < 0) {
+            *bdberr = BDBERR_UNPACK;
+            return -1;
+        }
+        need = len < bdb_state->lrl ? bdb_state->lrl : len;
+        need = (need + 7) & ~7;
+        if (used + need > bt->rowmemsz) {
+            if (bt->nrows > 0) {
+                /* full; this record starts the next batch */
+                bt->bulkptr = bulkptr;
+                break;
+            }
+            /* a single old-version record larger than the batch */
+            char *rowmem = thread_malloc(need);
+            if (!rowmem) {
+                *bdberr = BDBERR_MALLOC;
+                return -1;
+            }
+            thread_free(bt->rowmem);
+            bt->rowmem = rowmem;
+            bt->rowmemsz = need;
+        }
+        slot = bt->rowmem + used;
+
+        rc = bdb_unpack(bdb_state, dta, dtasize, slot, bt->rowmemsz - used,
+                        &odh, NULL);
+        if (rc != 0) {
+            *bdberr = BDBERR_UNPACK;
+            return -1;
+        }
+
+        if (odh.recptr == slot) {
+            used += need;
+        } else if (odh.length < bdb_state->lrl) {
+            memcpy(slot, odh.recptr, odh.length);
+            used += need;
+        } else {
+            slot = odh.recptr;
+        }
+
+        if (ip_updates_enabled(bdb_state)) {
+            unsigned long long genid;
+            memcpy(&genid, key, sizeof(genid));
+            genid = set_updateid(bdb_state, odh.updateid, genid);
+            memcpy(key, &genid, sizeof(genid));
+        }
+
+        row->key = key;
+        row->keysize = keysize;
+        row->dta = slot;
+        row->dtasize = odh.length;
+        row->ver = odh.csc2vers;
+        bt->nrows++;
+    }
+
+    *bdberr = 0;
+    return 0;
+}
+
+/**
+ * Step to the next record of the current bulk buffer; data cursors hand out
+ * rows from a batch unpacked by bulk_unpack_batch.
+ *
+ * Returns: 1 if positioned on a record, 0 if the buffer is used up,
+ *          -1 if error (bdberr set)
+ */
+static int bulk_next(bdb_berkdb_t *pberkdb, int *bdberr)
+{
+    bdb_berkdb_impl_t *berkdb = pberkdb->impl;
+    bdb_realdb_tag_t *bt = &berkdb->u.rl;
+
+    if (bt->currow >= bt->nrows) {
+        if (!bt->bulkptr)
+            return 0;
+
+        if (!bt->use_odh || berkdb->bdb_state->attr->bulk_sql_batch_rows <= 0) {
+            DB_MULTIPLE_KEY_NEXT(bt->bulkptr, &bt->bulk, bt->lastkey,
+                                 bt->lastkeysize, bt->lastdta,
+                                 bt->lastdtasize);
+            if (!bt->bulkptr)
+                return 0;
+            if (bt->use_odh && process_bulk_odh(pberkdb, bdberr))
+                return -1;
+            return 1;
+        }
+
+        if (bulk_unpack_batch(pberkdb, bdberr))
+            return -1;
+        if (bt->nrows == 0)
+            return 0;
+    }
+
+    bdb_bulk_row_t *row = &bt->rows[bt->currow++];
+    bt->lastkey = row->key;
+    bt->lastkeysize = row->keysize;
+    bt->lastdta = row->dta;
+    bt->lastdtasize = row->dtasize;
+    bt->odh.data = row->dta;
+    bt->odh.size = row->dtasize;
+    bt->ver = row->ver;
+    return 1;
+}
+
 /**
  * Position cursor on the next row:
  *    - If cursor is not initialized, this is same as "first"
@@ -775,6 +952,7 @@ int bdb_berkdb_next_real(bdb_berkdb_t *pberkdb, int *bdberr)
          * berkdb->num_nexts);*/
         bt->use_bulk = 1;
         bt->bulkptr = NULL;
+        bt->batchrows = 0;
         if (!bt->bulk.data) {
             bt->bulk.data = thread_malloc(bt->bulk.ulen);
         }
@@ -791,14 +969,11 @@ int bdb_berkdb_next_real(bdb_berkdb_t *pberkdb, int *bdberr)
     }
 
     /* try use bulk, if any */
-    if (bt->bulkptr)
-        DB_MULTIPLE_KEY_NEXT(bt->bulkptr, &bt->bulk, bt->lastkey,
-                             bt->lastkeysize, bt->lastdta, bt->lastdtasize);
-    if (bt->bulkptr) {
-        if (bt->use_odh && process_bulk_odh(pberkdb, bdberr))
-            return -1;
+    rc = bulk_next(pberkdb, bdberr);
+    if (rc < 0)
+        return -1;
+    if (rc > 0)
         return IX_FND;
-    }
 
     rc = bdb_berkdb_cget(berkdb, 1 /*use bulk if any*/, flags, bdberr);
     berkdb->at_eof = (rc != IX_FND);
@@ -808,12 +983,9 @@ int bdb_berkdb_next_real(bdb_berkdb_t *pberkdb, int *bdberr)
     /* got some data, bulk or not */
     if (bt->use_bulk) {
         DB_MULTIPLE_INIT(bt->bulkptr, &bt->bulk);
-        DB_MULTIPLE_KEY_NEXT(bt->bulkptr, &bt->bulk, bt->lastkey,
-                             bt->lastkeysize, bt->lastdta, bt->lastdtasize);
-        if (bt->use_odh) {
-            if (process_bulk_odh(pberkdb, bdberr))
-                return -1;
-        }
+        bt->nrows = bt->currow = 0;
+        if (bulk_next(pberkdb, bdberr) < 0)
+            return -1;
     }
 
     return IX_FND;
@@ -30,6 +30,15 @@ enum berkdb_t {
 
 };
 
+/* a row unpacked ahead of time from a bulk buffer */
+typedef struct bdb_bulk_row {
+    void *key;
+    int keysize;
+    void *dta; /* unpacked payload */
+    int dtasize;
+    uint8_t ver;
+} bdb_bulk_row_t;
+
 typedef struct bdb_realdb_tag {
 
     /* berkdb objects */
@@ -50,6 +59,15 @@ typedef struct bdb_realdb_tag {
     int lastdtasize;
     int lastkeysize;
 
+    /* rows of the bulk buffer already unpacked, see bulk_unpack_batch */
+    bdb_bulk_row_t *rows;
+    int nrows;
+    int currow;
+    int maxrows;
+    int batchrows; /* size of the last batch, doubles up to the attribute */
+    char *rowmem; /* copies of payloads that don't live in the bulk buffer */
+    int rowmemsz;
+
     /* ODH and inplace updates:
        there is no easy way to prevent this due to current layering.
        for now, set this if you need odh processing */
@@ -2427,6 +2427,9 @@ static DB_ENV *dbenv_open(bdb_state_type *bdb_state)
 
     dbenv->set_check_standalone(dbenv, comdb2_is_standalone);
 
+    /* let the lc cache keep log records in the buffers net read them into */
+    dbenv->set_rep_recvbuf(dbenv, net_recvbuf_hold, net_recvbuf_release);
+
     /* Register logical start and commit functions */
     dbenv->set_logical_start(dbenv, berkdb_start_logical);
     dbenv->set_logical_commit(dbenv, berkdb_commit_logical);
@@ -2449,6 +2452,10 @@ static DB_ENV *dbenv_open(bdb_state_type *bdb_state)
     net_register_handler(bdb_state->repinfo->netinfo, USER_TYPE_BERKDB_NEWSEQ,
                          berkdb_receive_rtn);
 
+    /* replicant acks shouldn't wait behind log records */
+    net_set_priority_usertype(bdb_state->repinfo->netinfo,
+                              USER_TYPE_BERKDB_NEWSEQ);
+
     net_register_handler(bdb_state->repinfo->netinfo, USER_TYPE_COMMITDELAYMORE,
                          berkdb_receive_rtn);
 
@@ -2532,6 +2539,8 @@ static DB_ENV *dbenv_open(bdb_state_type *bdb_state)
 
     net_register_handler(bdb_state->repinfo->netinfo_signal,
                          USER_TYPE_COHERENCY_LEASE, receive_coherency_lease);
+    net_set_priority_usertype(bdb_state->repinfo->netinfo_signal,
+                              USER_TYPE_COHERENCY_LEASE);
 
     net_register_handler(bdb_state->repinfo->netinfo_signal,
                          USER_TYPE_REQ_START_LSN, receive_start_lsn_request);
@@ -6837,6 +6846,7 @@ static int bdb_free_int(bdb_state_type *bdb_state, bdb_state_type *replace,
         free(child->txndir);
         free(child->tmpdir);
         free(child->fld_hints);
+        bdb_zstd_dict_free(child);
         // free bthash
         bdb_handle_dbp_drop_hash(child);
         memset(child, 0xff, sizeof(bdb_state));
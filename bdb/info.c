@@ -329,7 +329,9 @@ static void rep_stats(FILE *out, bdb_state_type *bdb_state)
     char str[80];
     extern int64_t gbl_rep_trans_parallel, gbl_rep_trans_serial,
         gbl_rep_trans_deadlocked, gbl_rep_trans_inline,
-        gbl_rep_rowlocks_multifile;
+        gbl_rep_rowlocks_multifile, gbl_rep_trans_page_chains,
+        gbl_rep_page_chains, gbl_group_wait_commits, gbl_group_wait_batches,
+        gbl_group_wait_max_batch, gbl_group_wait_ms;
 
     bdb_state->dbenv->rep_stat(bdb_state->dbenv, &stats, 0);
 
@@ -381,6 +383,16 @@ static void rep_stats(FILE *out, bdb_state_type *bdb_state)
     logmsgf(LOGMSG_USER, out, "txn serial: %lld\n", gbl_rep_trans_serial);
     logmsgf(LOGMSG_USER, out, "txn inline: %lld\n", gbl_rep_trans_inline);
     logmsgf(LOGMSG_USER, out, "txn multifile rowlocks: %lld\n", gbl_rep_rowlocks_multifile);
+    logmsgf(LOGMSG_USER, out, "txn split into page chains: %lld\n",
+            gbl_rep_trans_page_chains);
+    logmsgf(LOGMSG_USER, out, "page chain queues: %lld\n", gbl_rep_page_chains);
+    logmsgf(LOGMSG_USER, out, "group commit waits: %lld commits in %lld batches, "
+            "max batch %lld, avg wait %.2f ms\n",
+            gbl_group_wait_commits, gbl_group_wait_batches,
+            gbl_group_wait_max_batch,
+            gbl_group_wait_batches
+                ? (double)gbl_group_wait_ms / gbl_group_wait_batches
+                : 0.0);
     logmsgf(LOGMSG_USER, out, "txn deadlocked: %lld\n", gbl_rep_trans_deadlocked);
     prn_lstat(lc_cache_hits);
     prn_lstat(lc_cache_misses);
@@ -553,6 +565,11 @@ static void cache_stats(FILE *out, bdb_state_type *bdb_state, int extra)
     prn_stat(st_alloc_max_pages);
     prn_stat(st_ckp_pages_sync);
     prn_stat(st_ckp_pages_skip);
+    prn_stat(st_page_promote);
+    prn_stat(st_ckp_pages_total);
+    prn_stat(st_ckp_pages_written);
+    prn_stat(st_ckp_ms);
+    prn_stat(st_ckp_pages_per_sec);
 
     if (extra) {
         bdb_state->dbenv->memp_dump_region(bdb_state->dbenv, "A", out);
@@ -577,6 +594,8 @@ static void cache_stats(FILE *out, bdb_state_type *bdb_state, int extra)
                     (unsigned)(*i)->st_page_create);
             logmsgf(LOGMSG_USER, out, "  st_page_in    : %u\n", (unsigned)(*i)->st_page_in);
             logmsgf(LOGMSG_USER, out, "  st_page_out   : %u\n", (unsigned)(*i)->st_page_out);
+            logmsgf(LOGMSG_USER, out, "  st_page_promote: %u\n",
+                    (unsigned)(*i)->st_page_promote);
         }
 
         free(fsp);
@@ -156,7 +156,11 @@ typedef enum {
     LLMETA_VERSIONED_SP = 42,
     LLMETA_DEFAULT_VERSIONED_SP = 43,
     LLMETA_TABLE_USER_SCHEMA    = 44,
-    LLMETA_USER_PASSWORD_HASH   = 45
+    LLMETA_USER_PASSWORD_HASH   = 45,
+    LLMETA_TABLE_ZSTD_DICT      = 46, /* zstd dictionary for a table's records
+                                         key = 46 + TABLENAME */
+    LLMETA_TABLE_ZSTD_DICT_NEW  = 47  /* dictionary trained by an ongoing
+                                         schema change, kept for resume */
 } llmetakey_t;
 
 struct llmeta_file_type_key {
@@ -7218,8 +7222,8 @@ retry:
  *  1: not found
  * -1: error
  */
-static int llmeta_get_blob(llmetakey_t key, const char *table, char **value,
-                           int *len)
+static int llmeta_get_blob_tran(tran_type *tran, llmetakey_t key,
+                                const char *table, char **value, int *len)
 {
 #ifdef DEBUG
     fprintf(stderr, "%s\n", __func__);
@@ -7227,7 +7231,6 @@ static int llmeta_get_blob(llmetakey_t key, const char *table, char **value,
     if (llmeta_bdb_state == NULL)
         return -1;
     int rc, bdberr;
-    void *tran;
     char *tmpstr = NULL;
     char llkey[LLMETA_IXLEN] = {0};
     int retry = 0;
@@ -7239,12 +7242,12 @@ static int llmeta_get_blob(llmetakey_t key, const char *table, char **value,
                strnlen(table, LLMETA_IXLEN - sizeof(key)));
 
 rep:
-    if ((rc = bdb_lite_exact_var_fetch_tran(llmeta_bdb_state, NULL, llkey,
+    if ((rc = bdb_lite_exact_var_fetch_tran(llmeta_bdb_state, tran, llkey,
                                             (void **)&tmpstr, len, &bdberr)) ==
         0) {
         assert(tmpstr != NULL);
         *value = malloc(*len + 1);
-        strncpy(*value, tmpstr, *len);
+        memcpy(*value, tmpstr, *len);
         (*value)[*len] = '\0';
 #ifdef DEBUG
         fprintf(
@@ -7271,6 +7274,12 @@ rep:
     return rc;
 }
 
+static inline int llmeta_get_blob(llmetakey_t key, const char *table,
+                                  char **value, int *len)
+{
+    return llmeta_get_blob_tran(NULL, key, table, value, len);
+}
+
 /* find & delete old -> add new
  * returns 0: success
  *  -1: error
@@ -7394,6 +7403,32 @@ int bdb_del_table_csonparameters(void *parent_tran, const char *table)
     return llmeta_del_blob(parent_tran, LLMETA_TABLE_PARAMETERS, table);
 }
 
+/* zstd dictionary used to compress the records of tbl; newdict selects the
+ * copy saved by a schema change that is still converting records.
+ * NB: caller needs to free that memory area */
+int bdb_get_table_zstd_dict(tran_type *tran, const char *table, int newdict,
+                            char **dict, int *len)
+{
+    return llmeta_get_blob_tran(
+        tran, newdict ? LLMETA_TABLE_ZSTD_DICT_NEW : LLMETA_TABLE_ZSTD_DICT,
+        table, dict, len);
+}
+
+int bdb_set_table_zstd_dict(tran_type *tran, const char *table, int newdict,
+                            const char *dict, int len)
+{
+    return llmeta_set_blob(
+        tran, newdict ? LLMETA_TABLE_ZSTD_DICT_NEW : LLMETA_TABLE_ZSTD_DICT,
+        table, dict, len);
+}
+
+int bdb_del_table_zstd_dict(tran_type *tran, const char *table, int newdict)
+{
+    return llmeta_del_blob(
+        tran, newdict ? LLMETA_TABLE_ZSTD_DICT_NEW : LLMETA_TABLE_ZSTD_DICT,
+        table);
+}
+
 #include <cson_amalgamation_core.h>
 
 /* return parameter for tbl into value
@@ -13,7 +13,7 @@ bdb_SOURCES:=bdb/callback.c bdb/rep.c bdb/bdb.c				\
     bdb/llmeta.c bdb/queue.c bdb/custom_recover.c bdb/info.c		\
     bdb/bdb_osqlcur.c bdb/cursor.c bdb/fetch.c bdb/read.c bdb/phys.c	\
     bdb/bdblock.c bdb/attr.c bdb/locktest.c bdb/berktest.c		\
-    bdb/bdb_llops.c bdb/bdb_blkseq.c bdb/queuedb.c
+    bdb/bdb_llops.c bdb/bdb_blkseq.c bdb/queuedb.c bdb/stripescan.c
 bdb_GENSOURCES:=bdb/llog_auto.c
 bdb_GENOBJS:=$(bdb_GENSOURCES:.c=.o)
 bdb_OBJS:=$(bdb_SOURCES:.c=.o) $(bdb_GENOBJS)
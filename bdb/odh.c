@@ -45,6 +45,8 @@
 #include <comdb2rle.h>
 
 #include <lz4.h>
+#include <zstd.h>
+#include <zdict.h>
 #include <logmsg.h>
 
 #if LZ4_VERSION_NUMBER < 10701
@@ -150,6 +152,9 @@ const char *bdb_algo2compr(int alg)
         return "crle";
     case BDB_COMPRESS_LZ4:
         return "lz4 ";
+    case BDB_COMPRESS_ZSTD:
+    case BDB_COMPRESS_ZSTD_DICT:
+        return "zstd";
     default:
         return "????";
     }
@@ -165,6 +170,8 @@ int bdb_compr2algo(const char *a)
         return BDB_COMPRESS_CRLE;
     if (strncasecmp(a, "lz4", 3) == 0)
         return BDB_COMPRESS_LZ4;
+    if (strcasecmp(a, "zstd") == 0)
+        return BDB_COMPRESS_ZSTD;
     return BDB_COMPRESS_NONE;
 }
 
@@ -269,10 +276,127 @@ void init_odh(bdb_state_type *bdb_state, struct odh *odh, void *rec,
     if (is_blob) {
         odh->flags |= (bdb_state->compress_blobs & ODH_FLAG_COMPR_MASK);
     } else {
-        odh->flags |= (bdb_state->compress & ODH_FLAG_COMPR_MASK);
+        int alg = bdb_state->compress;
+        if (alg == BDB_COMPRESS_ZSTD && bdb_state->zstd_dict)
+            alg = BDB_COMPRESS_ZSTD_DICT;
+        odh->flags |= (alg & ODH_FLAG_COMPR_MASK);
     }
 }
 
+/* A table's zstd dictionary.  Records compressed with it are flagged
+ * BDB_COMPRESS_ZSTD_DICT and carry the dictionary id in their zstd frame. */
+struct bdb_zstd_dict {
+    void *raw;
+    size_t len;
+    unsigned id;
+    int refs; /* the handle's, plus one per thread (de)compressing with it */
+    ZSTD_CDict *cdict;
+    ZSTD_DDict *ddict;
+};
+
+/* A schema change can replace a live handle's dictionary while other threads
+ * are compressing or decompressing with it.  They hold a reference for the
+ * duration; the handle's pointer is swapped, and references taken, under a
+ * lock striped by handle. */
+#define ZSTD_DICT_LOCKS 16
+static pthread_mutex_t zstd_dict_lk[ZSTD_DICT_LOCKS] = {
+    [0 ... ZSTD_DICT_LOCKS - 1] = PTHREAD_MUTEX_INITIALIZER};
+
+static inline pthread_mutex_t *zstd_dict_lock(bdb_state_type *bdb_state)
+{
+    return &zstd_dict_lk[((uintptr_t)bdb_state >> 6) % ZSTD_DICT_LOCKS];
+}
+
+static void zstd_dict_destroy(struct bdb_zstd_dict *dict)
+{
+    ZSTD_freeCDict(dict->cdict);
+    ZSTD_freeDDict(dict->ddict);
+    free(dict->raw);
+    free(dict);
+}
+
+static struct bdb_zstd_dict *zstd_dict_get(bdb_state_type *bdb_state)
+{
+    pthread_mutex_t *lk = zstd_dict_lock(bdb_state);
+    struct bdb_zstd_dict *dict;
+
+    pthread_mutex_lock(lk);
+    if ((dict = bdb_state->zstd_dict) != NULL)
+        dict->refs++;
+    pthread_mutex_unlock(lk);
+    return dict;
+}
+
+static void zstd_dict_put(bdb_state_type *bdb_state,
+                          struct bdb_zstd_dict *dict)
+{
+    pthread_mutex_t *lk = zstd_dict_lock(bdb_state);
+    int last;
+
+    if (dict == NULL)
+        return;
+    pthread_mutex_lock(lk);
+    last = (--dict->refs == 0);
+    pthread_mutex_unlock(lk);
+    if (last)
+        zstd_dict_destroy(dict);
+}
+
+/* Make dict the handle's dictionary; the old one goes when its last reader
+ * is done with it */
+static void zstd_dict_swap(bdb_state_type *bdb_state,
+                           struct bdb_zstd_dict *dict)
+{
+    pthread_mutex_t *lk = zstd_dict_lock(bdb_state);
+    struct bdb_zstd_dict *old;
+
+    pthread_mutex_lock(lk);
+    old = bdb_state->zstd_dict;
+    bdb_state->zstd_dict = dict;
+    pthread_mutex_unlock(lk);
+    zstd_dict_put(bdb_state, old);
+}
+
+/* zstd wants a context per compressing/decompressing thread */
+static pthread_once_t zstd_once = PTHREAD_ONCE_INIT;
+static pthread_key_t zstd_cctx_key;
+static pthread_key_t zstd_dctx_key;
+
+static void zstd_free_cctx(void *cctx) { ZSTD_freeCCtx(cctx); }
+
+static void zstd_free_dctx(void *dctx) { ZSTD_freeDCtx(dctx); }
+
+static void zstd_init_keys(void)
+{
+    if (pthread_key_create(&zstd_cctx_key, zstd_free_cctx) ||
+        pthread_key_create(&zstd_dctx_key, zstd_free_dctx)) {
+        logmsg(LOGMSG_FATAL, "%s: pthread_key_create failed\n", __func__);
+        abort();
+    }
+}
+
+static ZSTD_CCtx *zstd_cctx(void)
+{
+    ZSTD_CCtx *cctx;
+    pthread_once(&zstd_once, zstd_init_keys);
+    if ((cctx = pthread_getspecific(zstd_cctx_key)) == NULL) {
+        cctx = ZSTD_createCCtx();
+        pthread_setspecific(zstd_cctx_key, cctx);
+    }
+    return cctx;
+}
+
+static ZSTD_DCtx *zstd_dctx(void)
+{
+    ZSTD_DCtx *dctx;
+    pthread_once(&zstd_once, zstd_init_keys);
+    if ((dctx = pthread_getspecific(zstd_dctx_key)) == NULL) {
+        dctx = ZSTD_createDCtx();
+        pthread_setspecific(zstd_dctx_key, dctx);
+    }
+    return dctx;
+}
+
 /* Pack a record ready for storage on disk with the ODH (if enabled).
  *
  * Input:
@@ -418,6 +542,48 @@ int bdb_pack(bdb_state_type *bdb_state, const struct odh *odh, void *to,
                 *recsize = rc + ODH_SIZE;
             }
             break;
+
+        case BDB_COMPRESS_ZSTD:
+        case BDB_COMPRESS_ZSTD_DICT: {
+            struct bdb_zstd_dict *dict = NULL;
+            ZSTD_CCtx *cctx = zstd_cctx();
+            size_t zrc;
+
+            if (cctx == NULL || odh->length < 2) {
+                alg = BDB_COMPRESS_NONE;
+                break;
+            }
+            if (alg == BDB_COMPRESS_ZSTD_DICT)
+                dict = zstd_dict_get(bdb_state);
+            if (dict) {
+                zrc = ZSTD_compress_usingCDict(cctx, (char *)to + ODH_SIZE,
+                                               odh->length - 1, odh->recptr,
+                                               odh->length, dict->cdict);
+            } else {
+                alg = BDB_COMPRESS_ZSTD;
+                zrc = ZSTD_compressCCtx(cctx, (char *)to + ODH_SIZE,
+                                        odh->length - 1, odh->recptr,
+                                        odh->length,
+                                        bdb_state->attr->zstd_level);
+            }
+            zstd_dict_put(bdb_state, dict);
+            if (ZSTD_isError(zrc)) {
+                alg = BDB_COMPRESS_NONE;
+                if (bdb_state->attr->ztrace) {
+                    logmsg(LOGMSG_USER, "no zstd compression gain for %u bytes\n",
+                           (unsigned)odh->length);
+                }
+            } else {
+                if (bdb_state->attr->ztrace) {
+                    logmsg(LOGMSG_USER, "%s zstd compressed %u bytes -> %u\n",
+                           bdb_state->name, (unsigned)odh->length,
+                           (unsigned)zrc);
+                }
+                flags = (flags & ~ODH_FLAG_COMPR_MASK) | alg;
+                *recsize = zrc + ODH_SIZE;
+            }
+            break;
+        }
         }
 
         if (alg == BDB_COMPRESS_NONE) {
@@ -598,6 +764,41 @@ static int bdb_unpack_updateid(bdb_state_type *bdb_state, const void *from,
                 if (rc != fromlen - ODH_SIZE) {
                     goto err;
                 }
+            } else if (alg == BDB_COMPRESS_ZSTD ||
+                       alg == BDB_COMPRESS_ZSTD_DICT) {
+                const char *src = (const char *)from + ODH_SIZE;
+                ZSTD_DCtx *dctx = zstd_dctx();
+                size_t zrc;
+
+                if (dctx == NULL)
+                    goto err;
+                if (alg == BDB_COMPRESS_ZSTD_DICT) {
+                    struct bdb_zstd_dict *dict = zstd_dict_get(bdb_state);
+                    unsigned id =
+                        ZSTD_getDictID_fromFrame(src, fromlen - ODH_SIZE);
+                    if (dict == NULL || dict->id != id) {
+                        logmsg(LOGMSG_ERROR,
+                               "%s:ERROR %s has no zstd dictionary %u\n",
+                               __func__, bdb_state->name, id);
+                        zstd_dict_put(bdb_state, dict);
+                        goto err;
+                    }
+                    zrc = ZSTD_decompress_usingDDict(dctx, to, odh->length,
+                                                     src, fromlen - ODH_SIZE,
+                                                     dict->ddict);
+                    zstd_dict_put(bdb_state, dict);
+                } else {
+                    zrc = ZSTD_decompressDCtx(dctx, to, odh->length, src,
+                                              fromlen - ODH_SIZE);
+                }
+                if (ZSTD_isError(zrc) || zrc != odh->length) {
+                    logmsg(LOGMSG_ERROR,
+                           "%s:ERROR zstd decompress %u->%u: %s\n", __func__,
+                           (unsigned)fromlen - ODH_SIZE, (unsigned)odh->length,
+                           ZSTD_isError(zrc) ? ZSTD_getErrorName(zrc)
+                                             : "bad length");
+                    goto err;
+                }
             }
 
             /* Successfully decompressed */
@@ -644,6 +845,20 @@ int bdb_unpack(bdb_state_type *bdb_state, const void *from, size_t fromlen,
                                freeptr, 1);
 }
 
+/* Length of the payload bdb_unpack() will produce for this record */
+int bdb_unpack_length(bdb_state_type *bdb_state, const void *from,
+                      size_t fromlen)
+{
+    struct odh odh;
+
+    if (!bdb_state->ondisk_header)
+        return fromlen;
+    if (fromlen < ODH_SIZE)
+        return -1;
+    read_odh(from, &odh);
+    return odh.length;
+}
+
 static int bdb_write_updateid(bdb_state_type *bdb_state, void *buf,
                               size_t buflen, int updateid)
 {
@@ -1356,6 +1571,7 @@ int bdb_validate_compression_alg(int alg)
     case BDB_COMPRESS_ZLIB:
     case BDB_COMPRESS_RLE8:
     case BDB_COMPRESS_CRLE:
+    case BDB_COMPRESS_ZSTD:
         return alg;
     }
     return -1;
@@ -1375,3 +1591,183 @@ void bdb_set_fld_hints(bdb_state_type *bdb_state, uint16_t *hints)
         free(bdb_state->fld_hints);
     bdb_state->fld_hints = hints;
 }
+
+static struct bdb_zstd_dict *zstd_dict_create(bdb_state_type *bdb_state,
+                                              const void *raw, size_t len)
+{
+    struct bdb_zstd_dict *dict = calloc(1, sizeof(*dict));
+    if (dict == NULL)
+        return NULL;
+    dict->raw = malloc(len);
+    if (dict->raw == NULL)
+        goto err;
+    memcpy(dict->raw, raw, len);
+    dict->len = len;
+    dict->id = ZSTD_getDictID_fromDict(raw, len);
+    dict->refs = 1;
+    dict->cdict = ZSTD_createCDict(raw, len, bdb_state->attr->zstd_level);
+    dict->ddict = ZSTD_createDDict(raw, len);
+    if (dict->cdict == NULL || dict->ddict == NULL)
+        goto err;
+    return dict;
+
+err:
+    logmsg(LOGMSG_ERROR, "%s: %s: can't create %zu byte zstd dictionary\n",
+           __func__, bdb_state->name, len);
+    zstd_dict_destroy(dict);
+    return NULL;
+}
+
+void bdb_zstd_dict_free(bdb_state_type *bdb_state)
+{
+    zstd_dict_swap(bdb_state, NULL);
+}
+
+/* Train a dictionary for bdb_state's records from a sample of from's records.
+ * Only call this before anything is written to bdb_state, the records it
+ * compresses can't be read back without the dictionary.  Tables too small to
+ * train on are left to compress without one. */
+int bdb_zstd_dict_train(bdb_state_type *bdb_state, bdb_state_type *from)
+{
+    size_t dictsz = bdb_state->attr->zstd_dict_size;
+    unsigned maxsamples = bdb_state->attr->zstd_dict_samples;
+    struct dtadump *dump;
+    char *samples = NULL;
+    size_t *sizes = NULL;
+    size_t len = 0, cap = 0, zrc;
+    unsigned nsamples = 0;
+    void *dict = NULL;
+    int rc = 0, bdberr = 0;
+
+    bdb_zstd_dict_free(bdb_state);
+    if (dictsz == 0 || maxsamples == 0)
+        return 0;
+
+    if ((dump = bdb_dtadump_start(from, &bdberr, 0, 0)) == NULL) {
+        logmsg(LOGMSG_ERROR, "%s: bdb_dtadump_start bdberr %d\n", __func__,
+               bdberr);
+        return -1;
+    }
+    if ((sizes = malloc(maxsamples * sizeof(size_t))) == NULL) {
+        rc = -1;
+        goto done;
+    }
+
+    /* zstd suggests ~100 times the dictionary size worth of samples */
+    while (nsamples < maxsamples && len < dictsz * 100) {
+        unsigned long long genid;
+        uint8_t ver;
+        void *dta;
+        int dtalen, rrn;
+
+        rc = bdb_dtadump_next(from, dump, &dta, &dtalen, &rrn, &genid, &ver,
+                              &bdberr);
+        if (rc) {
+            rc = (rc == 1) ? 0 : -1;
+            break;
+        }
+        if (len + dtalen > cap) {
+            char *n;
+            cap = (len + dtalen) * 2;
+            if ((n = realloc(samples, cap)) == NULL) {
+                rc = -1;
+                break;
+            }
+            samples = n;
+        }
+        memcpy(samples + len, dta, dtalen);
+        sizes[nsamples++] = dtalen;
+        len += dtalen;
+    }
+
+done:
+    bdb_dtadump_done(from, dump);
+    if (rc) {
+        logmsg(LOGMSG_ERROR, "%s: %s: failed sampling records bdberr %d\n",
+               __func__, bdb_state->name, bdberr);
+        goto out;
+    }
+
+    if ((dict = malloc(dictsz)) == NULL) {
+        rc = -1;
+        goto out;
+    }
+    zrc = ZDICT_trainFromBuffer(dict, dictsz, samples, sizes, nsamples);
+    if (ZDICT_isError(zrc)) {
+        logmsg(LOGMSG_INFO, "%s: %s: no zstd dictionary from %u records: %s\n",
+               __func__, bdb_state->name, nsamples, ZDICT_getErrorName(zrc));
+        goto out;
+    }
+    struct bdb_zstd_dict *trained = zstd_dict_create(bdb_state, dict, zrc);
+    if (trained == NULL) {
+        rc = -1;
+        goto out;
+    }
+    logmsg(LOGMSG_INFO,
+           "%s: %s: trained %zu byte zstd dictionary %u from %u records\n",
+           __func__, bdb_state->name, zrc, trained->id, nsamples);
+    zstd_dict_swap(bdb_state, trained);
+
+out:
+    free(dict);
+    free(sizes);
+    free(samples);
+    return rc;
+}
+
+/* Give bdb_state its own copy of from's dictionary, for a new handle on data
+ * files that from's records were compressed into. */
+int bdb_zstd_dict_copy(bdb_state_type *bdb_state, bdb_state_type *from)
+{
+    struct bdb_zstd_dict *src = zstd_dict_get(from), *dict = NULL;
+
+    if (src) {
+        dict = zstd_dict_create(bdb_state, src->raw, src->len);
+        zstd_dict_put(from, src);
+        if (dict == NULL)
+            return -1;
+    }
+    zstd_dict_swap(bdb_state, dict);
+    return 0;
+}
+
+/* Load the table's dictionary from llmeta, or the one saved by a schema change
+ * still converting the table if newdict is set. */
+int bdb_zstd_dict_load(bdb_state_type *bdb_state, tran_type *tran, int newdict)
+{
+    struct bdb_zstd_dict *dict;
+    char *raw = NULL;
+    int rc, len;
+
+    rc = bdb_get_table_zstd_dict(tran, bdb_state->name, newdict, &raw, &len);
+    if (rc == 1) {
+        bdb_zstd_dict_free(bdb_state);
+        return 0;
+    } else if (rc) {
+        return -1;
+    }
+    dict = zstd_dict_create(bdb_state, raw, len);
+    free(raw);
+    if (dict == NULL)
+        return -1;
+    zstd_dict_swap(bdb_state, dict);
+    return 0;
+}
+
+/* Save the handle's dictionary (or drop the stored one if it has none).
+ * Saving the table's dictionary retires the one kept for a schema change. */
+int bdb_zstd_dict_save(bdb_state_type *bdb_state, tran_type *tran, int newdict)
+{
+    struct bdb_zstd_dict *dict = zstd_dict_get(bdb_state);
+    int rc;
+
+    if (dict)
+        rc = bdb_set_table_zstd_dict(tran, bdb_state->name, newdict, dict->raw,
+                                     dict->len);
+    else
+        rc = bdb_del_table_zstd_dict(tran, bdb_state->name, newdict);
+    zstd_dict_put(bdb_state, dict);
+    if (rc == 0 && !newdict)
+        rc = bdb_del_table_zstd_dict(tran, bdb_state->name, 1);
+    return rc;
+}
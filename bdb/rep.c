@@ -3306,18 +3306,199 @@ done_wait:
     return outrc;
 }
 
+/*
+  group commit for the replication wait.  rather than every committing
+  thread waiting for its own seqnum, one thread (the leader) waits for the
+  highest seqnum of everyone that is waiting.  threads that show up while
+  the leader's first wait is in progress join its round: once that wait
+  succeeds, the leader waits once more for the highest of them.  threads
+  that show up during that second wait are picked up by the next round.
+  a thread is done as soon as a successful wait covered its seqnum; one
+  whose round failed, or outlived its own timeout, waits for itself, so the
+  coherency handling in bdb_wait_for_seqnum_from_all_int() sees every
+  transaction that needs it.  callers with and without the new coherency
+  logic never share a wait.
+*/
+struct group_wait {
+    pthread_mutex_t lk;
+    pthread_cond_t cd;
+    int in_wait;         /* a leader is waiting */
+    int extending;       /* the leader is waiting for the late arrivals */
+    uint64_t round;      /* bumped when a leader finishes */
+    seqnum_type waiting; /* what the leader is waiting for */
+    int ncovered;        /* followers in the current round */
+    int have_late;       /* someone joined after the leader started */
+    seqnum_type late;    /* highest seqnum that joined late */
+    int have_pending;    /* someone is waiting for the next round */
+    seqnum_type pending; /* highest seqnum waiting for the next round */
+    int have_acked;      /* a wait succeeded */
+    seqnum_type acked;   /* highest seqnum a wait succeeded for */
+    int acked_timeoutms; /* total timeout that wait allowed */
+};
+
+static struct group_wait group_wait[2] = {
+    {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER},
+    {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER}};
+
+int64_t gbl_group_wait_commits = 0, gbl_group_wait_batches = 0,
+        gbl_group_wait_max_batch = 0, gbl_group_wait_ms = 0;
+
+static inline void group_wait_max(bdb_state_type *bdb_state, int *have,
+                                  seqnum_type *max, seqnum_type *seqnum)
+{
+    if (!*have || bdb_seqnum_compare(bdb_state, seqnum, max) > 0) {
+        *max = *seqnum;
+        *have = 1;
+    }
+}
+
+static inline int group_wait_acked(bdb_state_type *bdb_state,
+                                   struct group_wait *g, seqnum_type *seqnum,
+                                   int *timeoutms)
+{
+    if (!g->have_acked || bdb_seqnum_compare(bdb_state, seqnum, &g->acked) > 0)
+        return 0;
+    *timeoutms = g->acked_timeoutms;
+    return 1;
+}
+
+/* Wait for the round to end; 0 if we ran past our deadline first */
+static int group_wait_round(struct group_wait *g, struct timespec *deadline)
+{
+    uint64_t myround = g->round;
+    int rc = 0;
+
+    while (g->round == myround && rc != ETIMEDOUT)
+        rc = pthread_cond_timedwait(&g->cd, &g->lk, deadline);
+    return g->round != myround;
+}
+
+static int bdb_wait_for_seqnum_from_all_group(bdb_state_type *bdb_state,
+                                              seqnum_type *seqnum,
+                                              int *timeoutms, uint64_t txnsize,
+                                              int newcoh)
+{
+    struct group_wait *g = &group_wait[newcoh ? 1 : 0];
+    struct timespec deadline;
+    seqnum_type waitfor;
+    int batch, rc, start, waitms, exttimeoutms;
+
+    if (bdb_state->parent)
+        bdb_state = bdb_state->parent;
+
+    if (!bdb_state->attr->group_commit_wait)
+        return bdb_wait_for_seqnum_from_all_int(bdb_state, seqnum, timeoutms,
+                                                txnsize, newcoh);
+
+    /* how long we follow someone else's wait: our own timeout, or as long
+       as an adaptive wait could take */
+    waitms = *timeoutms;
+    if (waitms <= 0)
+        waitms = bdb_state->attr->rep_timeout_maxms +
+                 bdb_state->attr->rep_timeout_minms;
+    setup_waittime(&deadline, waitms);
+
+    Pthread_mutex_lock(&g->lk);
+    gbl_group_wait_commits++;
+    while (1) {
+        if (group_wait_acked(bdb_state, g, seqnum, timeoutms)) {
+            Pthread_mutex_unlock(&g->lk);
+            return 0;
+        }
+        if (!g->in_wait)
+            break;
+
+        if (!g->extending ||
+            bdb_seqnum_compare(bdb_state, seqnum, &g->waiting) <= 0) {
+            /* join this round */
+            if (bdb_seqnum_compare(bdb_state, seqnum, &g->waiting) > 0)
+                group_wait_max(bdb_state, &g->have_late, &g->late, seqnum);
+            g->ncovered++;
+            if (group_wait_round(g, &deadline) &&
+                group_wait_acked(bdb_state, g, seqnum, timeoutms)) {
+                Pthread_mutex_unlock(&g->lk);
+                return 0;
+            }
+            Pthread_mutex_unlock(&g->lk);
+            return bdb_wait_for_seqnum_from_all_int(bdb_state, seqnum,
+                                                    timeoutms, txnsize, newcoh);
+        }
+
+        /* too late for this round, be in the next one */
+        group_wait_max(bdb_state, &g->have_pending, &g->pending, seqnum);
+        if (!group_wait_round(g, &deadline)) {
+            Pthread_mutex_unlock(&g->lk);
+            return bdb_wait_for_seqnum_from_all_int(bdb_state, seqnum,
+                                                    timeoutms, txnsize, newcoh);
+        }
+    }
+
+    /* we are the leader: wait for everyone queued up behind the last wait */
+    waitfor = *seqnum;
+    if (g->have_pending &&
+        bdb_seqnum_compare(bdb_state, &g->pending, &waitfor) > 0)
+        waitfor = g->pending;
+    g->waiting = waitfor;
+    g->have_pending = 0;
+    g->have_late = 0;
+    g->ncovered = 0;
+    g->extending = 0;
+    g->in_wait = 1;
+    Pthread_mutex_unlock(&g->lk);
+
+    start = time_epochms();
+    rc = bdb_wait_for_seqnum_from_all_int(bdb_state, &waitfor, timeoutms,
+                                          txnsize, newcoh);
+
+    Pthread_mutex_lock(&g->lk);
+    if (rc == 0) {
+        group_wait_max(bdb_state, &g->have_acked, &g->acked, &waitfor);
+        g->acked_timeoutms = *timeoutms;
+    }
+    if (rc == 0 && g->have_late) {
+        /* the ones who joined while we waited */
+        waitfor = g->late;
+        g->waiting = waitfor;
+        g->have_late = 0;
+        g->extending = 1;
+        Pthread_mutex_unlock(&g->lk);
+
+        exttimeoutms = *timeoutms;
+        int extrc = bdb_wait_for_seqnum_from_all_int(
+            bdb_state, &waitfor, &exttimeoutms, txnsize, newcoh);
+
+        Pthread_mutex_lock(&g->lk);
+        if (extrc == 0) {
+            group_wait_max(bdb_state, &g->have_acked, &g->acked, &waitfor);
+            g->acked_timeoutms = exttimeoutms;
+        }
+    }
+    batch = g->ncovered + 1;
+    gbl_group_wait_batches++;
+    gbl_group_wait_ms += time_epochms() - start;
+    if (batch > gbl_group_wait_max_batch)
+        gbl_group_wait_max_batch = batch;
+    g->in_wait = 0;
+    g->extending = 0;
+    g->round++;
+    pthread_cond_broadcast(&g->cd);
+    Pthread_mutex_unlock(&g->lk);
+
+    return rc;
+}
+
 int bdb_wait_for_seqnum_from_all(bdb_state_type *bdb_state, seqnum_type *seqnum)
 {
     int timeoutms = bdb_state->attr->reptimeout * MILLISEC;
-    return bdb_wait_for_seqnum_from_all_int(bdb_state, seqnum, &timeoutms, 0,
-                                            0);
+    return bdb_wait_for_seqnum_from_all_group(bdb_state, seqnum, &timeoutms,
+                                              0, 0);
 }
 
 int bdb_wait_for_seqnum_from_all_timeout(bdb_state_type *bdb_state,
                                          seqnum_type *seqnum, int timeoutms)
 {
-    return bdb_wait_for_seqnum_from_all_int(bdb_state, seqnum, &timeoutms, 0,
-                                            0);
+    return bdb_wait_for_seqnum_from_all_group(bdb_state, seqnum, &timeoutms,
+                                              0, 0);
 }
 
 int bdb_wait_for_seqnum_from_all_adaptive(bdb_state_type *bdb_state,
@@ -3325,8 +3506,8 @@ int bdb_wait_for_seqnum_from_all_adaptive(bdb_state_type *bdb_state,
                                           int *timeoutms)
 {
     *timeoutms = -1;
-    return bdb_wait_for_seqnum_from_all_int(bdb_state, seqnum, timeoutms,
-                                            txnsize, 0);
+    return bdb_wait_for_seqnum_from_all_group(bdb_state, seqnum, timeoutms,
+                                              txnsize, 0);
 }
 
 /*
@@ -3344,16 +3525,16 @@ int bdb_wait_for_seqnum_from_all_newcoh(bdb_state_type *bdb_state,
                                         seqnum_type *seqnum)
 {
     int timeoutms = bdb_state->attr->reptimeout * MILLISEC;
-    return bdb_wait_for_seqnum_from_all_int(bdb_state, seqnum, &timeoutms, 0,
-                                            1);
+    return bdb_wait_for_seqnum_from_all_group(bdb_state, seqnum, &timeoutms,
+                                              0, 1);
 }
 
 int bdb_wait_for_seqnum_from_all_timeout_newcoh(bdb_state_type *bdb_state,
                                                 seqnum_type *seqnum,
                                                 int timeoutms)
 {
-    return bdb_wait_for_seqnum_from_all_int(bdb_state, seqnum, &timeoutms, 0,
-                                            1);
+    return bdb_wait_for_seqnum_from_all_group(bdb_state, seqnum, &timeoutms,
+                                              0, 1);
 }
 
 int bdb_wait_for_seqnum_from_all_adaptive_newcoh(bdb_state_type *bdb_state,
@@ -3362,8 +3543,8 @@ int bdb_wait_for_seqnum_from_all_adaptive_newcoh(bdb_state_type *bdb_state,
                                                  int *timeoutms)
 {
     *timeoutms = -1;
-    return bdb_wait_for_seqnum_from_all_int(bdb_state, seqnum, timeoutms,
-                                            txnsize, 1);
+    return bdb_wait_for_seqnum_from_all_group(bdb_state, seqnum, timeoutms,
+                                              txnsize, 1);
 }
 
 /* let everyone know what logfile we are currently using */
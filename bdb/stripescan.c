@@ -0,0 +1,539 @@
+/*
+   Copyright 2017 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/*
+ * Parallel scan of the data stripes of a table.
+ *
+ * A scan starts up to nthreads workers.  Each worker claims the next unread
+ * stripe and walks it with bulk reads, unpacking (and decompressing) the
+ * records into batches which are queued for the reader.  The reader gets the
+ * rows in whatever order the batches arrive.
+ *
+ * Every batch opens a cursor, repositions after the last key the stripe
+ * handed out, fills the batch and closes the cursor again, so a worker
+ * parked on a full queue holds no page locks.  The workers rely on the
+ * reader's curtran and table locks to keep the table open: whenever the
+ * reader gives those up (deadlock recovery, releasing its locks while it
+ * emits rows) it has to pause the scan first.  A paused scan keeps its
+ * queued batches and where each stripe got to, and starts its workers
+ * again on the reader's next call.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include <db.h>
+
+#include "bdb_int.h"
+#include "bdb_cursor.h"
+#include <logmsg.h>
+
+#define STRIPE_SCAN_BULKSZ (256 * 1024)
+#define STRIPE_SCAN_DEADLK_RETRIES 100
+
+struct stripe_row {
+    unsigned long long genid;
+    void *dta;
+    int dtalen;
+    uint8_t ver;
+};
+
+struct stripe_batch {
+    struct stripe_batch *next;
+    struct stripe_row *rows;
+    int nrows;
+    int currow;
+    char *mem; /* payloads, at least lrl bytes each */
+    int memsz;
+};
+
+struct stripe_pos {
+    unsigned long long lastkey;
+    int have_last;
+    int claimed;
+    int done;
+};
+
+struct bdb_stripe_scan {
+    bdb_state_type *bdb_state;
+    pthread_mutex_t lk;
+    pthread_cond_t cd;
+
+    /* batches ready for the reader */
+    struct stripe_batch *head;
+    struct stripe_batch *tail;
+    int nqueued;
+    int maxqueued;
+
+    struct stripe_batch *cur;   /* batch the reader is on */
+    struct stripe_batch *avail; /* handed back by the reader */
+
+    int maxrows;
+    struct stripe_pos *pos; /* one per stripe */
+    int maxthreads;
+    int nthreads;
+    int running;
+    int stop;
+    int paused;
+    int bdberr;
+    pthread_t *thds;
+};
+
+static struct stripe_batch *stripe_batch_alloc(bdb_stripe_scan_t *scan)
+{
+    struct stripe_batch *b = calloc(1, sizeof(*b));
+    if (b == NULL)
+        return NULL;
+    b->memsz = scan->maxrows * scan->bdb_state->lrl;
+    b->rows = malloc(scan->maxrows * sizeof(struct stripe_row));
+    b->mem = malloc(b->memsz);
+    if (b->rows == NULL || b->mem == NULL) {
+        free(b->rows);
+        free(b->mem);
+        free(b);
+        return NULL;
+    }
+    return b;
+}
+
+static void stripe_batch_free(struct stripe_batch *b)
+{
+    free(b->rows);
+    free(b->mem);
+    free(b);
+}
+
+/* Wait for room on the queue and return an empty batch, or NULL if the scan
+ * is being paused or torn down. */
+static struct stripe_batch *stripe_batch_get(bdb_stripe_scan_t *scan)
+{
+    struct stripe_batch *b = NULL;
+
+    pthread_mutex_lock(&scan->lk);
+    while (!scan->stop && !scan->paused && scan->nqueued >= scan->maxqueued)
+        pthread_cond_wait(&scan->cd, &scan->lk);
+    if (scan->paused) {
+        pthread_mutex_unlock(&scan->lk);
+        return NULL;
+    }
+    if (!scan->stop && scan->avail) {
+        b = scan->avail;
+        scan->avail = b->next;
+    }
+    pthread_mutex_unlock(&scan->lk);
+
+    if (b == NULL && !scan->stop) {
+        b = stripe_batch_alloc(scan);
+        if (b == NULL) {
+            logmsg(LOGMSG_ERROR, "%s: malloc %d rows\n", __func__,
+                   scan->maxrows);
+            pthread_mutex_lock(&scan->lk);
+            scan->bdberr = BDBERR_MALLOC;
+            scan->stop = 1;
+            pthread_cond_broadcast(&scan->cd);
+            pthread_mutex_unlock(&scan->lk);
+        }
+    }
+    if (b) {
+        b->next = NULL;
+        b->nrows = b->currow = 0;
+    }
+    return b;
+}
+
+static void stripe_batch_put(bdb_stripe_scan_t *scan, struct stripe_batch *b)
+{
+    pthread_mutex_lock(&scan->lk);
+    if (scan->tail)
+        scan->tail->next = b;
+    else
+        scan->head = b;
+    scan->tail = b;
+    scan->nqueued++;
+    pthread_cond_broadcast(&scan->cd);
+    pthread_mutex_unlock(&scan->lk);
+}
+
+/* Fill a batch from a stripe, starting after lastkey if have_last is set.
+ * Returns 0 if the batch filled up, DB_NOTFOUND at the end of the stripe, or
+ * a berkdb error.  lastkey is advanced past the rows added to the batch. */
+static int stripe_batch_fill(bdb_stripe_scan_t *scan, DB *db, DBT *bulk,
+                             void *tmp, struct stripe_batch *b,
+                             unsigned long long *lastkey, int *have_last)
+{
+    bdb_state_type *bdb_state = scan->bdb_state;
+    unsigned long long startkey = *lastkey;
+    int skip_first = *have_last;
+    int used = 0;
+    DBC *dbc;
+    DBT k = {0};
+    int rc;
+
+    if ((rc = db->cursor(db, NULL, &dbc, 0)) != 0)
+        return rc;
+
+    k.data = &startkey;
+    k.size = sizeof(startkey);
+    k.ulen = sizeof(startkey);
+    k.flags = DB_DBT_USERMEM;
+
+    rc = dbc->c_get(dbc, &k, bulk,
+                    (*have_last ? DB_SET_RANGE : DB_FIRST) | DB_MULTIPLE_KEY);
+    while (rc == 0) {
+        void *bulkptr, *key, *dta;
+        uint32_t keysize, dtasize;
+
+        DB_MULTIPLE_INIT(bulkptr, bulk);
+        for (;;) {
+            struct stripe_row *row;
+            struct odh odh;
+            unsigned long long genid;
+            int need;
+
+            DB_MULTIPLE_KEY_NEXT(bulkptr, bulk, key, keysize, dta, dtasize);
+            if (bulkptr == NULL)
+                break;
+            if (keysize != sizeof(genid))
+                continue;
+            memcpy(&genid, key, sizeof(genid));
+            if (skip_first) {
+                skip_first = 0;
+                if (genid == *lastkey)
+                    continue;
+            }
+            if (b->nrows == scan->maxrows)
+                goto done;
+
+            rc = bdb_unpack(bdb_state, dta, dtasize, tmp, MAXRECSZ, &odh,
+                            NULL);
+            if (rc) {
+                logmsg(LOGMSG_ERROR, "%s: unpack genid %llx rc %d\n",
+                       __func__, genid, rc);
+                dbc->c_close(dbc);
+                return rc;
+            }
+            /* the reader expands short records to lrl in place */
+            need = odh.length < bdb_state->lrl ? bdb_state->lrl : odh.length;
+            need = (need + 7) & ~7;
+            if (used + need > b->memsz) {
+                if (b->nrows > 0)
+                    goto done;
+                char *mem = malloc(need);
+                if (mem == NULL) {
+                    dbc->c_close(dbc);
+                    return ENOMEM;
+                }
+                free(b->mem);
+                b->mem = mem;
+                b->memsz = need;
+            }
+            row = &b->rows[b->nrows++];
+            memcpy(b->mem + used, odh.recptr, odh.length);
+            row->dta = b->mem + used;
+            row->dtalen = odh.length;
+            row->ver = odh.csc2vers;
+            row->genid = genid;
+            if (ip_updates_enabled(bdb_state))
+                row->genid = set_updateid(bdb_state, odh.updateid, genid);
+            used += need;
+            *lastkey = genid;
+            *have_last = 1;
+        }
+        rc = dbc->c_get(dbc, &k, bulk, DB_NEXT | DB_MULTIPLE_KEY);
+    }
+
+done:
+    dbc->c_close(dbc);
+    return rc;
+}
+
+static void stripe_scan_one(bdb_stripe_scan_t *scan, DB *db, DBT *bulk,
+                            void *tmp, struct stripe_pos *pos)
+{
+    unsigned long long lastkey = pos->lastkey;
+    int have_last = pos->have_last;
+    int retries = 0;
+    int rc;
+
+    do {
+        struct stripe_batch *b = stripe_batch_get(scan);
+        if (b == NULL)
+            break;
+
+        unsigned long long savekey = lastkey;
+        int savehave = have_last;
+        rc = stripe_batch_fill(scan, db, bulk, tmp, b, &lastkey, &have_last);
+        if (rc == DB_LOCK_DEADLOCK &&
+            ++retries < STRIPE_SCAN_DEADLK_RETRIES) {
+            /* throw the partial batch away and read it again */
+            lastkey = savekey;
+            have_last = savehave;
+            b->nrows = 0;
+            pthread_mutex_lock(&scan->lk);
+            b->next = scan->avail;
+            scan->avail = b;
+            pthread_mutex_unlock(&scan->lk);
+            poll(NULL, 0, retries);
+            rc = 0;
+            continue;
+        }
+        if (rc != 0 && rc != DB_NOTFOUND) {
+            logmsg(LOGMSG_ERROR, "%s: %s rc %d\n", __func__,
+                   scan->bdb_state->name, rc);
+            pthread_mutex_lock(&scan->lk);
+            scan->bdberr = rc == DB_LOCK_DEADLOCK ? BDBERR_DEADLOCK
+                                                  : BDBERR_MISC;
+            scan->stop = 1;
+            b->next = scan->avail;
+            scan->avail = b;
+            pthread_cond_broadcast(&scan->cd);
+            pthread_mutex_unlock(&scan->lk);
+            return;
+        }
+        retries = 0;
+        if (b->nrows)
+            stripe_batch_put(scan, b);
+        else {
+            pthread_mutex_lock(&scan->lk);
+            b->next = scan->avail;
+            scan->avail = b;
+            pthread_mutex_unlock(&scan->lk);
+        }
+    } while (rc == 0);
+
+    /* remember where a paused stripe picks up again */
+    pthread_mutex_lock(&scan->lk);
+    pos->lastkey = lastkey;
+    pos->have_last = have_last;
+    pos->done = (rc == DB_NOTFOUND);
+    pthread_mutex_unlock(&scan->lk);
+}
+
+static void *stripe_scan_thd(void *arg)
+{
+    bdb_stripe_scan_t *scan = arg;
+    bdb_state_type *bdb_state = scan->bdb_state;
+    DBT bulk = {0};
+    void *tmp = malloc(MAXRECSZ);
+
+    bdb_thread_event(bdb_state, BDBTHR_EVENT_START_RDONLY);
+
+    bulk.data = malloc(STRIPE_SCAN_BULKSZ);
+    bulk.ulen = STRIPE_SCAN_BULKSZ;
+    bulk.flags = DB_DBT_USERMEM;
+
+    while (bulk.data && tmp) {
+        struct stripe_pos *pos = NULL;
+        int stripe = 0;
+        pthread_mutex_lock(&scan->lk);
+        if (!scan->stop && !scan->paused) {
+            for (stripe = 0; stripe < bdb_state->attr->dtastripe; stripe++) {
+                if (!scan->pos[stripe].claimed && !scan->pos[stripe].done) {
+                    pos = &scan->pos[stripe];
+                    pos->claimed = 1;
+                    break;
+                }
+            }
+        }
+        pthread_mutex_unlock(&scan->lk);
+        if (pos == NULL)
+            break;
+        stripe_scan_one(scan, bdb_state->dbp_data[0][stripe], &bulk, tmp, pos);
+        pthread_mutex_lock(&scan->lk);
+        pos->claimed = 0;
+        pthread_mutex_unlock(&scan->lk);
+    }
+
+    pthread_mutex_lock(&scan->lk);
+    if (bulk.data == NULL || tmp == NULL) {
+        scan->bdberr = BDBERR_MALLOC;
+        scan->stop = 1;
+    }
+    scan->running--;
+    pthread_cond_broadcast(&scan->cd);
+    pthread_mutex_unlock(&scan->lk);
+
+    free(bulk.data);
+    free(tmp);
+    bdb_thread_event(bdb_state, BDBTHR_EVENT_DONE_RDONLY);
+    return NULL;
+}
+
+/* Start the workers on the stripes that aren't done yet. */
+static int stripe_scan_start(bdb_stripe_scan_t *scan)
+{
+    pthread_attr_t attr;
+
+    scan->paused = 0;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 128 * 1024);
+    for (int i = 0; i < scan->maxthreads; ++i) {
+        int rc = pthread_create(&scan->thds[i], &attr, stripe_scan_thd, scan);
+        if (rc) {
+            logmsg(LOGMSG_ERROR, "%s: pthread_create rc %d\n", __func__, rc);
+            break;
+        }
+        pthread_mutex_lock(&scan->lk);
+        scan->running++;
+        pthread_mutex_unlock(&scan->lk);
+        scan->nthreads++;
+    }
+    pthread_attr_destroy(&attr);
+    return scan->nthreads ? 0 : -1;
+}
+
+/* Stop the workers and wait for them: for good if stop is set, otherwise
+ * until stripe_scan_start() runs them again. */
+static void stripe_scan_join(bdb_stripe_scan_t *scan, int stop)
+{
+    pthread_mutex_lock(&scan->lk);
+    if (stop)
+        scan->stop = 1;
+    else
+        scan->paused = 1;
+    pthread_cond_broadcast(&scan->cd);
+    pthread_mutex_unlock(&scan->lk);
+
+    for (int i = 0; i < scan->nthreads; ++i)
+        pthread_join(scan->thds[i], NULL);
+    scan->nthreads = 0;
+}
+
+bdb_stripe_scan_t *bdb_stripe_scan_open(bdb_state_type *bdb_state,
+                                        int nthreads, int *bdberr)
+{
+    bdb_stripe_scan_t *scan;
+
+    *bdberr = 0;
+    if (nthreads > bdb_state->attr->dtastripe)
+        nthreads = bdb_state->attr->dtastripe;
+    if (nthreads < 1 || bdb_state->lrl <= 0) {
+        *bdberr = BDBERR_BADARGS;
+        return NULL;
+    }
+
+    scan = calloc(1, sizeof(*scan));
+    if (scan == NULL) {
+        *bdberr = BDBERR_MALLOC;
+        return NULL;
+    }
+    scan->thds = calloc(nthreads, sizeof(pthread_t));
+    scan->pos = calloc(bdb_state->attr->dtastripe, sizeof(struct stripe_pos));
+    if (scan->thds == NULL || scan->pos == NULL) {
+        free(scan->thds);
+        free(scan->pos);
+        free(scan);
+        *bdberr = BDBERR_MALLOC;
+        return NULL;
+    }
+    scan->bdb_state = bdb_state;
+    scan->maxrows = bdb_state->attr->bulk_sql_batch_rows;
+    if (scan->maxrows < 64)
+        scan->maxrows = 64;
+    scan->maxthreads = nthreads;
+    scan->maxqueued = 2 * nthreads;
+    pthread_mutex_init(&scan->lk, NULL);
+    pthread_cond_init(&scan->cd, NULL);
+
+    if (stripe_scan_start(scan)) {
+        bdb_stripe_scan_close(scan);
+        *bdberr = BDBERR_MISC;
+        return NULL;
+    }
+    return scan;
+}
+
+void bdb_stripe_scan_pause(bdb_stripe_scan_t *scan)
+{
+    if (scan->nthreads)
+        stripe_scan_join(scan, 0);
+}
+
+int bdb_stripe_scan_next(bdb_stripe_scan_t *scan, unsigned long long *genid,
+                         void **dta, int *dtalen, uint8_t *ver, int *bdberr)
+{
+    struct stripe_batch *b = scan->cur;
+    struct stripe_row *row;
+
+    *bdberr = 0;
+    if (b == NULL || b->currow >= b->nrows) {
+        /* the caller holds its locks again */
+        if (scan->paused && stripe_scan_start(scan)) {
+            *bdberr = BDBERR_MISC;
+            return -1;
+        }
+        pthread_mutex_lock(&scan->lk);
+        if (b) {
+            b->next = scan->avail;
+            scan->avail = b;
+            scan->cur = NULL;
+        }
+        while (scan->head == NULL && scan->running > 0 && !scan->stop)
+            pthread_cond_wait(&scan->cd, &scan->lk);
+        if (scan->bdberr) {
+            *bdberr = scan->bdberr;
+            pthread_mutex_unlock(&scan->lk);
+            return -1;
+        }
+        b = scan->head;
+        if (b) {
+            scan->head = b->next;
+            if (scan->head == NULL)
+                scan->tail = NULL;
+            scan->nqueued--;
+            scan->cur = b;
+            pthread_cond_broadcast(&scan->cd);
+        }
+        pthread_mutex_unlock(&scan->lk);
+        if (b == NULL)
+            return 0;
+    }
+
+    row = &b->rows[b->currow++];
+    *genid = row->genid;
+    *dta = row->dta;
+    *dtalen = row->dtalen;
+    *ver = row->ver;
+    return 1;
+}
+
+void bdb_stripe_scan_close(bdb_stripe_scan_t *scan)
+{
+    struct stripe_batch *b;
+
+    stripe_scan_join(scan, 1);
+
+    if (scan->cur)
+        stripe_batch_free(scan->cur);
+    while ((b = scan->head) != NULL) {
+        scan->head = b->next;
+        stripe_batch_free(b);
+    }
+    while ((b = scan->avail) != NULL) {
+        scan->avail = b->next;
+        stripe_batch_free(b);
+    }
+    pthread_mutex_destroy(&scan->lk);
+    pthread_cond_destroy(&scan->cd);
+    free(scan->thds);
+    free(scan->pos);
+    free(scan);
+}
@@ -94,10 +94,20 @@ struct temp_cursor {
     struct temp_list_node *list_cur;
     void *hash_cur;
     unsigned int hash_cur_buk;
+    struct tmptbl_node *mem_node; /* position in an in-memory btree */
+    int keycap;                   /* allocated size of key */
+    int datacap;                  /* allocated size of data */
     LINKC_T(struct temp_cursor) lnk;
 };
 
-enum { TEMP_TABLE_TYPE_BTREE, TEMP_TABLE_TYPE_HASH, TEMP_TABLE_TYPE_LIST };
+enum {
+    TEMP_TABLE_TYPE_BTREE,
+    TEMP_TABLE_TYPE_HASH,
+    TEMP_TABLE_TYPE_LIST,
+    TEMP_TABLE_TYPE_MEM_BTREE
+};
+
+#define TMPTBL_MAXLEVEL 20
 
 struct temp_table {
     DB_ENV *dbenv_temp;
@@ -117,6 +127,15 @@ struct temp_table {
     int max_mem_entries;
     LISTC_T(struct temp_cursor) cursors;
     void *next;
+
+    /* TEMP_TABLE_TYPE_MEM_BTREE */
+    struct tmptbl_node *mem_head[TMPTBL_MAXLEVEL];
+    struct tmptbl_node *mem_tail;
+    int mem_level;
+    struct tmptbl_chunk *arena;
+    size_t mem_bytes;
+    size_t mem_budget;
+    unsigned int mem_seed;
 };
 
 enum { TMPTBL_PRIORITY, TMPTBL_WAIT };
@@ -153,6 +172,291 @@ hash_t *bdb_temp_table_histhash_init(void)
                           sizeof(pthread_t));
 }
 
+/* In-memory btrees.  Until a btree temp table outgrows temptable_mem_budget
+ * its rows live in a skiplist carved out of a per-table arena, so small
+ * sorters and shadow tables never touch berkdb pages, latches or the mpool.
+ * Once the budget is exceeded the rows are copied into the table's berkdb
+ * btree and it carries on as TEMP_TABLE_TYPE_BTREE.
+ *
+ * Cursors still hand out their own malloced copies of the key and data, as
+ * callers may take ownership of them (see bdb_temp_table_find_exact() and
+ * bdb_temp_table_reset_datapointers()), but the buffers are reused from row
+ * to row.  Deletes only mark the node, so cursors sitting on it stay valid;
+ * the space comes back when the table is truncated. */
+struct tmptbl_chunk {
+    struct tmptbl_chunk *next;
+    size_t used;
+    size_t size;
+    uint8_t buf[];
+};
+
+struct tmptbl_node {
+    uint8_t *key;
+    uint8_t *data;
+    int keylen;
+    int datalen;
+    int datacap;
+    int deleted;
+    struct tmptbl_node *prev;
+    struct tmptbl_node *next[1]; /* one per level */
+};
+
+#define TMPTBL_CHUNK (64 * 1024)
+
+static void *tmptbl_alloc(struct temp_table *tbl, size_t sz)
+{
+    struct tmptbl_chunk *c = tbl->arena;
+    void *p;
+
+    sz = (sz + 7) & ~(size_t)7;
+    if (c == NULL || c->used + sz > c->size) {
+        size_t csz = sz > TMPTBL_CHUNK / 4 ? sz : TMPTBL_CHUNK;
+        c = malloc(offsetof(struct tmptbl_chunk, buf) + csz);
+        if (c == NULL)
+            return NULL;
+        c->size = csz;
+        c->used = 0;
+        /* big rows get a chunk of their own; keep filling the current one */
+        if (csz != TMPTBL_CHUNK && tbl->arena) {
+            c->next = tbl->arena->next;
+            tbl->arena->next = c;
+        } else {
+            c->next = tbl->arena;
+            tbl->arena = c;
+        }
+        tbl->mem_bytes += csz;
+    }
+    p = c->buf + c->used;
+    c->used += sz;
+    return p;
+}
+
+static void tmptbl_mem_reset(struct temp_table *tbl)
+{
+    struct tmptbl_chunk *c;
+    struct temp_cursor *cur;
+
+    while ((c = tbl->arena) != NULL) {
+        tbl->arena = c->next;
+        free(c);
+    }
+    tbl->mem_bytes = 0;
+    memset(tbl->mem_head, 0, sizeof(tbl->mem_head));
+    tbl->mem_tail = NULL;
+    tbl->mem_level = 1;
+    LISTC_FOR_EACH(&tbl->cursors, cur, lnk) { cur->mem_node = NULL; }
+}
+
+/* same ordering as temp_table_compare() */
+static inline int tmptbl_node_cmp(struct temp_table *tbl, const void *key,
+                             int keylen, void *unpacked,
+                             struct tmptbl_node *n)
+{
+    if (unpacked)
+        return -tbl->cmpfunc(NULL, n->keylen, n->key, -1, unpacked);
+    return tbl->cmpfunc(tbl->usermem, keylen, key, n->keylen, n->key);
+}
+
+/* Return the first node >= key.  If update is given, fill in the links that
+ * would have to change to insert key, and the node that would precede it. */
+static struct tmptbl_node *tmptbl_seek(struct temp_table *tbl, const void *key,
+                                       int keylen, void *unpacked,
+                                       struct tmptbl_node ***update,
+                                       struct tmptbl_node **prev)
+{
+    struct tmptbl_node **next = tbl->mem_head;
+    struct tmptbl_node *x = NULL;
+
+    for (int lvl = tbl->mem_level - 1; lvl >= 0; lvl--) {
+        while (next[lvl] &&
+               tmptbl_node_cmp(tbl, key, keylen, unpacked, next[lvl]) > 0) {
+            x = next[lvl];
+            next = x->next;
+        }
+        if (update)
+            update[lvl] = &next[lvl];
+    }
+    if (prev)
+        *prev = x;
+    return next[0];
+}
+
+static struct tmptbl_node *tmptbl_live_next(struct tmptbl_node *n)
+{
+    while (n && n->deleted)
+        n = n->next[0];
+    return n;
+}
+
+static struct tmptbl_node *tmptbl_live_prev(struct tmptbl_node *n)
+{
+    while (n && n->deleted)
+        n = n->prev;
+    return n;
+}
+
+/* insert or overwrite a row */
+static struct tmptbl_node *tmptbl_put(struct temp_table *tbl, const void *key,
+                                      int keylen, const void *data, int dtalen,
+                                      void *unpacked)
+{
+    struct tmptbl_node **update[TMPTBL_MAXLEVEL];
+    struct tmptbl_node *n, *prev;
+    int height, lvl;
+
+    n = tmptbl_seek(tbl, key, keylen, unpacked, update, &prev);
+    if (n && tmptbl_node_cmp(tbl, key, keylen, unpacked, n) == 0) {
+        if (dtalen > n->datacap) {
+            if ((n->data = tmptbl_alloc(tbl, dtalen)) == NULL)
+                return NULL;
+            n->datacap = dtalen;
+        }
+        memcpy(n->data, data, dtalen);
+        n->datalen = dtalen;
+        n->deleted = 0;
+        return n;
+    }
+
+    height = 1;
+    while (height < TMPTBL_MAXLEVEL && (rand_r(&tbl->mem_seed) & 3) == 0)
+        height++;
+
+    n = tmptbl_alloc(tbl, offsetof(struct tmptbl_node, next) +
+                              height * sizeof(struct tmptbl_node *) + keylen +
+                              dtalen);
+    if (n == NULL)
+        return NULL;
+    n->key = (uint8_t *)&n->next[height];
+    n->data = n->key + keylen;
+    n->keylen = keylen;
+    n->datalen = n->datacap = dtalen;
+    n->deleted = 0;
+    memcpy(n->key, key, keylen);
+    memcpy(n->data, data, dtalen);
+
+    for (lvl = tbl->mem_level; lvl < height; lvl++)
+        update[lvl] = &tbl->mem_head[lvl];
+    if (height > tbl->mem_level)
+        tbl->mem_level = height;
+    for (lvl = 0; lvl < height; lvl++) {
+        n->next[lvl] = *update[lvl];
+        *update[lvl] = n;
+    }
+    n->prev = prev;
+    if (n->next[0])
+        n->next[0]->prev = n;
+    else
+        tbl->mem_tail = n;
+    tbl->num_mem_entries++;
+    return n;
+}
+
+/* point the cursor at n, copying the row into the cursor's buffers */
+static int tmptbl_cursor_set(struct temp_cursor *cur, struct tmptbl_node *n)
+{
+    void *p;
+
+    if (n->keylen > cur->keycap) {
+        if ((p = realloc(cur->key, n->keylen)) == NULL)
+            return -1;
+        cur->key = p;
+        cur->keycap = n->keylen;
+    }
+    if (n->datalen > cur->datacap) {
+        if ((p = realloc(cur->data, n->datalen)) == NULL)
+            return -1;
+        cur->data = p;
+        cur->datacap = n->datalen;
+    }
+    memcpy(cur->key, n->key, n->keylen);
+    memcpy(cur->data, n->data, n->datalen);
+    cur->keylen = n->keylen;
+    cur->datalen = n->datalen;
+    cur->mem_node = n;
+    cur->valid = 1;
+    return 0;
+}
+
+/* move an in-memory btree into its berkdb btree */
+static int bdb_temp_table_mem_spill(bdb_state_type *bdb_state,
+                                    struct temp_table *tbl, int *bdberr)
+{
+    DBT dkey, ddata;
+    struct tmptbl_node *n;
+    struct temp_cursor *cur;
+    int rc;
+
+    memset(&dkey, 0, sizeof(DBT));
+    memset(&ddata, 0, sizeof(DBT));
+    dkey.flags = ddata.flags = DB_DBT_USERMEM;
+    for (n = tmptbl_live_next(tbl->mem_head[0]); n;
+         n = tmptbl_live_next(n->next[0])) {
+        dkey.data = n->key;
+        dkey.ulen = dkey.size = n->keylen;
+        ddata.data = n->data;
+        ddata.ulen = ddata.size = n->datalen;
+        rc = tbl->tmpdb->put(tbl->tmpdb, NULL, &dkey, &ddata, 0);
+        if (rc) {
+            logmsg(LOGMSG_ERROR, "%s:%d put rc %d\n", __FILE__, __LINE__, rc);
+            *bdberr = rc;
+            return -1;
+        }
+    }
+
+    /* its now a btree! */
+    tbl->temp_table_type = TEMP_TABLE_TYPE_BTREE;
+
+    /* Open berkdb cursors at the rows the in-memory ones were on, so
+       next/prev carry on from there. */
+    LISTC_FOR_EACH(&tbl->cursors, cur, lnk)
+    {
+        n = cur->mem_node;
+        cur->mem_node = NULL;
+        cur->keycap = cur->datacap = 0;
+        rc = tbl->tmpdb->cursor(tbl->tmpdb, NULL, &cur->cur, 0);
+        if (rc) {
+            cur->cur = NULL;
+            logmsg(LOGMSG_ERROR, "%s:%d cursor rc %d\n", __FILE__, __LINE__, rc);
+            *bdberr = rc;
+            return -1;
+        }
+        if (n == NULL || n->deleted)
+            continue;
+        memset(&dkey, 0, sizeof(DBT));
+        memset(&ddata, 0, sizeof(DBT));
+        dkey.data = n->key;
+        dkey.size = n->keylen;
+        ddata.flags = DB_DBT_MALLOC;
+        if (cur->cur->c_get(cur->cur, &dkey, &ddata, DB_SET) == 0)
+            free(ddata.data);
+    }
+
+    tmptbl_mem_reset(tbl);
+    return 0;
+}
+
+static int bdb_temp_table_mem_put(bdb_state_type *bdb_state,
+                                  struct temp_table *tbl,
+                                  struct temp_cursor *cur, void *key,
+                                  int keylen, void *data, int dtalen,
+                                  void *unpacked, int *bdberr)
+{
+    struct tmptbl_node *n;
+
+    n = tmptbl_put(tbl, key, keylen, data, dtalen, unpacked);
+    if (n == NULL) {
+        *bdberr = ENOMEM;
+        return -1;
+    }
+    /* like c_put, leave the cursor on the new row */
+    if (cur)
+        cur->mem_node = n;
+
+    if (tbl->mem_bytes > tbl->mem_budget)
+        return bdb_temp_table_mem_spill(bdb_state, tbl, bdberr);
+    return 0;
+}
+
 static int bdb_hash_table_copy_to_temp_db(bdb_state_type *bdb_state,
                                           struct temp_table *tbl, int *bdberr)
 {
@@ -331,6 +635,8 @@ static struct temp_table *bdb_temp_table_create_main(bdb_state_type *bdb_state,
     tbl->next = NULL;
     tbl->tmpdb = NULL;
     tbl->cmpfunc = key_memcmp;
+    tbl->arena = NULL;
+    tbl->mem_seed = (unsigned int)(uintptr_t)tbl;
 
     rc = db_env_create(&dbenv_temp, 0);
     if (rc != 0) {
@@ -415,6 +721,7 @@ static struct temp_table *bdb_temp_table_create_main(bdb_state_type *bdb_state,
     tbl->tblid = id;
 
     listc_init(&tbl->cursors, offsetof(struct temp_cursor, lnk));
+    tmptbl_mem_reset(tbl);
 
     tbl->max_mem_entries = bdb_state->attr->temptable_mem_threshold;
 
@@ -541,6 +848,9 @@ static struct temp_table *bdb_temp_table_create_type(bdb_state_type *bdb_state,
 
     table->num_mem_entries = 0;
     table->cmpfunc = key_memcmp;
+    table->mem_budget = bdb_state->attr->temptable_mem_budget;
+    if (temp_table_type == TEMP_TABLE_TYPE_BTREE && table->mem_budget > 0)
+        temp_table_type = TEMP_TABLE_TYPE_MEM_BTREE;
     table->temp_table_type = temp_table_type;
 
     return table;
@@ -599,6 +909,10 @@ struct temp_cursor *bdb_temp_table_cursor(bdb_state_type *bdb_state,
         rc = 0;
         break;
 
+    case TEMP_TABLE_TYPE_MEM_BTREE:
+        rc = 0;
+        break;
+
     case TEMP_TABLE_TYPE_BTREE:
         rc = tbl->tmpdb->cursor(tbl->tmpdb, NULL, &cur->cur, 0);
         break;
@@ -633,9 +947,16 @@ int bdb_temp_table_insert(bdb_state_type *bdb_state, struct temp_cursor *cur,
 {
     DBT dkey, ddata;
     struct temp_table *tbl = cur->tbl;
+    int rc;
+
+    if (tbl->temp_table_type == TEMP_TABLE_TYPE_MEM_BTREE) {
+        rc = bdb_temp_table_mem_put(bdb_state, tbl, cur, key, keylen, data,
+                                    dtalen, NULL, bdberr);
+        goto done;
+    }
 
-    int rc = bdb_temp_table_insert_put(bdb_state, tbl, key, keylen, data,
-                                       dtalen, bdberr);
+    rc = bdb_temp_table_insert_put(bdb_state, tbl, key, keylen, data, dtalen,
+                                   bdberr);
     if (rc <= 0)
         goto done;
 
@@ -671,6 +992,15 @@ int bdb_temp_table_update(bdb_state_type *bdb_state, struct temp_cursor *cur,
     DBT dkey, ddata;
     int rc = 0;
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_MEM_BTREE) {
+        struct tmptbl_node *n = cur->mem_node;
+        if (n == NULL || n->deleted)
+            return -1;
+        rc = bdb_temp_table_mem_put(bdb_state, cur->tbl, cur, n->key,
+                                    n->keylen, data, dtalen, NULL, bdberr);
+        goto done;
+    }
+
     if (cur->tbl->temp_table_type != TEMP_TABLE_TYPE_BTREE) {
         logmsg(LOGMSG_ERROR, "bdb_temp_table_update operation "
                         "only supported for btree.\n");
@@ -698,6 +1028,7 @@ int bdb_temp_table_update(bdb_state_type *bdb_state, struct temp_cursor *cur,
         rc = -1;
     }
 
+done:
     dbghexdump(3, key, keylen);
     dbgtrace(3, "temp_table_update(cursor %d) = %d\n", cur->curid, rc);
     return rc;
@@ -713,9 +1044,16 @@ int bdb_temp_table_put(bdb_state_type *bdb_state, struct temp_table *tbl,
                        void *unpacked, int *bdberr)
 {
     DBT dkey, ddata;
+    int rc;
 
-    int rc = bdb_temp_table_insert_put(bdb_state, tbl, key, keylen, data,
-                                       dtalen, bdberr);
+    if (tbl->temp_table_type == TEMP_TABLE_TYPE_MEM_BTREE) {
+        rc = bdb_temp_table_mem_put(bdb_state, tbl, NULL, key, keylen, data,
+                                    dtalen, unpacked, bdberr);
+        goto done;
+    }
+
+    rc = bdb_temp_table_insert_put(bdb_state, tbl, key, keylen, data, dtalen,
+                                   bdberr);
     if (rc <= 0)
         goto done;
 
@@ -788,6 +1126,23 @@ static int bdb_temp_table_first_last(bdb_state_type *bdb_state,
         return 0;
     }
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_MEM_BTREE) {
+        struct tmptbl_node *n;
+        cur->valid = 0;
+        if (how == DB_FIRST)
+            n = tmptbl_live_next(cur->tbl->mem_head[0]);
+        else
+            n = tmptbl_live_prev(cur->tbl->mem_tail);
+        cur->mem_node = n;
+        if (n == NULL)
+            return IX_EMPTY;
+        if (tmptbl_cursor_set(cur, n)) {
+            *bdberr = ENOMEM;
+            return -1;
+        }
+        return 0;
+    }
+
     /* if cursor was deleted, need to reopen */
     if (cur->cur == NULL) {
         int rc = cur->tbl->tmpdb->cursor(cur->tbl->tmpdb, NULL, &cur->cur, 0);
@@ -880,6 +1235,23 @@ static int bdb_temp_table_next_prev_norewind(bdb_state_type *bdb_state,
         return 0;
     }
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_MEM_BTREE) {
+        struct tmptbl_node *n = cur->mem_node;
+        if (n == NULL)
+            return IX_PASTEOF;
+        if (how == DB_NEXT)
+            n = tmptbl_live_next(n->next[0]);
+        else
+            n = tmptbl_live_prev(n->prev);
+        if (n == NULL)
+            return IX_PASTEOF;
+        if (tmptbl_cursor_set(cur, n)) {
+            *bdberr = ENOMEM;
+            return -1;
+        }
+        return IX_FND;
+    }
+
     /* if cursor was deleted, need to reopen */
     if (cur->cur == NULL) {
         int rc = cur->tbl->tmpdb->cursor(cur->tbl->tmpdb, NULL, &cur->cur, 0);
@@ -1150,6 +1522,11 @@ int bdb_temp_table_truncate(bdb_state_type *bdb_state, struct temp_table *tbl,
         }
         break;
 
+    case TEMP_TABLE_TYPE_MEM_BTREE:
+        tmptbl_mem_reset(tbl);
+        tbl->num_mem_entries = 0;
+        break;
+
     case TEMP_TABLE_TYPE_BTREE:
 
         if (tbl->num_mem_entries < 100)
@@ -1375,9 +1752,11 @@ int bdb_temp_table_destroy_lru(struct temp_table *tbl,
         hash_clear(tbl->temp_hash_tbl);
     } break;
 
+    case TEMP_TABLE_TYPE_MEM_BTREE:
     case TEMP_TABLE_TYPE_BTREE:
         break;
     }
+    tmptbl_mem_reset(tbl);
 
     hash_free(tbl->temp_hash_tbl);
     tbl->temp_hash_tbl = NULL;
@@ -1414,6 +1793,16 @@ int bdb_temp_table_delete(bdb_state_type *bdb_state, struct temp_cursor *cur,
         goto done;
     }
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_MEM_BTREE) {
+        if (!cur->valid || cur->mem_node == NULL) {
+            rc = -1;
+            goto done;
+        }
+        cur->mem_node->deleted = 1;
+        rc = 0;
+        goto done;
+    }
+
     /*pthread_setspecific(cur->tbl->curkey, cur);*/
     if (!cur->valid) {
         rc = -1;
@@ -1516,6 +1905,24 @@ int bdb_temp_table_find(bdb_state_type *bdb_state, struct temp_cursor *cur,
         return 0;
     }
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_MEM_BTREE) {
+        struct tmptbl_node *n;
+        cur->valid = 0;
+        n = tmptbl_live_next(
+            tmptbl_seek(cur->tbl, key, keylen, unpacked, NULL, NULL));
+        if (n == NULL) {
+            /* find anything at all if possible */
+            rc = bdb_temp_table_last(bdb_state, cur, bdberr);
+            goto done;
+        }
+        rc = 0;
+        if (tmptbl_cursor_set(cur, n)) {
+            *bdberr = ENOMEM;
+            rc = -1;
+        }
+        goto done;
+    }
+
     assert(cur->cur != NULL);
 
     /*pthread_setspecific(cur->tbl->curkey, cur);*/
@@ -1618,6 +2025,34 @@ int bdb_temp_table_find_exact(bdb_state_type *bdb_state,
         return 0;
     }
 
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_MEM_BTREE) {
+        struct tmptbl_node *n;
+        cur->valid = 0;
+        n = tmptbl_seek(cur->tbl, key, keylen, NULL, NULL, NULL);
+        if (n == NULL || n->deleted ||
+            tmptbl_node_cmp(cur->tbl, key, keylen, NULL, n) != 0)
+            return IX_NOTFND;
+        /* like DB_SET, the cursor keeps the caller's key */
+        if (cur->key && cur->key != key)
+            free(cur->key);
+        cur->key = key;
+        cur->keylen = cur->keycap = keylen;
+        if (n->datalen > cur->datacap) {
+            void *p = realloc(cur->data, n->datalen);
+            if (p == NULL) {
+                *bdberr = ENOMEM;
+                return -1;
+            }
+            cur->data = p;
+            cur->datacap = n->datalen;
+        }
+        memcpy(cur->data, n->data, n->datalen);
+        cur->datalen = n->datalen;
+        cur->mem_node = n;
+        cur->valid = 1;
+        return IX_FND;
+    }
+
     /*pthread_setspecific(cur->tbl->curkey, cur);*/
 
     memset(&dkey, 0, sizeof(DBT));
@@ -1697,7 +2132,11 @@ int bdb_temp_table_close_cursor(bdb_state_type *bdb_state,
     struct temp_table *tbl;
     tbl = cur->tbl;
 
-    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_BTREE) {
+    if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_MEM_BTREE) {
+        free(cur->key);
+        free(cur->data);
+        cur->key = cur->data = NULL;
+    } else if (cur->tbl->temp_table_type == TEMP_TABLE_TYPE_BTREE) {
         if (cur->key) {
 #if 0
           printf( "%p Freeing %p\n", cur, cur->key);
@@ -1740,6 +2179,7 @@ void bdb_temp_table_reset_datapointers(struct temp_cursor *cur)
 
     if (cur) {
         cur->datalen = 0;
+        cur->datacap = 0;
         cur->data = NULL;
     }
 }
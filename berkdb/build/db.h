@@ -196,6 +196,7 @@ struct __db_dbt {
 #define	DB_DBT_REALLOC		0x010	/* Return in realloc'd memory. */
 #define	DB_DBT_USERMEM		0x020	/* Return in user's memory. */
 #define	DB_DBT_DUPOK		0x040	/* Insert if duplicate. */
+#define	DB_DBT_RECVBUF		0x080	/* Pinned net receive buffer. */
 	u_int32_t flags;
 };
 
@@ -876,6 +877,11 @@ struct __db_mpool_stat {
 	u_int32_t st_alloc_max_pages;	/* Max checked during allocation. */
 	u_int32_t st_ckp_pages_sync;	/* Number of pages sync'd using perfect ckp. */
 	u_int32_t st_ckp_pages_skip;	/* Number of pages skipped using perfect ckp. */
+	u_int32_t st_page_promote;	/* Pages promoted out of probation. */
+	u_int32_t st_ckp_pages_total;	/* Pages the last checkpoint had to write. */
+	u_int32_t st_ckp_pages_written;	/* Pages it has written so far. */
+	u_int32_t st_ckp_ms;		/* Time the last checkpoint took to write. */
+	u_int32_t st_ckp_pages_per_sec;	/* Write rate of the last checkpoint. */
 };
 
 /* Mpool file statistics structure. */
@@ -894,6 +900,7 @@ struct __db_mpool_fstat {
 	u_int32_t st_page_out;		/* Pages written out. */
 	u_int32_t st_ro_merges;		/* Read merges performed. */
 	u_int32_t st_rw_merges;		/* Write merges performed. */
+	u_int32_t st_page_promote;	/* Pages promoted out of probation. */
 };
 
 /*******************************************************
@@ -1980,6 +1987,7 @@ struct __lsn_collection {
 	int nalloc;
 	struct logrecord *array;
 	int memused;
+	void *lastbuf;	/* receive buffer last pinned, charged to memused */
 	int had_serializable_records;
 	int filled_from_cache;
 };
@@ -2474,6 +2482,13 @@ struct __db_env {
     int (*set_check_standalone) __P((DB_ENV *, int (*)(DB_ENV *)));
     int (*check_standalone)(DB_ENV *);
 
+	/* Pin/unpin the network buffer a replicated log record arrived in,
+	 * so the lc cache can keep the record without copying it. */
+	int (*set_rep_recvbuf) __P((DB_ENV *,
+	    void *(*)(const void *, size_t, size_t *), void (*)(void *)));
+	void *(*rep_recvbuf_hold)(const void *, size_t, size_t *);
+	void (*rep_recvbuf_release)(void *);
+
 };
 
 #ifndef DB_DBM_HSEARCH
@@ -2743,6 +2758,12 @@ struct __recovery_record {
 	DBT logdbt;	/* log record to apply */
 	DB_LSN lsn;	/* LSN of log record to apply */
 	int fileid;
+	/* page chains: the queue this is on, and the earlier record on another
+	 * queue that shares its meta page and has to be applied first */
+	struct __recovery_queue *chain;
+	struct __recovery_record *wait_for;
+	int waited_on;
+	int applied;
 	LINKC_T(struct __recovery_record) lnk;
 };
 
@@ -2751,6 +2772,7 @@ struct __recovery_queue {
 	struct __recovery_processor *processor;
 	int fileid;
 	int used;
+	int claimed;	/* a worker is applying its records */
 	LISTC_T(struct __recovery_record) records;
 	LINKC_T(struct __recovery_queue) lnk;
 };
@@ -2769,6 +2791,10 @@ struct __recovery_processor {
 	unsigned long long context;
 	u_int32_t lockid;
 	struct __recovery_queue **recovery_queues;
+	/* extra queues for files split into page chains */
+	struct __recovery_queue **chain_queues;
+	int num_chain_queues;
+	int used_chain_queues;
 	void *txninfo;
 	LSN_COLLECTION lc;
 	pool_t *recpool;
@@ -2824,6 +2850,8 @@ int berkdb_verify_lsn_written_to_disk(DB_ENV *dbenv, DB_LSN *lsn,
 
 u_int32_t file_id_for_recovery_record(DB_ENV *env, DB_LSN *lsn,
 	int rectype, DBT *dbt);
+int pgnos_for_recovery_record(DB_ENV *env, int rectype, DBT *dbt,
+	db_pgno_t *pgnos, int maxpgnos);
 
 int __rep_get_master(DB_ENV *dbenv, char **master);
 int __rep_get_eid(DB_ENV *dbenv,char **eid);
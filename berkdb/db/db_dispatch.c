@@ -54,6 +54,7 @@ static const char revid[] = "$Id: db_dispatch.c,v 11.145 2003/09/10 20:31:18 ube
 #include "db_int.h"
 #include "dbinc/db_page.h"
 #include "dbinc/db_shash.h"
+#include "dbinc/btree.h"
 #include "dbinc/hash.h"
 #include "dbinc/lock.h"
 #include "dbinc/log.h"
@@ -399,6 +400,109 @@ file_id_for_recovery_record(DB_ENV *env, DB_LSN *lsn, int rectype, DBT *dbt)
 	return fileid;
 }
 
+#define PGNO_FOR_RECORD(type, ...)					\
+	do {								\
+		type##_args *argp;					\
+		if ((ret = type##_read(env, dbt->data, &argp)) != 0)	\
+			return -1;					\
+		db_pgno_t pg[] = { __VA_ARGS__ };			\
+		for (i = 0; i < sizeof(pg) / sizeof(pg[0]); i++) {	\
+			if (npgnos == maxpgnos) {			\
+				__os_free(env, argp);			\
+				return -1;				\
+			}						\
+			pgnos[npgnos++] = pg[i];			\
+		}							\
+		__os_free(env, argp);					\
+	} while (0)
+
+/*
+ * Find the pages of its file that a log record will modify when it is
+ * applied.  Used by the replicant to split one file's records into
+ * independent page chains.  Returns the number of pages written to pgnos,
+ * or -1 if the record's footprint isn't known, in which case it has to be
+ * ordered against every other record for the file.
+ */
+int
+pgnos_for_recovery_record(DB_ENV *env, int rectype, DBT *dbt,
+    db_pgno_t *pgnos, int maxpgnos)
+{
+	int npgnos = 0, ret;
+	size_t i;
+
+	/*
+	 * The page arguments are pulled out through the generated read
+	 * routines.  Unused page arguments are PGNO_INVALID, which is also
+	 * the meta page; the caller orders page 0 records among themselves
+	 * rather than chaining through them, so keeping them only costs a
+	 * wait on the previous meta page record.
+	 */
+	switch (rectype) {
+	case DB___db_addrem:
+		PGNO_FOR_RECORD(__db_addrem, argp->pgno);
+		break;
+	case DB___db_big:
+		PGNO_FOR_RECORD(__db_big, argp->pgno, argp->prev_pgno,
+		    argp->next_pgno);
+		break;
+	case DB___db_ovref:
+		PGNO_FOR_RECORD(__db_ovref, argp->pgno);
+		break;
+	case DB___db_relink:
+		PGNO_FOR_RECORD(__db_relink, argp->pgno, argp->prev,
+		    argp->next);
+		break;
+	case DB___db_pg_alloc:
+		PGNO_FOR_RECORD(__db_pg_alloc, argp->meta_pgno, argp->pgno);
+		break;
+	case DB___db_pg_free:
+		PGNO_FOR_RECORD(__db_pg_free, argp->meta_pgno, argp->pgno);
+		break;
+	case DB___db_pg_freedata:
+		PGNO_FOR_RECORD(__db_pg_freedata, argp->meta_pgno, argp->pgno);
+		break;
+	case DB___bam_split:
+		PGNO_FOR_RECORD(__bam_split, argp->left, argp->right,
+		    argp->npgno, argp->root_pgno);
+		break;
+	case DB___bam_rsplit:
+		PGNO_FOR_RECORD(__bam_rsplit, argp->pgno, argp->root_pgno);
+		break;
+	case DB___bam_adj:
+		PGNO_FOR_RECORD(__bam_adj, argp->pgno);
+		break;
+	case DB___bam_cadjust:
+		PGNO_FOR_RECORD(__bam_cadjust, argp->pgno);
+		break;
+	case DB___bam_cdel:
+		PGNO_FOR_RECORD(__bam_cdel, argp->pgno);
+		break;
+	case DB___bam_repl:
+		PGNO_FOR_RECORD(__bam_repl, argp->pgno);
+		break;
+	case DB___bam_root:
+		PGNO_FOR_RECORD(__bam_root, argp->meta_pgno, argp->root_pgno);
+		break;
+	case DB___bam_prefix:
+		PGNO_FOR_RECORD(__bam_prefix, argp->pgno);
+		break;
+	case DB___bam_pgcompact:
+		PGNO_FOR_RECORD(__bam_pgcompact, argp->pgno, argp->npgno,
+		    argp->ppgno);
+		break;
+
+	case DB___bam_curadj:
+	case DB___bam_rcuradj:
+		/* Cursor adjustments only do work on abort. */
+		break;
+
+	default:
+		return -1;
+	}
+
+	return npgnos;
+}
+
 /*
  * __db_dispatch --
  *
@@ -61,6 +61,14 @@ BERK_DEF_ATTR(latch_max_poll, "Poll latch this many times before returning deadl
 BERK_DEF_ATTR(latch_timed_mutex, "Use a timed mutex", BERK_ATTR_TYPE_BOOLEAN, 1)
 BERK_DEF_ATTR(log_cursor_cache, "Cache log cursors", BERK_ATTR_TYPE_BOOLEAN, 0)
 BERK_DEF_ATTR(recovery_processor_poll_interval_us, "Recovery processor wakes this often to check workers", BERK_ATTR_TYPE_INTEGER, 1000)
+BERK_DEF_ATTR(rep_page_chains, "Split a file's records in a large replicated transaction into independent page chains", BERK_ATTR_TYPE_BOOLEAN, 0)
+BERK_DEF_ATTR(rep_page_chains_min_records, "Only split files with at least this many records in the transaction", BERK_ATTR_TYPE_INTEGER, 1024)
+BERK_DEF_ATTR(rep_page_chains_max, "Spread the page chains of a file over at most this many workers", BERK_ATTR_TYPE_INTEGER, 8)
+BERK_DEF_ATTR(mpool_scan_resistant, "Keep pages used only once on probation in the bufferpool so scans don't evict the working set", BERK_ATTR_TYPE_BOOLEAN, 0)
+BERK_DEF_ATTR(mpool_probation_pct, "Rank probationary pages this percent of the bufferpool below recently used pages", BERK_ATTR_TYPE_PERCENT, 50)
+BERK_DEF_ATTR(mpool_reref_window, "Uses of a probationary page within this percent of bufferpool puts count as one", BERK_ATTR_TYPE_PERCENT, 1)
+BERK_DEF_ATTR(ckp_spread_ms, "Spread a checkpoint's page writes over this many ms (0 writes them as fast as possible)", BERK_ATTR_TYPE_INTEGER, 0)
+BERK_DEF_ATTR(ckp_spread_min_rate, "Write at least this many pages a second when spreading a checkpoint", BERK_ATTR_TYPE_INTEGER, 1000)
 BERK_DEF_ATTR(lsnerr_logflush, "Flush log on lsn error", BERK_ATTR_TYPE_BOOLEAN, 1)
 BERK_DEF_ATTR(tracked_locklist_init, "Initial allocation count for tracked locks", BERK_ATTR_TYPE_INTEGER, 10)
 /* This is a placeholder for now */
@@ -330,9 +330,11 @@ struct __bh {
 #define	BH_TRASH	0x020		/* Page is garbage. */
 #define BH_NOINCR	0x040		/* Don't increment lru_cache. */
 #define BH_PREFAULT	0x080		/* prefault pages */
+#define	BH_HOT		0x100		/* Promoted out of scan probation. */
 	u_int16_t	flags;
 	u_int16_t	generation;	/* This changes before page changes */
 	u_int32_t	priority;	/* LRU priority. */
+	u_int32_t	first_ref;	/* LRU count at first use, 0 if unused. */
 	SH_TAILQ_ENTRY(__bh) hq;	/* MPOOL hash bucket queue. */
 
 	db_pgno_t pgno;			/* Underlying MPOOLFILE page number. */
@@ -53,8 +53,10 @@ __memp_dump_bufferpool_info(dbenv, f)
 	MPOOL *mp, *c_mp;
 	MPOOLFILE *bh_mfp;
 	DB_MPOOL *dbmp;
+	MPOOLFILE *mfp;
 	int count, n_cache;
-	u_int64_t bufcnt;
+	u_int64_t bufcnt, probation;
+	u_int32_t hits, misses;
 
 	dbmp = dbenv->mp_handle;
 	dbenv = dbmp->dbenv;
@@ -70,6 +72,7 @@ __memp_dump_bufferpool_info(dbenv, f)
 		c_mp = dbmp->reginfo[n_cache].primary;
 		dbht = R_ADDR(memreg, c_mp->htab);
 		logmsgf(LOGMSG_USER, f, "CACHE %d AT 0x%08p\n", n_cache, c_mp);
+		probation = 0;
 
 		for (count = 0; count < c_mp->htab_buckets; count++) {
 			hp = &dbht[count];
@@ -90,6 +93,8 @@ __memp_dump_bufferpool_info(dbenv, f)
 
 			do {
 				bufcnt++;
+				if (bhp->first_ref && !F_ISSET(bhp, BH_HOT))
+					probation++;
 				logmsgf(LOGMSG_USER, f, " (%d:%d:%d)", bhp->mf_offset,
 				    bhp->pgno, bhp->priority);
 				bhp = SH_TAILQ_NEXT(bhp, hq, __bh);
@@ -101,9 +106,26 @@ __memp_dump_bufferpool_info(dbenv, f)
 			MUTEX_UNLOCK(dbenv, mutexp);
 		}
 		logmsgf(LOGMSG_USER, f, "LRU_COUNT = %d\n", c_mp->lru_count);
+		logmsgf(LOGMSG_USER, f, "PROBATION = %llu\n", probation);
 		logmsgf(LOGMSG_USER, f, "\n");
 	}
 	logmsgf(LOGMSG_USER, f, "BUFCNT = %lld\n", bufcnt);
+
+	/* Per-file hit ratios. */
+	R_LOCK(dbenv, dbmp->reginfo);
+	for (mfp = SH_TAILQ_FIRST(&mp->mpfq, __mpoolfile);
+	    mfp != NULL; mfp = SH_TAILQ_NEXT(mfp, q, __mpoolfile)) {
+		hits = mfp->stat.st_cache_hit;
+		misses = mfp->stat.st_cache_miss;
+		if (hits + misses == 0)
+			continue;
+		logmsgf(LOGMSG_USER, f,
+		    "FILE %s HIT %u MISS %u RATIO %.2f%% PROMOTED %u\n",
+		    __memp_fns(dbmp, mfp), hits, misses,
+		    100.0 * hits / ((double)hits + misses),
+		    mfp->stat.st_page_promote);
+	}
+	R_UNLOCK(dbenv, dbmp->reginfo);
 	return 0;
 }
 
@@ -68,8 +68,8 @@ __memp_fput_internal(dbmfp, pgaddr, flags, pgorder)
 	DB_MPOOL *dbmp;
 	DB_MPOOL_HASH *hp;
 	MPOOL *c_mp;
-	u_int32_t n_cache;
-	int adjust, ret, incr_count = 1;
+	u_int32_t n_cache, window;
+	int adjust, ret, probation, incr_count = 1;
 
 	dbenv = dbmfp->dbenv;
 	MPF_ILLEGAL_BEFORE_OPEN(dbmfp, "DB_MPOOLFILE->put");
@@ -222,12 +222,42 @@ __memp_fput_internal(dbmfp, pgaddr, flags, pgorder)
 	else if (LF_ISSET(DB_MPOOL_NOCACHE) && F_ISSET(bhp, BH_NOINCR)) {
 		bhp->priority = 0;
 	} else {
+		/*
+		 * Scan resistance (2Q): a clean page that has only been used
+		 * once sits on probation, ranked below everything that was
+		 * used recently, so a large scan recycles its own buffers
+		 * instead of pushing out the working set.  It's promoted when
+		 * it's used again after the correlated reference window, so
+		 * repeated puts by the same scan don't count.
+		 */
+		probation = 0;
+		if (dbenv->attr.mpool_scan_resistant &&
+		    !F_ISSET(bhp, BH_HOT | BH_DIRTY)) {
+			window = (c_mp->stat.st_pages / 100) *
+			    dbenv->attr.mpool_reref_window;
+			if (bhp->first_ref == 0) {
+				bhp->first_ref = c_mp->lru_count ?
+				    c_mp->lru_count : 1;
+				probation = 1;
+			} else if (c_mp->lru_count - bhp->first_ref >= window) {
+				F_SET(bhp, BH_HOT);
+				++dbmfp->mfp->stat.st_page_promote;
+			} else
+				probation = 1;
+		}
+
 		/*
 		 * We don't lock the LRU counter or the stat.st_pages field, if
 		 * we get garbage (which won't happen on a 32-bit machine), it
 		 * only means a buffer has the wrong priority.
 		 */
 		bhp->priority = c_mp->lru_count;
+		if (probation) {
+			adjust = (c_mp->stat.st_pages / 100) *
+			    dbenv->attr.mpool_probation_pct;
+			bhp->priority = bhp->priority > (u_int32_t)adjust ?
+			    bhp->priority - adjust : 0;
+		}
 
 		adjust = 0;
 		if (dbmfp->mfp->priority != 0)
@@ -377,10 +407,15 @@ __memp_reset_lru(dbenv, memreg)
 
 		MUTEX_LOCK(dbenv, &hp->hash_mutex);
 		for (bhp = SH_TAILQ_FIRST(&hp->hash_bucket, __bh);
-		    bhp != NULL; bhp = SH_TAILQ_NEXT(bhp, hq, __bh))
+		    bhp != NULL; bhp = SH_TAILQ_NEXT(bhp, hq, __bh)) {
 			if (bhp->priority != UINT32_T_MAX &&
 			    bhp->priority > MPOOL_BASE_DECREMENT)
 				bhp->priority -= MPOOL_BASE_DECREMENT;
+			if (bhp->first_ref > MPOOL_BASE_DECREMENT)
+				bhp->first_ref -= MPOOL_BASE_DECREMENT;
+			else if (bhp->first_ref != 0)
+				bhp->first_ref = 1;
+		}
 		MUTEX_UNLOCK(dbenv, &hp->hash_mutex);
 	}
 }
@@ -170,6 +170,12 @@ __memp_stat(dbenv, gspp, fspp, flags)
 				    c_mp->stat.st_alloc_max_pages;
 			sp->st_ckp_pages_sync += c_mp->stat.st_ckp_pages_sync;
 			sp->st_ckp_pages_skip += c_mp->stat.st_ckp_pages_skip;
+			sp->st_ckp_pages_total += c_mp->stat.st_ckp_pages_total;
+			sp->st_ckp_pages_written +=
+			    c_mp->stat.st_ckp_pages_written;
+			sp->st_ckp_ms += c_mp->stat.st_ckp_ms;
+			sp->st_ckp_pages_per_sec +=
+			    c_mp->stat.st_ckp_pages_per_sec;
 
 			if (LF_ISSET(DB_STAT_CLEAR)) {
 				dbmp->reginfo[i].rp->mutex.mutex_set_wait = 0;
@@ -205,6 +211,7 @@ __memp_stat(dbenv, gspp, fspp, flags)
 			sp->st_page_create += mfp->stat.st_page_create;
 			sp->st_page_in += mfp->stat.st_page_in;
 			sp->st_page_out += mfp->stat.st_page_out;
+			sp->st_page_promote += mfp->stat.st_page_promote;
 			sp->st_ro_merges += mfp->stat.st_ro_merges;
 			sp->st_rw_merges += mfp->stat.st_rw_merges;
 			if (fspp == NULL && LF_ISSET(DB_STAT_CLEAR)) {
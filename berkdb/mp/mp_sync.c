@@ -50,6 +50,7 @@ void bdb_rellock(void *bdb_state, const char *funcname, int line);
 void bdb_get_readlock(void *bdb_state,
     const char *idstr, const char *funcname, int line);
 int bdb_the_lock_desired(void);
+extern int time_epochms();
 
 #define BDB_WRITELOCK(idstr)    bdb_get_writelock(gbl_bdb_state, (idstr), __func__, __LINE__)
 #define BDB_READLOCK(idstr)     bdb_get_readlock(gbl_bdb_state, (idstr), __func__, __LINE__)
@@ -516,6 +517,8 @@ struct trickler {
 	db_sync_op op;
 	int restartable;
 	int sgio;
+	int ckp;		/* checkpoint, report progress */
+	int pace_start;		/* time_epochms() when writes began */
 
 	int nwaits;		/* only updated by one thread */
 
@@ -523,6 +526,8 @@ struct trickler {
 	int total_pages;
 	int done_pages;
 	int written_pages;
+	int paced_pages;	/* written, as reported to trickle_pace */
+	int pace_rate;		/* pages/sec to write at, 0 if not pacing */
 	int ret;
 	pthread_mutex_t lk;
 	pthread_cond_t wait;
@@ -542,6 +547,44 @@ static pool_t *pgpool;
 pthread_mutex_t pgpool_lk;
 
 
+/*
+ * trickle_pace --
+ *	Account for pages a checkpoint has written, and if the checkpoint is
+ *	being spread out, sleep until those writes are due.  Called with no
+ *	buffer or hash bucket locked.
+ */
+static void
+trickle_pace(struct trickler *t, int npages)
+{
+	MPOOL *mp;
+	int ahead, due, now;
+
+	mp = t->dbmp->reginfo[0].primary;
+
+	pthread_mutex_lock(&t->lk);
+	t->paced_pages += npages;
+	mp->stat.st_ckp_pages_written = t->paced_pages;
+	while (t->pace_rate > 0 && t->ret == 0) {
+		/*
+		 * Someone wants the bdb lock, and may be waiting on us.
+		 * Write the rest as fast as we can.
+		 */
+		if (bdb_the_lock_desired()) {
+			t->pace_rate = 0;
+			break;
+		}
+		due = t->pace_start +
+		    (int)((long long)t->paced_pages * 1000 / t->pace_rate);
+		now = time_epochms();
+		if ((ahead = due - now) <= 0)
+			break;
+		pthread_mutex_unlock(&t->lk);
+		poll(NULL, 0, ahead > 100 ? 100 : ahead);
+		pthread_mutex_lock(&t->lk);
+	}
+	pthread_mutex_unlock(&t->lk);
+}
+
 static void
 trickle_do_work(struct thdpool *thdpool, void *work, void *thddata, int thd_op)
 {
@@ -558,7 +601,7 @@ trickle_do_work(struct thdpool *thdpool, void *work, void *thddata, int thd_op)
 	MPOOLFILE *mfp;
 	int ar_cnt, hb_lock, i, j, pass, remaining, ret, t_ret;
 	int wait_cnt, write_cnt, wrote;
-	int sgio, gathered, delay_write;
+	int sgio, gathered, delay_write, paced;
 	db_pgno_t off_gather;
 
 	ret = 0;
@@ -573,7 +616,7 @@ trickle_do_work(struct thdpool *thdpool, void *work, void *thddata, int thd_op)
 	ar_cnt = range->len;
 
 	sgio = range->t->sgio;
-	wrote = gathered = delay_write = 0;
+	wrote = gathered = delay_write = paced = 0;
 	off_gather = 0;
 
 	/*
@@ -635,6 +678,15 @@ trickle_do_work(struct thdpool *thdpool, void *work, void *thddata, int thd_op)
 
 		}
 
+		/*
+		 * Checkpoints report their progress, and are paced, between
+		 * writes while we hold no buffers.
+		 */
+		if (range->t->ckp && gathered == 0 && wrote > paced) {
+			trickle_pace(range->t, wrote - paced);
+			paced = wrote;
+		}
+
 		if (i >= ar_cnt) {
 			i = 0;
 			++pass;
@@ -1001,6 +1053,9 @@ trickle_do_work(struct thdpool *thdpool, void *work, void *thddata, int thd_op)
 		MUTEX_UNLOCK(dbenv, &hparray[j]->hash_mutex);
 	}
 
+	if (range->t->ckp && wrote > paced)
+		trickle_pace(range->t, wrote - paced);
+
 	pthread_mutex_lock(&range->t->lk);
 	range->t->written_pages += wrote;
 	range->t->done_pages += ar_cnt;
@@ -1031,7 +1086,6 @@ init_trickle_threads(void)
 
 int gbl_parallel_memptrickle = 1;
 
-extern int time_epochms();
 void thdpool_process_message(struct thdpool *pool, char *line, int lline,
     int st);
 
@@ -1085,8 +1139,9 @@ __memp_sync_int(dbenv, dbmfp, trickle_max, op, wrotep, restartable, ckp_lsnp)
 	int do_parallel;
 	struct trickler *pt;
 	struct writable_range *range;
-	int start, end;
+	int start, end, write_start;
 	int memp_sync_files_time = 0;
+	int spread_ms, write_ms, paced = 0;
 	db_pgno_t off_gather = 0;
 	int gathered = 0;
 	int delay_write = 0;
@@ -1297,12 +1352,38 @@ __memp_sync_int(dbenv, dbmfp, trickle_max, op, wrotep, restartable, ckp_lsnp)
 	pt->op = op;
 	pt->restartable = restartable;
 	pt->sgio = dbenv->attr.sgio_enabled;
+	pt->ckp = (op == DB_SYNC_CACHE && ckp_lsnp != NULL);
 			
 	pt->total_pages = pt->done_pages = pt->written_pages = 0;
+	pt->paced_pages = pt->pace_rate = 0;
 	pt->ret = pt->nwaits = 0;
 	pthread_mutex_init(&pt->lk, NULL);
 	pthread_cond_init(&pt->wait, NULL);
 
+	write_start = pt->pace_start = time_epochms();
+	if (pt->ckp) {
+		mp->stat.st_ckp_pages_total = ar_cnt;
+		mp->stat.st_ckp_pages_written = 0;
+
+		/*
+		 * Spread the checkpoint's writes over ckp_spread_ms rather
+		 * than writing them in one burst, but never slower than
+		 * ckp_spread_min_rate.  A paced checkpoint is written by this
+		 * thread alone, so it leaves the trickle threads to the LRU
+		 * and trickle writers.
+		 */
+		spread_ms = dbenv->attr.ckp_spread_ms;
+		if (spread_ms > 0 && !IS_RECOVERING(dbenv)) {
+			pt->pace_rate = (int)((long long)ar_cnt * 1000 / spread_ms);
+			if (pt->pace_rate < dbenv->attr.ckp_spread_min_rate)
+				pt->pace_rate = dbenv->attr.ckp_spread_min_rate;
+			if (pt->pace_rate > 0) {
+				paced = 1;
+				do_parallel = 0;
+			}
+		}
+	}
+
 	/*
 	 * Flush each file by passing it to a thread. This serializes writes
 	 * to a file, which may help throughput and performance.
@@ -1419,6 +1500,15 @@ __memp_sync_int(dbenv, dbmfp, trickle_max, op, wrotep, restartable, ckp_lsnp)
 		ret = pt->ret;
 	}
 
+	if (pt->ckp) {
+		write_ms = time_epochms() - write_start;
+		mp->stat.st_ckp_pages_written = wrote;
+		mp->stat.st_ckp_ms = write_ms;
+		mp->stat.st_ckp_pages_per_sec =
+		    write_ms > 0 ? (int)((long long)wrote * 1000 / write_ms) :
+		    wrote;
+	}
+
 	pthread_mutex_destroy(&pt->lk);
 	pthread_cond_destroy(&pt->wait);
 done:
@@ -1456,8 +1546,11 @@ err:	__os_free(dbenv, bharray);
 	end = time_epochms();
 
 	if (wrote && ((end - start) > memp_sync_alarm_ms))
-		ctrace("memp_sync %d pages %d ms (memp_sync_files %d ms)\n",
-		    wrote, end - start, memp_sync_files_time);
+		ctrace("memp_sync %d pages %d ms, %d pages/sec%s "
+		    "(memp_sync_files %d ms)\n", wrote, end - start,
+		    (end > start) ?
+		    (int)((long long)wrote * 1000 / (end - start)) : wrote,
+		    (paced ? " paced" : ""), memp_sync_files_time);
 
 	return (ret);
 }
@@ -57,6 +57,7 @@ __lc_cache_init(DB_ENV *dbenv, int reinit)
 	for (int i = 0; i < dbenv->attr.cache_lc_max; i++) {
 		lcc->ent[i].cacheid = i;
 		lcc->ent[i].lc.memused = 0;
+		lcc->ent[i].lc.lastbuf = NULL;
 		listc_abl(&lcc->avail, &lcc->ent[i]);
 	}
 	lcc->nent = dbenv->attr.cache_lc_max;
@@ -89,7 +90,11 @@ static void
 free_lsn_collection(DB_ENV *dbenv, LSN_COLLECTION * lc)
 {
 	for (int i = 0; i < lc->nlsns; i++) {
-		if (lc->array[i].rec.data) {
+		if (lc->array[i].rec.flags == DB_DBT_RECVBUF) {
+			dbenv->rep_recvbuf_release(lc->array[i].rec.app_data);
+			lc->array[i].rec.data = NULL;
+			lc->array[i].rec.flags = DB_DBT_MALLOC;
+		} else if (lc->array[i].rec.data) {
 			__os_free(dbenv, lc->array[i].rec.data);
 			lc->array[i].rec.data = NULL;
 		}
@@ -98,6 +103,7 @@ free_lsn_collection(DB_ENV *dbenv, LSN_COLLECTION * lc)
 	lc->array = 0;
 	lc->nalloc = 0;
 	lc->nlsns = 0;
+	lc->lastbuf = NULL;
 }
 
 static void
@@ -152,12 +158,19 @@ err:
 	return ret;
 }
 
+/* Pin a receive buffer for a record only if the record is at least this
+ * share of it; a small record would keep a large buffer alive. */
+#define LC_RECVBUF_MIN_SHARE 4
+
 /* add a log record to an existing collection */
 static int
 lsn_collection_add(DB_ENV *dbenv, LSN_COLLECTION * lc, DB_LSN lsn, DBT *dbt)
 {
 	int ret;
 	int nalloc;
+	int charge;
+	void *handle = NULL;
+	size_t bufsize;
 
 	if (lc->nlsns >= lc->nalloc) {
 		nalloc = lc->nalloc == 0 ? 20 : lc->nalloc * 2;
@@ -171,16 +184,39 @@ lsn_collection_add(DB_ENV *dbenv, LSN_COLLECTION * lc, DB_LSN lsn, DBT *dbt)
 	}
 	lc->array[lc->nlsns].lsn = lsn;
 	lc->array[lc->nlsns].rec.size = dbt->size;
-	if (ret = __os_malloc(dbenv, dbt->size, &lc->array[lc->nlsns].rec.data))
-		goto err;
-	memcpy(lc->array[lc->nlsns].rec.data, dbt->data,
-	    lc->array[lc->nlsns].rec.size);
+	/* If the record is still sitting in the buffer net read it into,
+	 * keep a reference to that instead of copying it.  The whole buffer
+	 * stays in memory, so that's what gets charged, once per buffer. */
+	if (dbenv->rep_recvbuf_hold &&
+	    (handle = dbenv->rep_recvbuf_hold(dbt->data, dbt->size,
+		&bufsize)) != NULL && handle != lc->lastbuf &&
+	    dbt->size * LC_RECVBUF_MIN_SHARE < bufsize) {
+		dbenv->rep_recvbuf_release(handle);
+		handle = NULL;
+	}
+	if (handle) {
+		lc->array[lc->nlsns].rec.data = dbt->data;
+		lc->array[lc->nlsns].rec.app_data = handle;
+		lc->array[lc->nlsns].rec.flags = DB_DBT_RECVBUF;
+		charge = handle == lc->lastbuf ? 0 : bufsize;
+		lc->lastbuf = handle;
+	} else {
+		if (ret = __os_malloc(dbenv, dbt->size,
+			&lc->array[lc->nlsns].rec.data))
+			goto err;
+		memcpy(lc->array[lc->nlsns].rec.data, dbt->data,
+		    lc->array[lc->nlsns].rec.size);
+		lc->array[lc->nlsns].rec.flags = DB_DBT_MALLOC;
+		charge = dbt->size;
+	}
 	lc->nlsns++;
-	lc->memused += dbt->size;
-	dbenv->lc_cache.memused += dbt->size;
+	lc->memused += charge;
+	dbenv->lc_cache.memused += charge;
 	return 0;
 
 err:
+	if (handle)
+		dbenv->rep_recvbuf_release(handle);
 	return ret;
 }
 
@@ -586,6 +622,7 @@ __lc_cache_get(DB_ENV *dbenv, DB_LSN *lsnp, LSN_COLLECTION * lcout,
 			e->lc.nlsns = 0;
 			e->lc.nalloc = 0;
 			e->lc.array = NULL;
+			e->lc.lastbuf = NULL;
 
 			e->lc.had_serializable_records = 0;
 			e->txnid = 0;
@@ -53,6 +53,8 @@ static int __rep_set_rep_transport __P((DB_ENV *, char *,
 	int (*)(DB_ENV *, const DBT *, const DBT *, const DB_LSN *,
 	    char *, int, void *)));
 static int __rep_set_check_standalone __P((DB_ENV *, int (*)(DB_ENV *)));
+static int __rep_set_rep_recvbuf __P((DB_ENV *,
+	void *(*)(const void *, size_t, size_t *), void (*)(void *)));
 static int __rep_set_rep_db_pagesize __P((DB_ENV *, int));
 static int __rep_get_rep_db_pagesize __P((DB_ENV *, int *));
 static int __rep_start __P((DB_ENV *, DBT *, u_int32_t));
@@ -111,6 +113,7 @@ __rep_dbenv_create(dbenv)
 		dbenv->set_rep_request = __rep_set_request;
 		dbenv->set_rep_transport = __rep_set_rep_transport;
 		dbenv->set_check_standalone = __rep_set_check_standalone;
+		dbenv->set_rep_recvbuf = __rep_set_rep_recvbuf;
 		dbenv->set_rep_db_pagesize = __rep_set_rep_db_pagesize;
 		dbenv->get_rep_db_pagesize = __rep_get_rep_db_pagesize;
 		dbenv->rep_truncate_repdb = __rep_truncate_repdb;
@@ -842,6 +845,29 @@ __rep_set_check_standalone(dbenv, f_check_standalone)
 	return (0);
 }
 
+/*
+ * __rep_set_rep_recvbuf --
+ *	Register the transport's receive buffer pinning routines.  Log
+ *	records handed to __rep_process_message live in the transport's
+ *	buffer; if hold returns non-NULL the record may be kept past the
+ *	call until the handle is passed to release.
+ */
+static int
+__rep_set_rep_recvbuf(dbenv, f_hold, f_release)
+	DB_ENV *dbenv;
+	void *(*f_hold) __P((const void *, size_t, size_t *));
+	void (*f_release) __P((void *));
+{
+	PANIC_CHECK(dbenv);
+	if (f_hold == NULL || f_release == NULL) {
+		__db_err(dbenv, "DB_ENV->set_rep_recvbuf: no function specified");
+		return (EINVAL);
+	}
+	dbenv->rep_recvbuf_release = f_release;
+	dbenv->rep_recvbuf_hold = f_hold;
+	return (0);
+}
+
 /*
  * __rep_set_transport --
  *	Set the transport function for replication.
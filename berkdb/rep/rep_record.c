@@ -100,7 +100,8 @@ static int __rep_verify_match __P((DB_ENV *, REP_CONTROL *, time_t));
 
 int64_t gbl_rep_trans_parallel = 0, gbl_rep_trans_serial =
     0, gbl_rep_trans_deadlocked = 0, gbl_rep_trans_inline =
-    0, gbl_rep_rowlocks_multifile = 0;
+    0, gbl_rep_rowlocks_multifile = 0, gbl_rep_trans_page_chains =
+    0, gbl_rep_page_chains = 0;
 
 static inline int wait_for_running_transactions(DB_ENV *dbenv);
 
@@ -269,7 +270,11 @@ static void
 lc_free(DB_ENV *dbenv, struct __recovery_processor *rp, LSN_COLLECTION * lc)
 {
 	for (int i = 0; i < lc->nlsns; i++) {
-		if (lc->array[i].rec.data &&
+		if (lc->array[i].rec.flags == DB_DBT_RECVBUF) {
+			dbenv->rep_recvbuf_release(lc->array[i].rec.app_data);
+			lc->array[i].rec.data = NULL;
+			lc->array[i].rec.flags = 0;
+		} else if (lc->array[i].rec.data &&
 		    lc->array[i].rec.flags == DB_DBT_USERMEM) {
 			comdb2_free(lc->array[i].rec.data);
 			lc->array[i].rec.data = NULL;
@@ -286,6 +291,7 @@ lc_free(DB_ENV *dbenv, struct __recovery_processor *rp, LSN_COLLECTION * lc)
 	lc->nlsns = 0;
 	lc->nalloc = 0;
 	lc->memused = 0;
+	lc->lastbuf = NULL;
 	lc->nalloc = 0;
 }
 
@@ -2640,6 +2646,124 @@ err:	if (dbc != NULL && (t_ret = __db_c_close(dbc)) != 0 && ret == 0) {
 
 u_int32_t gbl_rep_lockid;
 
+static void
+apply_recovery_record(DB_ENV *dbenv, struct __recovery_processor *rp,
+    struct __recovery_record *rr, DB_LOGC **logcp, DBT *tmpdbt)
+{
+	u_int32_t rectype;
+	int rc;
+
+	if (rr->logdbt.data == NULL) {
+		if (*logcp == NULL) {
+			if (__log_cursor(dbenv, logcp)) {
+				__db_err(dbenv,
+				    "worker can't get log cursor while processing %u:%u\n",
+				    rr->lsn.file, rr->lsn.offset);
+				abort();
+			}
+			bzero(tmpdbt, sizeof(DBT));
+			tmpdbt->flags = DB_DBT_REALLOC;
+		}
+		if ((rc = __log_c_get(*logcp, &rr->lsn, tmpdbt, DB_SET))) {
+			__db_err(dbenv, "worker can't get lsn %u:%u\n",
+			    rr->lsn.file, rr->lsn.offset);
+			abort();
+		}
+		LOGCOPY_32(&rectype, tmpdbt->data);
+		tmpdbt->app_data = &rp->context;
+
+		/* Map the txnid to the context */
+		if (dispatch_rectype(rectype)) {
+			rc = __db_dispatch(dbenv, dbenv->recover_dtab,
+			    dbenv->recover_dtab_size, tmpdbt, &rr->lsn,
+			    DB_TXN_APPLY, rp->txninfo);
+		} else
+			rc = 0;
+	} else {
+
+		LOGCOPY_32(&rectype, rr->logdbt.data);
+
+		rr->logdbt.app_data = &rp->context;
+		if (dispatch_rectype(rectype)) {
+			rc = __db_dispatch(dbenv, dbenv->recover_dtab,
+			    dbenv->recover_dtab_size, &rr->logdbt,
+			    &rr->lsn, DB_TXN_APPLY, rp->txninfo);
+		} else
+			rc = 0;
+	}
+
+	/* TODO: what do I do on an error? */
+	if (rc) {
+		__db_err(dbenv, "transaction failed at %lu:%lu rc=%d",
+		    (u_long)rr->lsn.file, (u_long)rr->lsn.offset, rc);
+		/* and now? */
+		abort();
+	}
+}
+
+static void apply_recovery_queue(struct __recovery_queue *rq,
+    struct __recovery_record *stop, DB_LOGC **logcp, DBT *tmpdbt, void *q);
+
+/*
+ * Wait until dep, a record on another page chain queue, is applied.  If no
+ * worker is on that queue, apply it up to dep here rather than wait for one:
+ * a worker only ever waits for an earlier record, so the worker holding the
+ * earliest unapplied record never waits, however few threads there are.
+ */
+static void
+wait_for_chain_record(struct __recovery_processor *rp,
+    struct __recovery_record *dep, DB_LOGC **logcp, DBT *tmpdbt, void *q)
+{
+	struct __recovery_queue *dq = dep->chain;
+
+	pthread_mutex_lock(&rp->lk);
+	while (!dep->applied) {
+		if (!dq->claimed) {
+			dq->claimed = 1;
+			pthread_mutex_unlock(&rp->lk);
+			apply_recovery_queue(dq, dep, logcp, tmpdbt, q);
+			pthread_mutex_lock(&rp->lk);
+			dq->claimed = 0;
+			pthread_cond_broadcast(&rp->wait);
+			continue;
+		}
+		pthread_cond_wait(&rp->wait, &rp->lk);
+	}
+	pthread_mutex_unlock(&rp->lk);
+}
+
+/* Apply rq's records in order, through stop if it is not NULL.  The caller
+ * has claimed rq. */
+static void
+apply_recovery_queue(struct __recovery_queue *rq,
+    struct __recovery_record *stop, DB_LOGC **logcp, DBT *tmpdbt, void *q)
+{
+	struct __recovery_processor *rp = rq->processor;
+	DB_ENV *dbenv = rp->dbenv;
+	struct __recovery_record *rr;
+
+	while ((rr = listc_rtl(&rq->records)) != NULL) {
+		if (rr->wait_for)
+			wait_for_chain_record(rp, rr->wait_for, logcp, tmpdbt,
+			    q);
+
+		apply_recovery_record(dbenv, rp, rr, logcp, tmpdbt);
+
+		if (rr->waited_on) {
+			pthread_mutex_lock(&rp->lk);
+			rr->applied = 1;
+			pthread_cond_broadcast(&rp->wait);
+			pthread_mutex_unlock(&rp->lk);
+		}
+
+		/* mempool? */
+		listc_abl(q, rr);
+
+		if (rr == stop)
+			break;
+	}
+}
+
 static void
 worker_thd(struct thdpool *pool, void *work, void *thddata, int op)
 {
@@ -2647,13 +2771,8 @@ worker_thd(struct thdpool *pool, void *work, void *thddata, int op)
 	struct __recovery_queue *rq;
 	struct __recovery_record *rr;
 	int rc;
-	DB_ENV *dbenv;
 	DB_LOGC *logc = NULL;
 	DBT tmpdbt;
-	db_recops redo;
-	u_int32_t rectype;
-	u_int32_t txnid;
-	int recnum = 0, count;
 	LISTC_T(struct recovery_record) q;
 
 	listc_init(&q, offsetof(struct __recovery_record, lnk));
@@ -2663,90 +2782,41 @@ worker_thd(struct thdpool *pool, void *work, void *thddata, int op)
 
 	rq = (struct __recovery_queue *)work;
 	rp = rq->processor;
-	dbenv = rq->processor->dbenv;
-
-	count = rq->records.count;
-
-	rr = listc_rtl(&rq->records);
-
-	while (rr) {
-		recnum++;
-		if (rr->logdbt.data == NULL) {
-			if (logc == NULL) {
-				if (__log_cursor(dbenv, &logc)) {
-					__db_err(dbenv,
-					    "worker can't get log cursor while processing %u:%u\n",
-					    rr->lsn.file, rr->lsn.offset);
-					abort();
-				}
-				bzero(&tmpdbt, sizeof(DBT));
-				tmpdbt.flags = DB_DBT_REALLOC;
-			}
-			if ((rc = __log_c_get(logc, &rr->lsn, &tmpdbt, DB_SET))) {
-				__db_err(dbenv, "worker can't get lsn %u:%u\n",
-				    rr->lsn.file, rr->lsn.offset);
-				abort();
-			}
-			LOGCOPY_32(&rectype, tmpdbt.data);
-			tmpdbt.app_data = &rp->context;
-
-			/* Map the txnid to the context */
-			if (dispatch_rectype(rectype)) {
-				rc = __db_dispatch(dbenv, dbenv->recover_dtab,
-				    dbenv->recover_dtab_size, &tmpdbt, &rr->lsn,
-				    DB_TXN_APPLY, rq->processor->txninfo);
-			} else
-				rc = 0;
-		} else {
-
-			LOGCOPY_32(&rectype, rr->logdbt.data);
 
-			rr->logdbt.app_data = &rp->context;
-			if (dispatch_rectype(rectype)) {
-				rc = __db_dispatch(dbenv, dbenv->recover_dtab,
-				    dbenv->recover_dtab_size, &rr->logdbt,
-				    &rr->lsn, DB_TXN_APPLY,
-				    rq->processor->txninfo);
-			} else
-				rc = 0;
-		}
+	/* Another page chain's worker may be applying this queue for a
+	 * record it depends on. */
+	pthread_mutex_lock(&rp->lk);
+	while (rq->claimed)
+		pthread_cond_wait(&rp->wait, &rp->lk);
+	rq->claimed = 1;
+	pthread_mutex_unlock(&rp->lk);
 
-		/* TODO: what do I do on an error? */
-		if (rc) {
-			__db_err(dbenv, "transaction failed at %lu:%lu rc=%d",
-			    (u_long)rr->lsn.file, (u_long)rr->lsn.offset, rc);
-			/* and now? */
-			abort();
-		}
-
-		/* mempool? */
-		listc_abl(&q, rr);
-
-		rr = listc_rtl(&rq->records);
-	}
+	apply_recovery_queue(rq, NULL, &logc, &tmpdbt, &q);
 
 	if (logc) {
 		if (tmpdbt.data)
 			free(tmpdbt.data);
 		if ((rc = __log_c_close(logc))) {
-			__db_err(dbenv, "__log_c_close rc %d\n", rc);
+			__db_err(rp->dbenv, "__log_c_close rc %d\n", rc);
 			abort();
 		}
 	}
 
-	pthread_mutex_lock(&rq->processor->lk);
+	pthread_mutex_lock(&rp->lk);
+	rq->claimed = 0;
 	rr = listc_rtl(&q);
 	while (rr) {
 		pool_relablk(rp->recpool, rr);
 		rr = listc_rtl(&q);
 	}
-	rq->processor->num_busy_workers--;
+	rp->num_busy_workers--;
 
-	/* Signal if not running inline */
+	/* Signal if not running inline; page chain workers wait on this
+	 * too */
 	if (pool) {
-		pthread_cond_signal(&rq->processor->wait);
+		pthread_cond_broadcast(&rp->wait);
 	}
-	pthread_mutex_unlock(&rq->processor->lk);
+	pthread_mutex_unlock(&rp->lk);
 }
 
 /* note: must be called under the dbenv->recover_lk lock */
@@ -2806,6 +2876,210 @@ logical_record_file_affinity(int rectype)
 
 #include <stdlib.h>
 
+/* split records touch at most 4 pages */
+#define	REP_MAX_RECORD_PGNOS	4
+
+struct page_chain_ref {
+	db_pgno_t pgno;
+	int rec;
+};
+
+static int
+page_chain_ref_cmp(const void *a, const void *b)
+{
+	const struct page_chain_ref *ra = a, *rb = b;
+
+	if (ra->pgno != rb->pgno)
+		return ra->pgno < rb->pgno ? -1 : 1;
+	return ra->rec - rb->rec;
+}
+
+static inline int
+page_chain_root(int *parent, int i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+static struct __recovery_queue *
+get_chain_queue(struct __recovery_processor *rp, int fileid)
+{
+	struct __recovery_queue *rq;
+
+	if (rp->used_chain_queues == rp->num_chain_queues) {
+		rp->chain_queues = realloc(rp->chain_queues,
+		    (rp->num_chain_queues + 1) *
+		    sizeof(struct __recovery_queue *));
+		rp->chain_queues[rp->num_chain_queues] =
+		    malloc(sizeof(struct __recovery_queue));
+		rp->num_chain_queues++;
+	}
+	rq = rp->chain_queues[rp->used_chain_queues++];
+	rq->fileid = fileid;
+	rq->processor = rp;
+	rq->used = 1;
+	rq->claimed = 0;
+	listc_init(&rq->records, offsetof(struct __recovery_record, lnk));
+	return rq;
+}
+
+/*
+ * A single big transaction against one file would otherwise be applied by
+ * one worker.  Split the file's records into chains: two records are in the
+ * same chain if they modify a common page other than page 0, and each chain
+ * keeps its records in log order.  Page 0 is the meta page, which every
+ * allocation and free touches, and also PGNO_INVALID, which records use for
+ * the pages they don't have; unioning on it would put nearly everything in
+ * one chain.  Instead the records on page 0 are ordered as a dependency
+ * chain of their own: each waits for the previous one if that is on another
+ * queue.  So every page still sees its records in order.  The chains are
+ * binned onto at most rep_page_chains_max queues, which are added to queues.
+ * Returns the number of queues added.
+ */
+static int
+split_page_chains(DB_ENV *dbenv, struct __recovery_processor *rp,
+    struct __recovery_queue *rq, DB_LOGC *logc, DBT *data_dbt, void *queues)
+{
+	struct __recovery_record **recs = NULL, *rr;
+	struct __recovery_queue **bins = NULL;
+	struct page_chain_ref *refs = NULL;
+	db_pgno_t pgnos[REP_MAX_RECORD_PGNOS];
+	int *parent = NULL, *size = NULL, *bin = NULL, *load = NULL;
+	char *meta = NULL;
+	int nrecs, nrefs = 0, maxbins, nbins = 0, added = 0, last_meta = -1;
+	int i, j, n, a, b;
+	u_int32_t rectype;
+	DBT *dbt;
+
+	nrecs = listc_size(&rq->records);
+	maxbins = dbenv->attr.rep_page_chains_max;
+	if (maxbins < 2 || nrecs < 2)
+		return 0;
+
+	recs = malloc(nrecs * sizeof(struct __recovery_record *));
+	refs = malloc(nrecs * REP_MAX_RECORD_PGNOS *
+	    sizeof(struct page_chain_ref));
+	parent = malloc(nrecs * sizeof(int));
+	size = calloc(nrecs, sizeof(int));
+	bin = malloc(nrecs * sizeof(int));
+	load = calloc(maxbins, sizeof(int));
+	bins = calloc(maxbins, sizeof(struct __recovery_queue *));
+	meta = calloc(nrecs, sizeof(char));
+	if (!recs || !refs || !parent || !size || !bin || !load || !bins ||
+	    !meta)
+		goto done;
+
+	i = 0;
+	LISTC_FOR_EACH(&rq->records, rr, lnk) {
+		recs[i] = rr;
+		parent[i] = i;
+		i++;
+	}
+
+	for (i = 0; i < nrecs; i++) {
+		rr = recs[i];
+		if (rr->logdbt.data == NULL) {
+			if (__log_c_get(logc, &rr->lsn, data_dbt, DB_SET) != 0)
+				goto done;
+			dbt = data_dbt;
+		} else
+			dbt = &rr->logdbt;
+
+		LOGCOPY_32(&rectype, dbt->data);
+		n = pgnos_for_recovery_record(dbenv, rectype, dbt, pgnos,
+		    REP_MAX_RECORD_PGNOS);
+		/* Don't know what this touches, leave the file serial. */
+		if (n < 0)
+			goto done;
+		for (j = 0; j < n; j++) {
+			if (pgnos[j] == PGNO_INVALID) {
+				meta[i] = 1;
+				continue;
+			}
+			refs[nrefs].pgno = pgnos[j];
+			refs[nrefs].rec = i;
+			nrefs++;
+		}
+	}
+
+	/* Union records that share a page.  A chain's root is its first
+	 * record. */
+	qsort(refs, nrefs, sizeof(struct page_chain_ref), page_chain_ref_cmp);
+	for (j = 1; j < nrefs; j++) {
+		if (refs[j].pgno != refs[j - 1].pgno)
+			continue;
+		a = page_chain_root(parent, refs[j - 1].rec);
+		b = page_chain_root(parent, refs[j].rec);
+		if (a < b)
+			parent[b] = a;
+		else if (b < a)
+			parent[a] = b;
+	}
+	for (i = 0; i < nrecs; i++)
+		size[page_chain_root(parent, i)]++;
+
+	/* Give each chain, in order of its first record, to the least
+	 * loaded bin. */
+	for (i = 0; i < nrecs; i++) {
+		a = page_chain_root(parent, i);
+		if (a != i) {
+			bin[i] = bin[a];
+			continue;
+		}
+		b = 0;
+		for (j = 1; j < maxbins; j++) {
+			if (load[j] < load[b])
+				b = j;
+		}
+		if (load[b] == 0)
+			nbins++;
+		load[b] += size[i];
+		bin[i] = b;
+	}
+
+	if (nbins < 2)
+		goto done;
+
+	/* The original queue is the first bin, it is already on queues. */
+	listc_init(&rq->records, offsetof(struct __recovery_record, lnk));
+	for (i = 0; i < nrecs; i++) {
+		b = bin[i];
+		if (bins[b] == NULL) {
+			if (i == 0) {
+				bins[b] = rq;
+			} else {
+				bins[b] = get_chain_queue(rp, rq->fileid);
+				listc_abl(queues, bins[b]);
+				added++;
+			}
+		}
+		recs[i]->chain = bins[b];
+		listc_abl(&bins[b]->records, recs[i]);
+
+		if (!meta[i])
+			continue;
+		if (last_meta >= 0 && bin[last_meta] != b) {
+			recs[i]->wait_for = recs[last_meta];
+			recs[last_meta]->waited_on = 1;
+		}
+		last_meta = i;
+	}
+
+done:
+	free(recs);
+	free(refs);
+	free(parent);
+	free(size);
+	free(bin);
+	free(load);
+	free(bins);
+	free(meta);
+	return added;
+}
+
 static void
 processor_thd(struct thdpool *pool, void *work, void *thddata, int op)
 {
@@ -2944,6 +3218,7 @@ processor_thd(struct thdpool *pool, void *work, void *thddata, int op)
 			rp->recovery_queues[fileid]->fileid = fileid;
 			rp->recovery_queues[fileid]->processor = rp;
 			rp->recovery_queues[fileid]->used = 0;
+			rp->recovery_queues[fileid]->claimed = 0;
 			listc_init(&rp->recovery_queues[fileid]->records,
 			    offsetof(struct __recovery_record, lnk));
 		}
@@ -2960,10 +3235,38 @@ processor_thd(struct thdpool *pool, void *work, void *thddata, int op)
 			rr->logdbt.data = NULL;
 		rr->lsn = *lsnp;
 		rr->fileid = fileid;
+		rr->chain = NULL;
+		rr->wait_for = NULL;
+		rr->waited_on = 0;
+		rr->applied = 0;
 
 		listc_abl(&rp->recovery_queues[fileid]->records, rr);
 	}
 
+	/* Split big files into page chains that can be applied in
+	 * parallel. */
+	if (dbenv->attr.rep_page_chains) {
+		int added, split = 0;
+
+		rp->used_chain_queues = 0;
+		for (j = 1; j < rp->num_fileids; j++) {
+			rq = rp->recovery_queues[j];
+			if (rq == NULL || !rq->used ||
+			    listc_size(&rq->records) <
+			    dbenv->attr.rep_page_chains_min_records)
+				continue;
+			added = split_page_chains(dbenv, rp, rq, logc,
+			    &data_dbt, &queues);
+			if (added) {
+				rp->num_busy_workers += added;
+				gbl_rep_page_chains += added + 1;
+				split = 1;
+			}
+		}
+		if (split)
+			gbl_rep_trans_page_chains++;
+	}
+
 	if ((dbenv->flags & DB_ENV_ROWLOCKS) && listc_size(&queues) > 1) {
 		gbl_rep_rowlocks_multifile++;
 	}
@@ -3889,6 +4192,7 @@ bad_resize:	;
 	rp->dbenv = dbenv;
 	rp->lc.nlsns = 0;
 	rp->lc.memused = 0;
+	rp->lc.lastbuf = NULL;
 	rp->txninfo = NULL;
 	rp->context = 0;
 
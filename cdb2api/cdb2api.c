@@ -63,6 +63,15 @@ static int cdb2_tcpbufsz = 0;
 #  define WITH_SSL 1
 #endif
 
+/* LZ4 compressed row frames need liblz4 */
+#ifndef WITH_LZ4
+#  define WITH_LZ4 0
+#endif
+
+#if WITH_LZ4
+#include <lz4.h>
+#endif
+
 #if WITH_SSL
 static ssl_mode cdb2_c_ssl_mode = SSL_ALLOW;
 static char cdb2_sslcertpath[PATH_MAX];
@@ -584,6 +593,22 @@ typedef struct cdb2_ssl_sess_list {
 } cdb2_ssl_sess_list;
 #endif
 
+/* A statement sent with cdb2_submit() whose response is still to be read */
+struct cdb2_async_stmt {
+    cdb2_async_callback cb;
+    void *arg;
+    struct cdb2_async_stmt *next;
+};
+
+/* A column of a multi-row frame, at the row being read */
+struct cdb2_frame_col {
+    const unsigned char *lens;
+    const unsigned char *nulls;
+    const unsigned char *data;
+    int len;
+    int isnull;
+};
+
 struct cdb2_hndl {
     char dbname[64];
     char cluster[64];
@@ -623,6 +648,8 @@ struct cdb2_hndl {
     int client_side_error;
     int n_bindvars;
     CDB2SQLQUERY__Bindvalue **bindvars;
+    int bind_rows;     /* rows ended with cdb2_bind_next_row() */
+    int bind_row_size; /* values in each of them */
     cdb2_query_list *query_list;
     int snapshot_file;
     int snapshot_offset;
@@ -641,6 +668,15 @@ struct cdb2_hndl {
     int debug_trace;
     int max_retries;
     int min_retries;
+    /* pipelined statements, in the order their responses will arrive */
+    struct cdb2_async_stmt *async_head;
+    struct cdb2_async_stmt *async_tail;
+    int async_npending;
+    /* multi-row frame in lastresponse, and its row being read */
+    unsigned char *frame_buf; /* decompressed frame */
+    struct cdb2_frame_col *frame_cols;
+    int frame_row;
+    int frame_nrows;
 #if WITH_SSL
     ssl_mode c_sslmode; /* client SSL mode */
     peer_ssl_mode s_sslmode; /* server SSL mode */
@@ -1507,7 +1543,10 @@ static int newsql_disconnect(cdb2_hndl_tp *hndl, SBUF2 *sb, int line)
     int fd = sbuf2fileno(sb);
 
     int timeoutms = 10 * 1000;
-    if ((hndl->firstresponse &&
+    /* Responses of pipelined statements may still be on the way, so the
+       socket can't go back to the pool. */
+    if (hndl->async_npending > 0 ||
+        (hndl->firstresponse &&
          (!hndl->lastresponse ||
           (hndl->lastresponse->response_type != RESPONSE_TYPE__LAST_ROW))) ||
         (!hndl->firstresponse)) {
@@ -1814,8 +1853,94 @@ static int cdb2_convert_error_code(int rc)
     }
 }
 
+static void cdb2_frame_clear(cdb2_hndl_tp *hndl)
+{
+    free(hndl->frame_buf);
+    hndl->frame_buf = NULL;
+    free(hndl->frame_cols);
+    hndl->frame_cols = NULL;
+    hndl->frame_row = 0;
+    hndl->frame_nrows = 0;
+}
+
+static void cdb2_frame_set_row(cdb2_hndl_tp *hndl, int row)
+{
+    int ncols = hndl->firstresponse->n_value;
+    uint32_t len;
+
+    for (int i = 0; i < ncols; i++) {
+        struct cdb2_frame_col *c = &hndl->frame_cols[i];
+        if (row > 0)
+            c->data += c->len;
+        memcpy(&len, c->lens + row * sizeof(uint32_t), sizeof(uint32_t));
+        c->len = ntohl(len);
+        c->isnull = (c->nulls[row / 8] >> (row % 8)) & 1;
+    }
+    hndl->frame_row = row;
+}
+
+/* Point the columns at the first row of the frame in lastresponse */
+static int cdb2_frame_load(cdb2_hndl_tp *hndl)
+{
+    CDB2SQLRESPONSE *resp = hndl->lastresponse;
+    int ncols = hndl->firstresponse->n_value;
+    int nrows = resp->frame_rows;
+    const unsigned char *p = resp->frame.data;
+    const unsigned char *end;
+    size_t len = resp->frame.len;
+
+    cdb2_frame_clear(hndl);
+    if (!resp->has_frame_rows || nrows <= 0 || ncols <= 0)
+        return -1;
+
+    if (resp->has_frame_rawlen) {
+#if WITH_LZ4
+        hndl->frame_buf = malloc(resp->frame_rawlen);
+        if (hndl->frame_buf == NULL ||
+            LZ4_decompress_safe((const char *)p, (char *)hndl->frame_buf,
+                                len, resp->frame_rawlen) != resp->frame_rawlen)
+            return -1;
+        p = hndl->frame_buf;
+        len = resp->frame_rawlen;
+#else
+        return -1;
+#endif
+    }
+    end = p + len;
+
+    hndl->frame_cols = calloc(ncols, sizeof(struct cdb2_frame_col));
+    if (hndl->frame_cols == NULL)
+        return -1;
+    for (int i = 0; i < ncols; i++) {
+        struct cdb2_frame_col *c = &hndl->frame_cols[i];
+        size_t datalen = 0;
+        uint32_t l;
+        if (end - p < (nrows + 7) / 8 + nrows * sizeof(uint32_t))
+            return -1;
+        c->nulls = p;
+        p += (nrows + 7) / 8;
+        c->lens = p;
+        p += nrows * sizeof(uint32_t);
+        for (int row = 0; row < nrows; row++) {
+            memcpy(&l, c->lens + row * sizeof(uint32_t), sizeof(uint32_t));
+            datalen += ntohl(l);
+        }
+        if (end - p < datalen)
+            return -1;
+        c->data = p;
+        p += datalen;
+    }
+    if (p != end)
+        return -1;
+
+    hndl->frame_nrows = nrows;
+    cdb2_frame_set_row(hndl, 0);
+    return 0;
+}
+
 static void clear_responses(cdb2_hndl_tp *hndl)
 {
+    cdb2_frame_clear(hndl);
     if (hndl->lastresponse) {
         cdb2__sqlresponse__free_unpacked(hndl->lastresponse, NULL);
         free((void *)hndl->last_buf);
@@ -1953,6 +2078,11 @@ static int cdb2_send_query(cdb2_hndl_tp *hndl, SBUF2 *sb, char *dbname,
 
     sqlquery.n_bindvars = n_bindvars;
     sqlquery.bindvars = bindvars;
+    if (hndl && n_bindvars && bindvars == hndl->bindvars &&
+        hndl->bind_rows > 0) {
+        sqlquery.has_bind_rows = 1;
+        sqlquery.bind_rows = hndl->bind_rows;
+    }
     sqlquery.n_types = ntypes;
     sqlquery.types = types;
 
@@ -2004,6 +2134,12 @@ static int cdb2_send_query(cdb2_hndl_tp *hndl, SBUF2 *sb, char *dbname,
     if (hndl) {
         features[n_features] = CDB2_CLIENT_FEATURES__ALLOW_MASTER_DBINFO;
         n_features++;
+        features[n_features] = CDB2_CLIENT_FEATURES__ROW_FRAMES;
+        n_features++;
+#if WITH_LZ4
+        features[n_features] = CDB2_CLIENT_FEATURES__ROW_FRAMES_LZ4;
+        n_features++;
+#endif
 #if WITH_SSL
         features[n_features] = CDB2_CLIENT_FEATURES__SSL;
         n_features++;
@@ -2137,6 +2273,13 @@ retry_next_record:
     if (hndl->firstresponse->error_code)
         PRINT_RETURN_OK(hndl->firstresponse->error_code);
 
+    /* the next row of the frame, if any left */
+    if (hndl->frame_row + 1 < hndl->frame_nrows) {
+        cdb2_frame_set_row(hndl, hndl->frame_row + 1);
+        hndl->rows_read++;
+        PRINT_RETURN_OK(CDB2_OK);
+    }
+
     if (hndl->lastresponse) {
         if (hndl->lastresponse->response_type == RESPONSE_TYPE__LAST_ROW) {
             PRINT_RETURN_OK(CDB2_OK_DONE);
@@ -2187,6 +2330,7 @@ retry_next_record:
     }
 
     if (hndl->last_buf != NULL) {
+        cdb2_frame_clear(hndl);
         if (hndl->lastresponse)
             cdb2__sqlresponse__free_unpacked(hndl->lastresponse, NULL);
 
@@ -2214,6 +2358,14 @@ retry_next_record:
             goto retry;
         }
 
+        if (hndl->lastresponse->has_frame && cdb2_frame_load(hndl)) {
+            cdb2_frame_clear(hndl);
+            newsql_disconnect(hndl, hndl->sb, __LINE__);
+            sprintf(hndl->errstr, "%s: Invalid row frame from server",
+                    __func__);
+            PRINT_RETURN_OK(-1);
+        }
+
         hndl->rows_read++;
         if (hndl->in_trans) {
             /* Give the same error for every query until commit/rollback */
@@ -2356,6 +2508,8 @@ int cdb2_close(cdb2_hndl_tp *hndl)
     if (!hndl)
         goto done;
 
+    cdb2_async_wait(hndl);
+
     if (hndl->ack)
         ack(hndl);
 
@@ -2368,6 +2522,7 @@ int cdb2_close(cdb2_hndl_tp *hndl)
         hndl->first_buf = NULL;
     }
 
+    cdb2_frame_clear(hndl);
     if (hndl->lastresponse) {
         cdb2__sqlresponse__free_unpacked(hndl->lastresponse, NULL);
         free((void *)hndl->last_buf);
@@ -2875,6 +3030,17 @@ static void clear_snapshot_info(cdb2_hndl_tp *hndl, int line)
     hndl->snapshot_offset = 0;
 }
 
+static int check_bind_rows(cdb2_hndl_tp *hndl)
+{
+    if (hndl->bind_rows &&
+        hndl->n_bindvars != hndl->bind_rows * hndl->bind_row_size) {
+        sprintf(hndl->errstr, "Bound parameters past the last "
+                              "cdb2_bind_next_row()");
+        return CDB2ERR_BADREQ;
+    }
+    return 0;
+}
+
 static int cdb2_run_statement_typed_int(cdb2_hndl_tp *hndl, const char *sql,
                                         int ntypes, int *types, int line)
 {
@@ -2909,6 +3075,9 @@ static int cdb2_run_statement_typed_int(cdb2_hndl_tp *hndl, const char *sql,
     if (!sql)
         return 0;
 
+    if ((rc = check_bind_rows(hndl)) != 0)
+        return rc;
+
     // Ohai .. i want to sniff out 'set hasql on' here ..
     if (strncasecmp(sql, "set", 3) == 0) {
         int i, j, k;
@@ -3659,6 +3828,9 @@ int cdb2_run_statement_typed(cdb2_hndl_tp *hndl, const char *sql, int ntypes,
 
     pthread_once(&init_once, do_init_once);
 
+    /* responses of pipelined statements come first */
+    cdb2_async_wait(hndl);
+
     if (hndl->temp_trans && hndl->in_trans) {
         cdb2_run_statement_typed_int(hndl, "rollback", 0, NULL, __LINE__);
     }
@@ -3707,6 +3879,226 @@ int cdb2_run_statement_typed(cdb2_hndl_tp *hndl, const char *sql, int ntypes,
     return rc;
 }
 
+/* Read the response of the oldest pipelined statement and hand it to its
+   callback, which may fetch the rows with cdb2_next_record().  Whatever
+   the callback leaves unread is discarded so the next response can be
+   read. */
+static int cdb2_async_complete(cdb2_hndl_tp *hndl)
+{
+    struct cdb2_async_stmt *stmt = hndl->async_head;
+    int len;
+    int type = 0;
+    int rc;
+
+    /* finish whatever the statement before left unread */
+    while (cdb2_next_record_int(hndl, 0) == CDB2_OK)
+        ;
+    clear_responses(hndl);
+    hndl->rows_read = 0;
+    hndl->first_record_read = 0;
+
+    if (hndl->sb == NULL) {
+        sprintf(hndl->errstr, "%s: Connection lost with statements pending",
+                __func__);
+        rc = CDB2ERR_IO_ERROR;
+    } else if (cdb2_read_record(hndl, (char **)&hndl->first_buf, &len,
+                                &type) != 0 ||
+               type != RESPONSE_HEADER__SQL_RESPONSE ||
+               hndl->first_buf == NULL ||
+               (hndl->firstresponse = cdb2__sqlresponse__unpack(
+                    NULL, len, hndl->first_buf)) == NULL) {
+        newsql_disconnect(hndl, hndl->sb, __LINE__);
+        free((void *)hndl->first_buf);
+        hndl->first_buf = NULL;
+        sprintf(hndl->errstr, "%s: Can't read response from the db",
+                __func__);
+        rc = CDB2ERR_IO_ERROR;
+    } else if (hndl->firstresponse->response_type !=
+               RESPONSE_TYPE__COLUMN_NAMES) {
+        newsql_disconnect(hndl, hndl->sb, __LINE__);
+        sprintf(hndl->errstr, "%s: Unknown response type %d", __func__,
+                hndl->firstresponse->response_type);
+        clear_responses(hndl);
+        rc = -1;
+    } else if (hndl->firstresponse->error_code) {
+        rc = cdb2_convert_error_code(hndl->firstresponse->error_code);
+    } else {
+        /* read ahead the first row, as cdb2_run_statement() does */
+        rc = cdb2_next_record_int(hndl, 0);
+        if (rc == CDB2_OK || rc == CDB2_OK_DONE)
+            rc = 0;
+        else
+            rc = cdb2_convert_error_code(rc);
+    }
+
+    /* dequeue first so the callback can submit more statements */
+    hndl->async_head = stmt->next;
+    if (hndl->async_head == NULL)
+        hndl->async_tail = NULL;
+
+    if (stmt->cb)
+        stmt->cb(hndl, rc, stmt->arg);
+
+    while (cdb2_next_record_int(hndl, 0) == CDB2_OK)
+        ;
+    clear_responses(hndl);
+
+    hndl->async_npending--;
+    free(stmt);
+
+    if (hndl->debug_trace) {
+        fprintf(stderr, "td %u %s line %d completed statement rc=%d, %d "
+                        "pending\n",
+                (uint32_t)pthread_self(), __func__, __LINE__, rc,
+                hndl->async_npending);
+    }
+    return rc;
+}
+
+int cdb2_submit(cdb2_hndl_tp *hndl, const char *sql, cdb2_async_callback cb,
+                void *arg)
+{
+    struct cdb2_async_stmt *stmt;
+    int rc = 0;
+
+    pthread_once(&init_once, do_init_once);
+
+    while (sql && isspace(*sql))
+        sql++;
+
+    if (!sql || *sql == '\0') {
+        sprintf(hndl->errstr, "%s: No statement", __func__);
+        rc = CDB2ERR_NOSTATEMENT;
+        goto done;
+    }
+
+    /* Transactions and sets need the answer of each statement before the
+       next one goes out, and hasql replays statements on other nodes. */
+    if (hndl->in_trans || hndl->is_hasql ||
+        strncasecmp(sql, "set", 3) == 0 || strncasecmp(sql, "begin", 5) == 0 ||
+        strncasecmp(sql, "commit", 6) == 0 ||
+        strncasecmp(sql, "rollback", 8) == 0) {
+        sprintf(hndl->errstr, "%s: Statement can't be pipelined, use "
+                              "cdb2_run_statement",
+                __func__);
+        rc = CDB2ERR_NOTSUPPORTED;
+        goto done;
+    }
+
+    if ((rc = check_bind_rows(hndl)) != 0)
+        goto done;
+
+    if (hndl->async_npending == 0) {
+        /* discard what is left of a cdb2_run_statement() */
+        while (cdb2_next_record_int(hndl, 0) == CDB2_OK)
+            ;
+        clear_responses(hndl);
+    }
+
+    if (hndl->sb == NULL) {
+        /* a new connection would answer out of order */
+        if (hndl->async_npending > 0) {
+            sprintf(hndl->errstr,
+                    "%s: Connection lost with statements pending", __func__);
+            rc = CDB2ERR_IO_ERROR;
+            goto done;
+        }
+        cdb2_connect_sqlhost(hndl);
+        if (hndl->sb == NULL) {
+            sprintf(hndl->errstr, "%s: Cannot connect to db", __func__);
+            rc = CDB2ERR_CONNECT_ERROR;
+            goto done;
+        }
+    }
+
+    stmt = malloc(sizeof(struct cdb2_async_stmt));
+    if (stmt == NULL) {
+        sprintf(hndl->errstr, "%s: out of memory", __func__);
+        rc = CDB2ERR_MALLOC;
+        goto done;
+    }
+    stmt->cb = cb;
+    stmt->arg = arg;
+    stmt->next = NULL;
+
+    make_random_str(hndl->cnonce, &hndl->cnonce_len);
+    rc = cdb2_send_query(hndl, hndl->sb, hndl->dbname, (char *)sql,
+                         hndl->num_set_commands, hndl->num_set_commands_sent,
+                         hndl->commands, hndl->n_bindvars, hndl->bindvars, 0,
+                         NULL, 0, 0, 0, 0, __LINE__);
+    if (rc != 0) {
+        free(stmt);
+        newsql_disconnect(hndl, hndl->sb, __LINE__);
+        sprintf(hndl->errstr, "%s: Can't send query to the db", __func__);
+        rc = CDB2ERR_IO_ERROR;
+        goto done;
+    }
+    /* the set commands went out with this statement */
+    hndl->num_set_commands_sent = hndl->num_set_commands;
+
+    if (hndl->async_tail)
+        hndl->async_tail->next = stmt;
+    else
+        hndl->async_head = stmt;
+    hndl->async_tail = stmt;
+    hndl->async_npending++;
+
+done:
+    if (log_calls)
+        fprintf(stderr, "%p> cdb2_submit(%p, \"%s\") = %d\n",
+                (void *)pthread_self(), hndl, sql, rc);
+    return rc;
+}
+
+int cdb2_async_fd(cdb2_hndl_tp *hndl)
+{
+    if (hndl->sb == NULL)
+        return -1;
+    return sbuf2fileno(hndl->sb);
+}
+
+int cdb2_async_pending(cdb2_hndl_tp *hndl)
+{
+    return hndl->async_npending;
+}
+
+/* Complete the pipelined statements whose responses have started to
+   arrive, without waiting for the others.  Returns how many completed. */
+int cdb2_async_process(cdb2_hndl_tp *hndl)
+{
+    struct pollfd pfd;
+    int n = 0;
+
+    pthread_once(&init_once, do_init_once);
+
+    while (hndl->async_head) {
+        if (hndl->sb && sbuf2pending(hndl->sb) == 0) {
+            pfd.fd = sbuf2fileno(hndl->sb);
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, 0) <= 0)
+                break;
+        }
+        cdb2_async_complete(hndl);
+        n++;
+    }
+    return n;
+}
+
+/* Complete every pipelined statement, blocking as needed */
+int cdb2_async_wait(cdb2_hndl_tp *hndl)
+{
+    int n = 0;
+
+    pthread_once(&init_once, do_init_once);
+
+    while (hndl->async_head) {
+        cdb2_async_complete(hndl);
+        n++;
+    }
+    return n;
+}
+
 int cdb2_numcolumns(cdb2_hndl_tp *hndl)
 {
     int rc;
@@ -3839,6 +4231,8 @@ int cdb2_column_size(cdb2_hndl_tp *hndl, int col)
 {
     if (hndl->lastresponse == NULL)
         return -1;
+    if (hndl->frame_nrows)
+        return hndl->frame_cols[col].len;
     return hndl->lastresponse->value[col]->value.len;
 }
 
@@ -3846,6 +4240,12 @@ void *cdb2_column_value(cdb2_hndl_tp *hndl, int col)
 {
     if (hndl->lastresponse == NULL)
         return NULL;
+    if (hndl->frame_nrows) {
+        struct cdb2_frame_col *c = &hndl->frame_cols[col];
+        if (c->isnull)
+            return NULL;
+        return c->len ? (void *)c->data : (void *)"";
+    }
     if (hndl->lastresponse->value[col]->value.len == 0 &&
         hndl->lastresponse->value[col]->has_isnull != 1 &&
         hndl->lastresponse->value[col]->isnull != 1) {
@@ -3927,6 +4327,32 @@ done:
     return rc;
 }
 
+/* End a row of bound parameters.  A statement run with several rows bound
+   is executed once for each row, in a single request. */
+int cdb2_bind_next_row(cdb2_hndl_tp *hndl)
+{
+    int rc = 0;
+    pthread_once(&init_once, do_init_once);
+    if (hndl->bind_rows == 0) {
+        hndl->bind_row_size = hndl->n_bindvars;
+    }
+    if (hndl->bind_row_size == 0 ||
+        hndl->n_bindvars != (hndl->bind_rows + 1) * hndl->bind_row_size) {
+        sprintf(hndl->errstr, "%s: row %d has %d values instead of %d",
+                __func__, hndl->bind_rows + 1,
+                hndl->n_bindvars - hndl->bind_rows * hndl->bind_row_size,
+                hndl->bind_row_size);
+        rc = CDB2ERR_BADREQ;
+        goto done;
+    }
+    hndl->bind_rows++;
+done:
+    if (log_calls)
+        fprintf(stderr, "%p> cdb2_bind_next_row(%p) = %d\n",
+                (void *)pthread_self(), hndl, rc);
+    return rc;
+}
+
 int cdb2_clearbindings(cdb2_hndl_tp *hndl)
 {
     pthread_once(&init_once, do_init_once);
@@ -3939,6 +4365,8 @@ int cdb2_clearbindings(cdb2_hndl_tp *hndl)
     free(hndl->bindvars);
     hndl->bindvars = NULL;
     hndl->n_bindvars = 0;
+    hndl->bind_rows = 0;
+    hndl->bind_row_size = 0;
 done:
     if (log_calls)
         fprintf(stderr, "%p> cdb2_clearbindings(%p)\n", (void *)pthread_self(),
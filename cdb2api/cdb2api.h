@@ -203,6 +203,21 @@ int cdb2_run_statement(cdb2_hndl_tp *hndl, const char *sql);
 int cdb2_run_statement_typed(cdb2_hndl_tp *hndl, const char *sql, int ntypes,
                              int *types);
 
+/* Pipelined statements: cdb2_submit() sends a statement without waiting
+   for its response.  Responses are read in submission order, by
+   cdb2_async_process() once cdb2_async_fd() is readable or by
+   cdb2_async_wait(), and each is passed to the statement's callback with
+   the rc cdb2_run_statement() would have returned.  Rows can be fetched
+   with cdb2_next_record() only from within the callback. */
+typedef void (*cdb2_async_callback)(cdb2_hndl_tp *hndl, int rc, void *arg);
+
+int cdb2_submit(cdb2_hndl_tp *hndl, const char *sql, cdb2_async_callback cb,
+                void *arg);
+int cdb2_async_fd(cdb2_hndl_tp *hndl);
+int cdb2_async_pending(cdb2_hndl_tp *hndl);
+int cdb2_async_process(cdb2_hndl_tp *hndl);
+int cdb2_async_wait(cdb2_hndl_tp *hndl);
+
 int cdb2_numcolumns(cdb2_hndl_tp *hndl);
 const char *cdb2_column_name(cdb2_hndl_tp *hndl, int col);
 int cdb2_column_type(cdb2_hndl_tp *hndl, int col);
@@ -226,6 +241,7 @@ int cdb2_bind_param(cdb2_hndl_tp *hndl, const char *name, int type,
                     const void *varaddr, int length);
 int cdb2_bind_index(cdb2_hndl_tp *hndl, int index, int type,
                     const void *varaddr, int length);
+int cdb2_bind_next_row(cdb2_hndl_tp *hndl);
 int cdb2_clearbindings(cdb2_hndl_tp *hndl);
 
 const char *cdb2_dbname(cdb2_hndl_tp *hndl);
@@ -22,6 +22,11 @@
 #include <arpa/nameser_compat.h>
 #include "comdb2rle.h"
 
+#ifdef __x86_64__
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 #ifndef BYTE_ORDER
 #   error "BYTE_ORDER not defined"
 #endif
@@ -181,6 +186,141 @@ static uint8_t varint_need(uint32_t i)
         o |= *i++;                                                             \
     } while (0)
 
+/* Run detection kernels
+ * prefix(a, b, n): number of leading bytes where a[] and b[] agree
+ * suffix(p, n, c): number of trailing bytes of p[n] equal to c */
+static size_t prefix_scalar(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    uint64_t x, y;
+    for (; i + sizeof(x) <= n; i += sizeof(x)) {
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        if (x != y)
+            break;
+    }
+    while (i < n && a[i] == b[i])
+        ++i;
+    return i;
+}
+
+static size_t suffix_scalar(const uint8_t *p, size_t n, uint8_t c)
+{
+    size_t i = n;
+    while (i && p[i - 1] == c)
+        --i;
+    return n - i;
+}
+
+#ifdef __x86_64__
+static size_t prefix_sse2(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        if (m != 0xffff)
+            return i + __builtin_ctz(~m);
+    }
+    return i + prefix_scalar(a + i, b + i, n - i);
+}
+
+static size_t suffix_sse2(const uint8_t *p, size_t n, uint8_t c)
+{
+    size_t i = n;
+    __m128i v = _mm_set1_epi8(c);
+    for (; i >= 16; i -= 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + i - 16));
+        unsigned m = _mm_movemask_epi8(_mm_cmpeq_epi8(x, v));
+        if (m != 0xffff) /* bytes above the highest mismatch are c */
+            return n - i + __builtin_clz(~m << 16);
+    }
+    return n - i + suffix_scalar(p, i, c);
+}
+
+__attribute__((target("avx2")))
+static size_t prefix_avx2(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        unsigned m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (m != 0xffffffff)
+            return i + __builtin_ctz(~m);
+    }
+    return i + prefix_sse2(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t suffix_avx2(const uint8_t *p, size_t n, uint8_t c)
+{
+    size_t i = n;
+    __m256i v = _mm256_set1_epi8(c);
+    for (; i >= 32; i -= 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + i - 32));
+        unsigned m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, v));
+        if (m != 0xffffffff)
+            return n - i + __builtin_clz(~m);
+    }
+    return n - i + suffix_sse2(p, i, c);
+}
+
+/* AVX2 needs cpu support and the OS saving ymm registers */
+static int have_avx2(void)
+{
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 7)
+        return 0;
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+        return 0;
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 0x6) != 0x6)
+        return 0;
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & bit_AVX2) != 0;
+}
+#endif
+
+typedef size_t (*prefix_t)(const uint8_t *, const uint8_t *, size_t);
+typedef size_t (*suffix_t)(const uint8_t *, size_t, uint8_t);
+static size_t prefix_init(const uint8_t *, const uint8_t *, size_t);
+static size_t suffix_init(const uint8_t *, size_t, uint8_t);
+static prefix_t prefix = prefix_init;
+static suffix_t suffix = suffix_init;
+
+/* Select best kernels on first use */
+static void crle_select_kernels(void)
+{
+#ifdef __x86_64__
+    if (have_avx2()) {
+        suffix = suffix_avx2;
+        prefix = prefix_avx2;
+    } else {
+        suffix = suffix_sse2;
+        prefix = prefix_sse2;
+    }
+#else
+    suffix = suffix_scalar;
+    prefix = prefix_scalar;
+#endif
+}
+
+static size_t prefix_init(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    crle_select_kernels();
+    return prefix(a, b, n);
+}
+
+static size_t suffix_init(const uint8_t *p, size_t n, uint8_t c)
+{
+    crle_select_kernels();
+    return suffix(p, n, c);
+}
+
 /* p:ointer to pattern
  * s:ize of pattern
  * r:epeat pattern these many times
@@ -234,63 +374,17 @@ static uint32_t space_reqd(uint32_t r, uint32_t s)
            (s > 1 ? (varint_need(s) + s) : s);
 }
 
-/* Check if 'sz' bytes repeat */
+/* Check if 'sz' bytes repeat
+ * The pattern repeats for as long as the input agrees with itself shifted by
+ * 'sz' bytes, so that is what we measure. */
 static uint32_t repeats(Data in, uint32_t sz, uint32_t *r_)
 {
     uint32_t r;
     r = *r_ = 0;
     if (in.sz < (sz * 2))
         return 0;
-    uint8_t *bp, *bx, bt;
-    uint16_t *wp, word;
-    switch (sz) {
-    case 1:
-        bt = *in.dt;        // 1st byte
-        bp = in.dt + sz;    // byte ptr
-        bx = in.dt + in.sz; // byte ptr max
-#ifndef _SUN_SOURCE
-        if (in.sz > 16) {
-            size_t qz = in.sz - in.sz % 8; // # of quads
-            uint64_t qw;
-            memset(&qw, bt, sizeof(qw));             // 1st quad
-            uint64_t *qp = (uint64_t *)in.dt;        // quad ptr
-            uint64_t *qx = (uint64_t *)(in.dt + qz); // quad ptr max
-            while (qp < qx && *qp == qw)
-                ++qp;
-            if ((uint8_t *)qp != in.dt) {
-                if (qp < qx) // last quad != 1st
-                    --qp;
-                bp = (uint8_t *)qp;
-            }
-        }
-#endif
-        // check remainder byte at a time
-        while (bp < bx && *bp == bt)
-            ++bp;
-        r = bp - in.dt - 1;
-        break;
-#ifndef _SUN_SOURCE
-    case 2:
-        word = *(uint16_t *)in.dt;
-        wp = (uint16_t *)(in.dt + sz);
-        in.sz -= (in.sz % sz);
-        while ((in.sz -= sz) != 0 && word == *wp) {
-            ++wp;
-            ++r;
-        }
-        break;
-#endif
-    default:
-        bp = in.dt + sz;
-        in.sz -= (in.sz % sz);
-        while ((in.sz -= sz) != 0) {
-            if (memcmp(in.dt, bp, sz))
-                break;
-            bp += sz;
-            ++r;
-        }
-        break;
-    }
+    size_t n = in.sz - in.sz % sz;
+    r = prefix(in.dt, in.dt + sz, n - sz) / sz;
     *r_ = r;
     return r;
 }
@@ -536,31 +630,38 @@ int decompressComdb2RLE(Comdb2RLE *d)
             memset(output.dt, *p, r);
             output.dt += r;
             output.sz -= r;
-        } else
-            for (uint32_t i = 0; i <= r; ++i) {
-                switch (s) {
-                case 9:
-                    output.dt[8] = p[8];
-                    output.dt[7] = p[7];
-                    output.dt[6] = p[6];
-                    output.dt[5] = p[5];
-                case 5:
-                    output.dt[4] = p[4];
-                    output.dt[3] = p[3];
-                case 3:
-                    output.dt[2] = p[2];
-                case 2:
-                    output.dt[1] = p[1];
-                case 1:
-                    output.dt[0] = p[0];
-                    break;
-                default:
-                    memcpy(output.dt, p, s);
-                    break;
-                }
-                output.dt += s;
-                output.sz -= s;
+        } else {
+            switch (s) {
+            case 9:
+                output.dt[8] = p[8];
+                output.dt[7] = p[7];
+                output.dt[6] = p[6];
+                output.dt[5] = p[5];
+            case 5:
+                output.dt[4] = p[4];
+                output.dt[3] = p[3];
+            case 3:
+                output.dt[2] = p[2];
+            case 2:
+                output.dt[1] = p[1];
+            case 1:
+                output.dt[0] = p[0];
+                break;
+            default:
+                memcpy(output.dt, p, s);
+                break;
+            }
+            /* expand the run by doubling what has been written so far, so
+             * long runs go out in wide memcpy()s instead of s bytes a time */
+            uint32_t done = s;
+            while (done < reqd) {
+                uint32_t n = reqd - done < done ? reqd - done : done;
+                memcpy(output.dt + done, output.dt, n);
+                done += n;
             }
+            output.dt += reqd;
+            output.sz -= reqd;
+        }
     }
     d->outsz = output.dt - d->out;
     return 0;
@@ -571,13 +672,8 @@ int decompressComdb2RLE(Comdb2RLE *d)
  * r: output param */
 static int repeats_rev(const Data *input, uint32_t sz, uint32_t *r)
 {
-    uint8_t *first = input->dt - 1; //sentinal -- one before first
-    uint8_t *last = first + sz;
-    uint8_t b = *last--;
-    uint32_t dups = 0;
-    while (last != first && b == *last--) {
-        ++dups;
-    }
+    uint8_t *last = input->dt + sz - 1;
+    uint32_t dups = suffix(input->dt, sz - 1, *last);
     *r = dups;
     return dups;
 }
@@ -39,6 +39,11 @@
 #include <strings.h>
 #include <pthread.h>
 #include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef _LINUX_SOURCE
+#include <sys/epoll.h>
+#endif
 
 #include <segstr.h>
 #include <machpthread.h>
@@ -47,6 +52,8 @@
 #include <lockmacro.h>
 
 #include <memory_sync.h>
+#include <list.h>
+#include <comdb2_atomic.h>
 
 #include <sbuf2.h>
 #include <bdb_api.h>
@@ -127,6 +134,7 @@ static const struct appsock_cmd *cmd_genid48;
 
 static void appsock_thd_start(struct thdpool *pool, void *thddata);
 static void appsock_thd_end(struct thdpool *pool, void *thddata);
+static int appsock_parked_conns(void);
 
 void close_appsock(SBUF2 *sb)
 {
@@ -196,6 +204,8 @@ void appsock_quick_stat(void)
 {
     logmsg(LOGMSG_USER, "num appsock connections %llu\n", total_appsock_conns);
     logmsg(LOGMSG_USER, "num active appsock connections %d\n", active_appsock_conns);
+    logmsg(LOGMSG_USER, "num parked appsock connections %d\n",
+           appsock_parked_conns());
     logmsg(LOGMSG_USER, "num appsock commands    %llu\n", total_toks);
 }
 
@@ -861,6 +871,235 @@ static void appsock_work_pp(struct thdpool *pool, void *work, void *thddata,
     }
 }
 
+/*
+ * Idle connections don't need an appsock thread.  Between requests a
+ * connection can be parked on one of a few epoll threads, costing only its
+ * client state.  When the client sends its next request the connection is
+ * handed back to the appsock pool to read and run it.
+ */
+int gbl_appsock_park_threads = 0;
+
+struct parked_appsock {
+    SBUF2 *sb;
+    appsock_resume_fn *resume;
+    void *arg;
+    int op;
+    int parked_at;
+    LINKC_T(struct parked_appsock) lnk;
+};
+
+struct park_thd {
+    int epfd;
+    pthread_mutex_t lk;
+    /* oldest first, so idle connections time out from the top */
+    LISTC_T(struct parked_appsock) parked;
+};
+
+static struct park_thd *park_thds = NULL;
+static int num_park_thds = 0;
+static unsigned park_next = 0;
+static pthread_once_t park_once = PTHREAD_ONCE_INIT;
+
+static int appsock_parked_conns(void)
+{
+    int i, n = 0;
+    for (i = 0; i < num_park_thds; i++) {
+        LOCK(&park_thds[i].lk) { n += listc_size(&park_thds[i].parked); }
+        UNLOCK(&park_thds[i].lk);
+    }
+    return n;
+}
+
+static void appsock_resume_work(struct thdpool *pool, void *work,
+                                void *thddata)
+{
+    struct appsock_thd_state *state = thddata;
+    struct parked_appsock *p = work;
+
+    thrman_setfd(state->thr_self, sbuf2fileno(p->sb));
+    thrman_change_type(state->thr_self, THRTYPE_APPSOCK_SQL);
+    p->resume(state->thr_self, p->arg, p->op);
+    thrman_setfd(state->thr_self, -1);
+    thrman_where(state->thr_self, NULL);
+    thrman_change_type(state->thr_self, THRTYPE_APPSOCK_POOL);
+}
+
+static void appsock_resume_pp(struct thdpool *pool, void *work,
+                              void *thddata, int op)
+{
+    struct parked_appsock *p = work;
+
+    switch (op) {
+    case THD_RUN:
+        appsock_resume_work(pool, work, thddata);
+        break;
+
+    case THD_FREE:
+        p->resume(NULL, p->arg, APPSOCK_RESUME_CLOSE);
+        break;
+
+    default:
+        abort();
+    }
+    free(p);
+}
+
+#ifdef _LINUX_SOURCE
+/* Called by the park thread once p is off its list and epoll set */
+static void appsock_unpark(struct parked_appsock *p, int op)
+{
+    p->op = op;
+    if (thdpool_enqueue(gbl_appsock_thdpool, appsock_resume_pp, p, 1,
+                        NULL) != 0) {
+        total_appsock_rejections++;
+        p->resume(NULL, p->arg, APPSOCK_RESUME_CLOSE);
+        free(p);
+    }
+}
+
+static void *appsock_park_thd(void *arg)
+{
+    struct park_thd *pt = arg;
+    struct parked_appsock *p;
+    struct epoll_event events[64];
+    int i, n, idle, now;
+
+    thread_started("appsock park");
+
+    while (1) {
+        n = epoll_wait(pt->epfd, events, sizeof(events) / sizeof(events[0]),
+                       1000);
+        if (n < 0 && errno != EINTR) {
+            logmsg(LOGMSG_ERROR, "%s: epoll_wait errno %d %s\n", __func__,
+                   errno, strerror(errno));
+            sleep(1);
+        }
+        for (i = 0; i < n; i++) {
+            p = events[i].data.ptr;
+            LOCK(&pt->lk)
+            {
+                listc_rfl(&pt->parked, p);
+                epoll_ctl(pt->epfd, EPOLL_CTL_DEL, sbuf2fileno(p->sb), NULL);
+            }
+            UNLOCK(&pt->lk);
+            appsock_unpark(p, APPSOCK_RESUME_READ);
+        }
+
+        /* Time out connections the way a blocked read would have */
+        idle = bdb_attr_get(thedb->bdb_attr, BDB_ATTR_MAX_SQL_IDLE_TIME);
+        if (idle <= 0)
+            continue;
+        now = time_epoch();
+        while (1) {
+            LOCK(&pt->lk)
+            {
+                p = LISTC_TOP(&pt->parked);
+                if (p && (now - p->parked_at) > idle) {
+                    listc_rfl(&pt->parked, p);
+                    epoll_ctl(pt->epfd, EPOLL_CTL_DEL, sbuf2fileno(p->sb),
+                              NULL);
+                } else {
+                    p = NULL;
+                }
+            }
+            UNLOCK(&pt->lk);
+            if (p == NULL)
+                break;
+            appsock_unpark(p, APPSOCK_RESUME_TIMEOUT);
+        }
+    }
+    return NULL;
+}
+
+static void appsock_park_init(void)
+{
+    pthread_t tid;
+    int i, n, rc;
+
+    n = gbl_appsock_park_threads;
+    park_thds = calloc(n, sizeof(struct park_thd));
+    if (park_thds == NULL) {
+        logmsg(LOGMSG_ERROR, "%s: malloc failed\n", __func__);
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        struct park_thd *pt = &park_thds[i];
+        pthread_mutex_init(&pt->lk, NULL);
+        listc_init(&pt->parked, offsetof(struct parked_appsock, lnk));
+        if ((pt->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            logmsg(LOGMSG_ERROR, "%s: epoll_create1 errno %d %s\n", __func__,
+                   errno, strerror(errno));
+            break;
+        }
+        rc = pthread_create(&tid, &gbl_pthread_attr_detached, appsock_park_thd,
+                            pt);
+        if (rc) {
+            logmsg(LOGMSG_ERROR, "%s: pthread_create rc %d %s\n", __func__, rc,
+                   strerror(rc));
+            close(pt->epfd);
+            break;
+        }
+    }
+    num_park_thds = i;
+    logmsg(LOGMSG_INFO, "parking idle appsock connections on %d threads\n",
+           num_park_thds);
+}
+#endif
+
+/* Park an idle connection until the client sends something.  Once this
+ * returns 0 the connection belongs to the park threads: resume is called with
+ * arg from an appsock pool thread when the connection is readable or has
+ * been idle for too long, and must either carry on with the connection or
+ * close it.  Returns non-0 if the connection can't be parked, in which case
+ * the caller carries on as before. */
+int appsock_park(SBUF2 *sb, appsock_resume_fn *resume, void *arg)
+{
+#ifdef _LINUX_SOURCE
+    struct parked_appsock *p;
+    struct park_thd *pt;
+    struct epoll_event ev;
+    int rc;
+
+    if (gbl_appsock_park_threads <= 0)
+        return -1;
+    pthread_once(&park_once, appsock_park_init);
+    if (num_park_thds == 0)
+        return -1;
+
+    /* Nothing will wake us for a request that's already been read in */
+    if (sbuf2pending(sb) != 0)
+        return -1;
+
+    if ((p = calloc(1, sizeof(struct parked_appsock))) == NULL)
+        return -1;
+    p->sb = sb;
+    p->resume = resume;
+    p->arg = arg;
+    p->parked_at = time_epoch();
+    pt = &park_thds[ATOMIC_ADD(park_next, 1) % num_park_thds];
+
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = p;
+    LOCK(&pt->lk)
+    {
+        listc_abl(&pt->parked, p);
+        rc = epoll_ctl(pt->epfd, EPOLL_CTL_ADD, sbuf2fileno(sb), &ev);
+        if (rc)
+            listc_rfl(&pt->parked, p);
+    }
+    UNLOCK(&pt->lk);
+    if (rc) {
+        logmsg(LOGMSG_ERROR, "%s: epoll_ctl errno %d %s\n", __func__, errno,
+               strerror(errno));
+        free(p);
+        return -1;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
 int gbl_appsock_connection_warn_threshold = 80;
 
 void dump_appsock_threads(void)
@@ -163,6 +163,7 @@ int gbl_llmeta_open = 0;
 int gbl_sqlite_sortermult = 1;
 
 int gbl_sqlite_sorter_mem = 300 * 1024 * 1024; /* 300 meg */
+int gbl_sqlite_sorter_topn = 1000;
 
 int gbl_rep_node_pri = 0;
 int gbl_handoff_node = 0;
@@ -310,6 +311,7 @@ int gbl_iothreads = 0;
 int gbl_ioqueue = 0;
 int gbl_prefaulthelperthreads = 0;
 int gbl_osqlpfault_threads = 0;
+int gbl_osqlpfault_ahead = 0;
 int gbl_prefault_udp = 0;
 __thread int send_prefault_udp = 0;
 
@@ -366,6 +368,8 @@ int gbl_rtcpu_debug = 0;
 int gbl_longblk_trans_purge_interval =
     30; /* initially, set this to 30 seconds */
 int gbl_sqlflush_freq = 0;
+int gbl_newsql_frame_rows = 1000;
+int gbl_newsql_frame_bytes = 256 * 1024;
 int gbl_sbuftimeout = 0;
 int gbl_conv_flush_freq = 100; /* this is currently ignored */
 pthread_attr_t gbl_pthread_attr;
@@ -414,6 +418,8 @@ int gbl_check_client_tags = 1;
 char *gbl_lrl_fname = NULL;
 char *gbl_spfile_name = NULL;
 int gbl_max_lua_instructions = 10000;
+int gbl_lua_vm_pool_size = 16;
+int gbl_lua_bytecode_cache = 256;
 
 int gbl_updategenids = 0;
 
@@ -475,6 +481,7 @@ int gbl_simulate_rowlock_deadlock_interval = 0;
 int gbl_enable_berkdb_retry_deadlock_bias = 0;
 int gbl_enable_cache_internal_nodes = 1;
 int gbl_use_appsock_as_sqlthread = 0;
+extern int gbl_appsock_park_threads;
 int gbl_rep_collect_txn_time = 0;
 int gbl_rep_process_txn_time = 0;
 
@@ -817,7 +824,14 @@ extern int gbl_allow_user_schema;
 extern int gbl_uses_password;
 
 extern int gbl_direct_count;
+extern int gbl_sql_skip_unused_cols;
+extern int gbl_net_writev;
 extern int gbl_parallel_count;
+extern int gbl_osql_batch_bytes;
+extern int gbl_osql_batch_compress;
+extern int gbl_osql_apply_threads;
+extern int gbl_osql_apply_min_ops;
+extern int gbl_osql_bulk_load_keys;
 
 int gbl_bbenv;
 
@@ -2480,6 +2494,38 @@ static int read_lrl_option(struct dbenv *dbenv, char *line, void *p, int len)
         gbl_osql_max_queue = ii;
     }
 
+    else if (tokcmp(tok, ltok, "osql_batch_bytes") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        ii = toknum(tok, ltok);
+        logmsg(LOGMSG_INFO, "setting osql_batch_bytes to %d\n", ii);
+        gbl_osql_batch_bytes = ii;
+    }
+
+    else if (tokcmp(tok, ltok, "osql_apply_threads") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        ii = toknum(tok, ltok);
+        logmsg(LOGMSG_INFO, "setting osql_apply_threads to %d\n", ii);
+        gbl_osql_apply_threads = ii;
+    }
+
+    else if (tokcmp(tok, ltok, "osql_apply_min_ops") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        ii = toknum(tok, ltok);
+        logmsg(LOGMSG_INFO, "setting osql_apply_min_ops to %d\n", ii);
+        gbl_osql_apply_min_ops = ii;
+    }
+
+    else if (tokcmp(tok, ltok, "osql_bulk_load_keys") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        ii = toknum(tok, ltok);
+        if (ii > 0) {
+            logmsg(LOGMSG_INFO, "setting osql_bulk_load_keys to %d\n", ii);
+            gbl_osql_bulk_load_keys = ii;
+        } else {
+            logmsg(LOGMSG_ERROR, "invalid osql_bulk_load_keys, %d\n", ii);
+        }
+    }
+
     else if (tokcmp(tok, ltok, "osql_bkoff_netsend") == 0) {
         tok = segtok(line, len, &st, &ltok);
         ii = toknum(tok, ltok);
@@ -2556,6 +2602,17 @@ static int read_lrl_option(struct dbenv *dbenv, char *line, void *p, int len)
         ii = toknum(tok, ltok);
         logmsg(LOGMSG_INFO, "setting maximum lua instructions %d\n", ii);
         gbl_max_lua_instructions = ii;
+    } else if (tokcmp(tok, ltok, "lua_vm_pool_size") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        ii = toknum(tok, ltok);
+        logmsg(LOGMSG_INFO, "keeping up to %d idle lua vms\n", ii);
+        gbl_lua_vm_pool_size = ii;
+    } else if (tokcmp(tok, ltok, "lua_bytecode_cache") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        ii = toknum(tok, ltok);
+        logmsg(LOGMSG_INFO, "caching bytecode of up to %d stored procedures\n",
+               ii);
+        gbl_lua_bytecode_cache = ii;
     } else if (tokcmp(tok, ltok, "iothreads") == 0) {
         tok = segtok(line, len, &st, &ltok);
         ii = toknum(tok, ltok);
@@ -2585,6 +2642,14 @@ static int read_lrl_option(struct dbenv *dbenv, char *line, void *p, int len)
                gbl_osqlpfault_threads);
     }
 
+    else if (tokcmp(tok, ltok, "osqlprefaultahead") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        ii = toknum(tok, ltok);
+        gbl_osqlpfault_ahead = ii;
+        logmsg(LOGMSG_INFO, "setting osqlprefaultahead to %d\n",
+               gbl_osqlpfault_ahead);
+    }
+
     else if (tokcmp(tok, ltok, "enable_prefault_udp") == 0) {
         gbl_prefault_udp = 1;
     }
@@ -2649,6 +2714,13 @@ static int read_lrl_option(struct dbenv *dbenv, char *line, void *p, int len)
         gbl_sqlite_sorter_mem = ii;
     }
 
+    else if (tokcmp(tok, ltok, "sqlsortertopn") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        ii = toknum(tok, ltok);
+        logmsg(LOGMSG_INFO, "setting sqlsortertopn to %d\n", ii);
+        gbl_sqlite_sorter_topn = ii;
+    }
+
     else if (tokcmp(tok, ltok, "sqlsortermult") == 0) {
         tok = segtok(line, len, &st, &ltok);
         ii = toknum(tok, ltok);
@@ -2741,6 +2813,18 @@ static int read_lrl_option(struct dbenv *dbenv, char *line, void *p, int len)
         ii = toknum(tok, ltok);
         logmsg(LOGMSG_INFO, "setting max appsock connections to %d\n", ii);
         bdb_attr_set(dbenv->bdb_attr, BDB_ATTR_MAXAPPSOCKSLIMIT, ii);
+    } else if (tokcmp(tok, ltok, "appsock_park_threads") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        ii = toknum(tok, ltok);
+        if (ii >= 0) {
+            logmsg(LOGMSG_INFO, "parking idle appsock connections on %d "
+                                "threads\n",
+                   ii);
+            gbl_appsock_park_threads = ii;
+        } else {
+            logmsg(LOGMSG_ERROR, "invalid appsock_park_threads value %d\n",
+                   ii);
+        }
     } else if (tokcmp(tok, ltok, "maxsockcached") == 0) {
         tok = segtok(line, len, &st, &ltok);
         ii = toknum(tok, ltok);
@@ -3485,6 +3569,34 @@ static int read_lrl_option(struct dbenv *dbenv, char *line, void *p, int len)
             gbl_sqlflush_freq = 0;
             return -1;
         }
+    } else if (tokcmp(tok, ltok, "newsql_frame_rows") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        if (ltok == 0) {
+            logmsg(LOGMSG_ERROR, "Expected #rows for newsql_frame_rows\n");
+            return -1;
+        }
+        ii = toknum(tok, ltok);
+        if (ii < 0) {
+            logmsg(LOGMSG_ERROR, "Invalid newsql_frame_rows %d\n", ii);
+            return -1;
+        }
+        gbl_newsql_frame_rows = ii;
+        logmsg(LOGMSG_INFO, "Sending up to %d rows per newsql frame\n",
+               gbl_newsql_frame_rows);
+    } else if (tokcmp(tok, ltok, "newsql_frame_bytes") == 0) {
+        tok = segtok(line, len, &st, &ltok);
+        if (ltok == 0) {
+            logmsg(LOGMSG_ERROR, "Expected #bytes for newsql_frame_bytes\n");
+            return -1;
+        }
+        ii = toknum(tok, ltok);
+        if (ii <= 0) {
+            logmsg(LOGMSG_ERROR, "Invalid newsql_frame_bytes %d\n", ii);
+            return -1;
+        }
+        gbl_newsql_frame_bytes = ii;
+        logmsg(LOGMSG_INFO, "Sending newsql frames of up to %d bytes\n",
+               gbl_newsql_frame_bytes);
     } else if (tokcmp(tok, ltok, "sbuftimeout") == 0) {
         tok = segtok(line, len, &st, &ltok);
         if (ltok == 0) {
@@ -8544,6 +8656,16 @@ static void register_all_int_switches()
     register_int_switch("parallel_count",
                         "When 'direct_count' is on, enable thread-per-stripe",
                         &gbl_parallel_count);
+    register_int_switch("osql_batch_compress",
+                        "Compress batched osql replies with lz4",
+                        &gbl_osql_batch_compress);
+    register_int_switch("sql_skip_unused_cols",
+                        "Don't convert index key columns a query doesn't read",
+                        &gbl_sql_skip_unused_cols);
+    register_int_switch("net_writev",
+                        "Flush net write queues with writev instead of "
+                        "copying through the socket buffer",
+                        &gbl_net_writev);
 }
 
 static void getmyid(void)
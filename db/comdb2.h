@@ -1426,6 +1426,9 @@ struct ireq {
 
     /* osql prefault step index */
     int *osql_step_ix;
+
+    /* index keys collected for a sorted add (RECFLAGS_SORTED_KEYS) */
+    struct sorted_keys *sorted_keys;
     /* REVIEW COMMENTS AT BEGINING OF STRUCT BEFORE ADDING NEW VARIABLES */
 
     unsigned char have_snap_info;
@@ -1638,6 +1641,8 @@ extern pthread_mutex_t
 extern int gbl_blob_maxage;
 extern int gbl_blob_lose_debug;
 extern int gbl_sqlflush_freq;
+extern int gbl_newsql_frame_rows;
+extern int gbl_newsql_frame_bytes;
 extern unsigned gbl_max_blob_cache_bytes;
 extern int gbl_blob_vb;
 extern long n_qtrap;
@@ -1697,6 +1702,8 @@ extern long long gbl_nsql_steps;
 
 extern unsigned int gbl_nnewsql;
 extern long long gbl_nnewsql_steps;
+extern int64_t gbl_sql_stmt_cache_hits;
+extern int64_t gbl_sql_stmt_cache_adds;
 
 extern int gbl_sql_client_stats;
 
@@ -1854,6 +1861,16 @@ int a2req(const char *s);
 void appsock_handler_start(struct dbenv *dbenv, SBUF2 *sb);
 void appsock_coalesce(struct dbenv *dbenv);
 void close_appsock(SBUF2 *sb);
+
+/* What a parked appsock connection is resumed for */
+enum {
+    APPSOCK_RESUME_READ = 0,    /* the client sent something */
+    APPSOCK_RESUME_TIMEOUT = 1, /* idle longer than max_sql_idle_time */
+    APPSOCK_RESUME_CLOSE = 2    /* couldn't dispatch, close it */
+};
+/* thr_self is NULL if the connection is closed outside the appsock pool */
+typedef void appsock_resume_fn(struct thr_handle *thr_self, void *arg, int op);
+int appsock_park(SBUF2 *sb, appsock_resume_fn *resume, void *arg);
 void thd_stats(void);
 void thd_dbinfo2_stats(struct db_info2_stats *stats);
 void thd_coalesce(struct dbenv *dbenv);
@@ -2720,7 +2737,10 @@ enum {
     /* used for upgrade record */
     RECFLAGS_UPGRADE_RECORD = RECFLAGS_DYNSCHEMA_NULLS_ONLY |
                               RECFLAGS_KEEP_GENID | RECFLAGS_NO_TRIGGERS |
-                              RECFLAGS_NO_CONSTRAINTS | RECFLAGS_NO_BLOBS | 512
+                              RECFLAGS_NO_CONSTRAINTS | RECFLAGS_NO_BLOBS | 512,
+    /* collect index keys in iq->sorted_keys instead of adding them, the
+     * caller adds them in key order with sorted_keys_add() */
+    RECFLAGS_SORTED_KEYS = 1024
 };
 
 /* flag codes */
@@ -2739,6 +2759,13 @@ int add_record(struct ireq *iq, void *trans, const uint8_t *p_buf_tag_name,
                int *ixfailnum, int *rrn, unsigned long long *genid,
                unsigned long long ins_keys, int opcode, int blkpos, int flags);
 
+struct sorted_keys *sorted_keys_create(void);
+void sorted_keys_destroy(struct sorted_keys *sk);
+int sorted_keys_count(const struct sorted_keys *sk);
+void sorted_keys_reset(struct sorted_keys *sk);
+int sorted_keys_add(struct ireq *iq, void *trans, struct sorted_keys *sk,
+                    int *blkpos, int *ixfailnum, struct db **faildb);
+
 int upgrade_record(struct ireq *iq, void *trans, unsigned long long vgenid,
                    uint8_t *p_buf_rec, const uint8_t *p_buf_rec_end,
                    int *opfailcode, int *ixfailnum, int opcode, int blkpos);
@@ -4219,6 +4219,11 @@ int backend_open(struct dbenv *dbenv)
                 logmsg(LOGMSG_ERROR, "fetch odh from llmeta failed\n");
                 return -1;
             }
+            if (bdb_zstd_dict_load(d->handle, NULL, 0) != 0) {
+                logmsg(LOGMSG_ERROR, "fetch zstd dictionary from llmeta "
+                                     "failed\n");
+                return -1;
+            }
 
             if (get_db_bthash(d, &bthashsz) != 0) {
                 bthashsz = 0;
@@ -45,7 +45,7 @@ $(SQLITE_FLAGS) -I$(SRCHOME)/berkdb/build -I$(SRCHOME)/berkdb/dbinc	\
 
 VERSION?=$(shell dpkg-parsechangelog | grep Version | cut -d' ' -f2 | sed 's/-.*//')
 
-SYSLIBS=$(BBSTATIC) -lssl -lcrypto -lz -llz4 -luuid -lprotobuf-c \
+SYSLIBS=$(BBSTATIC) -lssl -lcrypto -lz -llz4 -lzstd -luuid -lprotobuf-c \
    $(BBDYN) -lpthread -lrt -lm -ldl
 
 # Custom defines
@@ -71,6 +71,15 @@
 
 int g_osql_blocksql_parallel_max = 5;
 extern int gbl_blocksql_grace;
+extern int gbl_goslow;
+extern int gbl_osqlpfault_threads;
+extern int gbl_osqlpfault_ahead;
+void free_cached_idx(uint8_t **cached_idx);
+
+/* apply insert-only bplogs touching several tables with this many threads */
+int gbl_osql_apply_threads = 0;
+/* ... if the transaction has at least this many ops */
+int gbl_osql_apply_min_ops = 10000;
 
 typedef struct blocksql_info {
     osql_sess_t *sess; /* pointer to the osql session */
@@ -114,6 +123,44 @@ typedef struct oplog_key {
     unsigned long long seq;
 } oplog_key_t;
 
+/* one op copied out of the bplog; the packet follows the header */
+typedef struct apply_op {
+    int len;
+    int step;
+} apply_op_t;
+
+#define APPLY_OP_SIZE(len) ((sizeof(apply_op_t) + (len) + 7) & ~7)
+
+/* all the ops of a session that go to one table */
+typedef struct apply_part {
+    struct db *db;
+    char *buf;
+    size_t used;
+    size_t alloc;
+} apply_part_t;
+
+typedef struct parallel_apply {
+    struct ireq *iq;
+    void *parent; /* the bplog transaction; workers run in children of it */
+    unsigned long long rqid;
+    uuid_t uuid;
+
+    apply_part_t *parts;
+    int nparts;
+    int nextpart;
+
+    pthread_mutex_t mtx; /* serializes child begin/commit on the parent */
+    pthread_cond_t cond;
+    int nthds;
+    int nready;
+    int decided;
+    int failed;
+    int commit_failed;
+
+    int receivedrows;
+    double cost;
+} parallel_apply_t;
+
 static int apply_changes(struct ireq *iq, blocksql_tran_t *tran, void *iq_tran,
                          int *nops, struct block_err *err, SBUF2 *logsb);
 static int osql_bplog_wait(blocksql_tran_t *tran);
@@ -701,7 +748,7 @@ int osql_bplog_saveop(osql_sess_t *sess, char *rpl, int rplen,
         logmsg(LOGMSG_ERROR, 
             "%s: fail to put oplog rqid=%llx (%lld) seq=%llu rc=%d bdberr=%d\n",
             __func__, key.rqid, key.rqid, key.seq, rc, bdberr);
-    } else if (gbl_osqlpfault_threads) {
+    } else if (gbl_osqlpfault_threads && !gbl_osqlpfault_ahead) {
         osql_page_prefault(rpl, rplen, &(tran->last_db),
                            &(osql_session_get_ireq(sess)->osql_step_ix), rqid,
                            uuid, seq);
@@ -1065,6 +1112,384 @@ void osql_bplog_setlimit(int limit) { g_osql_blocksql_parallel_max = limit; }
 /************************* INTERNALS
  * ***************************************************/
 
+static void free_apply_parts(apply_part_t *parts, int nparts)
+{
+    int i;
+
+    for (i = 0; i < nparts; i++)
+        free(parts[i].buf);
+    free(parts);
+}
+
+static int apply_part_add(apply_part_t *part, char *data, int datalen,
+                          int step)
+{
+    apply_op_t *op;
+    size_t sz = APPLY_OP_SIZE(datalen);
+
+    if (part->used + sz > part->alloc) {
+        size_t alloc = part->alloc ? part->alloc * 2 : 65536;
+        char *buf;
+
+        while (alloc < part->used + sz)
+            alloc *= 2;
+        buf = realloc(part->buf, alloc);
+        if (!buf)
+            return -1;
+        part->buf = buf;
+        part->alloc = alloc;
+    }
+
+    op = (apply_op_t *)(part->buf + part->used);
+    op->len = datalen;
+    op->step = step;
+    memcpy(op + 1, data, datalen);
+    part->used += sz;
+
+    return 0;
+}
+
+/**
+ * Scan the ops of a session and split them by table.
+ * Only sessions made of inserts into plain tables without constraints
+ * are split; anything else (updates, deletes, verifies, queues, schema
+ * changes) must go through the serial path that keeps the deferred
+ * constraint checks in order.
+ * Returns the number of partitions, 0 if the session can't be split
+ *
+ */
+static int parallel_apply_split(struct temp_cursor *dbc, oplog_key_t *key,
+                                int *bdberr, apply_part_t **pparts,
+                                unsigned long long *done_seq,
+                                struct db **last_db)
+{
+    apply_part_t *parts = NULL;
+    apply_part_t *cur = NULL;
+    oplog_key_t *split_key;
+    unsigned long long seq = 0;
+    int nparts = 0;
+    int ninserts = 0;
+    int eligible = 0;
+    int rc, i;
+
+    /* the cursor owns the key it was positioned with, and frees or
+       overwrites it as it steps; keep the caller's key out of it */
+    split_key = malloc(sizeof(*split_key));
+    if (!split_key)
+        return 0;
+    *split_key = *key;
+    split_key->seq = 0;
+
+    rc = bdb_temp_table_find_exact(thedb->bdb_env, dbc, split_key,
+                                   sizeof(*split_key), bdberr);
+    if (rc)
+        free(split_key);
+    while (!rc) {
+        oplog_key_t *k = (oplog_key_t *)bdb_temp_table_key(dbc);
+        char *data = bdb_temp_table_data(dbc);
+        int datalen = bdb_temp_table_datasize(dbc);
+        struct db *db = NULL;
+        int type;
+
+        if (k->rqid != key->rqid)
+            break;
+        if (key->rqid == OSQL_RQID_USE_UUID && comdb2uuidcmp(k->uuid, key->uuid))
+            break;
+        if (k->seq != seq)
+            break; /* let the serial path report the gap */
+
+        type = osql_packet_type(key->rqid, data, datalen, &db);
+        switch (type) {
+        case OSQL_USEDB:
+            if (!db || db->dbtype != DBTYPE_TAGGED_TABLE ||
+                db->n_constraints != 0 || db->sc_from || db->sc_to)
+                goto done;
+            for (i = 0, cur = NULL; i < nparts; i++) {
+                if (parts[i].db == db) {
+                    cur = &parts[i];
+                    break;
+                }
+            }
+            if (!cur) {
+                apply_part_t *p = realloc(parts, (nparts + 1) * sizeof(*p));
+                if (!p)
+                    goto done;
+                parts = p;
+                cur = &parts[nparts++];
+                memset(cur, 0, sizeof(*cur));
+                cur->db = db;
+            }
+            *last_db = db;
+            break;
+        case OSQL_INSREC:
+        case OSQL_INSERT:
+            ninserts++;
+        /* fall-through */
+        case OSQL_QBLOB:
+        case OSQL_INSIDX:
+            if (!cur)
+                goto done;
+            break;
+        case OSQL_DONE:
+        case OSQL_DONE_SNAP:
+        case OSQL_DONE_STATS:
+            /* DONE is applied by the caller, after the tables */
+            *done_seq = seq;
+            eligible = (nparts > 1 && ninserts > 0);
+            goto done;
+        default:
+            goto done;
+        }
+
+        if (apply_part_add(cur, data, datalen, seq))
+            goto done;
+
+        seq++;
+        rc = bdb_temp_table_next(thedb->bdb_env, dbc, bdberr);
+    }
+
+done:
+    if (!eligible) {
+        if (parts)
+            free_apply_parts(parts, nparts);
+        return 0;
+    }
+    *pparts = parts;
+    return nparts;
+}
+
+static void *parallel_apply_thd(void *arg)
+{
+    parallel_apply_t *pa = (parallel_apply_t *)arg;
+    struct ireq iq = *pa->iq;
+    blob_buffer_t blobs[MAXBLOBS] = {0};
+    struct block_err err = {0};
+    void *trans = NULL;
+    int *updCols = NULL;
+    int flags = 0;
+    int receivedrows = 0;
+    int rc, irc, ix;
+
+    backend_thread_event(thedb, COMDB2_THR_EVENT_START_RDWR);
+
+    /* private copies of whatever the ops below write into the ireq */
+    iq.usedb = pa->parts[0].db;
+    iq.idxInsert = iq.idxDelete = NULL;
+    iq.osql_step_ix = NULL;
+    iq.cost = 0;
+
+    pthread_mutex_lock(&pa->mtx);
+    rc = trans_start(&iq, pa->parent, &trans);
+    pthread_mutex_unlock(&pa->mtx);
+    if (rc) {
+        logmsg(LOGMSG_ERROR, "%s: trans_start rc %d\n", __func__, rc);
+        trans = NULL;
+    }
+
+    while (!rc) {
+        apply_part_t *part;
+        size_t off;
+
+        pthread_mutex_lock(&pa->mtx);
+        ix = pa->failed ? pa->nparts : pa->nextpart++;
+        pthread_mutex_unlock(&pa->mtx);
+        if (ix >= pa->nparts)
+            break;
+
+        part = &pa->parts[ix];
+        for (off = 0; off < part->used && !rc;) {
+            apply_op_t *op = (apply_op_t *)(part->buf + off);
+
+            if (bdb_lock_desired(thedb->bdb_env)) {
+                rc = ERR_NOMASTER;
+                break;
+            }
+
+            rc = osql_process_packet(&iq, pa->rqid, pa->uuid, trans,
+                                     (char *)(op + 1), op->len, &flags,
+                                     &updCols, blobs, op->step, &err,
+                                     &receivedrows, NULL);
+            off += APPLY_OP_SIZE(op->len);
+        }
+        free_blob_buffers(blobs, MAXBLOBS);
+
+        if (rc) {
+            pthread_mutex_lock(&pa->mtx);
+            pa->failed = 1;
+            pthread_mutex_unlock(&pa->mtx);
+        }
+    }
+
+    /* wait for the other workers; either all children commit or none */
+    pthread_mutex_lock(&pa->mtx);
+    if (rc)
+        pa->failed = 1;
+    pa->receivedrows += receivedrows;
+    pa->cost += iq.cost;
+    pa->nready++;
+    pthread_cond_broadcast(&pa->cond);
+    while (!pa->decided)
+        pthread_cond_wait(&pa->cond, &pa->mtx);
+
+    if (trans) {
+        if (pa->failed)
+            irc = trans_abort(&iq, trans);
+        else
+            irc = trans_commit(&iq, trans, gbl_mynode);
+        if (irc) {
+            logmsg(LOGMSG_ERROR, "%s: failed to %s child transaction rc %d\n",
+                   __func__, pa->failed ? "abort" : "commit", irc);
+            pa->commit_failed = 1;
+        }
+    }
+    pthread_mutex_unlock(&pa->mtx);
+
+    if (iq.idxInsert || iq.idxDelete) {
+        free_cached_idx(iq.idxInsert);
+        free_cached_idx(iq.idxDelete);
+        free(iq.idxInsert);
+        free(iq.idxDelete);
+    }
+    if (updCols)
+        free(updCols);
+
+    backend_thread_event(thedb, COMDB2_THR_EVENT_DONE_RDWR);
+
+    return NULL;
+}
+
+/**
+ * Apply the row ops of a session that inserts into several tables with
+ * one thread per table, each in a child transaction of iq_tran.
+ * The tables share no pages, so the children don't conflict; they are
+ * committed only if all of them succeed.
+ * Returns 0 if every op but the final DONE was applied (*done_seq is set),
+ * 1 if nothing was applied and the session must be applied serially,
+ * or an error if the children could not be resolved
+ *
+ */
+static int apply_session_parallel(struct ireq *iq, void *iq_tran,
+                                  struct temp_cursor *dbc, oplog_key_t *key,
+                                  int *bdberr, int *receivedrows,
+                                  unsigned long long *done_seq)
+{
+    parallel_apply_t pa = {0};
+    pthread_t *thds;
+    pthread_attr_t attr;
+    struct db *last_db = NULL;
+    int nthds, i, rc;
+
+    if (gbl_rowlocks || gbl_goslow || gbl_replicate_local || iq->sc ||
+        iq->debug || iq->dbglog_file || iq->__limits.maxcost ||
+        osql_get_delayed(iq) ||
+        javasp_trans_care_about(iq->jsph, JAVASP_TRANS_LISTEN_AFTER_ADD) ||
+        is_rowlocks_transaction(iq_tran))
+        return 1;
+
+    pa.nparts =
+        parallel_apply_split(dbc, key, bdberr, &pa.parts, done_seq, &last_db);
+    if (pa.nparts == 0)
+        return 1;
+
+    nthds = gbl_osql_apply_threads;
+    if (nthds > pa.nparts)
+        nthds = pa.nparts;
+
+    thds = malloc(nthds * sizeof(pthread_t));
+    if (!thds) {
+        free_apply_parts(pa.parts, pa.nparts);
+        return 1;
+    }
+
+    pa.iq = iq;
+    pa.parent = iq_tran;
+    pa.rqid = key->rqid;
+    comdb2uuidcpy(pa.uuid, key->uuid);
+    pthread_mutex_init(&pa.mtx, NULL);
+    pthread_cond_init(&pa.cond, NULL);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 4096 * 1024);
+    for (i = 0; i < nthds; i++) {
+        rc = pthread_create(&thds[i], &attr, parallel_apply_thd, &pa);
+        if (rc) {
+            logmsg(LOGMSG_ERROR, "%s: pthread_create rc %d\n", __func__, rc);
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    pthread_mutex_lock(&pa.mtx);
+    pa.nthds = i;
+    if (pa.nthds < nthds)
+        pa.failed = 1;
+    while (pa.nready < pa.nthds)
+        pthread_cond_wait(&pa.cond, &pa.mtx);
+    pa.decided = 1;
+    pthread_cond_broadcast(&pa.cond);
+    pthread_mutex_unlock(&pa.mtx);
+
+    for (i = 0; i < pa.nthds; i++)
+        pthread_join(thds[i], NULL);
+
+    free(thds);
+    free_apply_parts(pa.parts, pa.nparts);
+    pthread_mutex_destroy(&pa.mtx);
+    pthread_cond_destroy(&pa.cond);
+
+    if (pa.commit_failed)
+        return ERR_INTERNAL;
+
+    if (pa.failed)
+        return 1;
+
+    *receivedrows += pa.receivedrows;
+    iq->cost += pa.cost;
+    iq->usedb = last_db;
+
+    return 0;
+}
+
+/**
+ * Hand the session ops up to gbl_osqlpfault_ahead past the one about to be
+ * applied to the prefault threads, so their pages are read while the
+ * block processor works on the ops before them.
+ * Returns the prefault cursor, or NULL once it ran past the session
+ *
+ */
+static struct temp_cursor *prefault_ahead(struct ireq *iq,
+                                          struct temp_cursor *pfc,
+                                          unsigned long long rqid,
+                                          uuid_t uuid,
+                                          unsigned long long applying,
+                                          unsigned long long *pf_seq,
+                                          struct db **pf_db)
+{
+    int bdberr = 0;
+
+    while (*pf_seq <= applying + gbl_osqlpfault_ahead) {
+        oplog_key_t *k = (oplog_key_t *)bdb_temp_table_key(pfc);
+
+        if (k->rqid != rqid ||
+            (rqid == OSQL_RQID_USE_UUID && comdb2uuidcmp(k->uuid, uuid)))
+            break;
+
+        osql_page_prefault(bdb_temp_table_data(pfc),
+                           bdb_temp_table_datasize(pfc), pf_db,
+                           &iq->osql_step_ix, rqid, uuid, k->seq);
+        *pf_seq = k->seq + 1;
+
+        if (bdb_temp_table_next(thedb->bdb_env, pfc, &bdberr))
+            break;
+    }
+
+    if (*pf_seq > applying + gbl_osqlpfault_ahead)
+        return pfc;
+
+    bdb_temp_table_close_cursor(thedb->bdb_env, pfc, &bdberr);
+    return NULL;
+}
+
 static int process_this_session(
     struct ireq *iq, void *iq_tran, osql_sess_t *sess, int *bdberr, int *nops,
     struct block_err *err, SBUF2 *logsb, struct temp_cursor *dbc,
@@ -1083,6 +1508,9 @@ static int process_this_session(
     int lastrcv = 0;
     int rc = 0, rc_out = 0;
     int *updCols = NULL;
+    struct temp_cursor *pfc = NULL;
+    struct db *pf_db = NULL;
+    unsigned long long pf_seq = 0;
 
     /* session info */
     blob_buffer_t blobs[MAXBLOBS] = {0};
@@ -1105,6 +1533,37 @@ static int process_this_session(
     key->seq = 0;
     osql_sess_getuuid(sess, key->uuid);
     osql_sess_getuuid(sess, uuid);
+
+    if (gbl_osql_apply_threads > 1 && !logsb &&
+        tran->rows >= gbl_osql_apply_min_ops &&
+        !(iq->osql_flags & OSQL_FLAGS_BULK_LOAD)) {
+        unsigned long long done_seq = 0;
+
+        rc = apply_session_parallel(iq, iq_tran, dbc, key, bdberr,
+                                    &receivedrows, &done_seq);
+        if (rc == 0) {
+            /* only the DONE op is left */
+            key->seq = done_seq;
+            step = done_seq;
+        } else if (rc != 1) {
+            err->blockop_num = 0;
+            err->errcode = ERR_INTERNAL;
+            err->ixnum = 0;
+            free(key);
+            return rc;
+        }
+        rc = 0;
+    }
+
+    /* bulk load: the inserts leave their index keys to be added sorted */
+    if (iq->osql_flags & OSQL_FLAGS_BULK_LOAD) {
+        iq->sorted_keys = sorted_keys_create();
+        if (!iq->sorted_keys) {
+            free(key);
+            return ERR_INTERNAL;
+        }
+    }
+
     key_next = key_crt = *key;
 
     if (key->rqid != OSQL_RQID_USE_UUID)
@@ -1113,12 +1572,17 @@ static int process_this_session(
         reqlog_set_rqid(iq->reqlogger, uuid, sizeof(uuid));
     reqlog_set_event(iq->reqlogger, "txn");
 
-    /* go through each record */
+    /* go through each record, from the start of the session or from its
+       DONE if the tables went in parallel; once found, the cursor owns key */
     rc = bdb_temp_table_find_exact(thedb->bdb_env, dbc, key, sizeof(*key),
                                    bdberr);
+    if (rc)
+        free(key);
     if (rc && rc != IX_EMPTY && rc != IX_NOTFND) {
         logmsg(LOGMSG_ERROR, "%s: bdb_temp_table_first failed rc=%d bdberr=%d\n",
                 __func__, rc, *bdberr);
+        sorted_keys_destroy(iq->sorted_keys);
+        iq->sorted_keys = NULL;
         return rc;
     }
 
@@ -1128,6 +1592,29 @@ static int process_this_session(
                 rqid, us);
     }
 
+    /* prefault the ops right before applying them; the cursor walks ahead
+       of the apply */
+    if (!rc && gbl_osqlpfault_threads && gbl_osqlpfault_ahead > 0) {
+        /* the prefault cursor gets its own copy of the key to own */
+        oplog_key_t *pf_key = malloc(sizeof(oplog_key_t));
+
+        if (pf_key) {
+            *pf_key = key_crt;
+            pfc = bdb_temp_table_cursor(thedb->bdb_env, tran->db, NULL,
+                                        bdberr);
+        }
+        if (pfc && bdb_temp_table_find_exact(thedb->bdb_env, pfc, pf_key,
+                                             sizeof(*pf_key), bdberr)) {
+            /* not found, pf_key is still ours */
+            bdb_temp_table_close_cursor(thedb->bdb_env, pfc, bdberr);
+            pfc = NULL;
+            free(pf_key);
+        } else if (!pfc) {
+            free(pf_key);
+        }
+        pf_seq = key_crt.seq;
+    }
+
     while (!rc && !rc_out) {
 
         data = bdb_temp_table_data(dbc);
@@ -1139,9 +1626,17 @@ static int process_this_session(
             err->blockop_num = 0;
             err->errcode = ERR_NOMASTER;
             err->ixnum = 0;
+            if (pfc)
+                bdb_temp_table_close_cursor(thedb->bdb_env, pfc, bdberr);
+            sorted_keys_destroy(iq->sorted_keys);
+            iq->sorted_keys = NULL;
             return ERR_NOMASTER /*OSQL_FAILDISPATCH*/;
         }
 
+        if (pfc)
+            pfc = prefault_ahead(iq, pfc, rqid, uuid, key_next.seq, &pf_seq,
+                                 &pf_db);
+
         if (iq->osql_step_ix)
             gbl_osqlpf_step[*(iq->osql_step_ix)].step = key_next.seq << 7;
 
@@ -1196,6 +1691,15 @@ static int process_this_session(
         step++;
     }
 
+    if (pfc) {
+        int pfberr;
+        bdb_temp_table_close_cursor(thedb->bdb_env, pfc, &pfberr);
+    }
+
+    /* keys not added by now belong to a failed transaction */
+    sorted_keys_destroy(iq->sorted_keys);
+    iq->sorted_keys = NULL;
+
     /* if for some reason the session has not completed correctly,
        this will free the eventually allocated buffers */
     free_blob_buffers(blobs, MAXBLOBS);
@@ -46,6 +46,12 @@
 #include <bpfunc.h>
 #include <strbuf.h>
 #include <logmsg.h>
+#include <lz4.h>
+#include "comdb2_atomic.h"
+
+#if LZ4_VERSION_NUMBER < 10701
+#define LZ4_compress_default LZ4_compress_limitedOutput
+#endif
 
 #define BLKOUT_DEFAULT_DELTA 5
 #define MAX_CLUSTER 16
@@ -65,6 +71,15 @@ queue_type *gbl_osqlpf_stepq = NULL;
 
 pthread_mutex_t osqlpf_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* how useful bplog prefaulting is: a request is "late" if the block
+   processor got to its op before a prefault thread did */
+static struct {
+    int queued;  /* requests handed to the prefault pool */
+    int dropped; /* requests refused by a full pool */
+    int late;    /* requests skipped, apply was already past them */
+    int faulted; /* requests that read their pages ahead of apply */
+} osqlpf_stats;
+
 extern __thread int send_prefault_udp;
 extern int gbl_prefault_udp;
 
@@ -114,6 +129,54 @@ BB_COMPILE_TIME_ASSERT(osqlcomm_poke_type_len,
 BB_COMPILE_TIME_ASSERT(osqlcomm_poke_uuid_type_len,
                        sizeof(osql_poke_uuid_t) == OSQLCOMM_POKE_UUID_TYPE_LEN);
 
+/* NET_OSQL_BATCH_RPL: several osql replies for one session packed in one
+   net message; the body is a sequence of <4 byte length><reply> pairs,
+   possibly lz4 compressed as a whole */
+typedef struct osql_batch_hdr {
+    int usertype; /* net type each reply would have been sent with */
+    int nops;
+    int flags;
+    int rawlen; /* body length before compression */
+} osql_batch_hdr_t;
+
+enum { OSQLCOMM_BATCH_HDR_LEN = 4 + 4 + 4 + 4 };
+
+BB_COMPILE_TIME_ASSERT(osqlcomm_batch_hdr_len,
+                       sizeof(osql_batch_hdr_t) == OSQLCOMM_BATCH_HDR_LEN);
+
+enum { OSQL_BATCH_LZ4 = 0x1 };
+
+static uint8_t *osqlcomm_batch_hdr_put(const osql_batch_hdr_t *p_hdr,
+                                       uint8_t *p_buf, const uint8_t *p_buf_end)
+{
+    if (p_buf_end < p_buf || OSQLCOMM_BATCH_HDR_LEN > (p_buf_end - p_buf))
+        return NULL;
+
+    p_buf = buf_put(&(p_hdr->usertype), sizeof(p_hdr->usertype), p_buf,
+                    p_buf_end);
+    p_buf = buf_put(&(p_hdr->nops), sizeof(p_hdr->nops), p_buf, p_buf_end);
+    p_buf = buf_put(&(p_hdr->flags), sizeof(p_hdr->flags), p_buf, p_buf_end);
+    p_buf = buf_put(&(p_hdr->rawlen), sizeof(p_hdr->rawlen), p_buf, p_buf_end);
+
+    return p_buf;
+}
+
+static const uint8_t *osqlcomm_batch_hdr_get(osql_batch_hdr_t *p_hdr,
+                                             const uint8_t *p_buf,
+                                             const uint8_t *p_buf_end)
+{
+    if (p_buf_end < p_buf || OSQLCOMM_BATCH_HDR_LEN > (p_buf_end - p_buf))
+        return NULL;
+
+    p_buf = buf_get(&(p_hdr->usertype), sizeof(p_hdr->usertype), p_buf,
+                    p_buf_end);
+    p_buf = buf_get(&(p_hdr->nops), sizeof(p_hdr->nops), p_buf, p_buf_end);
+    p_buf = buf_get(&(p_hdr->flags), sizeof(p_hdr->flags), p_buf, p_buf_end);
+    p_buf = buf_get(&(p_hdr->rawlen), sizeof(p_hdr->rawlen), p_buf, p_buf_end);
+
+    return p_buf;
+}
+
 static uint8_t *osqlcomm_poke_type_put(const osql_poke_t *p_poke_type,
                                        uint8_t *p_buf, const uint8_t *p_buf_end)
 {
@@ -2752,6 +2815,9 @@ static osql_comm_t *comm = NULL;
 
 static void net_osql_rpl(void *hndl, void *uptr, char *fromnode, int usertype,
                          void *dtap, int dtalen, uint8_t is_tcp);
+static void net_osql_batch_rpl(void *hndl, void *uptr, char *fromnode,
+                               int usertype, void *dtap, int dtalen,
+                               uint8_t is_tcp);
 static int net_osql_rpl_tail(void *hndl, void *uptr, char *fromnode,
                              int usertype, void *dtap, int dtalen, void *tail,
                              int tailen);
@@ -2885,6 +2951,8 @@ int osql_comm_init(struct dbenv *dbenv)
     }
 
     /* sqloffload handler */
+    net_register_handler(tmp->handle_sibling, NET_OSQL_BATCH_RPL,
+                         net_osql_batch_rpl);
     net_register_handler(tmp->handle_sibling, NET_OSQL_BLOCK_RPL, net_osql_rpl);
     net_register_handler(tmp->handle_sibling, NET_OSQL_BLOCK_RPL_UUID,
                          net_osql_rpl);
@@ -5735,11 +5803,260 @@ int osql_comm_check_bdb_lock(void)
     return 0;
 }
 
+/* Replies a sql session sends to a remote master for the rows of a
+   transaction are packed into NET_OSQL_BATCH_RPL messages of up to
+   osql_batch_bytes instead of going out one net message each.  The batch
+   lives in the session (clnt->osql.batch), since the statements of a
+   transaction can run on different sql threads; it is flushed at the end of
+   every statement, before anything else the session sends (usedb excepted)
+   and always before the commit, so the master sees the replies in the same
+   order.  0 sends every reply on its own, which older masters require. */
+int gbl_osql_batch_bytes = 0;
+int gbl_osql_batch_compress = 1;
+
+struct osql_batch {
+    char *host;
+    int usertype;
+    int nops;
+    int len;
+    int alloc;
+    int failed;   /* a flush failed; the session must not commit */
+    uint8_t *buf; /* OSQLCOMM_BATCH_HDR_LEN reserved, then the replies */
+};
+
+static int offload_net_send_int(char *host, int usertype, void *data,
+                                int datalen, int nodelay);
+
+static int osql_batchable(int usertype, const void *data, int datalen)
+{
+    int type;
+
+    switch (usertype) {
+    case NET_OSQL_SOCK_RPL:
+    case NET_OSQL_SOCK_RPL_UUID:
+    case NET_OSQL_RECOM_RPL:
+    case NET_OSQL_RECOM_RPL_UUID:
+    case NET_OSQL_SNAPISOL_RPL:
+    case NET_OSQL_SNAPISOL_RPL_UUID:
+    case NET_OSQL_SERIAL_RPL:
+    case NET_OSQL_SERIAL_RPL_UUID:
+        break;
+    default:
+        return 0;
+    }
+
+    if (datalen < sizeof(type))
+        return 0;
+    memcpy(&type, data, sizeof(type));
+    switch (ntohl(type)) {
+    case OSQL_USEDB:
+    case OSQL_DELREC:
+    case OSQL_INSREC:
+    case OSQL_QBLOB:
+    case OSQL_UPDREC:
+    case OSQL_UPDCOLS:
+    case OSQL_RECGENID:
+    case OSQL_UPDSTAT:
+    case OSQL_DBQ_CONSUME:
+    case OSQL_DBQ_CONSUME_UUID:
+    case OSQL_DELETE:
+    case OSQL_INSERT:
+    case OSQL_UPDATE:
+    case OSQL_DELIDX:
+    case OSQL_INSIDX:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Send the pending batch; the buffer is kept for the rest of the session */
+static int osql_batch_flush(struct osql_batch *b, int nodelay)
+{
+    osql_batch_hdr_t hdr = {0};
+    uint8_t *msg = b->buf;
+    int msglen = b->len;
+    int rc = 0;
+
+    if (b->nops > 0) {
+        hdr.usertype = b->usertype;
+        hdr.nops = b->nops;
+        hdr.rawlen = b->len - OSQLCOMM_BATCH_HDR_LEN;
+
+        if (gbl_osql_batch_compress) {
+            int bound = LZ4_compressBound(hdr.rawlen);
+            uint8_t *cmp = malloc(OSQLCOMM_BATCH_HDR_LEN + bound);
+            int clen = 0;
+            if (cmp)
+                clen = LZ4_compress_default(
+                    (char *)b->buf + OSQLCOMM_BATCH_HDR_LEN,
+                    (char *)cmp + OSQLCOMM_BATCH_HDR_LEN, hdr.rawlen, bound);
+            if (clen > 0 && clen < hdr.rawlen) {
+                hdr.flags |= OSQL_BATCH_LZ4;
+                msg = cmp;
+                msglen = OSQLCOMM_BATCH_HDR_LEN + clen;
+            } else {
+                free(cmp);
+            }
+        }
+
+        osqlcomm_batch_hdr_put(&hdr, msg, msg + OSQLCOMM_BATCH_HDR_LEN);
+        rc = offload_net_send_int(b->host, NET_OSQL_BATCH_RPL, msg, msglen,
+                                  nodelay);
+        if (msg != b->buf)
+            free(msg);
+        if (rc)
+            b->failed = 1;
+    }
+
+    b->nops = 0;
+    b->len = OSQLCOMM_BATCH_HDR_LEN;
+    return rc;
+}
+
+/* Returns the batch of the session this sql thread is running, if it talks
+   to host; NULL sends directly */
+static struct osql_batch *osql_batch_get(char *host, int create)
+{
+    struct sql_thread *thd = pthread_getspecific(query_info_key);
+    struct sqlclntstate *clnt;
+
+    if (thd == NULL || (clnt = thd->sqlclntstate) == NULL ||
+        clnt->osql.host != host)
+        return NULL;
+
+    if (clnt->osql.batch == NULL && create) {
+        clnt->osql.batch = calloc(1, sizeof(struct osql_batch));
+        if (clnt->osql.batch == NULL)
+            logmsg(LOGMSG_ERROR, "%s: calloc failed\n", __func__);
+    }
+    return clnt->osql.batch;
+}
+
+/**
+ * Sends the replies batched so far by this session; a failure, now or in an
+ * earlier flush, is returned so the transaction is not committed without them
+ *
+ */
+int osql_comm_flush_batch(struct sqlclntstate *clnt)
+{
+    struct osql_batch *b = clnt->osql.batch;
+    int rc;
+
+    if (b == NULL)
+        return 0;
+    if ((rc = osql_batch_flush(b, 0)) != 0)
+        return rc;
+    return b->failed ? -1 : 0;
+}
+
+/**
+ * Drops the replies batched so far, as the session is starting over or
+ * rolling back
+ *
+ */
+void osql_comm_discard_batch(struct sqlclntstate *clnt)
+{
+    struct osql_batch *b = clnt->osql.batch;
+
+    if (b == NULL)
+        return;
+    b->nops = 0;
+    b->len = OSQLCOMM_BATCH_HDR_LEN;
+    b->failed = 0;
+}
+
+/**
+ * Frees the session batch
+ *
+ */
+void osql_comm_free_batch(struct sqlclntstate *clnt)
+{
+    struct osql_batch *b = clnt->osql.batch;
+
+    if (b == NULL)
+        return;
+    free(b->buf);
+    free(b);
+    clnt->osql.batch = NULL;
+}
+
+static int osql_batch_add(struct osql_batch *b, char *host, int usertype,
+                          void *data, int datalen, int ntails, void **tails,
+                          int *tailens)
+{
+    int oplen = datalen;
+    int rc;
+
+    for (int i = 0; i < ntails; i++)
+        oplen += tailens[i];
+
+    if (b->nops > 0 && (b->host != host || b->usertype != usertype)) {
+        if ((rc = osql_batch_flush(b, 0)) != 0)
+            return rc;
+    }
+
+    if (b->buf == NULL)
+        b->len = OSQLCOMM_BATCH_HDR_LEN;
+    if (b->len + sizeof(int) + oplen > b->alloc) {
+        int alloc = b->alloc ? b->alloc : gbl_osql_batch_bytes;
+        while (alloc < b->len + sizeof(int) + oplen)
+            alloc *= 2;
+        uint8_t *buf = realloc(b->buf, alloc);
+        if (buf == NULL) {
+            logmsg(LOGMSG_ERROR, "%s: realloc %d failed\n", __func__, alloc);
+            return NET_SEND_FAIL_MALLOC_FAIL;
+        }
+        b->buf = buf;
+        b->alloc = alloc;
+    }
+
+    b->host = host;
+    b->usertype = usertype;
+    int nlen = htonl(oplen);
+    memcpy(b->buf + b->len, &nlen, sizeof(nlen));
+    b->len += sizeof(nlen);
+    memcpy(b->buf + b->len, data, datalen);
+    b->len += datalen;
+    for (int i = 0; i < ntails; i++) {
+        memcpy(b->buf + b->len, tails[i], tailens[i]);
+        b->len += tailens[i];
+    }
+    b->nops++;
+
+    if (b->len >= gbl_osql_batch_bytes)
+        return osql_batch_flush(b, 0);
+    return 0;
+}
+
 /* this wrapper tries to provide a reliable net_send that will prevent loosing
    packets
    due to queue being full */
 static int offload_net_send(char *host, int usertype, void *data, int datalen,
                             int nodelay)
+{
+    struct osql_batch *b = NULL;
+    int rc;
+
+    if (host == gbl_mynode)
+        host = NULL;
+
+    if (host && gbl_osql_batch_bytes > 0) {
+        int batchable = osql_batchable(usertype, data, datalen);
+        b = osql_batch_get(host, batchable);
+        if (b && batchable)
+            return osql_batch_add(b, host, usertype, data, datalen, 0, NULL,
+                                  NULL);
+    }
+
+    if (b && b->nops > 0 && (rc = osql_batch_flush(b, nodelay)) != 0)
+        return rc;
+
+    return offload_net_send_int(host, usertype, data, datalen, nodelay);
+}
+
+static int offload_net_send_int(char *host, int usertype, void *data,
+                                int datalen, int nodelay)
 {
     netinfo_type *netinfo_ptr = comm->handle_sibling;
     int backoff = gbl_osql_bkoff_netsend;
@@ -5832,6 +6149,25 @@ static int offload_net_send_tails(char *host, int usertype, void *data,
 {
 
     netinfo_type *netinfo_ptr = comm->handle_sibling;
+    struct osql_batch *b = NULL;
+
+    if (host == gbl_mynode)
+        host = NULL;
+
+    if (host && gbl_osql_batch_bytes > 0) {
+        int batchable = osql_batchable(usertype, data, datalen);
+        b = osql_batch_get(host, batchable);
+        if (b && batchable)
+            return osql_batch_add(b, host, usertype, data, datalen, ntails,
+                                  tails, tailens);
+    }
+
+    if (b && b->nops > 0) {
+        int rc = osql_batch_flush(b, nodelay);
+        if (rc)
+            return rc;
+    }
+
     int backoff = gbl_osql_bkoff_netsend;
     int total_wait = backoff;
     int unknownerror_retry = 0;
@@ -5987,6 +6323,58 @@ static void net_osql_rpl(void *hndl, void *uptr, char *fromnode, int usertype,
         stats[netrpl2req(usertype)].rcv_rdndt++;
 }
 
+/* unpack a NET_OSQL_BATCH_RPL and hand each reply to net_osql_rpl */
+static void net_osql_batch_rpl(void *hndl, void *uptr, char *fromnode,
+                               int usertype, void *dtap, int dtalen,
+                               uint8_t is_tcp)
+{
+    osql_batch_hdr_t hdr;
+    const uint8_t *p_buf = dtap;
+    const uint8_t *p_buf_end = p_buf + dtalen;
+    uint8_t *raw = NULL;
+
+    if (!(p_buf = osqlcomm_batch_hdr_get(&hdr, p_buf, p_buf_end))) {
+        logmsg(LOGMSG_ERROR, "%s: short batch from %s\n", __func__, fromnode);
+        return;
+    }
+
+    if (hdr.flags & OSQL_BATCH_LZ4) {
+        raw = malloc(hdr.rawlen);
+        if (raw == NULL ||
+            LZ4_decompress_safe((const char *)p_buf, (char *)raw,
+                                p_buf_end - p_buf, hdr.rawlen) != hdr.rawlen) {
+            logmsg(LOGMSG_ERROR, "%s: bad batch of %d ops from %s\n",
+                   __func__, hdr.nops, fromnode);
+            free(raw);
+            return;
+        }
+        p_buf = raw;
+        p_buf_end = raw + hdr.rawlen;
+    }
+
+    for (int i = 0; i < hdr.nops; i++) {
+        int oplen;
+        if (p_buf_end - p_buf < sizeof(oplen)) {
+            logmsg(LOGMSG_ERROR, "%s: truncated batch from %s at op %d/%d\n",
+                   __func__, fromnode, i, hdr.nops);
+            break;
+        }
+        memcpy(&oplen, p_buf, sizeof(oplen));
+        oplen = ntohl(oplen);
+        p_buf += sizeof(oplen);
+        if (oplen < 0 || oplen > p_buf_end - p_buf) {
+            logmsg(LOGMSG_ERROR, "%s: truncated batch from %s at op %d/%d\n",
+                   __func__, fromnode, i, hdr.nops);
+            break;
+        }
+        net_osql_rpl(hndl, uptr, fromnode, hdr.usertype, (void *)p_buf, oplen,
+                     is_tcp);
+        p_buf += oplen;
+    }
+
+    free(raw);
+}
+
 static int check_master(char *tohost)
 {
 
@@ -6284,6 +6672,53 @@ static inline int is_write_request(int type)
 }
 
 void free_cached_idx(uint8_t **cached_idx);
+
+/* Bulk load transactions (SET BULKLOAD ON) keep back the index keys of their
+   inserts in iq->sorted_keys, and add them in key order before any other
+   kind of op, at commit, or once this many keys are waiting. */
+int gbl_osql_bulk_load_keys = 1000000;
+
+static inline int bulk_load_keeps_keys(int type)
+{
+    switch (type) {
+    case OSQL_USEDB:
+    case OSQL_INSREC:
+    case OSQL_INSERT:
+    case OSQL_QBLOB:
+    case OSQL_INSIDX:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int osql_add_sorted_keys(struct ireq *iq, void *trans,
+                                struct block_err *err)
+{
+    int blkpos = 0, ixnum = -1;
+    struct db *db = NULL;
+    int rc;
+
+    rc = sorted_keys_add(iq, trans, iq->sorted_keys, &blkpos, &ixnum, &db);
+    if (rc == 0 || rc == RC_INTERNAL_RETRY)
+        return rc;
+
+    err->blockop_num = blkpos;
+    err->ixnum = ixnum;
+    if (rc == IX_DUP) {
+        err->errcode = OP_FAILED_UNIQ;
+        reqerrstr(iq, COMDB2_CSTRT_RC_DUP, "add key constraint "
+                                           "duplicate key '%s' on "
+                                           "table '%s' index %d",
+                  get_keynm_from_db_idx(db, ixnum), db->dbname, ixnum);
+    } else {
+        err->errcode = OP_FAILED_INTERNAL;
+        reqerrstr(iq, COMDB2_ADD_RC_INVL_KEY, "unable to add record rc = %d",
+                  rc);
+    }
+    return rc;
+}
+
 /**
  * Handles each packet and calls record.c functions
  * to apply to received row updates
@@ -6343,6 +6778,12 @@ int osql_process_packet(struct ireq *iq, unsigned long long rqid, uuid_t uuid,
     if (gbl_toblock_net_throttle && is_write_request(type))
         net_throttle_wait(thedb->handle_sibling);
 
+    if (iq->sorted_keys && sorted_keys_count(iq->sorted_keys) > 0 &&
+        !bulk_load_keeps_keys(type)) {
+        if ((rc = osql_add_sorted_keys(iq, trans, err)) != 0)
+            return rc;
+    }
+
     switch (type) {
     case OSQL_DONE:
     case OSQL_DONE_SNAP:
@@ -6568,6 +7009,8 @@ int osql_process_packet(struct ireq *iq, unsigned long long rqid, uuid_t uuid,
         if (osql_get_delayed(iq) == 0 && iq->usedb->n_constraints == 0 &&
             gbl_goslow == 0) {
             addflags |= RECFLAGS_NO_CONSTRAINTS;
+            if (iq->sorted_keys)
+                addflags |= RECFLAGS_SORTED_KEYS;
         } else {
             osql_set_delayed(iq);
         }
@@ -6621,6 +7064,12 @@ int osql_process_packet(struct ireq *iq, unsigned long long rqid, uuid_t uuid,
                             rrn, bdb_genid_to_host_order(genid));
         }
 
+        if (iq->sorted_keys &&
+            sorted_keys_count(iq->sorted_keys) >= gbl_osql_bulk_load_keys) {
+            if ((rc = osql_add_sorted_keys(iq, trans, err)) != 0)
+                return rc;
+        }
+
         (*receivedrows)++;
     } break;
     case OSQL_UPDREC:
@@ -7242,6 +7691,9 @@ static int sorese_rcvreq(char *fromhost, void *dtap, int dtalen, int type,
         iq->sorese.use_blkseq = 0;
     }
 
+    if ((req.flags & OSQL_FLAGS_BULK_LOAD))
+        iq->osql_flags |= OSQL_FLAGS_BULK_LOAD;
+
 done:
 
     if (rc) {
@@ -8070,7 +8522,7 @@ static void osqlpfault_do_work_pp(struct thdpool *pool, void *work,
 
 /* given a table, key   : enqueue a fault for the a single ix record */
 int enque_osqlpfault_oldkey(struct db *db, void *key, int keylen, int ixnum,
-                            int i, unsigned long long rqid,
+                            int i, unsigned long long rqid, uuid_t uuid,
                             unsigned long long seq)
 {
     osqlpf_rq_t *qdata = NULL;
@@ -8090,12 +8542,17 @@ int enque_osqlpfault_oldkey(struct db *db, void *key, int keylen, int ixnum,
     qdata->i = i;
     qdata->seq = seq;
     qdata->rqid = rqid;
+    comdb2uuidcpy(qdata->uuid, uuid);
 
     if ((keylen > 0) && (keylen < MAXKEYLEN))
         memcpy(qdata->key, key, keylen);
 
     rc = thdpool_enqueue(gbl_osqlpfault_thdpool, osqlpfault_do_work_pp, qdata,
                          0, NULL);
+    if (rc == 0)
+        ATOMIC_ADD(osqlpf_stats.queued, 1);
+    else
+        ATOMIC_ADD(osqlpf_stats.dropped, 1);
 
     if (rc != 0) {
         free(qdata);
@@ -8105,7 +8562,7 @@ int enque_osqlpfault_oldkey(struct db *db, void *key, int keylen, int ixnum,
 
 /* given a table, key   : enqueue a fault for the a single ix record */
 int enque_osqlpfault_newkey(struct db *db, void *key, int keylen, int ixnum,
-                            int i, unsigned long long rqid,
+                            int i, unsigned long long rqid, uuid_t uuid,
                             unsigned long long seq)
 {
     osqlpf_rq_t *qdata = NULL;
@@ -8125,12 +8582,17 @@ int enque_osqlpfault_newkey(struct db *db, void *key, int keylen, int ixnum,
     qdata->i = i;
     qdata->seq = seq;
     qdata->rqid = rqid;
+    comdb2uuidcpy(qdata->uuid, uuid);
 
     if ((keylen > 0) && (keylen < MAXKEYLEN))
         memcpy(qdata->key, key, keylen);
 
     rc = thdpool_enqueue(gbl_osqlpfault_thdpool, osqlpfault_do_work_pp, qdata,
                          0, NULL);
+    if (rc == 0)
+        ATOMIC_ADD(osqlpf_stats.queued, 1);
+    else
+        ATOMIC_ADD(osqlpf_stats.dropped, 1);
 
     if (rc != 0) {
         free(qdata);
@@ -8166,6 +8628,10 @@ int enque_osqlpfault_olddata_oldkeys(struct db *db, unsigned long long genid,
 
     rc = thdpool_enqueue(gbl_osqlpfault_thdpool, osqlpfault_do_work_pp, qdata,
                          0, NULL);
+    if (rc == 0)
+        ATOMIC_ADD(osqlpf_stats.queued, 1);
+    else
+        ATOMIC_ADD(osqlpf_stats.dropped, 1);
 
     if (rc != 0) {
         free(qdata);
@@ -8204,6 +8670,10 @@ int enque_osqlpfault_newdata_newkeys(struct db *db, void *record, int reclen,
 
     rc = thdpool_enqueue(gbl_osqlpfault_thdpool, osqlpfault_do_work_pp, qdata,
                          0, NULL);
+    if (rc == 0)
+        ATOMIC_ADD(osqlpf_stats.queued, 1);
+    else
+        ATOMIC_ADD(osqlpf_stats.dropped, 1);
 
     if (rc != 0) {
         free(qdata->record);
@@ -8248,6 +8718,10 @@ int enque_osqlpfault_olddata_oldkeys_newkeys(
 
     rc = thdpool_enqueue(gbl_osqlpfault_thdpool, osqlpfault_do_work_pp, qdata,
                          0, NULL);
+    if (rc == 0)
+        ATOMIC_ADD(osqlpf_stats.queued, 1);
+    else
+        ATOMIC_ADD(osqlpf_stats.dropped, 1);
 
     if (rc != 0) {
         free(qdata->record);
@@ -8271,12 +8745,13 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
     if (!gbl_osqlpfault_threads)
         goto done;
 
-    if (req->rqid != gbl_osqlpf_step[req->i].rqid) {
+    if (req->rqid != gbl_osqlpf_step[req->i].rqid ||
+        (req->rqid == OSQL_RQID_USE_UUID &&
+         comdb2uuidcmp(req->uuid, gbl_osqlpf_step[req->i].uuid))) {
+        /* the transaction was applied before we got here */
+        ATOMIC_ADD(osqlpf_stats.late, 1);
         goto done;
     }
-    if (req->rqid == OSQL_RQID_USE_UUID &&
-        comdb2uuidcmp(req->uuid, gbl_osqlpf_step[req->i].uuid))
-        goto done;
 
     step = req->seq << 7;
 
@@ -8289,6 +8764,7 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
 
         step += 1;
         if (step <= gbl_osqlpf_step[req->i].step) {
+            ATOMIC_ADD(osqlpf_stats.late, 1);
             if (fnddta)
                 free(fnddta);
             break;
@@ -8299,6 +8775,7 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
             logmsg(LOGMSG_FATAL, "osqlpfault_do_work: malloc %u failed\n", od_len);
             exit(1);
         }
+        ATOMIC_ADD(osqlpf_stats.faulted, 1);
         rc = ix_find_by_rrn_and_genid_prefault(&iq, 2, req->genid, fnddta,
                                                &fndlen, od_len);
         if (fnddta)
@@ -8315,10 +8792,12 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
 
         step += ((1 + (unsigned long long)req->index) << 1);
         if (step <= gbl_osqlpf_step[req->i].step) {
+            ATOMIC_ADD(osqlpf_stats.late, 1);
             break;
         }
 
         iq.usedb = req->db;
+        ATOMIC_ADD(osqlpf_stats.faulted, 1);
         rc = ix_find_prefault(&iq, req->index, req->key, req->len, fndkey,
                               &fndrrn, &genid, NULL, NULL, 0);
     } break;
@@ -8334,10 +8813,12 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
 
         step += 1 + ((1 + (unsigned long long)req->index) << 1);
         if (step <= gbl_osqlpf_step[req->i].step) {
+            ATOMIC_ADD(osqlpf_stats.late, 1);
             break;
         }
 
         iq.usedb = req->db;
+        ATOMIC_ADD(osqlpf_stats.faulted, 1);
         rc = ix_find_prefault(&iq, req->index, req->key, req->len, fndkey,
                               &fndrrn, &genid, NULL, NULL, 0);
     } break;
@@ -8362,6 +8843,7 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
 
         step += 1;
         if (step <= gbl_osqlpf_step[req->i].step) {
+            ATOMIC_ADD(osqlpf_stats.late, 1);
             if (fnddta)
                 free(fnddta);
             break;
@@ -8372,6 +8854,7 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
             exit(1);
         }
 
+        ATOMIC_ADD(osqlpf_stats.faulted, 1);
         rc = ix_find_by_rrn_and_genid_prefault(&iq, 2, req->genid, fnddta,
                                                &fndlen, od_len);
 
@@ -8404,7 +8887,7 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
             }
 
             rc = enque_osqlpfault_oldkey(iq.usedb, key, keysz, ixnum, req->i,
-                                         req->rqid, req->seq);
+                                         req->rqid, req->uuid, req->seq);
         }
         if (fnddta)
             free(fnddta);
@@ -8438,7 +8921,7 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
             }
 
             rc = enque_osqlpfault_newkey(iq.usedb, key, keysz, ixnum, req->i,
-                                         req->rqid, req->seq);
+                                         req->rqid, req->uuid, req->seq);
         }
     } break;
     case OSQLPFRQ_OLDDATA_OLDKEYS_NEWKEYS: {
@@ -8461,6 +8944,7 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
 
         step += 1;
         if (step <= gbl_osqlpf_step[req->i].step) {
+            ATOMIC_ADD(osqlpf_stats.late, 1);
             if (fnddta)
                 free(fnddta);
             break;
@@ -8471,6 +8955,7 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
             exit(1);
         }
 
+        ATOMIC_ADD(osqlpf_stats.faulted, 1);
         rc = ix_find_by_rrn_and_genid_prefault(&iq, 2, req->genid, fnddta,
                                                &fndlen, od_len);
 
@@ -8503,7 +8988,7 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
             }
 
             rc = enque_osqlpfault_oldkey(iq.usedb, key, keysz, ixnum, req->i,
-                                         req->rqid, req->seq);
+                                         req->rqid, req->uuid, req->seq);
         }
 
         if (fnddta)
@@ -8532,7 +9017,7 @@ static void osqlpfault_do_work(struct thdpool *pool, void *work, void *thddata)
             }
 
             rc = enque_osqlpfault_newkey(iq.usedb, key, keysz, ixnum, req->i,
-                                         req->rqid, req->seq);
+                                         req->rqid, req->uuid, req->seq);
         }
     } break;
     }
@@ -8561,64 +9046,125 @@ static void osqlpfault_do_work_pp(struct thdpool *pool, void *work,
     }
 }
 
+void osql_page_prefault_stats(void)
+{
+    int queued = ATOMIC_ADD(osqlpf_stats.queued, 0);
+    int dropped = ATOMIC_ADD(osqlpf_stats.dropped, 0);
+    int late = ATOMIC_ADD(osqlpf_stats.late, 0);
+    int faulted = ATOMIC_ADD(osqlpf_stats.faulted, 0);
+
+    logmsg(LOGMSG_USER, "Osql io prefault requests queued %d dropped %d "
+                        "late %d faulted %d\n",
+           queued, dropped, late, faulted);
+    if (faulted + late > 0)
+        logmsg(LOGMSG_USER, "Osql io prefault hit rate %.1f%%\n",
+               100.0 * faulted / (faulted + late));
+}
+
+int osql_packet_type(unsigned long long rqid, char *msg, int msglen,
+                     struct db **usedb)
+{
+    const uint8_t *p_buf = (const uint8_t *)msg;
+    const uint8_t *p_buf_end = p_buf + msglen;
+    int type;
+
+    if (usedb)
+        *usedb = NULL;
+
+    if (rqid == OSQL_RQID_USE_UUID) {
+        osql_uuid_rpl_t rpl = {0};
+        p_buf = osqlcomm_uuid_rpl_type_get(&rpl, p_buf, p_buf_end);
+        type = rpl.type;
+    } else {
+        osql_rpl_t rpl = {0};
+        p_buf = osqlcomm_rpl_type_get(&rpl, p_buf, p_buf_end);
+        type = rpl.type;
+    }
+    if (!p_buf)
+        return -1;
+
+    if (type == OSQL_USEDB && usedb) {
+        osql_usedb_t dt;
+        const char *tablename;
+        size_t left;
+
+        tablename = (const char *)osqlcomm_usedb_type_get(&dt, p_buf,
+                                                          p_buf_end);
+        if (!tablename)
+            return type;
+        left = (const char *)p_buf_end - tablename;
+        if (dt.tablenamelen > left || strnlen(tablename, left) >= left)
+            return type;
+        if (!is_tablename_queue(tablename, strlen(tablename)))
+            *usedb = getdbbyname(tablename);
+    }
+
+    return type;
+}
+
 int osql_page_prefault(char *rpl, int rplen, struct db **last_db,
                        int **iq_step_ix, unsigned long long rqid, uuid_t uuid,
                        unsigned long long seq)
 {
-    static int last_step_idex = 0;
+    int step_idex;
     int *ii;
     int rc;
-    osql_rpl_t rpl_op;
+    int type;
+    struct db *usedb = NULL;
     uint8_t *p_buf = (uint8_t *)rpl;
     uint8_t *p_buf_end = p_buf + rplen;
-    osqlcomm_rpl_type_get(&rpl_op, p_buf, p_buf_end);
+
+    type = osql_packet_type(rqid, rpl, rplen, &usedb);
+    if (rqid == OSQL_RQID_USE_UUID)
+        p_buf += sizeof(osql_uuid_rpl_t);
+    else
+        p_buf += sizeof(osql_rpl_t);
 
     if (seq == 0) {
-        rc = pthread_mutex_lock(&osqlpf_mutex);
-        if (rc != 0) {
-            logmsg(LOGMSG_ERROR, "osql_page_prefault: Failed to lock osqlpf_mutex\n");
-            return 1;
-        }
-        ii = queue_next(gbl_osqlpf_stepq);
-        rc = pthread_mutex_unlock(&osqlpf_mutex);
-        if (rc != 0) {
-            logmsg(LOGMSG_ERROR, "osql_page_prefault: Failed to unlock osqlpf_mutex\n");
-            return 1;
-        }
-        if (ii == NULL) {
-            logmsg(LOGMSG_ERROR, "osql io prefault got a BUG!\n");
-            exit(1);
+        /* a retried transaction keeps its slot */
+        if (*iq_step_ix == NULL) {
+            rc = pthread_mutex_lock(&osqlpf_mutex);
+            if (rc != 0) {
+                logmsg(LOGMSG_ERROR, "osql_page_prefault: Failed to lock osqlpf_mutex\n");
+                return 1;
+            }
+            ii = queue_next(gbl_osqlpf_stepq);
+            rc = pthread_mutex_unlock(&osqlpf_mutex);
+            if (rc != 0) {
+                logmsg(LOGMSG_ERROR, "osql_page_prefault: Failed to unlock osqlpf_mutex\n");
+                return 1;
+            }
+            if (ii == NULL) {
+                logmsg(LOGMSG_ERROR, "osql io prefault got a BUG!\n");
+                exit(1);
+            }
+            *iq_step_ix = ii;
         }
-        last_step_idex = *ii;
-        *iq_step_ix = ii;
-        gbl_osqlpf_step[last_step_idex].rqid = rqid;
-        comdb2uuidcpy(gbl_osqlpf_step[last_step_idex].uuid, uuid);
+        step_idex = **iq_step_ix;
+        gbl_osqlpf_step[step_idex].rqid = rqid;
+        gbl_osqlpf_step[step_idex].step = 0;
+        comdb2uuidcpy(gbl_osqlpf_step[step_idex].uuid, uuid);
     }
 
-    switch (rpl_op.type) {
-    case OSQL_USEDB: {
-        osql_usedb_t dt;
-        p_buf = (uint8_t *)&((osql_usedb_rpl_t *)rpl)->dt;
-        char *tablename;
-        struct db *db;
+    /* prefaulting started in the middle of this transaction */
+    if (*iq_step_ix == NULL)
+        return 0;
+    step_idex = **iq_step_ix;
 
-        tablename = (char *)osqlcomm_usedb_type_get(&dt, p_buf, p_buf_end);
+    if (type != OSQL_USEDB && *last_db == NULL)
+        return 0;
 
-        db = getdbbyname(tablename);
-        if (db == NULL) {
-            logmsg(LOGMSG_ERROR, "%s: unable to get usedb for table %.*s\n",
-                    __func__, dt.tablenamelen, tablename);
-        } else {
-            *last_db = db;
-        }
-    } break;
+    switch (type) {
+    case OSQL_USEDB:
+        /* NULL for queues and unknown tables; skip their ops */
+        *last_db = usedb;
+        break;
     case OSQL_DELREC:
     case OSQL_DELETE: {
         osql_del_t dt;
-        p_buf = (uint8_t *)&((osql_del_rpl_t *)rpl)->dt;
         p_buf = (uint8_t *)osqlcomm_del_type_get(&dt, p_buf, p_buf_end,
-                                                 rpl_op.type == OSQL_DELETE);
-        enque_osqlpfault_olddata_oldkeys(*last_db, dt.genid, last_step_idex,
+                                                 type == OSQL_DELETE);
+        enque_osqlpfault_olddata_oldkeys(*last_db, dt.genid, step_idex,
                                          rqid, uuid, seq);
     } break;
     case OSQL_INSREC:
@@ -8627,24 +9173,22 @@ int osql_page_prefault(char *rpl, int rplen, struct db **last_db,
         unsigned char *pData = NULL;
         int rrn = 0;
         unsigned long long genid = 0;
-        uint8_t *p_buf = (uint8_t *)&((osql_ins_rpl_t *)rpl)->dt;
         pData = (uint8_t *)osqlcomm_ins_type_get(&dt, p_buf, p_buf_end,
-                                                 rpl_op.type == OSQL_INSERT);
+                                                 type == OSQL_INSERT);
         enque_osqlpfault_newdata_newkeys(*last_db, pData, dt.nData,
-                                         last_step_idex, rqid, uuid, seq);
+                                         step_idex, rqid, uuid, seq);
     } break;
     case OSQL_UPDREC:
     case OSQL_UPDATE: {
         osql_upd_t dt;
-        uint8_t *p_buf = (uint8_t *)&((osql_upd_rpl_t *)rpl)->dt;
         unsigned char *pData;
         int rrn = 2;
         unsigned long long genid;
         pData = (uint8_t *)osqlcomm_upd_type_get(&dt, p_buf, p_buf_end,
-                                                 rpl_op.type == OSQL_UPDATE);
+                                                 type == OSQL_UPDATE);
         genid = dt.genid;
         enque_osqlpfault_olddata_oldkeys_newkeys(*last_db, dt.genid, pData,
-                                                 dt.nData, last_step_idex, rqid,
+                                                 dt.nData, step_idex, rqid,
                                                  uuid, seq);
     } break;
     default:
@@ -198,6 +198,25 @@ int osql_send_commit_by_uuid(char *tohost, uuid_t uuid, int nops,
                              struct client_query_stats *query_stats,
                              snap_uid_t *snap_info);
 
+/**
+ * Sends the row replies a session has batched so far (osql_batch_bytes)
+ * Returns non-zero if this or an earlier flush of the session failed
+ *
+ */
+int osql_comm_flush_batch(struct sqlclntstate *clnt);
+
+/**
+ * Drops the batched row replies of a session that restarts or rolls back
+ *
+ */
+void osql_comm_discard_batch(struct sqlclntstate *clnt);
+
+/**
+ * Frees the session batch
+ *
+ */
+void osql_comm_free_batch(struct sqlclntstate *clnt);
+
 /**
  * Send decomission for osql net
  *
@@ -227,6 +246,15 @@ int osql_process_packet(struct ireq *iq, unsigned long long rqid, uuid_t uuid,
                         int **updCols, blob_buffer_t blobs[MAXBLOBS], int step,
                         struct block_err *err, int *receivedrows, SBUF2 *logsb);
 
+/**
+ * Decodes the type of a bplog packet without applying it.
+ * For OSQL_USEDB, *usedb is set to the table being switched to
+ * (NULL for queues and unknown tables)
+ *
+ */
+int osql_packet_type(unsigned long long rqid, char *msg, int msglen,
+                     struct db **usedb);
+
 /**
  * Sends a user command to offload net (used by "osqlnet")
  *
@@ -414,5 +442,12 @@ int osql_page_prefault(char *rpl, int rplen, struct db **last_db,
                        int **iq_step_ix, unsigned long long rqid, uuid_t uuid,
                        unsigned long long seq);
 
+/**
+ * Print how many bplog prefault requests read their pages ahead of
+ * the block processor
+ *
+ */
+void osql_page_prefault_stats(void);
+
 int osql_close_connection(char *host);
 #endif
@@ -418,6 +418,9 @@ int osql_sock_start(struct sqlclntstate *clnt, int type, int keep_rqid)
     osql->xerr.errval = 0;
     osql->xerr.errstr[0] = '\0';
 
+    /* replies batched for an earlier attempt do not belong to this one */
+    osql_comm_discard_batch(clnt);
+
 #ifdef DEBUG
     if (gbl_debug_sql_opcodes) {
         uuidstr_t us;
@@ -500,6 +503,9 @@ retry:
     else
         flags = 0;
 
+    if (clnt->bulk_load)
+        flags |= OSQL_FLAGS_BULK_LOAD;
+
     /* send request to blockprocessor */
     rc = osql_comm_send_socksqlreq(osql->host, clnt->sql, strlen(clnt->sql) + 1,
                                    osql->rqid, osql->uuid, clnt->tzname, type,
@@ -1278,6 +1284,14 @@ static int osql_send_commit_logic(struct sqlclntstate *clnt, int nettype)
         }
     }
 
+    /* the master must have every row before it sees DONE */
+    rc = osql_comm_flush_batch(clnt);
+    if (rc) {
+        logmsg(LOGMSG_ERROR, "%s: failed to send batched rows rc=%d\n",
+               __func__, rc);
+        return rc;
+    }
+
 retry:
     if (osql->rqid == OSQL_RQID_USE_UUID) {
         rc = osql_send_commit_by_uuid(osql->host, osql->uuid, osql->sentops,
@@ -1314,6 +1328,8 @@ static int osql_send_abort_logic(struct sqlclntstate *clnt, int nettype)
              "sql session %llu %s rollback", osql->rqid,
              comdb2uuidstr(osql->uuid, us));
 
+    osql_comm_discard_batch(clnt);
+
     if (osql->rqid == OSQL_RQID_USE_UUID)
         rc = osql_send_commit_by_uuid(osql->host, osql->uuid, 0, &xerr, nettype,
                                       osql->logsb, clnt->query_stats, NULL);
@@ -78,6 +78,7 @@ extern int __berkdb_fsync_alarm_ms;
 #include "ssl_bend.h"
 
 #include <trigger.h>
+#include "sp.h"
 #include <sc_stripes.h>
 #include <sc_global.h>
 #include <logmsg.h>
@@ -238,6 +239,7 @@ static const char *HELP_STAT[] = {
     "stat rmtpol #              - remote policy for given machine number",
     "stat thr                   - dump all registered threads",
     "stat dumpsql               - running sql statements",
+    "stat lua                   - lua vm pool and bytecode cache",
     "stat size                  - database ondisk size info",
     "stat ixstat                - index usage stats",
     "stat cursors               - cursor mode stats",
@@ -1286,6 +1288,7 @@ int process_command(struct dbenv *dbenv, char *line, int lline, int st)
            logmsg(LOGMSG_USER, "Osql io prefault is DISABLED\n");
         }
         thdpool_print_stats(stdout, gbl_osqlpfault_thdpool);
+        osql_page_prefault_stats();
     } else if (tokcmp(tok, ltok, "enable_prefault_udp") == 0) {
         if (gbl_prefault_udp) {
            logmsg(LOGMSG_USER, "prefault upd was already enabled on this node\n");
@@ -2098,6 +2101,8 @@ int process_command(struct dbenv *dbenv, char *line, int lline, int st)
             thdpool_print_stats(stdout, gbl_pgcompact_thdpool);
         } else if (tokcmp(tok, ltok, "dumpsql") == 0) {
             sql_dump_running_statements();
+        } else if (tokcmp(tok, ltok, "lua") == 0) {
+            sp_cache_stats();
         } else if (tokcmp(tok, ltok, "rep") == 0) {
             replication_stats(dbenv);
         } else if (tokcmp(tok, ltok, "long") == 0) {
@@ -2229,6 +2234,9 @@ int process_command(struct dbenv *dbenv, char *line, int lline, int st)
             logmsg(LOGMSG_USER, "readonly                %c\n", gbl_readonly ? 'Y' : 'N');
             logmsg(LOGMSG_USER, "num sql queries         %u\n", gbl_nsql);
             logmsg(LOGMSG_USER, "num new sql queries     %u\n", gbl_nnewsql);
+            logmsg(LOGMSG_USER, "sql stmt cache hits %lld adds %lld\n",
+                   (long long)gbl_sql_stmt_cache_hits,
+                   (long long)gbl_sql_stmt_cache_adds);
             logmsg(LOGMSG_USER, "sql ticks               %llu\n", gbl_sqltick);
             logmsg(LOGMSG_USER, "sql deadlocks recover attempts %llu failures %llu\n",
                    gbl_sql_deadlock_reconstructions, gbl_sql_deadlock_failures);
@@ -71,6 +71,10 @@ static int check_blob_buffers(struct ireq *iq, blob_buffer_t *blobs,
                               void *record, const void *nulls);
 
 void free_cached_idx(uint8_t * *cached_idx);
+static int sorted_keys_push(struct sorted_keys *sk, struct db *db, int ixnum,
+                            const void *key, int keylen,
+                            unsigned long long genid, int rrn, int blkpos,
+                            const void *dta, int dtalen);
 
 /*
  * Add a record:
@@ -511,9 +515,14 @@ add_record_int(struct ireq *iq, void *trans, const uint8_t *p_buf_tag_name,
             if (iq->osql_step_ix)
                 gbl_osqlpf_step[*(iq->osql_step_ix)].step += 2;
 
-            /* add the key */
-            rc = ix_addk(iq, trans, key, ixnum, *genid, *rrn, od_dta_tail,
-                         od_len_tail);
+            /* add the key, or keep it for the caller to add sorted */
+            if ((flags & RECFLAGS_SORTED_KEYS) && iq->sorted_keys)
+                rc = sorted_keys_push(iq->sorted_keys, iq->usedb, ixnum, key,
+                                      ixkeylen, *genid, *rrn, blkpos,
+                                      od_dta_tail, od_len_tail);
+            else
+                rc = ix_addk(iq, trans, key, ixnum, *genid, *rrn, od_dta_tail,
+                             od_len_tail);
             if (iq->debug) {
                 reqprintf(iq, "ix_addk IX %d LEN %u KEY ", ixnum, ixkeylen);
                 reqdumphex(iq, key, ixkeylen);
@@ -3229,3 +3238,148 @@ void testrep(int niter, int recsz)
 done:
     free(stuff);
 }
+
+/* Index keys collected by add_record() under RECFLAGS_SORTED_KEYS.  They are
+ * added in key order by sorted_keys_add(), so a btree fills its pages left to
+ * right instead of splitting them at random. */
+struct sorted_key {
+    struct db *db;
+    int ixnum;
+    int keylen;
+    int dtalen; /* datacopy tail stored after the key */
+    int rrn;
+    int blkpos;
+    unsigned long long genid;
+    size_t off; /* offset of the key in buf */
+    const char *key;
+};
+
+struct sorted_keys {
+    struct sorted_key *keys;
+    int nkeys, maxkeys;
+    char *buf;
+    size_t used, alloc;
+};
+
+struct sorted_keys *sorted_keys_create(void)
+{
+    return calloc(1, sizeof(struct sorted_keys));
+}
+
+void sorted_keys_destroy(struct sorted_keys *sk)
+{
+    if (sk) {
+        free(sk->keys);
+        free(sk->buf);
+        free(sk);
+    }
+}
+
+int sorted_keys_count(const struct sorted_keys *sk)
+{
+    return sk->nkeys;
+}
+
+void sorted_keys_reset(struct sorted_keys *sk)
+{
+    sk->nkeys = 0;
+    sk->used = 0;
+}
+
+static int sorted_keys_push(struct sorted_keys *sk, struct db *db, int ixnum,
+                            const void *key, int keylen,
+                            unsigned long long genid, int rrn, int blkpos,
+                            const void *dta, int dtalen)
+{
+    struct sorted_key *k;
+
+    if (dta == NULL || dtalen < 0)
+        dtalen = 0;
+
+    if (sk->nkeys == sk->maxkeys) {
+        int maxkeys = sk->maxkeys ? sk->maxkeys * 2 : 1024;
+        k = realloc(sk->keys, maxkeys * sizeof(struct sorted_key));
+        if (!k)
+            return ERR_INTERNAL;
+        sk->keys = k;
+        sk->maxkeys = maxkeys;
+    }
+    if (sk->used + keylen + dtalen > sk->alloc) {
+        size_t alloc = sk->alloc ? sk->alloc : 65536;
+        char *buf;
+        while (sk->used + keylen + dtalen > alloc)
+            alloc *= 2;
+        buf = realloc(sk->buf, alloc);
+        if (!buf)
+            return ERR_INTERNAL;
+        sk->buf = buf;
+        sk->alloc = alloc;
+    }
+
+    k = &sk->keys[sk->nkeys++];
+    k->db = db;
+    k->ixnum = ixnum;
+    k->keylen = keylen;
+    k->dtalen = dtalen;
+    k->rrn = rrn;
+    k->blkpos = blkpos;
+    k->genid = genid;
+    k->off = sk->used;
+    memcpy(sk->buf + sk->used, key, keylen);
+    if (dtalen)
+        memcpy(sk->buf + sk->used + keylen, dta, dtalen);
+    sk->used += keylen + dtalen;
+    return 0;
+}
+
+static int sorted_key_cmp(const void *p1, const void *p2)
+{
+    const struct sorted_key *k1 = p1, *k2 = p2;
+    int rc;
+
+    if (k1->db != k2->db)
+        return k1->db < k2->db ? -1 : 1;
+    if (k1->ixnum != k2->ixnum)
+        return k1->ixnum < k2->ixnum ? -1 : 1;
+    /* keys of one index have the same length */
+    if ((rc = memcmp(k1->key, k2->key, k1->keylen)) != 0)
+        return rc;
+    return bdb_cmp_genids(k1->genid, k2->genid);
+}
+
+/* Add the collected keys in key order and empty the collection.  On failure
+ * the ix_addk() rcode is returned with the failing key's block position,
+ * index and table (faildb may be NULL), and the transaction has to be
+ * aborted.  iq->usedb is restored either way. */
+int sorted_keys_add(struct ireq *iq, void *trans, struct sorted_keys *sk,
+                    int *blkpos, int *ixfailnum, struct db **faildb)
+{
+    struct db *usedb = iq->usedb;
+    int rc = 0;
+
+    for (int ii = 0; ii < sk->nkeys; ii++)
+        sk->keys[ii].key = sk->buf + sk->keys[ii].off;
+    qsort(sk->keys, sk->nkeys, sizeof(struct sorted_key), sorted_key_cmp);
+
+    for (int ii = 0; ii < sk->nkeys; ii++) {
+        struct sorted_key *k = &sk->keys[ii];
+        iq->usedb = k->db;
+        rc = ix_addk(iq, trans, (void *)k->key, k->ixnum, k->genid, k->rrn,
+                     k->dtalen ? (void *)(k->key + k->keylen) : NULL,
+                     k->dtalen);
+        if (rc) {
+            if (iq->debug)
+                reqprintf(iq, "sorted ix_addk IX %d GENID 0x%llx RC %d",
+                          k->ixnum, k->genid, rc);
+            *blkpos = k->blkpos;
+            *ixfailnum = k->ixnum;
+            if (faildb)
+                *faildb = k->db;
+            break;
+        }
+    }
+
+    iq->usedb = usedb;
+    sorted_keys_reset(sk);
+    return rc;
+}
@@ -70,8 +70,10 @@ enum transaction_level {
 
 #define MAX_HASH_SQL_LENGTH 8192
 
+struct osql_batch;
+
 typedef struct stmt_hash_entry {
-    char sql[MAX_HASH_SQL_LENGTH];
+    char *sql; /* normalized sql, allocated with the entry */
     sqlite3_stmt *stmt;
     char *query;
     struct schema *params_to_bind;
@@ -194,6 +196,7 @@ typedef struct osqlstate {
                             (i.e. already translated */
     int long_request;
     int dirty; /* optimization to nop selectv only transactions */
+    struct osql_batch *batch; /* row replies not yet sent to the master */
 } osqlstate_t;
 
 enum ctrl_sqleng {
@@ -347,6 +350,15 @@ struct sqlclntstate {
     uint8_t ready_for_heartbeats;
     uint8_t no_more_heartbeats;
     uint8_t done;
+    /* more pipelined requests are buffered: hold back response flushes */
+    uint8_t defer_flush;
+    /* array binding: the row of parameters being run, the changes of the
+       rows before it, and whether the rows run in their own transaction */
+    int bind_row;
+    long long bind_changes;
+    uint8_t bind_own_trans;
+    /* rows of the result set waiting to go out in a multi-row frame */
+    struct row_frame *frame;
 
     int using_case_insensitive_like;
     int deadlock_recovered;
@@ -457,6 +469,8 @@ struct sqlclntstate {
     int nrows;
 
     int planner_effort;
+    int parallel_scan; /* max stripe scan threads, see SET PARALLELSCAN */
+    int bulk_load;     /* SET BULKLOAD: inserts add their index keys sorted */
     int osql_max_trans;
     /* read-set validation */
     CurRangeArr *arr;
@@ -623,9 +637,12 @@ struct BtCursor {
     blob_status_t blobs;
 
     bdb_cursor_ifn_t *bdbcur;
+    bdb_stripe_scan_t *stripe_scan; /* parallel full scan, see
+                                       cursor_move_table */
 
     int nmove, nfind, nwrite;
     int nblobs;
+    int nskipcols; /* key columns not converted, see col_mask */
     int num_nexts;
 
     int numblobs;
@@ -687,6 +704,7 @@ struct BtCursor {
 
     unsigned long long col_mask; /* tracking first 63 columns, if bit is set,
                                     column is needed */
+    uint8_t have_col_mask;       /* col_mask was set by the query plan */
 
     unsigned long long keyDdl; /* rowid for side DDL row */
     char *dataDdl;             /* DDL row, cached during CREATE operations */
@@ -716,6 +734,7 @@ struct sql_thread {
     int ntmpwrite;
     int ntmpread;
     int nblobs;
+    int nskipcols;
     int bufsz;
     int id;
     char *buf;
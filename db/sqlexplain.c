@@ -1127,6 +1127,11 @@ static void get_one_explain_line(sqlite3 *hndl, strbuf *out, Vdbe *v,
             strbuf_append(out, ")");
         }
         break;
+    case OP_SorterTopN:
+        strbuf_appendf(out, "Keep only the first %d row(s) written to sorter "
+                            "cursor [%d]",
+                       op->p2, op->p1);
+        break;
     case OP_SorterInsert:
         strbuf_appendf(out, "Write key in R%d into ", op->p2);
         strbuf_appendf(out, "sorter table using cursor [%d]", op->p1);
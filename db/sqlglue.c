@@ -649,6 +649,21 @@ void done_sql_thread(void)
 static int get_data_int(BtCursor *, struct schema *, uint8_t *in, int fnum,
                         Mem *, uint8_t flip_orig, const char *tzname);
 
+extern int gbl_sql_skip_unused_cols;
+
+/* Projection for index cursors: does the query read key column fnum?
+ * Columns that the plan doesn't reference are handed to sqlite as NULLs.
+ * Only read-only cursors are trimmed; writes may need whole keys. */
+static inline int key_field_used(BtCursor *pCur, int fnum)
+{
+    if (!pCur || !pCur->have_col_mask || pCur->writeTransaction ||
+        pCur->cursor_class != CURSORCLASS_INDEX)
+        return 1;
+    if (fnum >= 63)
+        return (pCur->col_mask & (1ULL << 63)) != 0;
+    return (pCur->col_mask & (1ULL << fnum)) != 0;
+}
+
 static int ondisk_to_sqlite_tz(struct db *db, struct schema *s, void *inp,
                                int rrn, unsigned long long genid, void *outp,
                                int maxout, int nblobs, void **blob,
@@ -697,9 +712,16 @@ static int ondisk_to_sqlite_tz(struct db *db, struct schema *s, void *inp,
 
     for (fnum = 0; fnum < nField; fnum++) {
         memset(&m[fnum], 0, sizeof(Mem));
-        rc = get_data_int(pCur, s, in, fnum, &m[fnum], 1, tzname);
-        if (rc)
-            goto done;
+        if (key_field_used(pCur, fnum)) {
+            rc = get_data_int(pCur, s, in, fnum, &m[fnum], 1, tzname);
+            if (rc)
+                goto done;
+        } else {
+            m[fnum].flags = MEM_Null;
+            pCur->nskipcols++;
+            if (pCur->thd)
+                pCur->thd->nskipcols++;
+        }
         type =
             sqlite3VdbeSerialType(&m[fnum], SQLITE_DEFAULT_FILE_FORMAT, &len);
         sz = sqlite3VdbeSerialTypeLen(type);
@@ -773,7 +795,7 @@ done:
     /* revert back the flipped fields */
     for (i = 0; i < nField; i++) {
         f = &s->member[i];
-        if (f->flags & INDEX_DESCEND) {
+        if ((f->flags & INDEX_DESCEND) && key_field_used(pCur, i)) {
             xorbuf(in + f->offset + rec_srt_off, f->len - rec_srt_off);
         }
     }
@@ -2605,6 +2627,73 @@ static int get_matching_genid(BtCursor *cur, int rrn, unsigned long long *genid)
     return 0;
 }
 
+/**
+ * A full scan can be read by a parallel stripe scan when the rows don't have
+ * to come through the bdb cursor: read-only, no shadows or snapshot to merge,
+ * no genids to record and no blobs to fetch later by genid.  Only the first
+ * rewind of a cursor qualifies, so an inner loop rescanning a table doesn't
+ * start threads on every pass.
+ */
+static int use_stripe_scan(BtCursor *pCur, struct sqlclntstate *clnt)
+{
+    return clnt->parallel_scan > 1 && pCur->nfind == 1 &&
+           pCur->cursor_class == CURSORCLASS_TABLE && pCur->db->dtastripe > 1 &&
+           !pCur->writeTransaction && !pCur->is_recording &&
+           pCur->numblobs == 0 && pCur->shadtbl == NULL && !clnt->intrans &&
+           (clnt->dbtran.mode == TRANLEVEL_SOSQL ||
+            clnt->dbtran.mode == TRANLEVEL_RECOM) &&
+           pCur->db->totalsize >=
+               bdb_attr_get(thedb->bdb_attr, BDB_ATTR_PARALLEL_SCAN_MIN_SIZE);
+}
+
+static void close_stripe_scan(BtCursor *pCur)
+{
+    if (pCur->stripe_scan) {
+        bdb_stripe_scan_close(pCur->stripe_scan);
+        pCur->stripe_scan = NULL;
+    }
+}
+
+/**
+ * Helper function for cursor_move_table(): hand out the next row of the
+ * stripe scan.
+ */
+static int cursor_move_stripe_scan(BtCursor *pCur, int *pRes, int how)
+{
+    void *buf;
+    int sz;
+    uint8_t ver;
+    int bdberr;
+    int rc;
+
+    rc = bdb_stripe_scan_next(pCur->stripe_scan, &pCur->genid, &buf, &sz, &ver,
+                              &bdberr);
+    if (rc < 0) {
+        logmsg(LOGMSG_ERROR, "%s: %s bdberr %d\n", __func__,
+               pCur->db->dbname, bdberr);
+        close_stripe_scan(pCur);
+        return bdberr == BDBERR_DEADLOCK ? SQLITE_DEADLOCK : SQLITE_INTERNAL;
+    }
+    if (rc == 0) {
+        if (how == CFIRST)
+            pCur->empty = 1;
+        pCur->eof = 1;
+        *pRes = 1;
+        return SQLITE_OK;
+    }
+
+    vtag_to_ondisk_vermap(pCur->db, buf, &sz, ver);
+    if (sz > getdatsize(pCur->db)) {
+        logmsg(LOGMSG_ERROR, "%s: incorrect datsize %d\n", __func__, sz);
+        return SQLITE_INTERNAL;
+    }
+    pCur->rrn = 2;
+    pCur->dtabuf = buf;
+    pCur->empty = 0;
+    *pRes = 0;
+    return SQLITE_OK;
+}
+
 static int cursor_move_table(BtCursor *pCur, int *pRes, int how)
 {
     struct sql_thread *thd = pCur->thd;
@@ -2636,6 +2725,23 @@ static int cursor_move_table(BtCursor *pCur, int *pRes, int how)
     if (thd)
         thd->had_tablescans = 1;
 
+    if (pCur->stripe_scan) {
+        if (how == CNEXT) {
+            thd->nmove++;
+            return cursor_move_stripe_scan(pCur, pRes, how);
+        }
+        close_stripe_scan(pCur);
+    }
+    if (how == CFIRST && use_stripe_scan(pCur, clnt)) {
+        pCur->stripe_scan = bdb_stripe_scan_open(
+            pCur->db->handle, clnt->parallel_scan, &bdberr);
+        if (pCur->stripe_scan) {
+            thd->nmove++;
+            return cursor_move_stripe_scan(pCur, pRes, how);
+        }
+        /* fall back to the bdb cursor */
+    }
+
     iq.dbenv = thedb;
     iq.is_fake = 1;
     iq.usedb = pCur->db;
@@ -5720,6 +5826,7 @@ int sqlite3BtreeMovetoUnpacked(BtCursor *pCur, /* The cursor to be moved */
     /* we may move the cursor in a way that would invalidate any serialized
      * cursor we may have */
     bdb_cursor_ser_invalidate(&pCur->cur_ser);
+    close_stripe_scan(pCur);
 
     if (access_control_check_sql_read(pCur, thd)) {
         rc = SQLITE_ACCESS;
@@ -6484,6 +6591,7 @@ skip:
             free(pCur->tmptable);
         }
 
+        close_stripe_scan(pCur);
         if (pCur->bdbcur) {
             /* opened a real cursor? close it */
             bdberr = 0;
@@ -9349,6 +9457,9 @@ static int recover_deadlock_int(bdb_state_type *bdb_state,
     if (thd->bt) {
         LISTC_FOR_EACH(&thd->bt->cursors, cur, lnk)
         {
+            /* its workers read under our curtran and table locks */
+            if (cur->stripe_scan)
+                bdb_stripe_scan_pause(cur->stripe_scan);
             if (cur->bdbcur) {
                 if (cur->bdbcur->unlock(cur->bdbcur, &bdberr))
                     ctrace("%s: cur ixnum=%d bdberr = %d [1]\n", __func__,
@@ -10604,6 +10715,7 @@ int sqlite3BtreeCursorRestore(BtCursor *pCur, int *pDifferentRow)
 }
 
 int gbl_direct_count = 1;
+int gbl_sql_skip_unused_cols = 1;
 
 /*
  ** The first argument, pCur, is a cursor opened on some b-tree. Count the
@@ -11730,6 +11842,7 @@ void sqlite3RegisterDateTimeFunctions(void) {}
 void sqlite3BtreeCursorSetFieldUsed(BtCursor *pCur, unsigned long long mask)
 {
     pCur->col_mask = mask;
+    pCur->have_col_mask = gbl_sql_skip_unused_cols;
 }
 
 void clearClientSideRow(struct sqlclntstate *clnt)
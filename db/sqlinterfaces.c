@@ -25,6 +25,7 @@
 #include <errno.h>
 #include <string.h>
 #include <stddef.h>
+#include <ctype.h>
 #include <pthread.h>
 #include <sys/types.h>
 #include <util.h>
@@ -105,6 +106,11 @@
 #include "mem.h"
 #include "comdb2_atomic.h"
 #include "logmsg.h"
+#include <lz4.h>
+
+#if LZ4_VERSION_NUMBER < 10701
+#define LZ4_compress_default LZ4_compress_limitedOutput
+#endif
 
 /* delete this after comdb2_api.h changes makes it through */
 #define SQLHERR_MASTER_QUEUE_FULL -108
@@ -195,6 +201,7 @@ void send_prepare_error(struct sqlclntstate *clnt, const char *errstr,
 static int send_err_but_msg(struct sqlclntstate *clnt, const char *errstr,
                             int irc);
 static int flush_row(struct sqlclntstate *clnt);
+static int row_frame_send(struct sqlclntstate *clnt);
 static int send_dummy(struct sqlclntstate *clnt);
 static void send_last_row(struct sqlthdstate *thd, struct sqlclntstate *clnt,
                           const char *func, int line);
@@ -742,7 +749,8 @@ int fsql_write_response(struct sqlclntstate *clnt, struct fsqlresp *resp,
                 return -1;
             }
 
-            sbuf2flush(sb);
+            if (!clnt->defer_flush)
+                sbuf2flush(sb);
             rc = pthread_mutex_unlock(&clnt->write_lock);
             if (rc != 0) {
                 logmsg(LOGMSG_FATAL, "couldnt get clnt->write_lock\n");
@@ -798,7 +806,7 @@ int fsql_write_response(struct sqlclntstate *clnt, struct fsqlresp *resp,
         }
     }
 
-    if (flush) {
+    if (flush && !clnt->defer_flush) {
         sbuf2flush(sb);
     }
 
@@ -900,7 +908,7 @@ int newsql_write_response(struct sqlclntstate *clnt, int type,
         }
     }
 
-    if (flush) {
+    if (flush && (!clnt->defer_flush || type == FSQL_HEARTBEAT)) {
         sbuf2flush(sb);
     }
 
@@ -1489,11 +1497,15 @@ static void sql_statement_done(struct sql_thread *thd, struct reqlogger *logger,
     if (rqid) {
         reqlog_logf(logger, REQL_INFO, "rqid=%llx", rqid);
     }
+    if (thd->nskipcols) {
+        reqlog_logf(logger, REQL_INFO, "skipped_cols=%d", thd->nskipcols);
+    }
 
     reqlog_set_vreplays(logger, clnt->verify_retries);
     reqlog_end_request(logger, stmt_rc, __func__, __LINE__);
 
     thd->nmove = thd->nfind = thd->nwrite = thd->ntmpread = thd->ntmpwrite = 0;
+    thd->nskipcols = 0;
 
     if (thd->sqlclntstate->conninfo.pename[0]) {
         h->conn = thd->sqlclntstate->conninfo;
@@ -2488,18 +2500,69 @@ done:
     return outrc;
 }
 
-static int strcmpfunc_stmt(char *a, char *b, int len) { return strcmp(a, b); }
+static int strcmpfunc_stmt(char **a, char **b, int len)
+{
+    return strcmp(*a, *b);
+}
 
-static u_int strhashfunc_stmt(u_char *keyp, int len)
+static u_int strhashfunc_stmt(u_char **keyp, int len)
 {
     unsigned hash;
-    int jj;
-    u_char *key = keyp;
+    u_char *key = *keyp;
     for (hash = 0; *key; key++)
         hash = ((hash % 8388013) << 8) + ((*key));
     return hash;
 }
 
+/* Statement cache counters, summed over all sql threads.  Every sql thread
+ * compiles into its own sqlite connection and a compiled program points into
+ * that connection's schema, so nothing but these counts is shared. */
+int64_t gbl_sql_stmt_cache_hits;
+int64_t gbl_sql_stmt_cache_adds;
+
+/* Collapse runs of whitespace outside quotes and trim both ends, so queries
+ * that only differ in formatting share a cache entry.  Text with comments
+ * is left alone: a newline may be what ends a comment. */
+static int normalize_stmt_sql(const char *sql, char *out, int outlen)
+{
+    const char *in = sql;
+    char quote = 0;
+    int len = 0;
+    int space = 0;
+
+    while (isspace((unsigned char)*in))
+        in++;
+    for (; *in; in++) {
+        if (quote) {
+            if (*in == quote)
+                quote = 0;
+        } else if (*in == '\'' || *in == '"' || *in == '`') {
+            quote = *in;
+        } else if (*in == '[') {
+            quote = ']';
+        } else if ((in[0] == '-' && in[1] == '-') ||
+                   (in[0] == '/' && in[1] == '*')) {
+            len = strlen(sql);
+            if (len >= outlen)
+                return -1;
+            memcpy(out, sql, len + 1);
+            return len;
+        } else if (isspace((unsigned char)*in)) {
+            space = 1;
+            continue;
+        }
+        if (len + space + 1 >= outlen)
+            return -1;
+        if (space) {
+            out[len++] = ' ';
+            space = 0;
+        }
+        out[len++] = *in;
+    }
+    out[len] = 0;
+    return len;
+}
+
 static int finalize_stmt_hash(void *stmt_entry, void *args)
 {
     stmt_hash_entry_type *entry = (stmt_hash_entry_type *)stmt_entry;
@@ -2525,9 +2588,10 @@ static void delete_stmt_table(hash_t *stmt_table)
 
 static void init_stmt_table(hash_t **stmt_table)
 {
-    *stmt_table =
-        hash_init_user((hashfunc_t *)strhashfunc_stmt,
-                       (cmpfunc_t *)strcmpfunc_stmt, 0, MAX_HASH_SQL_LENGTH);
+    *stmt_table = hash_init_user((hashfunc_t *)strhashfunc_stmt,
+                                 (cmpfunc_t *)strcmpfunc_stmt,
+                                 offsetof(stmt_hash_entry_type, sql),
+                                 sizeof(char *));
 }
 
 void touch_stmt_entry(struct sqlthdstate *thd, stmt_hash_entry_type *entry)
@@ -2535,6 +2599,8 @@ void touch_stmt_entry(struct sqlthdstate *thd, stmt_hash_entry_type *entry)
     stmt_hash_entry_type **tail = NULL;
     stmt_hash_entry_type **head = NULL;
 
+    ATOMIC_ADD(gbl_sql_stmt_cache_hits, 1);
+
     if (entry->params_to_bind) {
         tail = &thd->param_stmt_tail;
         head = &thd->param_stmt_head;
@@ -2587,7 +2653,7 @@ static void delete_last_stmt_entry(struct sqlthdstate *thd,
         has_params = 1;
         free_tag_schema((*tail)->params_to_bind);
     }
-    hash_del(stmt_table, (*tail)->sql);
+    hash_del(stmt_table, *tail);
     entry->next = NULL;
     sqlite3_free(*tail);
     *tail = entry;
@@ -2602,7 +2668,8 @@ int add_stmt_table(struct sqlthdstate *thd, const char *sql, char *actual_sql,
                    sqlite3_stmt *stmt, struct schema *params_to_bind)
 {
     int ret = -1;
-    int len = strlen(sql);
+    char *key = alloca(MAX_HASH_SQL_LENGTH);
+    int len;
 
     stmt_hash_entry_type **tail = NULL;
     stmt_hash_entry_type **head = NULL;
@@ -2618,10 +2685,12 @@ int add_stmt_table(struct sqlthdstate *thd, const char *sql, char *actual_sql,
         head = &thd->noparam_stmt_head;
     }
 
-    if (len < MAX_HASH_SQL_LENGTH) {
+    if ((len = normalize_stmt_sql(sql, key, MAX_HASH_SQL_LENGTH)) >= 0) {
+        /* the key text lives right after the entry */
         stmt_hash_entry_type *entry =
-            sqlite3_malloc(sizeof(stmt_hash_entry_type));
-        strcpy(entry->sql, sql);
+            sqlite3_malloc(sizeof(stmt_hash_entry_type) + len + 1);
+        entry->sql = (char *)(entry + 1);
+        memcpy(entry->sql, key, len + 1);
         entry->stmt = stmt;
         entry->params_to_bind = params_to_bind;
         if (actual_sql && gbl_debug_temptables)
@@ -2646,6 +2715,10 @@ int add_stmt_table(struct sqlthdstate *thd, const char *sql, char *actual_sql,
             } else {
                 thd->noparam_cache_entries++;
             }
+            ATOMIC_ADD(gbl_sql_stmt_cache_adds, 1);
+        } else {
+            free(entry->query);
+            sqlite3_free(entry);
         }
     } else {
         sqlite3_finalize(stmt);
@@ -2656,8 +2729,11 @@ int add_stmt_table(struct sqlthdstate *thd, const char *sql, char *actual_sql,
 int find_stmt_table(hash_t *stmt_table, const char *sql,
                     stmt_hash_entry_type **entry)
 {
-    if (strlen(sql) < MAX_HASH_SQL_LENGTH) {
-        *entry = hash_find(stmt_table, sql);
+    char *key = alloca(MAX_HASH_SQL_LENGTH);
+
+    *entry = NULL;
+    if (normalize_stmt_sql(sql, key, MAX_HASH_SQL_LENGTH) >= 0) {
+        *entry = hash_find(stmt_table, &key);
         if (*entry)
             return 0;
     }
@@ -3520,6 +3596,7 @@ void query_stats_setup(struct sqlthdstate *thd, struct sqlclntstate *clnt)
     thd->sqlthd->startms = time_epochms();
     thd->sqlthd->stime = time_epoch();
     thd->sqlthd->nmove = thd->sqlthd->nfind = thd->sqlthd->nwrite = 0;
+    thd->sqlthd->nskipcols = 0;
 
     /* reqlog */
     setup_reqlog_new_sql(thd, clnt);
@@ -4013,6 +4090,34 @@ static int check_client_specified_conversions(struct sqlthdstate *thd,
     return 0;
 }
 
+/* Number of rows of parameters bound to a newsql request.  The statement
+ * runs once for each row (see step_bind_rows). */
+static int bind_nrows(struct sqlclntstate *clnt)
+{
+    if (!clnt->is_newsql || !clnt->sql_query ||
+        !clnt->sql_query->has_bind_rows || clnt->sql_query->bind_rows < 1)
+        return 1;
+    return clnt->sql_query->bind_rows;
+}
+
+static int bind_row(struct sqlclntstate *clnt, sqlite3_stmt *stmt, int row,
+                    char **errstr)
+{
+    CDB2SQLQUERY rowquery = *clnt->sql_query;
+    int nrows = bind_nrows(clnt);
+
+    if (rowquery.n_bindvars % nrows) {
+        *errstr = sqlite3_mprintf("%d values can't be split into %d rows",
+                                  rowquery.n_bindvars, nrows);
+        return -1;
+    }
+    rowquery.n_bindvars /= nrows;
+    rowquery.bindvars += row * rowquery.n_bindvars;
+
+    return bind_parameters(stmt, NULL, &rowquery, NULL, NULL, 0, NULL, NULL,
+                           clnt->tzname, gbl_dump_sql_dispatched, errstr);
+}
+
 static int bind_params(struct sqlthdstate *thd, struct sqlclntstate *clnt,
                        struct sql_state *rec, struct errstat *err)
 {
@@ -4022,9 +4127,7 @@ static int bind_params(struct sqlthdstate *thd, struct sqlclntstate *clnt,
     if (rec->parameters_to_bind ||
         (clnt->is_newsql && clnt->sql_query && clnt->sql_query->n_bindvars)) {
         if (clnt->is_newsql) {
-            rc = bind_parameters(rec->stmt, NULL, clnt->sql_query, NULL, NULL,
-                                 0, NULL, NULL, clnt->tzname,
-                                 gbl_dump_sql_dispatched, &errstr);
+            rc = bind_row(clnt, rec->stmt, 0, &errstr);
         } else {
             rc = bind_parameters(rec->stmt, rec->parameters_to_bind, NULL,
                                  clnt->tagbuf, clnt->nullbits, clnt->numblobs,
@@ -4828,6 +4931,180 @@ static void *blob_alloc_override(size_t len)
     return comdb2_bmalloc(blobmem, len + 1);
 }
 
+/* Rows held back to go to the client in one multi-row frame, column by
+ * column (see the frame layout in sqlresponse.proto) */
+struct row_frame_col {
+    uint8_t *nulls;
+    uint32_t *lens;
+    char *data;
+    int datalen;
+    int datasz;
+};
+
+struct row_frame {
+    int ncols;
+    int nrows;
+    int maxrows;
+    int nbytes;
+    int lz4;
+    struct row_frame_col cols[1];
+};
+
+static void row_frame_free(struct sqlclntstate *clnt)
+{
+    struct row_frame *f = clnt->frame;
+    if (!f)
+        return;
+    for (int i = 0; i < f->ncols; i++) {
+        free(f->cols[i].nulls);
+        free(f->cols[i].lens);
+        free(f->cols[i].data);
+    }
+    free(f);
+    clnt->frame = NULL;
+}
+
+/* Frame the rows of this result set if the client reads frames.  A retried
+ * query sends its rows one by one, as they carry row ids. */
+static void row_frame_init(struct sqlclntstate *clnt, int ncols)
+{
+    struct row_frame *f;
+    int frames = 0, lz4 = 0;
+
+    clnt->frame = NULL;
+    if (!clnt->is_newsql || !clnt->isselect || clnt->num_retry ||
+        gbl_newsql_frame_rows <= 1 || ncols <= 0)
+        return;
+    for (int ii = 0; ii < clnt->sql_query->n_features; ii++) {
+        if (clnt->sql_query->features[ii] == CDB2_CLIENT_FEATURES__ROW_FRAMES)
+            frames = 1;
+        else if (clnt->sql_query->features[ii] ==
+                 CDB2_CLIENT_FEATURES__ROW_FRAMES_LZ4)
+            lz4 = 1;
+    }
+    if (!frames)
+        return;
+
+    f = calloc(1, offsetof(struct row_frame, cols) +
+                      ncols * sizeof(struct row_frame_col));
+    if (!f)
+        return;
+    f->ncols = ncols;
+    f->maxrows = gbl_newsql_frame_rows;
+    f->lz4 = lz4;
+    clnt->frame = f;
+    for (int i = 0; i < ncols; i++) {
+        f->cols[i].nulls = calloc((f->maxrows + 7) / 8, 1);
+        f->cols[i].lens = malloc(f->maxrows * sizeof(uint32_t));
+        if (!f->cols[i].nulls || !f->cols[i].lens) {
+            f->ncols = i + 1;
+            row_frame_free(clnt);
+            return;
+        }
+    }
+}
+
+/* Send the rows of the frame, if any */
+static int row_frame_send(struct sqlclntstate *clnt)
+{
+    CDB2SQLRESPONSE sql_response = CDB2__SQLRESPONSE__INIT;
+    struct row_frame *f = clnt->frame;
+    char *raw, *cmp = NULL, *p;
+    int rawlen = 0, nullsz, clen = 0;
+    int rc;
+
+    if (!f || f->nrows == 0)
+        return 0;
+
+    nullsz = (f->nrows + 7) / 8;
+    for (int i = 0; i < f->ncols; i++)
+        rawlen += nullsz + f->nrows * sizeof(uint32_t) + f->cols[i].datalen;
+    raw = p = malloc(rawlen);
+    if (!raw)
+        return -1;
+    for (int i = 0; i < f->ncols; i++) {
+        struct row_frame_col *c = &f->cols[i];
+        memcpy(p, c->nulls, nullsz);
+        p += nullsz;
+        memcpy(p, c->lens, f->nrows * sizeof(uint32_t));
+        p += f->nrows * sizeof(uint32_t);
+        memcpy(p, c->data, c->datalen);
+        p += c->datalen;
+        memset(c->nulls, 0, nullsz);
+        c->datalen = 0;
+    }
+
+    if (f->lz4) {
+        int bound = LZ4_compressBound(rawlen);
+        cmp = malloc(bound);
+        if (cmp)
+            clen = LZ4_compress_default(raw, cmp, rawlen, bound);
+    }
+    sql_response.has_frame = 1;
+    if (clen > 0 && clen < rawlen) {
+        sql_response.frame.data = (uint8_t *)cmp;
+        sql_response.frame.len = clen;
+        sql_response.has_frame_rawlen = 1;
+        sql_response.frame_rawlen = rawlen;
+    } else {
+        sql_response.frame.data = (uint8_t *)raw;
+        sql_response.frame.len = rawlen;
+    }
+    sql_response.has_frame_rows = 1;
+    sql_response.frame_rows = f->nrows;
+    f->nrows = 0;
+    f->nbytes = 0;
+
+    _has_snapshot(clnt, sql_response);
+
+    rc = _push_row_new(clnt, RESPONSE_TYPE__COLUMN_VALUES, &sql_response, NULL,
+                       0, (sql_response.frame.len + 1 > gbl_blob_sz_thresh_bytes)
+                              ? blob_alloc_override
+                              : malloc,
+                       0);
+    free(cmp);
+    free(raw);
+    return rc;
+}
+
+/* Add the row in thd->buf to the frame, and send the frame once it is full */
+static int row_frame_add(struct sqlthdstate *thd, struct sqlclntstate *clnt,
+                         int ncols)
+{
+    struct row_frame *f = clnt->frame;
+    int row = f->nrows;
+
+    for (int i = 0; i < ncols; i++) {
+        struct row_frame_col *c = &f->cols[i];
+        int len = thd->offsets[i].len;
+        if (len == -1) {
+            c->nulls[row / 8] |= 1 << (row % 8);
+            c->lens[row] = 0;
+            continue;
+        }
+        if (c->datalen + len > c->datasz) {
+            int sz = c->datasz ? c->datasz : 1024;
+            char *data;
+            while (sz < c->datalen + len)
+                sz *= 2;
+            data = realloc(c->data, sz);
+            if (!data)
+                return -1;
+            c->data = data;
+            c->datasz = sz;
+        }
+        memcpy(c->data + c->datalen, thd->buf + thd->offsets[i].offset, len);
+        c->datalen += len;
+        c->lens[row] = htonl(len);
+        f->nbytes += len;
+    }
+    f->nrows++;
+
+    if (f->nrows >= f->maxrows || f->nbytes >= gbl_newsql_frame_bytes)
+        return row_frame_send(clnt);
+    return 0;
+}
+
 static int send_row_new(struct sqlthdstate *thd, struct sqlclntstate *clnt,
                         int ncols, int row_id,
                         CDB2SQLRESPONSE__Column **columns)
@@ -4906,7 +5183,8 @@ static int send_row(struct sqlthdstate *thd, struct sqlclntstate *clnt,
         if (!rc && (clnt->num_retry == clnt->sql_query->retry) &&
                 (clnt->num_retry == 0 || clnt->sql_query->has_skip_rows == 0 ||
                  (clnt->sql_query->skip_rows < row_id)))
-            irc = send_row_new(thd, clnt, ncols, row_id, columns);
+            irc = clnt->frame ? row_frame_add(thd, clnt, ncols)
+                              : send_row_new(thd, clnt, ncols, row_id, columns);
     } else {
         irc = send_row_old(thd, clnt, new_row_data_type);
     }
@@ -4916,6 +5194,8 @@ static int send_row(struct sqlthdstate *thd, struct sqlclntstate *clnt,
 static int flush_row(struct sqlclntstate *clnt)
 {
     if (gbl_sqlflush_freq && clnt->recno % gbl_sqlflush_freq == 0) {
+        if (row_frame_send(clnt))
+            return -1;
         if (fsql_write_response(clnt, NULL, NULL, 0, 1, __func__,
                                 __LINE__) < 0)
             return -1;
@@ -5041,6 +5321,10 @@ static int post_sqlite_processing(struct sqlthdstate *thd,
     int rc;
     test_no_btcursors(thd);
 
+    /* the rows still in the frame go before anything else */
+    if (row_frame_send(clnt))
+        return -1;
+
     if (clnt->client_understands_query_stats) {
         record_query_cost(thd->sqlthd, clnt);
         if(comm->send_cost)
@@ -5109,6 +5393,82 @@ static int post_sqlite_processing(struct sqlthdstate *thd,
     return 0;
 }
 
+/* Step a statement bound to several rows of parameters: once a row is done,
+ * bind the next one and carry on, so all the rows run through the same
+ * prepared statement.  Outside a client transaction, the rows run in one
+ * transaction that the last row commits.  The rows changed by each write
+ * are added up into the count row of the last one. */
+static int step_bind_rows(struct sqlthdstate *thd, struct sqlclntstate *clnt,
+                          sqlite3_stmt *stmt)
+{
+    int nrows = bind_nrows(clnt);
+    char *errstr = NULL;
+    int rc;
+
+    while (1) {
+        rc = sqlite3_step(stmt);
+        if (clnt->bind_row >= nrows - 1) {
+            if (rc == SQLITE_ROW && clnt->bind_changes && !clnt->isselect) {
+                Vdbe *v = (Vdbe *)stmt;
+                sqlite3VdbeMemSetInt64(&v->pResultSet[0],
+                                       sqlite3_column_int64(stmt, 0) +
+                                           clnt->bind_changes);
+            }
+            return rc;
+        }
+
+        if (rc == SQLITE_ROW) {
+            if (clnt->isselect)
+                return rc;
+            /* count row of a write */
+            clnt->bind_changes += sqlite3_column_int64(stmt, 0);
+            continue;
+        }
+        if (rc != SQLITE_DONE)
+            return rc;
+
+        clnt->bind_row++;
+        sqlite3_reset(stmt);
+        if (bind_row(clnt, stmt, clnt->bind_row, &errstr)) {
+            /* reported to the client like any failed step */
+            sqlite3ErrorWithMsg(thd->sqldb, SQLITE_ERROR, "row %d: %s",
+                                clnt->bind_row, errstr ? errstr : "");
+            sqlite3_free(errstr);
+            return SQLITE_ERROR;
+        }
+
+        if (clnt->bind_own_trans && clnt->bind_row == nrows - 1) {
+            if (clnt->ctrl_sqlengine == SQLENG_INTRANS_STATE)
+                sql_set_sqlengine_state(clnt, __FILE__, __LINE__,
+                                        SQLENG_FNSH_STATE);
+            else
+                sql_set_sqlengine_state(clnt, __FILE__, __LINE__,
+                                        SQLENG_NORMAL_PROCESS);
+        }
+    }
+}
+
+/* Roll back the transaction of the parameter rows if the last row didn't
+ * get to commit it */
+static void end_bind_rows(struct sqlthdstate *thd, struct sqlclntstate *clnt)
+{
+    if (!clnt->bind_own_trans)
+        return;
+    clnt->bind_own_trans = 0;
+
+    if (clnt->ctrl_sqlengine == SQLENG_NORMAL_PROCESS)
+        return;
+
+    if (clnt->intrans) {
+        sql_set_sqlengine_state(clnt, __FILE__, __LINE__,
+                                SQLENG_FNSH_RBK_STATE);
+        sqlite3BtreeRollback(thd->sqldb->aDb[0].pBt, 0, 0);
+    }
+    if (clnt->ctrl_sqlengine != SQLENG_NORMAL_PROCESS)
+        sql_set_sqlengine_state(clnt, __FILE__, __LINE__,
+                                SQLENG_NORMAL_PROCESS);
+}
+
 /* The design choice here for communication is to send row data inside this function,
    and delegate the error sending to the caller (since we send multiple rows, but we 
    send error only once and stop processing at that time)
@@ -5132,11 +5492,21 @@ static int run_stmt(struct sqlthdstate *thd, struct sqlclntstate *clnt,
     reqlog_set_event(thd->logger, "sql");
     run_stmt_setup(clnt, rec);
 
+    clnt->frame = NULL;
+    clnt->bind_row = 0;
+    clnt->bind_changes = 0;
+    if (bind_nrows(clnt) > 1 && !clnt->isselect &&
+        clnt->ctrl_sqlengine == SQLENG_NORMAL_PROCESS) {
+        /* as if the client had sent a begin */
+        sql_set_sqlengine_state(clnt, __FILE__, __LINE__, SQLENG_STRT_STATE);
+        clnt->bind_own_trans = 1;
+    }
+
     new_row_data_type = is_new_row_data(clnt);
     ncols = sqlite3_column_count(rec->stmt);
 
     /* Get first row to figure out column structure */
-    steprc = sqlite3_step(stmt);
+    steprc = step_bind_rows(thd, clnt, stmt);
     if (steprc == SQLITE_SCHEMA_REMOTE) {
         /* remote schema changed;
            Only safe to recover here
@@ -5183,6 +5553,8 @@ static int run_stmt(struct sqlthdstate *thd, struct sqlclntstate *clnt,
     if(!thd->offsets)
         return -1;
 
+    row_frame_init(clnt, ncols);
+
     do {
         /* replication contention reduction */
         release_locks_on_emit_row(thd, clnt);
@@ -5257,7 +5629,7 @@ static int run_stmt(struct sqlthdstate *thd, struct sqlclntstate *clnt,
             if (rc)
                 goto out;
         }
-    } while ((rc = sqlite3_step(stmt)) == SQLITE_ROW);
+    } while ((rc = step_bind_rows(thd, clnt, stmt)) == SQLITE_ROW);
 
 /* whatever sqlite returns in sqlite3_step is only used to step out of the loop,
    otherwise ignored; we are gonna
@@ -5273,6 +5645,7 @@ postprocessing:
                                columns, comm);
 
 out:
+    row_frame_free(clnt);
     newsql_dealloc_row(columns, ncols);
     return rc;
 }
@@ -5396,6 +5769,7 @@ static int handle_sqlite_requests(struct sqlthdstate *thd,
         /* run the engine */
         fast_error = 0;
         rc = run_stmt(thd, clnt, &rec, &fast_error, &err, comm);
+        end_bind_rows(thd, clnt);
         if (rc) {
             int irc = errstat_get_rc(&err);
             switch(irc) {
@@ -5466,11 +5840,19 @@ int execute_sql_query(struct sqlthdstate *thd, struct sqlclntstate *clnt)
        done
      */
     rc = handle_non_sqlite_requests(thd, clnt, &outrc);
-    if (rc)
-        return outrc;
+    if (rc) {
+        rc = outrc;
+    } else {
+        /* This is a request that require a sqlite engine */
+        rc = handle_sqlite_requests(thd, clnt, &client_sql_api);
+    }
 
-    /* This is a request that require a sqlite engine */
-    rc = handle_sqlite_requests(thd, clnt, &client_sql_api);
+    /* the rows this statement batched for the master go out now; the next
+       statement of the transaction may run on another thread.  A failure
+       sticks to the session and fails its commit */
+    if (osql_comm_flush_batch(clnt))
+        logmsg(LOGMSG_ERROR, "%s: failed to send batched rows to %s\n",
+               __func__, clnt->osql.host ? clnt->osql.host : "master");
 
     return rc;
 }
@@ -6240,6 +6622,9 @@ void reset_clnt(struct sqlclntstate *clnt, SBUF2 *sb, int initial)
     }
     clnt->planner_effort =
         bdb_attr_get(thedb->bdb_attr, BDB_ATTR_PLANNER_EFFORT);
+    clnt->parallel_scan =
+        bdb_attr_get(thedb->bdb_attr, BDB_ATTR_PARALLEL_SCAN_THREADS);
+    clnt->bulk_load = 0;
     clnt->osql_max_trans = g_osql_max_trans;
 
     clnt->arr = NULL;
@@ -7523,6 +7908,21 @@ static int process_set_commands(struct sqlclntstate *clnt)
                 printf("setting clnt->planner_effort to %d\n",
                        clnt->planner_effort);
 #endif
+            } else if (strncasecmp(sqlstr, "parallelscan", 12) == 0) {
+                sqlstr += 12;
+                int nthreads = strtol(sqlstr, &endp, 10);
+                if (endp != sqlstr && nthreads >= 0)
+                    clnt->parallel_scan = nthreads;
+                else
+                    rc = ii + 1;
+            } else if (strncasecmp(sqlstr, "bulkload", 8) == 0) {
+                sqlstr += 8;
+                sqlstr = cdb2_skipws(sqlstr);
+                if (strncasecmp(sqlstr, "on", 2) == 0) {
+                    clnt->bulk_load = 1;
+                } else {
+                    clnt->bulk_load = 0;
+                }
             } else {
                 rc = ii + 1;
             }
@@ -7612,25 +8012,224 @@ retry:
     return written;
 }
 
+static int newsql_loop(struct sqlclntstate *clnt, struct thr_handle *thr_self,
+                       CDB2QUERY *query);
+static void newsql_done(struct sqlclntstate *clnt);
+static void newsql_resume(struct thr_handle *thr_self, void *arg, int op);
+
+/* Run the requests of a newsql connection, starting with query.  Returns 1
+ * if the connection was parked while idle, and 0 when it should be closed. */
+static int newsql_loop(struct sqlclntstate *clnt, struct thr_handle *thr_self,
+                       CDB2QUERY *query)
+{
+    CDB2SQLQUERY *sql_query;
+    int rc;
+
+    while (query) {
+        assert(query->sqlquery);
+        sql_query = query->sqlquery;
+
+        clnt->sql = sql_query->sql_query;
+        if (!clnt->in_client_trans) {
+            bzero(&clnt->effects, sizeof(clnt->effects));
+            bzero(&clnt->log_effects, sizeof(clnt->log_effects));
+            clnt->trans_has_sp = 0;
+        }
+        clnt->is_newsql = 1;
+        if (clnt->dbtran.mode < TRANLEVEL_SOSQL) {
+            clnt->dbtran.mode = TRANLEVEL_SOSQL;
+        }
+        clnt->osql.sent_column_data = 0;
+        clnt->sql_query = sql_query;
+
+        if ((clnt->tzname[0] == '\0') && sql_query->tzname)
+            strncpy(clnt->tzname, sql_query->tzname, sizeof(clnt->tzname));
+
+        if (sql_query->dbname && thedb->envname &&
+            strcasecmp(sql_query->dbname, thedb->envname)) {
+            logmsg(LOGMSG_ERROR, "DB name mismatch query:'%s' actual:'%s' \n",
+                    sql_query->dbname, thedb->envname);
+            char *errstr = "DB name mismatch";
+            struct fsqlresp resp;
+
+            resp.response = FSQL_COLUMN_DATA;
+            resp.flags = 0;
+            resp.rcode = CDB2__ERROR_CODE__WRONG_DB;
+            fsql_write_response(clnt, &resp, (void *)errstr, strlen(errstr) + 1, 1 /*flush*/, __func__, __LINE__);
+            return 0;
+        }
+
+        if (clnt->sql_query->client_info) {
+            if (clnt->conninfo.pid &&
+                clnt->conninfo.pid != clnt->sql_query->client_info->pid) {
+                /* Different pid is coming without reset. */
+                logmsg(LOGMSG_WARN, "Multiple processes using same socket PID 1 %d "
+                                "PID 2 %d Host %.8x\n",
+                        clnt->conninfo.pid, clnt->sql_query->client_info->pid,
+                        clnt->sql_query->client_info->host_id);
+            }
+            clnt->conninfo.pid = clnt->sql_query->client_info->pid;
+            clnt->conninfo.node = clnt->sql_query->client_info->host_id;
+        }
+
+        rc = process_set_commands(clnt);
+        if (rc) {
+            /*
+            fprintf(stderr, "%s line %d td %u process_set_commands error\n",
+                    __func__, __LINE__, (uint32_t) pthread_self());
+                    */
+            return 0;
+        }
+
+        if (gbl_rowlocks && clnt->dbtran.mode != TRANLEVEL_SERIAL) {
+            clnt->dbtran.mode = TRANLEVEL_SNAPISOL;
+        }
+
+        if (sql_query->little_endian) {
+            clnt->have_endian = 1;
+            clnt->endian = FSQL_ENDIAN_LITTLE_ENDIAN;
+        } else {
+            clnt->have_endian = 0;
+        }
+
+        clnt->query = query;
+        clnt->added_to_hist = 0;
+
+        /* avoid new accepting new queries/transaction on opened connections
+           if we are incoherent (and not in a transaction). */
+        if (!bdb_am_i_coherent(thedb->bdb_env) &&
+            (clnt->ctrl_sqlengine == SQLENG_NORMAL_PROCESS)) {
+            logmsg(LOGMSG_ERROR, "%s line %d td %u new query on incoherent node, "
+                            "dropping socket\n",
+                    __func__, __LINE__, (uint32_t)pthread_self());
+            return 0;
+        }
+
+        clnt->heartbeat = 1;
+
+        /* The client pipelined more requests behind this one: leave its
+         * responses in the write buffer and send them together */
+        clnt->defer_flush = sbuf2pending(clnt->sb) > 0;
+
+        if (clnt->had_errors && strncasecmp(clnt->sql, "commit", 6) &&
+            strncasecmp(clnt->sql, "rollback", 8)) {
+            if (clnt->in_client_trans == 0) {
+                clnt->had_errors = 0;
+                /* tell blobmem that I want my priority back
+                   when the sql thread is done */
+                comdb2bma_pass_priority_back(blobmem);
+                rc = dispatch_sql_query(clnt);
+            } else {
+                /* Do Nothing */
+                send_heartbeat(clnt);
+            }
+        } else if (clnt->had_errors) {
+            /* Do Nothing */
+            if (clnt->ctrl_sqlengine == SQLENG_STRT_STATE)
+                clnt->ctrl_sqlengine = SQLENG_NORMAL_PROCESS;
+
+            clnt->had_errors = 0;
+            clnt->in_client_trans = 0;
+            rc = -1;
+        } else {
+            /* tell blobmem that I want my priority back
+               when the sql thread is done */
+            comdb2bma_pass_priority_back(blobmem);
+            rc = dispatch_sql_query(clnt);
+        }
+
+        if (clnt->osql.replay == OSQL_RETRY_DO) {
+            if (clnt->trans_has_sp == 0) {
+                srs_tran_replay(clnt, thr_self);
+            } else {
+                osql_set_replay(__FILE__, __LINE__, clnt, OSQL_RETRY_NONE);
+                srs_tran_destroy(clnt);
+            }
+        } else {
+            /* if this transaction is done (marked by SQLENG_NORMAL_PROCESS),
+               clean transaction sql history
+            */
+            if (clnt->osql.history &&
+                clnt->ctrl_sqlengine == SQLENG_NORMAL_PROCESS)
+                srs_tran_destroy(clnt);
+        }
+
+        if (clnt->defer_flush) {
+            pthread_mutex_lock(&clnt->write_lock);
+            clnt->defer_flush = 0;
+            if (sbuf2pending(clnt->sb) == 0)
+                sbuf2flush(clnt->sb);
+            pthread_mutex_unlock(&clnt->write_lock);
+        }
+
+        if (rc && !clnt->in_client_trans)
+            return 0;
+
+        pthread_mutex_lock(&clnt->wait_mutex);
+        if (clnt->query) {
+            if (clnt->added_to_hist == 1) {
+                clnt->query = NULL;
+            } else {
+                cdb2__query__free_unpacked(clnt->query, &pb_alloc);
+                clnt->query = NULL;
+            }
+        }
+        pthread_mutex_unlock(&clnt->wait_mutex);
+
+        /* Between transactions, wait for the next request without holding
+         * this thread */
+        if (!clnt->in_client_trans &&
+            clnt->ctrl_sqlengine == SQLENG_NORMAL_PROCESS &&
+            !gbl_use_appsock_as_sqlthread &&
+            appsock_park(clnt->sb, newsql_resume, clnt) == 0)
+            return 1;
+
+        query = read_newsql_query(clnt, clnt->sb);
+    }
+    return 0;
+}
+
+/* Carry on with a newsql connection that was parked between requests */
+static void newsql_resume(struct thr_handle *thr_self, void *arg, int op)
+{
+    struct sqlclntstate *clnt = arg;
+    CDB2QUERY *query;
+
+    if (op == APPSOCK_RESUME_READ &&
+        (query = read_newsql_query(clnt, clnt->sb)) != NULL &&
+        newsql_loop(clnt, thr_self, query))
+        return;
+
+    if (op == APPSOCK_RESUME_TIMEOUT)
+        handle_failed_dispatch(clnt, "Socket read timeout.");
+    newsql_done(clnt);
+}
+
 int handle_newsql_requests(struct thr_handle *thr_self, SBUF2 *sb,
                            int *keepsocket)
 {
     int rc = 0;
     int do_master_check = 1;
 
-    struct sqlclntstate clnt;
-    reset_clnt(&clnt, sb, 1);
-    clnt.tzname[0] = '\0';
-
-    clnt.is_newsql = 1;
+    struct sqlclntstate *clnt;
 
     if (keepsocket)
         *keepsocket = 1;
 
+    if ((clnt = malloc(sizeof(struct sqlclntstate))) == NULL) {
+        logmsg(LOGMSG_ERROR, "%s: malloc failed\n", __func__);
+        close_appsock(sb);
+        return 0;
+    }
+    reset_clnt(clnt, sb, 1);
+    clnt->tzname[0] = '\0';
+
+    clnt->is_newsql = 1;
+
     if (thedb->rep_sync == REP_SYNC_NONE)
         do_master_check = 0;
 
-    if (do_master_check && sbuf_is_local(clnt.sb))
+    if (do_master_check && sbuf_is_local(clnt->sb))
         do_master_check = 0;
 
     if (active_appsock_conns >
@@ -7643,7 +8242,7 @@ int handle_newsql_requests(struct thr_handle *thr_self, SBUF2 *sb,
         bzero(&resp, sizeof(resp));
         resp.response = FSQL_ERROR;
         resp.rcode = SQLHERR_APPSOCK_LIMIT;
-        rc = fsql_write_response(&clnt, &resp, err, strlen(err) + 1, 1,
+        rc = fsql_write_response(clnt, &resp, err, strlen(err) + 1, 1,
                                  __func__, __LINE__);
         goto done;
     }
@@ -7651,14 +8250,14 @@ int handle_newsql_requests(struct thr_handle *thr_self, SBUF2 *sb,
     /* avoid new accepting new queries/transaction on opened connections
        if we are incoherent (and not in a transaction). */
     if (!bdb_am_i_coherent(thedb->bdb_env) &&
-        (clnt.ctrl_sqlengine == SQLENG_NORMAL_PROCESS)) {
+        (clnt->ctrl_sqlengine == SQLENG_NORMAL_PROCESS)) {
         logmsg(LOGMSG_ERROR, 
                "%s line %d td %u new query on incoherent node, dropping socket\n",
                __func__, __LINE__, (uint32_t)pthread_self());
         goto done;
     }
 
-    CDB2QUERY *query = read_newsql_query(&clnt, sb);
+    CDB2QUERY *query = read_newsql_query(clnt, sb);
 
     if (query == NULL) {
         goto done;
@@ -7678,12 +8277,12 @@ int handle_newsql_requests(struct thr_handle *thr_self, SBUF2 *sb,
             allow_master_dbinfo = 1;
         } else if (CDB2_CLIENT_FEATURES__ALLOW_QUEUING ==
                    sql_query->features[ii]) {
-            clnt.req.flags |= SQLF_QUEUE_ME;
+            clnt->req.flags |= SQLF_QUEUE_ME;
         }
     }
 
     if (do_master_check && bdb_master_should_reject(thedb->bdb_env) &&
-        (clnt.ctrl_sqlengine == SQLENG_NORMAL_PROCESS)) {
+        (clnt->ctrl_sqlengine == SQLENG_NORMAL_PROCESS)) {
         if (allow_master_exec == 0) {
             logmsg(LOGMSG_ERROR, 
                    "%s line %d td %u new query on master, dropping socket\n",
@@ -7703,16 +8302,16 @@ int handle_newsql_requests(struct thr_handle *thr_self, SBUF2 *sb,
     int notimeout = disable_server_sql_timeouts();
 
     /* these connections shouldn't time out */
-    sbuf2settimeout(clnt.sb, 0, 0);
+    sbuf2settimeout(clnt->sb, 0, 0);
 
-    pthread_mutex_init(&clnt.wait_mutex, NULL);
-    pthread_cond_init(&clnt.wait_cond, NULL);
-    pthread_mutex_init(&clnt.write_lock, NULL);
-    pthread_mutex_init(&clnt.dtran_mtx, NULL);
+    pthread_mutex_init(&clnt->wait_mutex, NULL);
+    pthread_cond_init(&clnt->wait_cond, NULL);
+    pthread_mutex_init(&clnt->write_lock, NULL);
+    pthread_mutex_init(&clnt->dtran_mtx, NULL);
 
-    clnt.osql.count_changes = 1;
-    clnt.dbtran.mode = tdef_to_tranlevel(gbl_sql_tranlevel_default);
-    clnt.high_availability = 0;
+    clnt->osql.count_changes = 1;
+    clnt->dbtran.mode = tdef_to_tranlevel(gbl_sql_tranlevel_default);
+    clnt->high_availability = 0;
 
     sbuf2settimeout(
         sb, bdb_attr_get(thedb->bdb_attr, BDB_ATTR_MAX_SQL_IDLE_TIME) * 1000,
@@ -7727,7 +8326,7 @@ int handle_newsql_requests(struct thr_handle *thr_self, SBUF2 *sb,
 
     net_add_watch_warning(
         sb, bdb_attr_get(thedb->bdb_attr, BDB_ATTR_MAX_SQL_IDLE_TIME),
-        wrtimeoutsec, &clnt, watcher_warning_function);
+        wrtimeoutsec, clnt, watcher_warning_function);
 
     /* appsock threads aren't sql threads so for appsock pool threads
      * sqlthd will be NULL */
@@ -7737,184 +8336,53 @@ int handle_newsql_requests(struct thr_handle *thr_self, SBUF2 *sb,
         sqlthd->sqlclntstate->origin[0] = 0;
     }
 
-    while (query) {
-        assert(query->sqlquery);
-        sql_query = query->sqlquery;
-
-        clnt.sql = sql_query->sql_query;
-        if (!clnt.in_client_trans) {
-            bzero(&clnt.effects, sizeof(clnt.effects));
-            bzero(&clnt.log_effects, sizeof(clnt.log_effects));
-            clnt.trans_has_sp = 0;
-        }
-        clnt.is_newsql = 1;
-        if (clnt.dbtran.mode < TRANLEVEL_SOSQL) {
-            clnt.dbtran.mode = TRANLEVEL_SOSQL;
-        }
-        clnt.osql.sent_column_data = 0;
-        clnt.sql_query = sql_query;
-
-        if ((clnt.tzname[0] == '\0') && sql_query->tzname)
-            strncpy(clnt.tzname, sql_query->tzname, sizeof(clnt.tzname));
-
-        if (sql_query->dbname && thedb->envname &&
-            strcasecmp(sql_query->dbname, thedb->envname)) {
-            logmsg(LOGMSG_ERROR, "DB name mismatch query:'%s' actual:'%s' \n",
-                    sql_query->dbname, thedb->envname);
-            char *errstr = "DB name mismatch";
-            struct fsqlresp resp;
-
-            resp.response = FSQL_COLUMN_DATA;
-            resp.flags = 0;
-            resp.rcode = CDB2__ERROR_CODE__WRONG_DB;
-            fsql_write_response(&clnt, &resp, (void *)errstr, strlen(errstr) + 1, 1 /*flush*/, __func__, __LINE__);
-            goto done;
-        }
-
-        if (clnt.sql_query->client_info) {
-            if (clnt.conninfo.pid &&
-                clnt.conninfo.pid != clnt.sql_query->client_info->pid) {
-                /* Different pid is coming without reset. */
-                logmsg(LOGMSG_WARN, "Multiple processes using same socket PID 1 %d "
-                                "PID 2 %d Host %.8x\n",
-                        clnt.conninfo.pid, clnt.sql_query->client_info->pid,
-                        clnt.sql_query->client_info->host_id);
-            }
-            clnt.conninfo.pid = clnt.sql_query->client_info->pid;
-            clnt.conninfo.node = clnt.sql_query->client_info->host_id;
-        }
-
-        rc = process_set_commands(&clnt);
-        if (rc) {
-            /*
-            fprintf(stderr, "%s line %d td %u process_set_commands error\n",
-                    __func__, __LINE__, (uint32_t) pthread_self());
-                    */
-            goto done;
-        }
-
-        if (gbl_rowlocks && clnt.dbtran.mode != TRANLEVEL_SERIAL) {
-            clnt.dbtran.mode = TRANLEVEL_SNAPISOL;
-        }
-
-        if (sql_query->little_endian) {
-            clnt.have_endian = 1;
-            clnt.endian = FSQL_ENDIAN_LITTLE_ENDIAN;
-        } else {
-            clnt.have_endian = 0;
-        }
-
-        clnt.query = query;
-        clnt.added_to_hist = 0;
-
-        /* avoid new accepting new queries/transaction on opened connections
-           if we are incoherent (and not in a transaction). */
-        if (!bdb_am_i_coherent(thedb->bdb_env) &&
-            (clnt.ctrl_sqlengine == SQLENG_NORMAL_PROCESS)) {
-            logmsg(LOGMSG_ERROR, "%s line %d td %u new query on incoherent node, "
-                            "dropping socket\n",
-                    __func__, __LINE__, (uint32_t)pthread_self());
-            goto done;
-        }
-
-        clnt.heartbeat = 1;
-
-        if (clnt.had_errors && strncasecmp(clnt.sql, "commit", 6) &&
-            strncasecmp(clnt.sql, "rollback", 8)) {
-            if (clnt.in_client_trans == 0) {
-                clnt.had_errors = 0;
-                /* tell blobmem that I want my priority back
-                   when the sql thread is done */
-                comdb2bma_pass_priority_back(blobmem);
-                rc = dispatch_sql_query(&clnt);
-            } else {
-                /* Do Nothing */
-                send_heartbeat(&clnt);
-            }
-        } else if (clnt.had_errors) {
-            /* Do Nothing */
-            if (clnt.ctrl_sqlengine == SQLENG_STRT_STATE)
-                clnt.ctrl_sqlengine = SQLENG_NORMAL_PROCESS;
-
-            clnt.had_errors = 0;
-            clnt.in_client_trans = 0;
-            rc = -1;
-        } else {
-            /* tell blobmem that I want my priority back
-               when the sql thread is done */
-            comdb2bma_pass_priority_back(blobmem);
-            rc = dispatch_sql_query(&clnt);
-        }
-
-        if (clnt.osql.replay == OSQL_RETRY_DO) {
-            if (clnt.trans_has_sp == 0) {
-                srs_tran_replay(&clnt, thr_self);
-            } else {
-                osql_set_replay(__FILE__, __LINE__, &clnt, OSQL_RETRY_NONE);
-                srs_tran_destroy(&clnt);
-            }
-        } else {
-            /* if this transaction is done (marked by SQLENG_NORMAL_PROCESS),
-               clean transaction sql history
-            */
-            if (clnt.osql.history &&
-                clnt.ctrl_sqlengine == SQLENG_NORMAL_PROCESS)
-                srs_tran_destroy(&clnt);
-        }
-
-        if (rc && !clnt.in_client_trans)
-            goto done;
-
-        pthread_mutex_lock(&clnt.wait_mutex);
-        if (clnt.query) {
-            if (clnt.added_to_hist == 1) {
-                clnt.query = NULL;
-            } else {
-                cdb2__query__free_unpacked(clnt.query, &pb_alloc);
-                clnt.query = NULL;
-            }
-        }
-        pthread_mutex_unlock(&clnt.wait_mutex);
-
-        query = read_newsql_query(&clnt, sb);
-    }
+    /* a parked connection is no longer ours */
+    if (newsql_loop(clnt, thr_self, query))
+        return 0;
 
 done:
-    if (clnt.ctrl_sqlengine == SQLENG_INTRANS_STATE) {
-        handle_sql_intrans_unrecoverable_error(&clnt);
+    newsql_done(clnt);
+    return 0;
+}
+
+/* Tear down a newsql connection and free its client state */
+static void newsql_done(struct sqlclntstate *clnt)
+{
+    if (clnt->ctrl_sqlengine == SQLENG_INTRANS_STATE) {
+        handle_sql_intrans_unrecoverable_error(clnt);
     }
 
-    close_sp(&clnt);
-    osql_clean_sqlclntstate(&clnt);
+    close_sp(clnt);
+    osql_clean_sqlclntstate(clnt);
 
-    if (clnt.dbglog) {
-        sbuf2close(clnt.dbglog);
-        clnt.dbglog = NULL;
+    if (clnt->dbglog) {
+        sbuf2close(clnt->dbglog);
+        clnt->dbglog = NULL;
     }
 
-    if (clnt.query) {
-        if (clnt.added_to_hist == 1) {
-            clnt.query = NULL;
+    if (clnt->query) {
+        if (clnt->added_to_hist == 1) {
+            clnt->query = NULL;
         } else {
-            cdb2__query__free_unpacked(clnt.query, &pb_alloc);
-            clnt.query = NULL;
+            cdb2__query__free_unpacked(clnt->query, &pb_alloc);
+            clnt->query = NULL;
         }
     }
 
     /* XXX free logical tran?  */
-    close_appsock(sb);
+    close_appsock(clnt->sb);
 
-    clnt.dbtran.mode = TRANLEVEL_INVALID;
-    clnt.high_availability = 0;
-    if (clnt.query_stats)
-        free(clnt.query_stats);
+    clnt->dbtran.mode = TRANLEVEL_INVALID;
+    clnt->high_availability = 0;
+    if (clnt->query_stats)
+        free(clnt->query_stats);
 
-    pthread_mutex_destroy(&clnt.wait_mutex);
-    pthread_cond_destroy(&clnt.wait_cond);
-    pthread_mutex_destroy(&clnt.write_lock);
-    pthread_mutex_destroy(&clnt.dtran_mtx);
+    pthread_mutex_destroy(&clnt->wait_mutex);
+    pthread_cond_destroy(&clnt->wait_cond);
+    pthread_mutex_destroy(&clnt->write_lock);
+    pthread_mutex_destroy(&clnt->dtran_mtx);
 
-    return 0;
+    free(clnt);
 }
 
 int handle_fastsql_requests(struct thr_handle *thr_self, SBUF2 *sb,
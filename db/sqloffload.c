@@ -611,6 +611,7 @@ int osql_clean_sqlclntstate(struct sqlclntstate *clnt)
 
     if (osql->tablename)
         free(osql->tablename);
+    osql_comm_free_batch(clnt);
     if (!osql_shadtbl_empty(clnt))
         osql_shadtbl_close(clnt);
     if (osql->history)
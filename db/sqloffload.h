@@ -60,7 +60,9 @@ enum {
     OSQL_FLAGS_USE_BLKSEQ =
         0x00000010, /* sent in local case when a remote tran is retried */
     OSQL_FLAGS_ROWLOCKS = 0x00000020,
-    OSQL_FLAGS_GENID48 =  0x00000040
+    OSQL_FLAGS_GENID48 =  0x00000040,
+    OSQL_FLAGS_BULK_LOAD = 0x00000080 /* SET BULKLOAD: add index keys of
+                                         inserts sorted, before commit */
 };
 
 int osql_open(struct dbenv *dbenv);
@@ -67,6 +67,8 @@ extern int gbl_return_long_column_names;
 extern int gbl_max_sqlcache;
 extern int gbl_lua_new_trans_model;
 extern int gbl_max_lua_instructions;
+extern int gbl_lua_vm_pool_size;
+extern int gbl_lua_bytecode_cache;
 extern int gbl_lua_version;
 extern int gbl_break_lua;
 
@@ -2957,10 +2959,173 @@ static int get_func_by_name(Lua L, const char *func, char **err)
     return 0;
 }
 
+/* Compiled procedures, by name and version, so that loading one in a VM
+ * doesn't parse its source again */
+struct sp_bytecode {
+    char *key;
+    int lua_version; // of the source it was compiled from
+    char *code;
+    size_t len;
+    LINKC_T(struct sp_bytecode) lnk;
+};
+
+static pthread_once_t sp_cache_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t sp_cache_lk = PTHREAD_MUTEX_INITIALIZER;
+static hash_t *sp_bytecode_hash;
+static LISTC_T(struct sp_bytecode) sp_bytecode_lru;
+static LISTC_T(struct stored_proc) sp_pool;
+static unsigned long long sp_bytecode_hits, sp_bytecode_misses;
+static unsigned long long sp_pool_hits, sp_pool_misses;
+
+static void init_sp_cache(void)
+{
+    sp_bytecode_hash = hash_init_strptr(offsetof(struct sp_bytecode, key));
+    listc_init(&sp_bytecode_lru, offsetof(struct sp_bytecode, lnk));
+    listc_init(&sp_pool, offsetof(struct stored_proc, pool_lnk));
+}
+
+static char *sp_bytecode_key(SP sp)
+{
+    if (sp->spname[0] == 0)
+        return NULL;
+    strbuf *buf = strbuf_new();
+    strbuf_appendf(buf, "%s:%d:%s", sp->spname, sp->spversion.version_num,
+                   sp->spversion.version_str ? sp->spversion.version_str : "");
+    char *key = strbuf_disown(buf);
+    strbuf_free(buf);
+    return key;
+}
+
+static void free_sp_bytecode(struct sp_bytecode *bc)
+{
+    hash_del(sp_bytecode_hash, bc);
+    listc_rfl(&sp_bytecode_lru, bc);
+    free(bc->key);
+    free(bc->code);
+    free(bc);
+}
+
+// Copy of the cached bytecode of this version of the procedure
+static char *get_sp_bytecode(const char *key, int lua_version, size_t *len)
+{
+    char *code = NULL;
+    pthread_mutex_lock(&sp_cache_lk);
+    struct sp_bytecode *bc = hash_find(sp_bytecode_hash, &key);
+    if (bc && bc->lua_version == lua_version &&
+        (code = malloc(bc->len)) != NULL) {
+        memcpy(code, bc->code, bc->len);
+        *len = bc->len;
+        listc_rfl(&sp_bytecode_lru, bc);
+        listc_abl(&sp_bytecode_lru, bc);
+        ++sp_bytecode_hits;
+    } else {
+        ++sp_bytecode_misses;
+    }
+    pthread_mutex_unlock(&sp_cache_lk);
+    return code;
+}
+
+// Takes over key and code
+static void put_sp_bytecode(char *key, int lua_version, char *code,
+                            size_t len)
+{
+    pthread_mutex_lock(&sp_cache_lk);
+    struct sp_bytecode *bc = hash_find(sp_bytecode_hash, &key);
+    if (bc) {
+        if (bc->lua_version >= lua_version) {
+            // as new as ours
+            pthread_mutex_unlock(&sp_cache_lk);
+            free(key);
+            free(code);
+            return;
+        }
+        free_sp_bytecode(bc);
+    }
+    bc = malloc(sizeof(struct sp_bytecode));
+    if (bc == NULL) {
+        pthread_mutex_unlock(&sp_cache_lk);
+        free(key);
+        free(code);
+        return;
+    }
+    bc->key = key;
+    bc->lua_version = lua_version;
+    bc->code = code;
+    bc->len = len;
+    hash_add(sp_bytecode_hash, bc);
+    listc_abl(&sp_bytecode_lru, bc);
+    while (listc_size(&sp_bytecode_lru) > gbl_lua_bytecode_cache)
+        free_sp_bytecode(LISTC_TOP(&sp_bytecode_lru));
+    pthread_mutex_unlock(&sp_cache_lk);
+}
+
+struct sp_dump {
+    char *code;
+    size_t len;
+    size_t sz;
+};
+
+static int sp_dump_writer(Lua L, const void *p, size_t sz, void *ud)
+{
+    struct sp_dump *d = ud;
+    if (d->len + sz > d->sz) {
+        size_t newsz = d->sz ? d->sz : 4096;
+        while (newsz < d->len + sz)
+            newsz *= 2;
+        char *code = realloc(d->code, newsz);
+        if (code == NULL)
+            return 1;
+        d->code = code;
+        d->sz = newsz;
+    }
+    memcpy(d->code + d->len, p, sz);
+    d->len += sz;
+    return 0;
+}
+
+// Compile src, the source of sp, or load it compiled from the bytecode cache
+static int load_src_chunk(Lua L, const char *src)
+{
+    SP sp = getsp(L);
+    char *key;
+    char *code;
+    size_t len;
+    int rc;
+
+    if (gbl_lua_bytecode_cache <= 0 || sp == NULL ||
+        (key = sp_bytecode_key(sp)) == NULL)
+        return luaL_loadstring(L, src);
+
+    pthread_once(&sp_cache_once, init_sp_cache);
+    if ((code = get_sp_bytecode(key, sp->lua_version, &len)) != NULL) {
+        rc = luaL_loadbuffer(L, code, len, sp->spname);
+        free(code);
+        if (rc == 0) {
+            free(key);
+            return 0;
+        }
+        lua_pop(L, 1);
+    }
+
+    if ((rc = luaL_loadstring(L, src)) != 0) {
+        free(key);
+        return rc;
+    }
+    struct sp_dump d = {0};
+    if (lua_dump(L, sp_dump_writer, &d) == 0 && d.len) {
+        put_sp_bytecode(key, sp->lua_version, d.code, d.len);
+    } else {
+        free(key);
+        free(d.code);
+    }
+    return 0;
+}
+
 static int process_src(Lua L, const char *src, char **err)
 {
     int rc;
-    if ((rc = luaL_dostring(L, src)) != 0) {
+    if ((rc = load_src_chunk(L, src)) != 0 ||
+        (rc = lua_pcall(L, 0, LUA_MULTRET, 0)) != 0) {
         *err = strdup(lua_tostring(L, -1));
         return -1;
     }
@@ -3098,6 +3263,190 @@ static void close_sp_int(SP sp, int freesp)
     comdb2ma_destroy(mspace);
 }
 
+// A VM from the pool, ready to load a procedure
+static SP get_sp_from_pool(void)
+{
+    SP sp;
+    if (gbl_lua_vm_pool_size <= 0)
+        return NULL;
+    pthread_once(&sp_cache_once, init_sp_cache);
+    pthread_mutex_lock(&sp_cache_lk);
+    if ((sp = listc_rtl(&sp_pool)) != NULL)
+        ++sp_pool_hits;
+    else
+        ++sp_pool_misses;
+    pthread_mutex_unlock(&sp_cache_lk);
+    return sp;
+}
+
+// Registry keys of the pristine state of a new VM: a shallow copy of each
+// table a procedure can reach by name (_G, the tables in it, their
+// metatables and the registry's tables) and the metatables of those tables
+#define SP_SNAPSHOT "_cdb2_snapshot"
+#define SP_SNAPSHOT_MT "_cdb2_snapshot_mt"
+
+// Copy the table on top of the stack into snapshot, and its metatable
+// into metatables (absolute indexes)
+static void snapshot_table(Lua L, int snap, int mts)
+{
+    if (!lua_istable(L, -1)) return;
+    lua_pushvalue(L, -1);
+    lua_rawget(L, snap);
+    int seen = !lua_isnil(L, -1);
+    lua_pop(L, 1);
+    if (seen) return;
+
+    lua_pushvalue(L, -1);
+    if (!lua_getmetatable(L, -1)) lua_pushboolean(L, 0);
+    lua_rawset(L, mts); // metatables[t] = mt or false
+
+    int t = lua_gettop(L);
+    lua_pushvalue(L, t);
+    lua_newtable(L);
+    lua_pushnil(L);
+    while (lua_next(L, t)) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -4); // copy[k] = v
+    }
+    lua_rawset(L, snap); // snapshot[t] = copy
+}
+
+// Snapshot the tables (and metatables) among the values of the table on
+// top of the stack
+static void snapshot_values(Lua L, int snap, int mts)
+{
+    int t = lua_gettop(L);
+    lua_pushnil(L);
+    while (lua_next(L, t)) {
+        snapshot_table(L, snap, mts);
+        if (lua_getmetatable(L, -1)) {
+            snapshot_table(L, snap, mts);
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+    }
+}
+
+// Remember what a new VM looks like, so a pooled one can be put back
+static void snapshot_globals(Lua L)
+{
+    lua_newtable(L);
+    lua_newtable(L);
+    int snap = lua_gettop(L) - 1;
+    int mts = lua_gettop(L);
+
+    lua_pushvalue(L, LUA_GLOBALSINDEX);
+    snapshot_table(L, snap, mts);
+    if (lua_getmetatable(L, -1)) {
+        snapshot_table(L, snap, mts);
+        lua_pop(L, 1);
+    }
+    snapshot_values(L, snap, mts);
+    lua_pop(L, 1);
+
+    lua_pushvalue(L, LUA_REGISTRYINDEX);
+    snapshot_values(L, snap, mts);
+    lua_pop(L, 1);
+
+    lua_setfield(L, LUA_REGISTRYINDEX, SP_SNAPSHOT_MT);
+    lua_setfield(L, LUA_REGISTRYINDEX, SP_SNAPSHOT);
+}
+
+// Put every table in the snapshot back the way the VM was created: drop
+// the fields a procedure added, restore those it changed or removed, and
+// its metatable.  Globals, functions, and changes to the libraries and the
+// db types don't leak from one procedure, or user, to the next.
+static int restore_globals(Lua L)
+{
+    lua_getfield(L, LUA_REGISTRYINDEX, SP_SNAPSHOT);
+    lua_getfield(L, LUA_REGISTRYINDEX, SP_SNAPSHOT_MT);
+    int snap = lua_gettop(L) - 1;
+    int mts = lua_gettop(L);
+    if (!lua_istable(L, snap) || !lua_istable(L, mts)) {
+        lua_pop(L, 2);
+        return -1;
+    }
+
+    lua_pushnil(L);
+    while (lua_next(L, snap)) {
+        int t = lua_gettop(L) - 1;
+        int copy = lua_gettop(L);
+
+        lua_pushnil(L);
+        while (lua_next(L, t)) {
+            lua_pop(L, 1);
+            lua_pushvalue(L, -1);
+            lua_rawget(L, copy);
+            int keep = !lua_isnil(L, -1);
+            lua_pop(L, 1);
+            if (!keep) {
+                // clearing a field is allowed while traversing
+                lua_pushvalue(L, -1);
+                lua_pushnil(L);
+                lua_rawset(L, t);
+            }
+        }
+        lua_pushnil(L);
+        while (lua_next(L, copy)) {
+            lua_pushvalue(L, -2);
+            lua_insert(L, -2);
+            lua_rawset(L, t);
+        }
+        lua_pop(L, 1); // copy
+
+        lua_pushvalue(L, t);
+        lua_rawget(L, mts);
+        if (!lua_istable(L, -1)) {
+            lua_pop(L, 1);
+            lua_pushnil(L);
+        }
+        lua_setmetatable(L, t);
+    }
+    lua_pop(L, 2);
+    return 0;
+}
+
+// Keep the VM of a client that is done with it for the next one
+static int put_sp_in_pool(SP sp)
+{
+    if (gbl_lua_vm_pool_size <= 0 || sp->lua == NULL || sp->dirty_vm ||
+        sp->parent != sp)
+        return -1;
+    lua_settop(sp->lua, 0);
+    if (restore_globals(sp->lua) != 0)
+        return -1;
+    reset_sp(sp);
+    free_spversion(sp);
+    sp->clnt = NULL;
+    sp->debug_clnt = NULL;
+    sp->thd = NULL;
+    sp->emit_mutex = NULL;
+    pthread_once(&sp_cache_once, init_sp_cache);
+    pthread_mutex_lock(&sp_cache_lk);
+    if (listc_size(&sp_pool) >= gbl_lua_vm_pool_size) {
+        pthread_mutex_unlock(&sp_cache_lk);
+        return -1;
+    }
+    listc_abl(&sp_pool, sp);
+    pthread_mutex_unlock(&sp_cache_lk);
+    return 0;
+}
+
+void sp_cache_stats(void)
+{
+    pthread_once(&sp_cache_once, init_sp_cache);
+    pthread_mutex_lock(&sp_cache_lk);
+    logmsg(LOGMSG_USER, "lua vm pool: %d/%d vms, %llu hits, %llu misses\n",
+           listc_size(&sp_pool), gbl_lua_vm_pool_size, sp_pool_hits,
+           sp_pool_misses);
+    logmsg(LOGMSG_USER,
+           "lua bytecode cache: %d/%d procedures, %llu hits, %llu misses\n",
+           listc_size(&sp_bytecode_lru), gbl_lua_bytecode_cache,
+           sp_bytecode_hits, sp_bytecode_misses);
+    pthread_mutex_unlock(&sp_cache_lk);
+}
+
 static int db_create_thread_int(Lua lua, const char *funcname)
 {
     /* Make a new cloned working state. */
@@ -3127,6 +3476,7 @@ static int db_create_thread_int(Lua lua, const char *funcname)
     newsp->spversion = sp->spversion;
     if (newsp->spversion.version_str)
         newsp->spversion.version_str = strdup(newsp->spversion.version_str);
+    newsp->lua_version = sp->lua_version;
     newsp->parent = sp->parent;
 
     if (process_src(newlua, sp->src, &err) != 0) goto bad;
@@ -4376,6 +4726,9 @@ static int create_sp_int(SP sp, char **err)
 
     disable_global_variables(lua);
 
+    if (gbl_lua_vm_pool_size > 0)
+        snapshot_globals(lua);
+
     /* To be given as lrl value. */
     lua_sethook(lua, InstructionCountHook, LUA_MASKCOUNT, 1);
     return 0;
@@ -4383,7 +4736,10 @@ static int create_sp_int(SP sp, char **err)
 
 static SP create_sp(char **err)
 {
-    SP sp = calloc(1, sizeof(struct stored_proc));
+    SP sp = get_sp_from_pool();
+    if (sp)
+        return sp;
+    sp = calloc(1, sizeof(struct stored_proc));
     if (create_sp_int(sp, err) != 0) {
         free(sp);
         return NULL;
@@ -5777,6 +6133,7 @@ static int setup_sp(char *spname, struct sqlthdstate *thd,
     }
     if (clnt && (clnt->want_stored_procedure_trace ||
                  clnt->want_stored_procedure_debug)) {
+        sp->dirty_vm = 1;
         if (load_debugging_information(sp, err)) {
             return -1;
         }
@@ -6461,7 +6818,10 @@ static int exec_procedure_int(const char *s, char **err,
 
     update_tran_funcs(L, clnt->in_client_trans);
 
-    if (strncasecmp(spname, "sys.", 4) == 0) init_sys_funcs(L);
+    if (strncasecmp(spname, "sys.", 4) == 0) {
+        init_sys_funcs(L);
+        sp->dirty_vm = 1;
+    }
 
     if ((rc = push_args(&s, clnt, err, params, &args)) != 0) return rc;
 
@@ -6497,6 +6857,7 @@ static int setup_sp_for_trigger(trigger_reg_t *reg, char **err,
     if (new_vm == 0) return 0;
 
     sp->parent->have_consumer = 1;
+    sp->dirty_vm = 1;
     remove_tran_funcs(L);
     remove_consumer(L);
     remove_emit(L);
@@ -6530,7 +6891,8 @@ static int setup_sp_for_trigger(trigger_reg_t *reg, char **err,
 
 void close_sp(struct sqlclntstate *clnt)
 {
-    close_sp_int(clnt->sp, 1);
+    if (clnt->sp == NULL || put_sp_in_pool(clnt->sp) != 0)
+        close_sp_int(clnt->sp, 1);
     clnt->sp = NULL;
 }
 
@@ -33,6 +33,7 @@ int exec_procedure(const char *s, char **err, struct sqlthdstate *, struct schem
 int exec_thread(struct sqlthdstate *, struct sqlclntstate *);
 void *exec_trigger(struct trigger_reg *);
 void close_sp(struct sqlclntstate *);
+void sp_cache_stats(void);
 
 void lua_final(struct sqlite3_context *);
 void lua_step(struct sqlite3_context *, int argc, struct Mem **argv);
@@ -65,6 +65,8 @@ struct stored_proc {
     dbstmt_t *prev_dbstmt; // for db_bind -- deprecated
     int pingpong;
     int have_consumer;
+    int dirty_vm; // changed in ways reset_sp() can't undo: not for the pool
+    LINKC_T(struct stored_proc) pool_lnk;
 };
 
 #define getsp(x) ((SP)lua_getsp(x))
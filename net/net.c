@@ -60,6 +60,7 @@
 #include <dirent.h>
 #include <utime.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <poll.h>
 
 #include <bb_oscompat.h>
@@ -88,6 +89,7 @@
 #include <util.h>
 #include <sched.h>
 #include <cdb2_constants.h>
+#include <comdb2_atomic.h>
 #include "intern_strings.h"
 
 #include <fsnapf.h>
@@ -114,6 +116,10 @@ extern int gbl_pmux_route_enabled;
 
 int gbl_verbose_net = 0;
 
+/* Flush the write queue with writev() straight from the queued messages
+ * instead of copying them through the sbuf (plaintext connections only) */
+int gbl_net_writev = 1;
+
 static unsigned long long gettmms(void)
 {
     struct timeval tm;
@@ -624,9 +630,14 @@ static int write_list(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr,
     /* Although generic, this logic was really added to ensure that we
      * don't double enque heartbeat messages.  Not sure how much this really
      * happens in practice. */
-    if ((flags & WRITE_MSG_NODUPE) != 0 && host_node_ptr->write_head) {
+    if ((flags & WRITE_MSG_NODUPE) != 0 &&
+        ((flags & WRITE_MSG_PRIORITY) ? host_node_ptr->write_prio_head
+                                      : host_node_ptr->write_head)) {
         const wire_header_type *newitem = headptr;
-        wire_header_type *headitem = &host_node_ptr->write_head->payload.header;
+        wire_header_type *headitem =
+            (flags & WRITE_MSG_PRIORITY)
+                ? &host_node_ptr->write_prio_head->payload.header
+                : &host_node_ptr->write_head->payload.header;
         if (newitem->type == headitem->type) {
             /* Dedupe this item */
             host_node_ptr->dedupe_count++;
@@ -718,7 +729,16 @@ fprintf(stderr, "[%s] using malloc for %d bytes\n",
 
     Pthread_mutex_lock(&(host_node_ptr->enquelk));
 
-    if (host_node_ptr->write_head == NULL) {
+    if (flags & WRITE_MSG_PRIORITY) {
+        /* Priority lane is strictly first in first out */
+        insert->next = NULL;
+        insert->prev = host_node_ptr->write_prio_tail;
+        if (host_node_ptr->write_prio_tail)
+            host_node_ptr->write_prio_tail->next = insert;
+        else
+            host_node_ptr->write_prio_head = insert;
+        host_node_ptr->write_prio_tail = insert;
+    } else if (host_node_ptr->write_head == NULL) {
         host_node_ptr->write_head = host_node_ptr->write_tail = insert;
         insert->next = insert->prev = NULL;
     } else if (flags & WRITE_MSG_HEAD) {
@@ -1094,6 +1114,21 @@ static int read_connect_message(SBUF2 *sb, char hostname[], int hostnamel,
     return 0;
 }
 
+static void free_write_data(host_node_type *host_node_ptr, write_data *ptr)
+{
+    if (ptr->pooled) {
+        Pthread_mutex_lock(&(host_node_ptr->pool_lock));
+        pool_relablk(host_node_ptr->write_pool, ptr);
+        Pthread_mutex_unlock(&(host_node_ptr->pool_lock));
+    } else {
+#ifdef PER_THREAD_MALLOC
+        free(ptr);
+#else
+        comdb2_free(ptr);
+#endif
+    }
+}
+
 static int empty_write_list(host_node_type *host_node_ptr)
 {
     write_data *ptr, *nxt;
@@ -1103,23 +1138,19 @@ static int empty_write_list(host_node_type *host_node_ptr)
     nxt = ptr = host_node_ptr->write_head;
     while (nxt != NULL) {
         ptr = ptr->next;
-
-        if (nxt->pooled) {
-            Pthread_mutex_lock(&(host_node_ptr->pool_lock));
-            pool_relablk(host_node_ptr->write_pool, nxt);
-            Pthread_mutex_unlock(&(host_node_ptr->pool_lock));
-        } else {
-#ifdef PER_THREAD_MALLOC
-            free(nxt);
-#else
-            comdb2_free(nxt);
-#endif
-        }
-
+        free_write_data(host_node_ptr, nxt);
         nxt = ptr;
     }
     host_node_ptr->write_head = host_node_ptr->write_tail = NULL;
 
+    nxt = ptr = host_node_ptr->write_prio_head;
+    while (nxt != NULL) {
+        ptr = ptr->next;
+        free_write_data(host_node_ptr, nxt);
+        nxt = ptr;
+    }
+    host_node_ptr->write_prio_head = host_node_ptr->write_prio_tail = NULL;
+
     host_node_ptr->enque_count = 0;
     host_node_ptr->enque_bytes = 0;
 
@@ -1255,6 +1286,11 @@ static int write_message_int(netinfo_type *netinfo_ptr,
 
     wire_header.type = type;
 
+    /* Heartbeats and acks must not wait behind queued bulk messages */
+    if (type == WIRE_HEADER_HEARTBEAT || type == WIRE_HEADER_ACK ||
+        type == WIRE_HEADER_ACK_PAYLOAD)
+        flags |= WRITE_MSG_PRIORITY;
+
     /* Add this message to our linked list to send. */
     rc = write_list(netinfo_ptr, host_node_ptr, &wire_header, iov, iovcount,
                     flags);
@@ -1277,13 +1313,23 @@ static int write_message_int(netinfo_type *netinfo_ptr,
 static int write_message_checkhello(netinfo_type *netinfo_ptr,
                                     host_node_type *host_node_ptr, int type,
                                     const struct iovec *iov, int iovcount,
-                                    int nodelay, int nodrop, int inorder)
+                                    int nodelay, int nodrop, int inorder,
+                                    int priority)
 {
     return write_message_int(netinfo_ptr, host_node_ptr, type, iov, iovcount,
                              (nodelay ? WRITE_MSG_NODELAY : 0) |
                                  WRITE_MSG_NOHELLOCHECK |
                                  (nodrop ? WRITE_MSG_NOLIMIT : 0) |
-                                 (inorder ? WRITE_MSG_INORDER : 0));
+                                 (inorder ? WRITE_MSG_INORDER : 0) |
+                                 (priority ? WRITE_MSG_PRIORITY : 0));
+}
+
+static inline int is_priority_usertype(netinfo_type *netinfo_ptr,
+                                       int usertype)
+{
+    if (usertype < 0 || usertype > MAX_USER_TYPE)
+        return 0;
+    return netinfo_ptr->priority_usertypes[usertype];
 }
 
 static int write_message_nohello(netinfo_type *netinfo_ptr,
@@ -1811,7 +1857,8 @@ int net_send_message_payload_ack(netinfo_type *netinfo_ptr, const char *to_host,
 
     rc = write_message_checkhello(netinfo_ptr, host_node_ptr,
                                   WIRE_HEADER_USER_MSG, iov, 2, 1 /*nodelay*/,
-                                  0, 0);
+                                  0, 0,
+                                  is_priority_usertype(netinfo_ptr, usertype));
 
     if (rc != 0) {
         if (seq_ptr)
@@ -2109,7 +2156,8 @@ static int net_send_int(netinfo_type *netinfo_ptr, const char *host,
 
     rc = write_message_checkhello(netinfo_ptr, host_node_ptr,
                                   WIRE_HEADER_USER_MSG, iov, iovcount, nodelay,
-                                  nodrop, inorder);
+                                  nodrop, inorder,
+                                  is_priority_usertype(netinfo_ptr, usertype));
 
     /* queue is full */
     if (-2 == rc) {
@@ -2326,6 +2374,16 @@ int net_register_handler(netinfo_type *netinfo_ptr, int usertype, NETFP func)
     return 0;
 }
 
+int net_set_priority_usertype(netinfo_type *netinfo_ptr, int usertype)
+{
+    if (usertype < 0 || usertype > MAX_USER_TYPE)
+        return -1;
+
+    netinfo_ptr->priority_usertypes[usertype] = 1;
+
+    return 0;
+}
+
 int is_real_netinfo(netinfo_type *netinfo_ptr)
 {
     if (!netinfo_ptr->fake)
@@ -2565,8 +2623,6 @@ host_node_type *add_to_netinfo(netinfo_type *netinfo_ptr, const char hostname[],
         goto err;
     }
 
-    ptr->user_data_buf = malloc(netinfo_ptr->user_data_buf_size);
-
     if (gbl_verbose_net)
         logmsg(LOGMSG_INFO, "creating %d byte buffer pool for node %s\n",
                 netinfo_ptr->pool_size, hostname);
@@ -2701,7 +2757,8 @@ static void rem_from_netinfo(netinfo_type *netinfo_ptr,
             netinfo_ptr->last_used_node_ptr = NULL;
         }
 
-        if (host_node_ptr->write_head != NULL) {
+        if (host_node_ptr->write_head != NULL ||
+            host_node_ptr->write_prio_head != NULL) {
             /* purge anything pending to be sent */
             Pthread_mutex_lock(&(host_node_ptr->write_lock));
             empty_write_list(host_node_ptr);
@@ -2727,7 +2784,8 @@ static void rem_from_netinfo(netinfo_type *netinfo_ptr,
         comdb2ma_destroy(host_node_ptr->msp);
 #endif
 
-        free(host_node_ptr->user_data_buf);
+        if (host_node_ptr->recvbuf)
+            net_recvbuf_release(host_node_ptr->recvbuf);
 
         free(host_node_ptr);
     }
@@ -3186,6 +3244,12 @@ static netinfo_type *create_netinfo_int(char myhostname[], int myportnum,
         goto fail;
     }
 
+    rc = pthread_mutex_init(&(netinfo_ptr->recvbuf_lk), NULL);
+    if (rc != 0) {
+        logmsg(LOGMSG_ERROR, "create_netinfo: couldn't init recvbuf_lk mutex\n");
+        goto fail;
+    }
+
     netinfo_ptr->pool_size = 512;
     netinfo_ptr->pool_extend = 1024;
     netinfo_ptr->user_data_buf_size = 256 * 1024;
@@ -3413,17 +3477,103 @@ static int read_hostlist(netinfo_type *netinfo_ptr, SBUF2 *sb, char *hosts[],
     return 0;
 }
 
+/* buffer whose message the reader thread is currently delivering */
+static __thread struct net_recvbuf *delivering_recvbuf;
+
+static int recvbuf_sizeclass(netinfo_type *netinfo_ptr, int len)
+{
+    int cls = 0;
+
+    if (len >= netinfo_ptr->user_data_buf_size)
+        return -1;
+    while ((1 << (cls + NET_RECVBUF_MIN_SHIFT)) < len) {
+        if (++cls == NET_RECVBUF_CLASSES)
+            return -1;
+    }
+    return cls;
+}
+
+static struct net_recvbuf *recvbuf_get(netinfo_type *netinfo_ptr, int len)
+{
+    struct net_recvbuf *buf = NULL;
+    int cls = recvbuf_sizeclass(netinfo_ptr, len);
+    int size = cls < 0 ? len : 1 << (cls + NET_RECVBUF_MIN_SHIFT);
+
+    if (cls >= 0) {
+        Pthread_mutex_lock(&(netinfo_ptr->recvbuf_lk));
+        buf = netinfo_ptr->recvbuf_free[cls];
+        if (buf) {
+            netinfo_ptr->recvbuf_free[cls] = buf->next;
+            netinfo_ptr->recvbuf_pooled -= buf->size;
+        }
+        Pthread_mutex_unlock(&(netinfo_ptr->recvbuf_lk));
+    }
+    if (buf == NULL) {
+        buf = mymalloc(offsetof(struct net_recvbuf, data) + size);
+        if (buf == NULL)
+            return NULL;
+        buf->size = size;
+        buf->sizeclass = cls;
+        buf->netinfo = netinfo_ptr;
+    }
+    buf->refcnt = 1;
+    buf->next = NULL;
+    return buf;
+}
+
+/* keep up to 16 full size buffers worth of spares around */
+static void recvbuf_put(struct net_recvbuf *buf)
+{
+    netinfo_type *netinfo_ptr = buf->netinfo;
+
+    if (buf->sizeclass >= 0) {
+        Pthread_mutex_lock(&(netinfo_ptr->recvbuf_lk));
+        if (netinfo_ptr->recvbuf_pooled + buf->size <=
+            16 * netinfo_ptr->user_data_buf_size) {
+            buf->next = netinfo_ptr->recvbuf_free[buf->sizeclass];
+            netinfo_ptr->recvbuf_free[buf->sizeclass] = buf;
+            netinfo_ptr->recvbuf_pooled += buf->size;
+            buf = NULL;
+        }
+        Pthread_mutex_unlock(&(netinfo_ptr->recvbuf_lk));
+    }
+    free(buf);
+}
+
+void *net_recvbuf_hold(const void *data, size_t size, size_t *bufsize)
+{
+    struct net_recvbuf *buf = delivering_recvbuf;
+    const char *p = data;
+
+    if (buf == NULL || p < buf->data || p + size > buf->data + buf->size)
+        return NULL;
+    ATOMIC_ADD(buf->refcnt, 1);
+    *bufsize = buf->size;
+    return buf;
+}
+
+void net_recvbuf_release(void *handle)
+{
+    struct net_recvbuf *buf = handle;
+
+    if (ATOMIC_ADD(buf->refcnt, -1) == 0)
+        recvbuf_put(buf);
+}
+
+/* Returns the message in *recvbuf.  Unless it's the host's cached buffer the
+ * caller must net_recvbuf_release() it when done. */
 static int read_user_data(host_node_type *host_node_ptr, int *type, int *seqnum,
-                          int *needack, int *datalen, void **data,
-                          int *malloced)
+                          int *needack, int *datalen,
+                          struct net_recvbuf **recvbuf)
 {
+    struct net_recvbuf *buf;
     int rc;
     net_send_message_header msghdr;
     uint8_t databf[NET_SEND_MESSAGE_HEADER_LEN], *p_buf, *p_buf_end;
     netinfo_type *netinfo_ptr = host_node_ptr->netinfo_ptr;
     SBUF2 *sb = host_node_ptr->sb;
 
-    *malloced = 0;
+    *recvbuf = NULL;
 
     rc = read_stream(netinfo_ptr, host_node_ptr, sb, &databf, sizeof(databf));
     if (rc != sizeof(msghdr)) {
@@ -3446,33 +3596,40 @@ static int read_user_data(host_node_type *host_node_ptr, int *type, int *seqnum,
         if (netinfo_ptr->trace && debug_switch_net_verbose())
             logmsg(LOGMSG_ERROR, "Reading %d bytes %llu\n", *datalen, gettmms());
 
-        if (*datalen < (netinfo_ptr->user_data_buf_size)) {
-            *data = host_node_ptr->user_data_buf;
-            *malloced = 0;
-        } else {
-            *data = mymalloc(*datalen);
-            *malloced = 1;
+        /* Reuse the host's buffer unless it is the wrong size or a handler
+         * is still holding on to the last message in it. */
+        buf = host_node_ptr->recvbuf;
+        if (buf && (buf->sizeclass !=
+                        recvbuf_sizeclass(netinfo_ptr, *datalen) ||
+                    ATOMIC_ADD(buf->refcnt, 0) != 1)) {
+            net_recvbuf_release(buf);
+            host_node_ptr->recvbuf = buf = NULL;
         }
-
-        if (*data == NULL) {
-            host_node_errf(LOGMSG_ERROR, host_node_ptr, "%s: malloc %d failed\n", __func__,
-                           *datalen);
-            goto fail;
+        if (buf == NULL) {
+            buf = recvbuf_get(netinfo_ptr, *datalen);
+            if (buf == NULL) {
+                host_node_errf(LOGMSG_ERROR, host_node_ptr,
+                               "%s: malloc %d failed\n", __func__, *datalen);
+                goto fail;
+            }
+            if (buf->sizeclass >= 0)
+                host_node_ptr->recvbuf = buf;
         }
-        rc = read_stream(netinfo_ptr, host_node_ptr, sb, *data, *datalen);
+        *recvbuf = buf;
+
+        rc = read_stream(netinfo_ptr, host_node_ptr, sb, buf->data, *datalen);
         if (rc != *datalen) {
             host_node_errf(LOGMSG_ERROR, host_node_ptr,
                            "read_user_data:error reading user_data, "
                            "wanted %d bytes, got %d\n",
                            *datalen, rc);
 
-            if (*malloced)
-                free(*data);
+            if (buf != host_node_ptr->recvbuf)
+                net_recvbuf_release(buf);
+            *recvbuf = NULL;
 
             goto fail;
         }
-    } else {
-        *data = NULL;
     }
 
     return 0;
@@ -3665,23 +3822,24 @@ static int process_user_message(netinfo_type *netinfo_ptr,
 {
     int usertype, seqnum, datalen, needack;
     ack_state_type *ack_state = NULL;
-    void *data;
+    void *data = NULL;
+    struct net_recvbuf *recvbuf;
 
     /* deliver nothing for fake netinfo */
     if (netinfo_ptr->fake || netinfo_ptr->exiting)
         return 0;
 
-
-    int malloced = 0;
-
     int rc = read_user_data(host_node_ptr, &usertype, &seqnum, &needack,
-                            &datalen, &data, &malloced);
+                            &datalen, &recvbuf);
 
     /* fprintf(stderr, "process_user_message from %s, ut=%d\n", host_node_ptr->host, usertype); */
 
     if (rc != 0)
         return -1; /* not sure ... exit the reader thread??? */
 
+    if (recvbuf)
+        data = recvbuf->data;
+
     if (usertype == TYPE_DECOM_NAME ||
         (usertype >= 0 && usertype <= MAX_USER_TYPE &&
          netinfo_ptr->userfuncs[usertype] != NULL)) {
@@ -3716,9 +3874,11 @@ static int process_user_message(netinfo_type *netinfo_ptr,
             Pthread_mutex_unlock(&(host_node_ptr->timestamp_lock));
 
             /* run the user's function */
+            delivering_recvbuf = recvbuf;
             netinfo_ptr->userfuncs[usertype](ack_state, netinfo_ptr->usrptr,
                                              host_node_ptr->host, usertype,
                                              data, datalen, 1);
+            delivering_recvbuf = NULL;
 
             /* update timestamp before checking it */
             Pthread_mutex_lock(&(host_node_ptr->timestamp_lock));
@@ -3736,8 +3896,8 @@ static int process_user_message(netinfo_type *netinfo_ptr,
     if (ack_state)
         free(ack_state);
 
-    if (malloced)
-        free(data);
+    if (recvbuf && recvbuf != host_node_ptr->recvbuf)
+        net_recvbuf_release(recvbuf);
 
     return 0;
 }
@@ -4140,12 +4300,171 @@ static void shutdown_other_hostnodes(host_node_type *host_node_ptr)
 }
 
 
+/* Fill in the wire header of a queued message with the details of our
+ * current connection. */
+static void set_wire_header(netinfo_type *netinfo_ptr,
+                            host_node_type *host_node_ptr, write_data *item)
+{
+    wire_header_type *wire_header, tmp_wire_hdr;
+    uint8_t *p_buf, *p_buf_end;
+
+    wire_header = &item->payload.header;
+    if (netinfo_ptr->myhostname_len >= HOSTNAME_LEN) {
+        snprintf(tmp_wire_hdr.fromhost, sizeof(tmp_wire_hdr.fromhost), ".%d",
+                 netinfo_ptr->myhostname_len);
+    } else {
+        strncpy(tmp_wire_hdr.fromhost, netinfo_ptr->myhostname,
+                sizeof(tmp_wire_hdr.fromhost));
+    }
+    tmp_wire_hdr.fromport = netinfo_ptr->myport;
+    tmp_wire_hdr.fromnode = 0;
+    if (host_node_ptr->hostname_len >= HOSTNAME_LEN) {
+        snprintf(tmp_wire_hdr.tohost, sizeof(tmp_wire_hdr.tohost), ".%d",
+                 host_node_ptr->hostname_len);
+    } else {
+        strncpy(tmp_wire_hdr.tohost, host_node_ptr->host,
+                sizeof(tmp_wire_hdr.tohost));
+    }
+    tmp_wire_hdr.toport = host_node_ptr->port;
+    tmp_wire_hdr.tonode = 0;
+    tmp_wire_hdr.type = wire_header->type;
+
+    /* This shouldn't happen.. but for a while it was happening
+     * due to various races. */
+    if (tmp_wire_hdr.toport == 0)
+        host_node_errf(LOGMSG_WARN, host_node_ptr, "PORT IS ZERO! type %d\n",
+                       tmp_wire_hdr.type);
+
+    p_buf = (uint8_t *)wire_header;
+    p_buf_end = ((uint8_t *)wire_header + sizeof(*wire_header));
+
+    /* endianize this */
+    net_wire_header_put(&tmp_wire_hdr, p_buf, p_buf_end);
+}
+
+/* Write a batch of queued messages.  On a plaintext connection this is a
+ * writev() straight out of the queued payloads; SSL connections go through
+ * the sbuf one message at a time. */
+static int write_batch(netinfo_type *netinfo_ptr, host_node_type *host_node_ptr,
+                       struct iovec *iov, int niov)
+{
+    SBUF2 *sb = host_node_ptr->sb;
+    watchlist_node_type *watchlist_node = NULL;
+    ssize_t nwrite;
+    int ii;
+
+    if (!gbl_net_writev || sslio_has_ssl(sb)) {
+        for (ii = 0; ii < niov; ii++) {
+            if (write_stream(netinfo_ptr, host_node_ptr, sb, iov[ii].iov_base,
+                             iov[ii].iov_len) < 0)
+                return -1;
+        }
+        return 0;
+    }
+
+    /* anything already in the sbuf goes out first */
+    if (sbuf2flush(sb) < 0)
+        return -1;
+
+    /* keep the watchlist's stuck write detection working */
+    if (sbuf2getw(sb) == net_writes)
+        watchlist_node = sbuf2getuserptr(sb);
+    if (watchlist_node)
+        watchlist_node->write_age = time_epoch();
+
+    while (niov > 0) {
+        nwrite = writev(sbuf2fileno(sb), iov, niov);
+        if (nwrite < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        netinfo_ptr->stats.bytes_written += nwrite;
+        host_node_ptr->stats.bytes_written += nwrite;
+
+        /* skip what was written, and resume a partial write */
+        while (niov > 0 && nwrite >= iov->iov_len) {
+            nwrite -= iov->iov_len;
+            iov++;
+            niov--;
+        }
+        if (niov > 0) {
+            iov->iov_base = (char *)iov->iov_base + nwrite;
+            iov->iov_len -= nwrite;
+        }
+    }
+
+    if (watchlist_node)
+        watchlist_node->write_age = 0;
+
+    return niov > 0 ? -1 : 0;
+}
+
+enum { NET_WRITEV_BATCH = 64 };
+
+/* Write and free a list of queued messages, NET_WRITEV_BATCH at a time.
+ * Between batches of the bulk lane (prio == 0) anything that arrived on the
+ * priority lane is written first, so heartbeats and acks never sit behind a
+ * large backlog of log records.  Once rc is negative the remaining messages
+ * are just freed.  Called with write_lock held. */
+static int write_queued(netinfo_type *netinfo_ptr,
+                        host_node_type *host_node_ptr, write_data *list,
+                        int prio, int rc, int *flags)
+{
+    struct iovec iov[NET_WRITEV_BATCH];
+    write_data *batch[NET_WRITEV_BATCH];
+    write_data *prio_list, *ptr;
+    int niov, ii;
+
+    while (list != NULL) {
+        for (niov = 0; list != NULL && niov < NET_WRITEV_BATCH;
+             list = list->next) {
+            batch[niov] = list;
+            if (!host_node_ptr->closed && rc >= 0) {
+                set_wire_header(netinfo_ptr, host_node_ptr, list);
+                iov[niov].iov_base = list->payload.raw;
+                iov[niov].iov_len = list->len;
+                *flags |= list->flags;
+            }
+            niov++;
+        }
+
+        if (!host_node_ptr->closed && rc >= 0)
+            rc = write_batch(netinfo_ptr, host_node_ptr, iov, niov);
+        else
+            rc = -1;
+
+        for (ii = 0; ii < niov; ii++)
+            free_write_data(host_node_ptr, batch[ii]);
+
+        /* let the priority lane cut in */
+        if (list && !prio && host_node_ptr->write_prio_head != NULL) {
+            Pthread_mutex_lock(&(host_node_ptr->enquelk));
+            prio_list = host_node_ptr->write_prio_head;
+            host_node_ptr->write_prio_head = host_node_ptr->write_prio_tail =
+                NULL;
+            for (ptr = prio_list; ptr != NULL; ptr = ptr->next) {
+                host_node_ptr->enque_count--;
+                host_node_ptr->enque_bytes -= ptr->len;
+            }
+            Pthread_mutex_unlock(&(host_node_ptr->enquelk));
+
+            rc = write_queued(netinfo_ptr, host_node_ptr, prio_list, 1, rc,
+                              flags);
+            if (rc >= 0 && (*flags & WRITE_MSG_NODELAY))
+                sbuf2flush(host_node_ptr->sb);
+        }
+    }
+
+    return rc;
+}
+
 static void *writer_thread(void *args)
 {
     netinfo_type *netinfo_ptr;
     host_node_type *host_node_ptr;
-    write_data *write_list_ptr, *write_list_back;
-    int rc, flags, maxage;
+    write_data *write_list_ptr;
+    int rc, flags;
     int th_start_time = time_epoch();
     struct timespec waittime;
 #ifndef HAS_CLOCK_GETTIME
@@ -4170,12 +4489,17 @@ static void *writer_thread(void *args)
 
     while (!host_node_ptr->decom_flag && !host_node_ptr->closed &&
            !netinfo_ptr->exiting) {
-        while (host_node_ptr->write_head != NULL) {
+        while (host_node_ptr->write_head != NULL ||
+               host_node_ptr->write_prio_head != NULL) {
+            write_data *prio_list_ptr;
             unsigned count, bytes;
             int start_time, end_time, diff_time;
 
-            /* grab the entire list and reset enqueue counters */
-            write_list_back = write_list_ptr = host_node_ptr->write_head;
+            /* grab both lanes and reset enqueue counters */
+            prio_list_ptr = host_node_ptr->write_prio_head;
+            host_node_ptr->write_prio_head = host_node_ptr->write_prio_tail =
+                NULL;
+            write_list_ptr = host_node_ptr->write_head;
             host_node_ptr->write_head = host_node_ptr->write_tail = NULL;
             count = host_node_ptr->enque_count;
             bytes = host_node_ptr->enque_bytes;
@@ -4187,86 +4511,14 @@ static void *writer_thread(void *args)
 
             pthread_cond_broadcast(&(host_node_ptr->throttle_wakeup));
 
-            rc = 0;
             flags = 0;
-            maxage = 0;
 
             Pthread_mutex_lock(&(host_node_ptr->write_lock));
             start_time = time_epoch();
-            while (write_list_ptr != NULL) {
-                /* stop writing if we've hit an error or if we've disconnected
-                 */
-                if (!host_node_ptr->closed && rc >= 0) {
-                    int age;
-                    wire_header_type *wire_header, tmp_wire_hdr;
-                    uint8_t *p_buf, *p_buf_end;
-
-                    if (flags & WRITE_MSG_NODELAY) {
-                        age = time_epoch() - write_list_ptr->enque_time;
-                        if (age > maxage)
-                            maxage = age;
-                    }
-
-                    /* File in the wire header with correct details for our
-                     * current connection. */
-
-                    wire_header = &write_list_ptr->payload.header;
-                    if (netinfo_ptr->myhostname_len >= HOSTNAME_LEN) {
-                        snprintf(tmp_wire_hdr.fromhost,
-                                 sizeof(tmp_wire_hdr.fromhost), ".%d",
-                                 netinfo_ptr->myhostname_len);
-                    } else {
-                        strncpy(tmp_wire_hdr.fromhost, netinfo_ptr->myhostname,
-                                sizeof(tmp_wire_hdr.fromhost));
-                    }
-                    tmp_wire_hdr.fromport = netinfo_ptr->myport;
-                    tmp_wire_hdr.fromnode = 0;
-                    if (host_node_ptr->hostname_len >= HOSTNAME_LEN) {
-                        snprintf(tmp_wire_hdr.tohost,
-                                 sizeof(tmp_wire_hdr.tohost), ".%d",
-                                 host_node_ptr->hostname_len);
-                    } else {
-                        strncpy(tmp_wire_hdr.tohost, host_node_ptr->host,
-                                sizeof(tmp_wire_hdr.tohost));
-                    }
-                    tmp_wire_hdr.toport = host_node_ptr->port;
-                    tmp_wire_hdr.tonode = 0;
-                    tmp_wire_hdr.type = wire_header->type;
-
-                    /* This shouldn't happen.. but for a while it was happening
-                     * due to various races. */
-                    if (tmp_wire_hdr.toport == 0)
-                        host_node_errf(LOGMSG_WARN, host_node_ptr, "PORT IS ZERO! type %d\n",
-                                       tmp_wire_hdr.type);
-
-                    p_buf = (uint8_t *)wire_header;
-                    p_buf_end = ((uint8_t *)wire_header + sizeof(*wire_header));
-
-                    /* endianize this */
-                    net_wire_header_put(&tmp_wire_hdr, p_buf, p_buf_end);
-
-                    rc = write_stream(
-                        netinfo_ptr, host_node_ptr, host_node_ptr->sb,
-                        write_list_ptr->payload.raw, write_list_ptr->len);
-                    flags |= write_list_ptr->flags;
-                } else
-                    rc = -1;
-
-                write_list_back = write_list_ptr;
-                write_list_ptr = write_list_ptr->next;
-
-                if (write_list_back->pooled) {
-                    Pthread_mutex_lock(&(host_node_ptr->pool_lock));
-                    pool_relablk(host_node_ptr->write_pool, write_list_back);
-                    Pthread_mutex_unlock(&(host_node_ptr->pool_lock));
-                } else {
-#ifdef PER_THREAD_MALLOC
-                    free(write_list_back);
-#else
-                    comdb2_free(write_list_back);
-#endif
-                }
-            }
+            rc = write_queued(netinfo_ptr, host_node_ptr, prio_list_ptr, 1, 0,
+                              &flags);
+            rc = write_queued(netinfo_ptr, host_node_ptr, write_list_ptr, 0, rc,
+                              &flags);
             /* we seem to set nodelay on virtually every message.  try to get
              * slightly better streaming performance by moving the flush out of
              * the main loop. */
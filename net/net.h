@@ -112,6 +112,17 @@ int net_send_inorder(netinfo_type *netinfo,
    user messages of type "usertype" are recieved */
 int net_register_handler(netinfo_type *netinfo_ptr, int usertype, NETFP func);
 
+/* send user messages of type "usertype" on the priority lane, ahead of
+   anything already queued for the node */
+int net_set_priority_usertype(netinfo_type *netinfo_ptr, int usertype);
+
+/* called from inside a user message callback: if [data, data+size) lies in
+   the message being delivered, pin its buffer and return a handle for
+   net_recvbuf_release(), with the size of the pinned buffer in *bufsize;
+   otherwise return NULL and the caller must copy */
+void *net_recvbuf_hold(const void *data, size_t size, size_t *bufsize);
+void net_recvbuf_release(void *handle);
+
 /* register your callback routine that will be called when a
    disconnect happens for a node */
 int net_register_hostdown(netinfo_type *netinfo_ptr, HOSTDOWNFP func);
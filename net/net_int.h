@@ -41,7 +41,8 @@ enum {
     WRITE_MSG_NOHELLOCHECK = 4,
     WRITE_MSG_NODUPE = 8,
     WRITE_MSG_NOLIMIT = 16,
-    WRITE_MSG_INORDER = 32
+    WRITE_MSG_INORDER = 32,
+    WRITE_MSG_PRIORITY = 64
 };
 
 typedef struct {
@@ -85,6 +86,22 @@ typedef struct seq_node_data {
 
 struct host_node_tag;
 struct netinfo_struct;
+
+/* User messages are read into refcounted buffers so a handler can keep
+ * pointers into a message after it returns (see net_recvbuf_hold()).
+ * Buffers come in power of two size classes and are recycled through a
+ * per-netinfo freelist. */
+#define NET_RECVBUF_MIN_SHIFT 10
+#define NET_RECVBUF_CLASSES 10
+
+struct net_recvbuf {
+    int refcnt;
+    int size;
+    int sizeclass; /* -1 for oversized one-off buffers */
+    struct netinfo_struct *netinfo;
+    struct net_recvbuf *next;
+    char data[1];
+};
 struct watchlist_node_tag;
 
 typedef struct watchlist_node_tag {
@@ -143,6 +160,10 @@ struct host_node_tag {
     arch_tid writer_thread_arch_tid;
     write_data *write_head;
     write_data *write_tail;
+    /* Priority lane: heartbeats, acks and priority user messages.  The
+     * writer drains this ahead of, and in between batches of, write_head. */
+    write_data *write_prio_head;
+    write_data *write_prio_tail;
     seq_data *wait_list;
     pthread_mutex_t lock;
     pthread_mutex_t enquelk;
@@ -192,7 +213,7 @@ struct host_node_tag {
     comdb2ma msp;
 #endif
 
-    void *user_data_buf;
+    struct net_recvbuf *recvbuf;
 
     HostInfo udp_info;
     int num_sends;
@@ -246,11 +267,16 @@ struct netinfo_struct {
     int accept_on_child;
 
     NETFP *userfuncs[MAX_USER_TYPE + 1];
+    /* user message types sent on the priority lane */
+    uint8_t priority_usertypes[MAX_USER_TYPE + 1];
     decom_type *decomhead;
     pthread_mutex_t seqlock;
     pthread_rwlock_t lock;
     pthread_mutex_t watchlk;
     pthread_mutex_t sanclk;
+    pthread_mutex_t recvbuf_lk;
+    struct net_recvbuf *recvbuf_free[NET_RECVBUF_CLASSES];
+    int recvbuf_pooled; /* bytes on the freelists */
     pthread_t accept_thread_id;
     pthread_t heartbeat_send_thread_id;
     pthread_t heartbeat_check_thread_id;
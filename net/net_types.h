@@ -84,6 +84,7 @@ enum {
     NET_OSQL_SOCK_REQ_COST_UUID = 169,
     NET_AUTHENTICATION_CHECK = 170,
     NET_OSQL_UUID_REQUEST_MAX,
+    NET_OSQL_BATCH_RPL = 172, /* several osql replies in one message */
 
     MAX_USER_TYPE
 };
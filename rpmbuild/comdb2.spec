@@ -7,8 +7,8 @@ License:        Various
 URL:            http://github.com/bloomberg/comdb2
 Source0:        comdb2-VVEERRSSIIOONN.tar.gz
 
-BuildRequires:  gcc gcc-c++ protobuf-c libunwind libunwind-devel protobuf-c-devel byacc flex openssl openssl-devel openssl-libs readline readline-devel sqlite sqlite-devel libuuid libuuid-devel zlib-devel zlib lz4-devel gawk tcl
-Requires:       protobuf-c libunwind openssl openssl-libs readline sqlite libuuid zlib lz4
+BuildRequires:  gcc gcc-c++ protobuf-c libunwind libunwind-devel protobuf-c-devel byacc flex openssl openssl-devel openssl-libs readline readline-devel sqlite sqlite-devel libuuid libuuid-devel zlib-devel zlib lz4-devel libzstd-devel gawk tcl
+Requires:       protobuf-c libunwind openssl openssl-libs readline sqlite libuuid zlib lz4 libzstd
 
 %description
 Comdb2 is a distributed relational database.
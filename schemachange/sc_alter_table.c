@@ -530,6 +530,26 @@ int do_alter_table_int(struct schema_change_type *s, struct ireq *iniq)
                          newdb->instant_schema_change, newdb->version,
                          s->compress, s->compress_blobs, datacopy_odh);
 
+    /* rewritten records get a zstd dictionary trained on the current ones
+     * (or the one trained before we were interrupted); data files that are
+     * kept need the dictionary they were written with */
+    if (!newdb->plan || newdb->plan->dta_plan == -1) {
+        if (s->compress != BDB_COMPRESS_ZSTD)
+            rc = 0;
+        else if (s->resume)
+            rc = bdb_zstd_dict_load(newdb->handle, NULL, 1);
+        else if ((rc = bdb_zstd_dict_train(newdb->handle, db->handle)) == 0)
+            rc = bdb_zstd_dict_save(newdb->handle, NULL, 1);
+    } else {
+        rc = bdb_zstd_dict_copy(newdb->handle, db->handle);
+    }
+    if (rc) {
+        sc_errf(s, "failed setting up zstd dictionary\n");
+        delete_temp_table(s, newdb);
+        change_schemas_recover(s->table);
+        return -1;
+    }
+
     /* set sc_genids, 0 them if we are starting a new schema change, or
      * restore them to their previous values if we are resuming */
     if (init_sc_genids(newdb, s)) {
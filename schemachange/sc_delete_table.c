@@ -41,6 +41,7 @@ int delete_table(char *table)
     MEMORY_SYNC;
     delete_schema(table);
     bdb_del_table_csonparameters(NULL, table);
+    bdb_del_table_zstd_dict(NULL, table, 0);
     return 0;
 }
 
@@ -172,6 +172,8 @@ int appsock_schema_change(SBUF2 *sb, int *keepsocket)
             sc.compress = BDB_COMPRESS_CRLE;
         else if (strcmp(tok, "rec_lz4") == 0)
             sc.compress = BDB_COMPRESS_LZ4;
+        else if (strcmp(tok, "rec_zstd") == 0)
+            sc.compress = BDB_COMPRESS_ZSTD;
         else if (strcmp(tok, "rec_nocompress") == 0)
             sc.compress = BDB_COMPRESS_NONE;
 
@@ -181,6 +183,8 @@ int appsock_schema_change(SBUF2 *sb, int *keepsocket)
             sc.compress_blobs = BDB_COMPRESS_RLE8;
         else if (strcmp(tok, "blob_lz4") == 0)
             sc.compress_blobs = BDB_COMPRESS_LZ4;
+        else if (strcmp(tok, "blob_zstd") == 0)
+            sc.compress_blobs = BDB_COMPRESS_ZSTD;
         else if (strcmp(tok, "blob_nocompress") == 0)
             sc.compress_blobs = BDB_COMPRESS_NONE;
 
@@ -76,6 +76,58 @@ static inline int tbl_had_writes(struct convert_record_data *data)
     return (data->write_count - oldcount) != 0;
 }
 
+static inline int sorted_batches(struct convert_record_data *data)
+{
+    return data->bulk != NULL && !data->bulk_off;
+}
+
+/* aborts the conversion transaction; the records of an open batch are
+ * dropped and will be read and converted again */
+static void abort_convert_trans(struct convert_record_data *data)
+{
+    trans_abort(&data->iq, data->trans);
+    data->trans = NULL;
+    if (data->bulk) {
+        data->nrecs -= data->bulk_nrecs;
+        data->bulk_nrecs = 0;
+        sorted_keys_reset(data->bulk);
+    }
+}
+
+/* adds the keys of the open batch in key order
+ * ret code: 0 keys added, 1 batch aborted and to be redone, -2 on failure */
+static int add_sorted_keys(struct convert_record_data *data)
+{
+    int rc, blkpos = 0, ixfailnum = -1;
+
+    rc = sorted_keys_add(&data->iq, data->trans, data->bulk, &blkpos,
+                         &ixfailnum, NULL);
+    if (rc == 0)
+        return 0;
+
+    abort_convert_trans(data);
+    if (rc == RC_INTERNAL_RETRY) {
+        data->num_retry_errors++;
+        data->totnretries++;
+        if (data->cmembers->is_decrease_thrds)
+            decrease_max_threads(&data->cmembers->maxthreads);
+        else
+            poll(0, 0, (rand() % 500 + 10));
+        return 1;
+    } else if (rc == IX_DUP) {
+        /* redo it one record per transaction, so the duplicate is
+         * reported or skipped the usual way */
+        sc_printf(data->s, "duplicate entry in index %d, stripe %d stops "
+                           "sorting keys\n",
+                  ixfailnum, data->stripe);
+        data->bulk_off = 1;
+        return 1;
+    }
+    sc_errf(data->s, "Error adding sorted keys rcode %d ixfailnum %d\n", rc,
+            ixfailnum);
+    return -2;
+}
+
 /* prints global stats if not printed in the last sc_report_freq,
  * returns 1 if successful
  */
@@ -317,6 +369,12 @@ void convert_record_data_cleanup(struct convert_record_data *data)
         data->dta_buf = NULL;
     }
 
+    if (data->bulk) {
+        sorted_keys_destroy(data->bulk);
+        data->bulk = NULL;
+        data->iq.sorted_keys = NULL;
+    }
+
     if (data->rec) {
         free_db_record(data->rec);
         data->rec = NULL;
@@ -339,7 +397,8 @@ static void delay_sc_if_needed(struct convert_record_data *data,
     int rc;
 
     /* wait for replication on what we just committed */
-    if ((data->nrecs % data->num_records_per_trans) == 0) {
+    if (sorted_batches(data) ||
+        (data->nrecs % data->num_records_per_trans) == 0) {
         if ((rc = trans_wait_for_seqnum(&data->iq, gbl_mynode, ss)) != 0) {
             sc_errf(data->s, "delay_sc_if_needed: error waiting for "
                     "replication rcode %d\n",
@@ -433,7 +492,8 @@ static int convert_record(struct convert_record_data *data)
         sc_errf(data->s, "Schema change aborted\n");
         return -1;
     }
-    if (tbl_had_writes(data)) {
+    /* don't back off holding the locks of an open batch */
+    if (data->trans == NULL && tbl_had_writes(data)) {
         usleep(gbl_sc_usleep);
         return 1;
     }
@@ -446,6 +506,12 @@ static int convert_record(struct convert_record_data *data)
             return -2;
         }
         set_tran_lowpri(&data->iq, data->trans);
+
+        /* a batch reads ahead of sc_genids, which live schema change only
+         * moves once the batch is ready to commit */
+        if (sorted_batches(data))
+            memcpy(data->bulk_genids, data->sc_genids,
+                   gbl_dtastripe * sizeof(unsigned long long));
     }
 
     data->iq.debug = debug_this_request(gbl_debug_until);
@@ -480,9 +546,11 @@ static int convert_record(struct convert_record_data *data)
     data->iq.timeoutms = gbl_sc_timeoutms;
 
     if (data->scanmode == SCAN_PARALLEL) {
-        rc = dtas_next(&data->iq, data->sc_genids, &genid, &data->stripe, 1,
-                       data->dta_buf, data->trans, data->from->lrl, &dtalen,
-                       NULL);
+        rc = dtas_next(&data->iq,
+                       sorted_batches(data) ? data->bulk_genids
+                                            : data->sc_genids,
+                       &genid, &data->stripe, 1, data->dta_buf, data->trans,
+                       data->from->lrl, &dtalen, NULL);
         if (rc == 0) {
             dta = data->dta_buf;
             check_genid = bdb_normalise_genid(data->to->handle, genid);
@@ -503,14 +571,19 @@ static int convert_record(struct convert_record_data *data)
 
             // AZ: determine what locks we hold at this time
             // bdb_dump_active_locks(data->to->handle, stdout);
+            if (data->bulk_nrecs > 0) {
+                if ((rc = add_sorted_keys(data)) != 0)
+                    return rc;
+                gbl_sc_nrecs += data->bulk_nrecs;
+                data->bulk_nrecs = 0;
+            }
             data->sc_genids[data->stripe] = -1ULL;
 
             sc_printf(data->s, "finished stripe %d, setting genid %llx\n",
                       data->stripe, data->sc_genids[data->stripe]);
             return 0;
         } else if (rc == RC_INTERNAL_RETRY) {
-            trans_abort(&data->iq, data->trans);
-            data->trans = NULL;
+            abort_convert_trans(data);
 
             data->totnretries++;
             if (data->cmembers->is_decrease_thrds)
@@ -618,8 +691,7 @@ static int convert_record(struct convert_record_data *data)
             data->blobix, data->blb.bloblens, data->blb.bloboffs,
             (void **)data->blb.blobptrs, &args, &bdberr);
         if (blobrc != 0 && bdberr == BDBERR_DEADLOCK) {
-            trans_abort(&data->iq, data->trans);
-            data->trans = NULL;
+            abort_convert_trans(data);
             data->totnretries++;
             if (data->cmembers->is_decrease_thrds)
                 decrease_max_threads(&data->cmembers->maxthreads);
@@ -758,6 +830,9 @@ static int convert_record(struct convert_record_data *data)
     if (data->to->plan && gbl_use_plan)
         addflags |= RECFLAGS_NO_BLOBS;
 
+    if (sorted_batches(data))
+        addflags |= RECFLAGS_SORTED_KEYS;
+
     int rebuild = (data->to->plan && data->to->plan->dta_plan) ||
                   schema_change == SC_CONSTRAINT_CHANGE;
 
@@ -838,8 +913,7 @@ err: /*if (is_schema_change_doomed())*/
 
     /* if we should retry the operation */
     if (rc == RC_INTERNAL_RETRY) {
-        trans_abort(&data->iq, data->trans);
-        data->trans = NULL;
+        abort_convert_trans(data);
         data->num_retry_errors++;
         data->totnretries++;
         if (data->cmembers->is_decrease_thrds)
@@ -848,6 +922,12 @@ err: /*if (is_schema_change_doomed())*/
             poll(0, 0, (rand() % 500 + 10));
         return 1;
     } else if (rc == IX_DUP) {
+        if (sorted_batches(data)) {
+            /* redo the batch one record per transaction */
+            abort_convert_trans(data);
+            data->bulk_off = 1;
+            return 1;
+        }
         if (data->scanmode == SCAN_PARALLEL && data->s->rebuild_index) {
             /* if we are resuming an index rebuild schemachange,
              * and the stored llmeta genid is stale, some of the records
@@ -885,7 +965,17 @@ err: /*if (is_schema_change_doomed())*/
 
     /* Advance our progress markers */
     data->nrecs++;
+    int ncommit = 1;
     if (data->scanmode == SCAN_PARALLEL) {
+        if (sorted_batches(data)) {
+            data->bulk_genids[data->stripe] = genid;
+            if (++data->bulk_nrecs < data->bulk_max)
+                return 1;
+            if ((rc = add_sorted_keys(data)) != 0)
+                return rc;
+            ncommit = data->bulk_nrecs;
+            data->bulk_nrecs = 0;
+        }
         data->sc_genids[data->stripe] = genid;
     }
 
@@ -910,7 +1000,7 @@ err: /*if (is_schema_change_doomed())*/
     if (data->live)
         delay_sc_if_needed(data, &ss);
 
-    gbl_sc_nrecs++;
+    gbl_sc_nrecs += ncommit;
 
     int now = time_epoch();
     if ((rc = report_sc_progress(data, now)))
@@ -974,6 +1064,14 @@ void *convert_records_thd(struct convert_record_data *data)
     data->num_records_per_trans = gbl_num_record_converts;
     data->num_retry_errors = 0;
 
+    data->bulk_max =
+        bdb_attr_get(data->from->dbenv->bdb_attr, BDB_ATTR_SC_SORTED_KEYS_BATCH);
+    if (data->bulk_max > 1 && data->scanmode == SCAN_PARALLEL &&
+        schema_change != SC_CONSTRAINT_CHANGE) {
+        data->bulk = sorted_keys_create();
+        data->iq.sorted_keys = data->bulk;
+    }
+
     if (gbl_pg_compact_thresh > 0) {
         /* Disable page compaction only if page compaction is enabled. */
         (void)pthread_setspecific(no_pgcompact, (void *)1);
@@ -1009,6 +1107,11 @@ void *convert_records_thd(struct convert_record_data *data)
         data->outrc = rc;
     }
 
+    if (data->trans && data->bulk_nrecs > 0) {
+        /* batch left open by a failure, its keys were never added */
+        abort_convert_trans(data);
+    }
+
     if (data->trans) {
         /* can only get here for non-live schema change, shouldn't ever get here
          * now since bulk transactions have been disabled in all schema changes
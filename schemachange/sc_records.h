@@ -55,6 +55,11 @@ struct convert_record_data {
     int *tagmap; // mapping of fields from -> to
     struct common_members *cmembers;
     unsigned int write_count; // saved write counter to this tbl
+    struct sorted_keys *bulk; // keys of the open batch, SC_SORTED_KEYS_BATCH
+    unsigned long long bulk_genids[MAXDTASTRIPE]; // read position of the batch
+    int bulk_max;   // records per batch
+    int bulk_nrecs; // records converted in the open batch
+    int bulk_off;   // batching turned off for this thread
 };
 
 int convert_all_records(struct db *from, struct db *to,
@@ -392,6 +392,11 @@ int set_header_and_properties(void *tran, struct db *newdb,
         sc_errf(s, "Failed to set bthash size in meta\n");
         return SC_TRANSACTION_FAILED;
     }
+
+    if (bdb_zstd_dict_save(newdb->handle, tran, 0)) {
+        sc_errf(s, "Failed to save zstd dictionary in llmeta\n");
+        return SC_TRANSACTION_FAILED;
+    }
     return SC_OK;
 }
 
@@ -999,6 +1004,9 @@ int set_odh_options_tran(struct db *db, void *trans, int *bdberr)
                          db->instant_schema_change, db->version, compr,
                          blob_compr, datacopy_odh);
 
+    if (bdb_zstd_dict_load(db->handle, trans, 0))
+        return -1;
+
     if (db->version < 0)
         return -1;
 
@@ -223,6 +223,8 @@ void fillTableOption(struct schema_change_type* sc, int opt)
         sc->compress_blobs = BDB_COMPRESS_ZLIB;
     else if (OPT_ON(opt, BLOB_LZ4))
         sc->compress_blobs = BDB_COMPRESS_LZ4;
+    else if (OPT_ON(opt, BLOB_ZSTD))
+        sc->compress_blobs = BDB_COMPRESS_ZSTD;
 
     sc->compress = -1;
     if (OPT_ON(opt, REC_NONE))
@@ -235,6 +237,8 @@ void fillTableOption(struct schema_change_type* sc, int opt)
         sc->compress = BDB_COMPRESS_ZLIB;
     else if (OPT_ON(opt, REC_LZ4))
         sc->compress = BDB_COMPRESS_LZ4;
+    else if (OPT_ON(opt, REC_ZSTD))
+        sc->compress = BDB_COMPRESS_ZSTD;
 
     if (OPT_ON(opt, FORCE_REBUILD))
         sc->force_rebuild = 1;
@@ -27,6 +27,9 @@
 
 #define FORCE_REBUILD 0x2000
 
+#define BLOB_ZSTD     0x4000
+#define REC_ZSTD      0x8000
+
 #define REBUILD_ALL     1
 #define REBUILD_DATA    2
 #define REBUILD_BLOB    4
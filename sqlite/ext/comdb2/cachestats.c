@@ -0,0 +1,238 @@
+/*
+**
+** Vtables interface for Schema Tables.
+**
+** Though this is technically an extension, currently it must be
+** built as part of SQLITE_CORE, as comdb2 does not support
+** run time extensions at this time.
+**
+** For a little while we had to use our own "fake" tables, because
+** eponymous system tables did not exist. Now that they do, we
+** have moved schema tables to their own extension.
+**
+** We have piggy backed off of SQLITE_BUILDING_FOR_COMDB2 here, though
+** a new #define would also suffice.
+*/
+#if (!defined(SQLITE_CORE) || defined(SQLITE_BUILDING_FOR_COMDB2)) \
+    && !defined(SQLITE_OMIT_VIRTUALTABLE)
+
+#if defined(SQLITE_BUILDING_FOR_COMDB2) && !defined(SQLITE_CORE)
+# define SQLITE_CORE 1
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "comdb2.h"
+#include "comdb2systbl.h"
+#include "comdb2systblInt.h"
+
+/* systbl_cachestats_cursor is a subclass of sqlite3_vtab_cursor which
+** serves as the underlying cursor to enumerate the rows in this
+** vtable. The bufferpool counters are snapshotted when the scan starts.
+*/
+typedef struct systbl_cachestats_cursor systbl_cachestats_cursor;
+struct systbl_cachestats_cursor {
+  sqlite3_vtab_cursor base;  /* Base class - must be first */
+  sqlite3_int64 iRowid;      /* The rowid */
+  struct bdb_cache_file_stats *stats;
+  int nfiles;
+};
+
+static int systblCacheStatsConnect(
+  sqlite3 *db,
+  void *pAux,
+  int argc,
+  const char *const*argv,
+  sqlite3_vtab **ppVtab,
+  char **pErr
+){
+  sqlite3_vtab *pNew;
+  int rc;
+
+/* Column numbers */
+#define STCS_FILE      0
+#define STCS_PAGESIZE  1
+#define STCS_HITS      2
+#define STCS_MISSES    3
+#define STCS_HITRATIO  4
+#define STCS_PAGESIN   5
+#define STCS_PAGESOUT  6
+#define STCS_PROMOTED  7
+
+  rc = sqlite3_declare_vtab(db, "CREATE TABLE comdb2_cachestats(filename, "
+    "pagesize, hits, misses, hit_ratio, pages_in, pages_out, promoted)");
+  if( rc==SQLITE_OK ){
+    pNew = *ppVtab = sqlite3_malloc( sizeof(*pNew) );
+    if( pNew==0 ) return SQLITE_NOMEM;
+    memset(pNew, 0, sizeof(*pNew));
+  }
+  return rc;
+}
+
+/*
+** Destructor for sqlite3_vtab objects.
+*/
+static int systblCacheStatsDisconnect(sqlite3_vtab *pVtab){
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+/*
+** Constructor for systbl_cachestats_cursor objects.
+*/
+static int systblCacheStatsOpen(sqlite3_vtab *p, sqlite3_vtab_cursor **ppCursor){
+  systbl_cachestats_cursor *pCur;
+
+  pCur = sqlite3_malloc( sizeof(*pCur) );
+  if( pCur==0 ) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+/*
+** Destructor for systbl_cachestats_cursor.
+*/
+static int systblCacheStatsClose(sqlite3_vtab_cursor *cur){
+  systbl_cachestats_cursor *pCur = (systbl_cachestats_cursor*)cur;
+
+  bdb_free_cache_file_stats(pCur->stats, pCur->nfiles);
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+/*
+** Advance to the next file.
+*/
+static int systblCacheStatsNext(sqlite3_vtab_cursor *cur){
+  systbl_cachestats_cursor *pCur = (systbl_cachestats_cursor*)cur;
+
+  pCur->iRowid++;
+  return SQLITE_OK;
+}
+
+/*
+** Return the counters for the current file.
+*/
+static int systblCacheStatsColumn(
+  sqlite3_vtab_cursor *cur,
+  sqlite3_context *ctx,
+  int i
+){
+  systbl_cachestats_cursor *pCur = (systbl_cachestats_cursor*)cur;
+  struct bdb_cache_file_stats *st = &pCur->stats[pCur->iRowid];
+
+  switch( i ){
+    case STCS_FILE: {
+      sqlite3_result_text(ctx, st->filename, -1, NULL);
+      break;
+    }
+    case STCS_PAGESIZE: {
+      sqlite3_result_int64(ctx, (sqlite3_int64)st->pagesize);
+      break;
+    }
+    case STCS_HITS: {
+      sqlite3_result_int64(ctx, (sqlite3_int64)st->hits);
+      break;
+    }
+    case STCS_MISSES: {
+      sqlite3_result_int64(ctx, (sqlite3_int64)st->misses);
+      break;
+    }
+    case STCS_HITRATIO: {
+      if( st->hits + st->misses == 0 ){
+        sqlite3_result_null(ctx);
+      }else{
+        sqlite3_result_double(ctx,
+          (double)st->hits / ((double)st->hits + st->misses));
+      }
+      break;
+    }
+    case STCS_PAGESIN: {
+      sqlite3_result_int64(ctx, (sqlite3_int64)st->pages_in);
+      break;
+    }
+    case STCS_PAGESOUT: {
+      sqlite3_result_int64(ctx, (sqlite3_int64)st->pages_out);
+      break;
+    }
+    case STCS_PROMOTED: {
+      sqlite3_result_int64(ctx, (sqlite3_int64)st->promoted);
+      break;
+    }
+  }
+  return SQLITE_OK;
+};
+
+/*
+** Return the rowid for the current row.
+*/
+static int systblCacheStatsRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid){
+  systbl_cachestats_cursor *pCur = (systbl_cachestats_cursor*)cur;
+
+  *pRowid = pCur->iRowid;
+  return SQLITE_OK;
+}
+
+/*
+** Return TRUE if the cursor has been moved off of the last row of output.
+*/
+static int systblCacheStatsEof(sqlite3_vtab_cursor *cur){
+  systbl_cachestats_cursor *pCur = (systbl_cachestats_cursor*)cur;
+
+  return pCur->iRowid >= pCur->nfiles;
+}
+
+/*
+** Take a fresh snapshot of the bufferpool counters and rewind.
+*/
+static int systblCacheStatsFilter(
+  sqlite3_vtab_cursor *pVtabCursor,
+  int idxNum, const char *idxStr,
+  int argc, sqlite3_value **argv
+){
+  systbl_cachestats_cursor *pCur = (systbl_cachestats_cursor*)pVtabCursor;
+
+  bdb_free_cache_file_stats(pCur->stats, pCur->nfiles);
+  pCur->stats = NULL;
+  pCur->nfiles = 0;
+  if( bdb_get_cache_file_stats(thedb->bdb_env, &pCur->stats, &pCur->nfiles) ){
+    return SQLITE_NOMEM;
+  }
+  pCur->iRowid = 0;
+  return SQLITE_OK;
+}
+
+static int systblCacheStatsBestIndex(
+  sqlite3_vtab *tab,
+  sqlite3_index_info *pIdxInfo
+){
+  return SQLITE_OK;
+}
+
+const sqlite3_module systblCacheStatsModule = {
+  0,                            /* iVersion */
+  0,                            /* xCreate */
+  systblCacheStatsConnect,      /* xConnect */
+  systblCacheStatsBestIndex,    /* xBestIndex */
+  systblCacheStatsDisconnect,   /* xDisconnect */
+  0,                            /* xDestroy */
+  systblCacheStatsOpen,         /* xOpen - open a cursor */
+  systblCacheStatsClose,        /* xClose - close a cursor */
+  systblCacheStatsFilter,       /* xFilter - configure scan constraints */
+  systblCacheStatsNext,         /* xNext - advance a cursor */
+  systblCacheStatsEof,          /* xEof - check for end of scan */
+  systblCacheStatsColumn,       /* xColumn - read data */
+  systblCacheStatsRowid,        /* xRowid - read data */
+  0,                            /* xUpdate */
+  0,                            /* xBegin */
+  0,                            /* xSync */
+  0,                            /* xCommit */
+  0,                            /* xRollback */
+  0,                            /* xFindMethod */
+  0,                            /* xRename */
+};
+
+#endif /* (!defined(SQLITE_CORE) || defined(SQLITE_BUILDING_FOR_COMDB2)) \
+          && !defined(SQLITE_OMIT_VIRTUALTABLE) */
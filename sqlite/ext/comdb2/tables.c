@@ -229,6 +229,8 @@ int comdb2SystblInit(
     rc = sqlite3_create_module(db, "comdb2_tablepermissions", &systblTablePermissionsModule, 0);
   if (rc == SQLITE_OK)
     rc = sqlite3_create_module(db, "comdb2_triggers", &systblTriggersModule, 0);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_create_module(db, "comdb2_cachestats", &systblCacheStatsModule, 0);
 #endif
   return rc;
 }
@@ -58,8 +58,11 @@ struct SortCtx {
   int labelDone;        /* Jump here when done, ex: LIMIT reached */
   u8 sortFlags;         /* Zero or more SORTFLAG_* bits */
   u8 bOrderedInnerLoop; /* ORDER BY correctly sorts the inner loop */
+  int addrTopN;         /* Address of OP_SorterTopN, or 0 */
+  int nTopN;            /* Rows kept by a top-N sorter */
 };
 #define SORTFLAG_UseSorter  0x01   /* Use SorterOpen instead of OpenEphemeral */
+#define SORTFLAG_TopN       0x02   /* Sorter only keeps the first nTopN rows */
 
 /* COMDB2 MODIFICATION */
 static void fingerprintSelectInt(sqlite3 *db, MD5Context *c, Select *p);
@@ -665,7 +668,9 @@ static void pushOntoSorter(
     op = OP_IdxInsert;
   }
   sqlite3VdbeAddOp2(v, op, pSort->iECursor, regRecord);
-  if( iLimit ){
+  /* COMDB2 MODIFICATION */
+  /* A top-N sorter discards anything past LIMIT+OFFSET on its own */
+  if( iLimit && (pSort->sortFlags & SORTFLAG_TopN)==0 ){
     int addr;
     int r1 = 0;
     /* Fill the sorter until it contains LIMIT+OFFSET entries.  (The iLimit
@@ -1203,6 +1208,21 @@ static void explainTempTable(Parse *pParse, const char *zUsage){
   }
 }
 
+/* COMDB2 MODIFICATION */
+/*
+** Add a row of output to the EQP result for an ORDER BY that is done with
+** a top-N sorter keeping only nTopN rows.
+*/
+static void explainTopN(Parse *pParse, int nTopN){
+  if( pParse->explain==2 ){
+    Vdbe *v = pParse->pVdbe;
+    char *zMsg = sqlite3MPrintf(pParse->db,
+                                "USE TOP-N SORTER FOR ORDER BY (%d ROWS)",
+                                nTopN);
+    sqlite3VdbeAddOp4(v, OP_Explain, pParse->iSelectId, 0, 0, zMsg, P4_DYNAMIC);
+  }
+}
+
 /*
 ** Assign expression b to lvalue a. A second, no-op, version of this macro
 ** is provided when SQLITE_OMIT_EXPLAIN is defined. This allows the code
@@ -1215,6 +1235,7 @@ static void explainTempTable(Parse *pParse, const char *zUsage){
 #else
 /* No-op versions of the explainXXX() functions and macros. */
 # define explainTempTable(y,z)
+# define explainTopN(y,z)
 # define explainSetInteger(y,z)
 #endif
 
@@ -1994,6 +2015,26 @@ static void computeLimitRegisters(Parse *pParse, Select *p, int iBreak){
   }
 }
 
+/* COMDB2 MODIFICATION */
+extern int gbl_sqlite_sorter_topn;
+
+/*
+** If the LIMIT and OFFSET of p are constants and LIMIT+OFFSET is no more
+** than the "sqlsortertopn" setting, return LIMIT+OFFSET: the number of rows
+** a top-N sorter has to keep to answer an ORDER BY on p.  Otherwise
+** return 0.
+*/
+static int sortTopNLimit(Select *p){
+  int nLimit;
+  int nOffset = 0;
+  if( p->pLimit==0 || !sqlite3ExprIsInteger(p->pLimit, &nLimit) ) return 0;
+  if( p->pOffset && !sqlite3ExprIsInteger(p->pOffset, &nOffset) ) return 0;
+  if( nLimit<=0 ) return 0;
+  if( nOffset<0 ) nOffset = 0;
+  if( (i64)nLimit+nOffset > gbl_sqlite_sorter_topn ) return 0;
+  return nLimit+nOffset;
+}
+
 #ifndef SQLITE_OMIT_COMPOUND_SELECT
 /*
 ** Return the appropriate collating sequence for the iCol-th column of
@@ -5249,10 +5290,21 @@ int sqlite3Select(
   */
   iEnd = sqlite3VdbeMakeLabel(v);
   p->nSelectRow = 320;  /* 4 billion rows */
+  /* COMDB2 MODIFICATION */
+  sSort.nTopN = p->iLimit==0 ? sortTopNLimit(p) : 0;
   computeLimitRegisters(pParse, p, iEnd);
   if( p->iLimit==0 && sSort.addrSortIndex>=0 ){
     sqlite3VdbeChangeOpcode(v, sSort.addrSortIndex, OP_SorterOpen);
     sSort.sortFlags |= SORTFLAG_UseSorter;
+  }else if( sSort.nTopN>0 && sSort.addrSortIndex>=0 ){
+    /* ORDER BY with a small constant LIMIT: keep the best LIMIT+OFFSET rows
+    ** in a bounded heap rather than an ephemeral index that has its last
+    ** entry deleted after every insert.  Undone below if the sort turns out
+    ** to be partly satisfied by an index. */
+    sqlite3VdbeChangeOpcode(v, sSort.addrSortIndex, OP_SorterOpen);
+    sSort.addrTopN = sqlite3VdbeAddOp2(v, OP_SorterTopN, sSort.iECursor,
+                                       sSort.nTopN);
+    sSort.sortFlags |= SORTFLAG_UseSorter|SORTFLAG_TopN;
   }
 
   /* Open an ephemeral index to use for the distinct set.
@@ -5301,6 +5353,19 @@ int sqlite3Select(
       sqlite3VdbeChangeToNoop(v, sSort.addrSortIndex);
     }
 
+    /* COMDB2 MODIFICATION */
+    /* Rows sorted on a prefix of the ORDER BY are sorted group by group,
+    ** and each group must only fill what is left of the LIMIT.  Go back to
+    ** the ephemeral index for those. */
+    if( sSort.addrTopN && sSort.nOBSat>0 ){
+      sqlite3VdbeChangeToNoop(v, sSort.addrTopN);
+      if( sSort.pOrderBy ){
+        sqlite3VdbeChangeOpcode(v, sSort.addrSortIndex, OP_OpenEphemeral);
+      }
+      sSort.addrTopN = 0;
+      sSort.sortFlags &= ~(SORTFLAG_UseSorter|SORTFLAG_TopN);
+    }
+
     /* Use the standard inner loop. */
     selectInnerLoop(pParse, p, pEList, -1, &sSort, &sDistinct, pDest,
                     sqlite3WhereContinueLabel(pWInfo),
@@ -5511,6 +5576,8 @@ int sqlite3Select(
       ){
         sSort.pOrderBy = 0;
         sqlite3VdbeChangeToNoop(v, sSort.addrSortIndex);
+        /* COMDB2 MODIFICATION */
+        if( sSort.addrTopN ) sqlite3VdbeChangeToNoop(v, sSort.addrTopN);
       }
 
       /* Evaluate the current GROUP BY terms and store in b0, b1, b2...
@@ -5779,8 +5846,13 @@ int sqlite3Select(
   ** and send them to the callback one by one.
   */
   if( sSort.pOrderBy ){
-    explainTempTable(pParse,
-                     sSort.nOBSat>0 ? "RIGHT PART OF ORDER BY":"ORDER BY");
+    /* COMDB2 MODIFICATION */
+    if( sSort.sortFlags & SORTFLAG_TopN ){
+      explainTopN(pParse, sSort.nTopN);
+    }else{
+      explainTempTable(pParse,
+                       sSort.nOBSat>0 ? "RIGHT PART OF ORDER BY":"ORDER BY");
+    }
     generateSortTail(pParse, p, &sSort, pEList->nExpr, pDest);
   }
 
@@ -4101,6 +4101,25 @@ case OP_SorterOpen: {
   break;
 }
 
+/* Opcode: SorterTopN P1 P2 * * *
+** Synopsis: keep smallest P2 rows of cursor[P1]
+**
+** P1 is a sorter cursor that has just been opened by OP_SorterOpen.
+** Only the P2 smallest records written to it are kept, in a bounded heap
+** in memory, instead of sorting every record.  This implements
+** ORDER BY ... LIMIT when LIMIT+OFFSET is a small constant.
+*/
+case OP_SorterTopN: {
+  VdbeCursor *pC;
+
+  assert( pOp->p1>=0 && pOp->p1<p->nCursor );
+  pC = p->apCsr[pOp->p1];
+  assert( isSorter(pC) );
+  rc = sqlite3VdbeSorterTopN(pC, pOp->p2);
+  if( rc ) goto abort_due_to_error;
+  break;
+}
+
 /* Opcode: SequenceTest P1 P2 * * *
 ** Synopsis: if( cursor[P1].ctr++ ) pc = P2
 **
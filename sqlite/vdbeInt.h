@@ -126,6 +126,9 @@ struct VdbeSorter {
   int nfind;
   int nmove;
   int nwrite;
+  SorterRecord **aTopN;           /* Max-heap of records kept for a top-N */
+  int mxTopN;                     /* Size of aTopN[], 0 if not a top-N sort */
+  int nTopN;                      /* Records currently in aTopN[] */
 };
 
 #endif
@@ -632,6 +635,7 @@ void sqlite3VdbePreUpdateHook(Vdbe*,VdbeCursor*,int,const char*,Table*,i64,int);
 int sqlite3VdbeTransferError(Vdbe *p);
 
 int sqlite3VdbeSorterInit(sqlite3 *, int, VdbeCursor *);
+int sqlite3VdbeSorterTopN(const VdbeCursor *, int);
 void sqlite3VdbeSorterReset(sqlite3 *, VdbeSorter *);
 void sqlite3VdbeSorterClose(sqlite3 *, VdbeCursor *);
 int sqlite3VdbeSorterRowkey(const VdbeCursor *, Mem *);
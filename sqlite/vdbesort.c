@@ -339,6 +339,9 @@ struct VdbeSorter {
   int nfind;
   int nmove;
   int nwrite;
+  SorterRecord **aTopN;           /* Max-heap of records kept for a top-N */
+  int mxTopN;                     /* Size of aTopN[], 0 if not a top-N sort */
+  int nTopN;                      /* Records currently in aTopN[] */
 };
 
 #endif
@@ -1044,6 +1047,40 @@ int sqlite3VdbeSorterInit(
 }
 #undef nWorker   /* Defined at the top of this function */
 
+/* COMDB2 MODIFICATION */
+/*
+** Turn the sorter into a top-N sorter: instead of sorting everything
+** written to it, only the nLimit smallest records are kept, in a max-heap
+** in memory.  Used for ORDER BY ... LIMIT with a small constant limit.
+** Must be called before any records are written.
+*/
+int sqlite3VdbeSorterTopN(const VdbeCursor *pCsr, int nLimit){
+  VdbeSorter *pSorter;
+
+  assert( pCsr->eCurType==CURTYPE_SORTER );
+  assert( nLimit>0 );
+  pSorter = pCsr->uc.pSorter;
+  assert( pSorter->list.pList==0 && pSorter->nTopN==0 );
+  if( pSorter->mxTopN<nLimit ){
+    sqlite3_free(pSorter->aTopN);
+    pSorter->aTopN = (SorterRecord**)sqlite3Malloc(
+        nLimit * sizeof(SorterRecord*)
+    );
+    if( pSorter->aTopN==0 ){
+      pSorter->mxTopN = 0;
+      return SQLITE_NOMEM_BKPT;
+    }
+  }
+  pSorter->mxTopN = nLimit;
+
+  /* Records that fall out of the heap are freed one at a time, so they
+  ** cannot live in the bulk aMemory[] allocation. */
+  sqlite3_free(pSorter->list.aMemory);
+  pSorter->list.aMemory = 0;
+  pSorter->nMemory = 0;
+  return SQLITE_OK;
+}
+
 /*
 ** Free the list of sorted records starting at pRecord.
 */
@@ -1269,6 +1306,11 @@ void sqlite3VdbeSorterReset(sqlite3 *db, VdbeSorter *pSorter){
   if( pSorter->list.aMemory==0 ){
     vdbeSorterRecordFree(0, pSorter->list.pList);
   }
+  /* COMDB2 MODIFICATION */
+  for(i=0; i<pSorter->nTopN; i++){
+    sqlite3_free(pSorter->aTopN[i]);
+  }
+  pSorter->nTopN = 0;
   pSorter->list.pList = 0;
   pSorter->list.szPMA = 0;
   pSorter->bUsePMA = 0;
@@ -1291,6 +1333,7 @@ void sqlite3VdbeSorterClose(sqlite3 *db, VdbeCursor *pCsr){
 
     sqlite3VdbeSorterReset(db, pSorter);
     sqlite3_free(pSorter->list.aMemory);
+    sqlite3_free(pSorter->aTopN);
     sqlite3DbFree(db, pSorter);
     pCsr->uc.pSorter = 0;
   }
@@ -1366,6 +1409,105 @@ static int vdbeSortAllocUnpacked(SortSubtask *pTask){
   return SQLITE_OK;
 }
 
+/* COMDB2 MODIFICATION */
+/*
+** Compare two records held by a top-N sorter.
+*/
+static int vdbeSorterTopNCompare(
+  SortSubtask *pTask,
+  SorterRecord *p1,
+  SorterRecord *p2
+){
+  int bCached = 0;
+  return vdbeSorterCompare(pTask, &bCached, SRVAL(p1), p1->nVal,
+                           SRVAL(p2), p2->nVal);
+}
+
+/*
+** Restore the heap property of aTopN[] after aTopN[i] has been replaced
+** with a smaller record.
+*/
+static void vdbeSorterTopNSiftDown(VdbeSorter *pSorter, int i){
+  SortSubtask *pTask = &pSorter->aTask[0];
+  SorterRecord **a = pSorter->aTopN;
+  int n = pSorter->nTopN;
+
+  for(;;){
+    int iBig = i;
+    int iLeft = 2*i + 1;
+    int iRight = iLeft + 1;
+    SorterRecord *pTmp;
+    if( iLeft<n && vdbeSorterTopNCompare(pTask, a[iLeft], a[iBig])>0 ){
+      iBig = iLeft;
+    }
+    if( iRight<n && vdbeSorterTopNCompare(pTask, a[iRight], a[iBig])>0 ){
+      iBig = iRight;
+    }
+    if( iBig==i ) break;
+    pTmp = a[i];
+    a[i] = a[iBig];
+    a[iBig] = pTmp;
+    i = iBig;
+  }
+}
+
+/*
+** Restore the heap property of aTopN[] after appending aTopN[i].
+*/
+static void vdbeSorterTopNSiftUp(VdbeSorter *pSorter, int i){
+  SortSubtask *pTask = &pSorter->aTask[0];
+  SorterRecord **a = pSorter->aTopN;
+
+  while( i>0 ){
+    int iParent = (i-1)/2;
+    SorterRecord *pTmp;
+    if( vdbeSorterTopNCompare(pTask, a[i], a[iParent])<=0 ) break;
+    pTmp = a[i];
+    a[i] = a[iParent];
+    a[iParent] = pTmp;
+    i = iParent;
+  }
+}
+
+/*
+** Add a record to a top-N sorter.  Once the heap is full, a record only
+** gets in by evicting the largest one, so at most mxTopN records are ever
+** held no matter how many rows the query visits.
+*/
+static int vdbeSorterTopNWrite(VdbeSorter *pSorter, Mem *pVal){
+  SortSubtask *pTask = &pSorter->aTask[0];
+  SorterRecord *pNew;
+  int rc;
+
+  rc = vdbeSortAllocUnpacked(pTask);
+  if( rc!=SQLITE_OK ) return rc;
+
+  if( pSorter->nTopN==pSorter->mxTopN ){
+    SorterRecord *pTop = pSorter->aTopN[0];
+    int bCached = 0;
+    if( vdbeSorterCompare(pTask, &bCached, pVal->z, pVal->n,
+                          SRVAL(pTop), pTop->nVal)>=0 ){
+      return pTask->pUnpacked->errCode;
+    }
+  }
+
+  pNew = (SorterRecord*)sqlite3Malloc(sizeof(SorterRecord) + pVal->n);
+  if( pNew==0 ) return SQLITE_NOMEM_BKPT;
+  memcpy(SRVAL(pNew), pVal->z, pVal->n);
+  pNew->nVal = pVal->n;
+  pNew->u.pNext = 0;
+
+  if( pSorter->nTopN==pSorter->mxTopN ){
+    sqlite3_free(pSorter->aTopN[0]);
+    pSorter->aTopN[0] = pNew;
+    vdbeSorterTopNSiftDown(pSorter, 0);
+  }else{
+    pSorter->aTopN[pSorter->nTopN++] = pNew;
+    vdbeSorterTopNSiftUp(pSorter, pSorter->nTopN-1);
+  }
+  return pTask->pUnpacked->errCode;
+}
+
 
 /*
 ** Merge the two sorted lists p1 and p2 into a single list.
@@ -1835,6 +1977,9 @@ int sqlite3VdbeSorterWrite(
   /* COMDB2 MODIFICATION */
   addVbdeToThdCost(VDBESORTER_WRITE);
   pSorter->nwrite++;
+  if( pSorter->mxTopN ){
+    return vdbeSorterTopNWrite(pSorter, pVal);
+  }
 
 
   /* Figure out whether or not the current contents of memory should be
@@ -2629,6 +2774,18 @@ int sqlite3VdbeSorterRewind(const VdbeCursor *pCsr, int *pbEof){
   /* COMDB2 MODIFICATION */
   pSorter->nfind++;
 
+  /* A top-N sorter hands its heap over to the in-memory list, which is
+  ** then sorted and read back like any other sorter that fit in memory. */
+  if( pSorter->nTopN ){
+    int i;
+    assert( pSorter->bUsePMA==0 && pSorter->list.aMemory==0 );
+    for(i=0; i<pSorter->nTopN; i++){
+      pSorter->aTopN[i]->u.pNext = pSorter->list.pList;
+      pSorter->list.pList = pSorter->aTopN[i];
+    }
+    pSorter->nTopN = 0;
+  }
+
   /* If no data has been written to disk, then do not do so now. Instead,
   ** sort the VdbeSorter.pRecord list. The vdbe layer will read data directly
   ** from the in-memory list.  */
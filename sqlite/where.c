@@ -4824,6 +4824,12 @@ WhereInfo *sqlite3WhereBegin(
             if( (pTabItem->colUsed & MASKBIT(jj))==0 ) continue;
             colUsed |= ((u64)1)<<(ii<63 ? ii : 63);
           }
+          /* COMDB2 MODIFICATION */
+          /* Seek and skip-scan columns are compared against the key
+          ** even if the query never reads them. */
+          for(ii=0; ii<=pLoop->u.btree.nEq && ii<pIx->nColumn; ii++){
+            colUsed |= ((u64)1)<<(ii<63 ? ii : 63);
+          }
           sqlite3VdbeAddOp4Dup8(v, OP_ColumnsUsed, iIndexCur, 0, 0,
                                 (u8*)&colUsed, P4_INT64);
         }
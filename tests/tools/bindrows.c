@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cdb2api.h>
+
+/* Runs statements over rows of parameters bound with cdb2_bind_next_row()
+   and checks their counts, their results, and that a failing row rolls
+   back the whole batch. */
+
+#define NROWS 1000
+
+static cdb2_hndl_tp *db = NULL;
+static long long a[NROWS];
+static char b[NROWS][64];
+
+static int run(const char *sql)
+{
+    int rc = cdb2_run_statement(db, sql);
+    if (rc) {
+        fprintf(stderr, "%s: rc %d %s\n", sql, rc, cdb2_errstr(db));
+        return rc;
+    }
+    while ((rc = cdb2_next_record(db)) == CDB2_OK)
+        ;
+    return rc == CDB2_OK_DONE ? 0 : rc;
+}
+
+static long long count(const char *sql)
+{
+    long long cnt = -1;
+    if (cdb2_run_statement(db, sql) == 0 && cdb2_next_record(db) == CDB2_OK)
+        cnt = *(long long *)cdb2_column_value(db, 0);
+    while (cdb2_next_record(db) == CDB2_OK)
+        ;
+    return cnt;
+}
+
+/* rows lo..hi-1; every 10th b is NULL and the lengths vary */
+static void bind_rows(int lo, int hi)
+{
+    for (int i = lo; i < hi; i++) {
+        a[i] = i;
+        snprintf(b[i], sizeof(b[i]), "%.*s%d", i % 40,
+                 "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb", i);
+        cdb2_bind_param(db, "a", CDB2_INTEGER, &a[i], sizeof(a[i]));
+        if (i % 10 == 0)
+            cdb2_bind_param(db, "b", CDB2_CSTRING, NULL, 0);
+        else
+            cdb2_bind_param(db, "b", CDB2_CSTRING, b[i], strlen(b[i]));
+        cdb2_bind_next_row(db);
+    }
+}
+
+#define CHECK(cond, ...)                                                       \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, __VA_ARGS__);                                      \
+            fprintf(stderr, "\n");                                             \
+            return 1;                                                          \
+        }                                                                      \
+    } while (0)
+
+int main(int argc, char *argv[])
+{
+    cdb2_effects_tp eff;
+    long long cnt;
+    int rc, nrows;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <dbname>\n", argv[0]);
+        return 1;
+    }
+    char *conf = getenv("CDB2_CONFIG");
+    if (conf)
+        cdb2_set_comdb2db_config(conf);
+    if ((rc = cdb2_open(&db, argv[1], "default", 0)) != 0) {
+        fprintf(stderr, "cdb2_open rc %d\n", rc);
+        return 1;
+    }
+
+    /* insert 0..799 in one statement */
+    bind_rows(0, 800);
+    CHECK(run("insert into t1 values (@a, @b)") == 0, "insert batch");
+    CHECK(cdb2_get_effects(db, &eff) == 0 && eff.num_inserted == 800,
+          "insert batch reported %d rows", eff.num_inserted);
+    cdb2_clearbindings(db);
+    CHECK((cnt = count("select count(*) from t1")) == 800, "%lld rows", cnt);
+    CHECK((cnt = count("select count(*) from t1 where b is null")) == 80,
+          "%lld null rows", cnt);
+    CHECK((cnt = count("select count(*) from t1 where b is not null and b != "
+                       "substr('bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb', 1, "
+                       "a % 40) || a")) == 0,
+          "%lld rows with the wrong b", cnt);
+
+    /* 800..999 with a duplicate in the middle: none of it may stay */
+    bind_rows(800, 1000);
+    a[900] = 5;
+    CHECK(run("insert into t1 values (@a, @b)") != 0, "duplicate row passed");
+    cdb2_clearbindings(db);
+    CHECK((cnt = count("select count(*) from t1")) == 800,
+          "%lld rows after the failed batch", cnt);
+
+    /* the same batch inside a transaction that rolls back */
+    CHECK(run("begin") == 0, "begin");
+    bind_rows(800, 1000);
+    CHECK(run("insert into t1 values (@a, @b)") == 0, "insert in transaction");
+    cdb2_clearbindings(db);
+    CHECK(run("rollback") == 0, "rollback");
+    CHECK((cnt = count("select count(*) from t1")) == 800,
+          "%lld rows after rollback", cnt);
+
+    /* updates add up across the rows */
+    for (int i = 0; i < 100; i++) {
+        a[i] = i * 3;
+        cdb2_bind_param(db, "a", CDB2_INTEGER, &a[i], sizeof(a[i]));
+        cdb2_bind_next_row(db);
+    }
+    CHECK(run("update t1 set b = 'updated' where a = @a") == 0, "update");
+    CHECK(cdb2_get_effects(db, &eff) == 0 && eff.num_updated == 100,
+          "update batch reported %d rows", eff.num_updated);
+    cdb2_clearbindings(db);
+    CHECK((cnt = count("select count(*) from t1 where b = 'updated'")) == 100,
+          "%lld rows updated", cnt);
+
+    /* selects come back as one result set */
+    for (int i = 0; i < 10; i++) {
+        a[i] = 700 + i;
+        cdb2_bind_param(db, "a", CDB2_INTEGER, &a[i], sizeof(a[i]));
+        cdb2_bind_next_row(db);
+    }
+    CHECK(cdb2_run_statement(db, "select a from t1 where a = @a") == 0,
+          "select");
+    for (nrows = 0; cdb2_next_record(db) == CDB2_OK; nrows++)
+        CHECK(*(long long *)cdb2_column_value(db, 0) == 700 + nrows,
+              "select row %d", nrows);
+    CHECK(nrows == 10, "select returned %d rows", nrows);
+    cdb2_clearbindings(db);
+
+    cdb2_close(db);
+    printf("Success\n");
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+   Copyright 2015 Bloomberg Finance L.P.
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ */
+
+/* Microbenchmark for comdb2rle run detection and expansion kernels.
+ * usage: crle_bench [iterations] [record size] */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+#include <time.h>
+#include <comdb2rle.c> //need access to static funcs
+
+struct kernels {
+    const char *name;
+    prefix_t prefix;
+    suffix_t suffix;
+};
+
+static struct kernels all[] = {
+    {"scalar", prefix_scalar, suffix_scalar},
+#ifdef __x86_64__
+    {"sse2", prefix_sse2, suffix_sse2},
+    {"avx2", prefix_avx2, suffix_avx2},
+#endif
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Something that looks like a row: null ints, small ints, zero padded
+ * cstrings and a few random bytes */
+static void make_record(uint8_t *rec, uint32_t sz)
+{
+    uint32_t i = 0;
+    while (i < sz) {
+        uint32_t left = sz - i;
+        uint32_t n;
+        switch (rand() % 5) {
+        case 0: /* null int */
+            n = left < 9 ? left : 9;
+            memset(rec + i, 0, n);
+            break;
+        case 1: /* small int */
+            n = left < 5 ? left : 5;
+            memset(rec + i, 0, n);
+            rec[i] = 0x08;
+            rec[i + n - 1] = rand() % 100;
+            break;
+        case 2: /* cstring with padding */
+            n = left < 64 ? left : 64;
+            memset(rec + i, 0, n);
+            rec[i] = 0x08;
+            for (uint32_t j = 1; j < n && j < 8; ++j)
+                rec[i + j] = 'a' + rand() % 26;
+            break;
+        case 3: /* blank padded string */
+            n = left < 128 ? left : 128;
+            memset(rec + i, ' ', n);
+            rec[i] = 0x08;
+            break;
+        default:
+            n = left < 16 ? left : 16;
+            for (uint32_t j = 0; j < n; ++j)
+                rec[i + j] = rand();
+            break;
+        }
+        i += n;
+    }
+}
+
+static void check_kernels(void)
+{
+    uint8_t a[300], b[300];
+    for (int t = 0; t < 10000; ++t) {
+        uint32_t n = rand() % sizeof(a);
+        memset(a, rand() % 2, sizeof(a));
+        memcpy(b, a, sizeof(b));
+        if (n)
+            b[rand() % n] ^= 1 + rand() % 255;
+        size_t p = prefix_scalar(a, b, n);
+        size_t s = suffix_scalar(a, n, a[0]);
+        for (size_t k = 1; k < sizeof(all) / sizeof(all[0]); ++k) {
+            assert(all[k].prefix(a, b, n) == p);
+            assert(all[k].suffix(a, n, a[0]) == s);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int iter = argc > 1 ? atoi(argv[1]) : 100000;
+    uint32_t sz = argc > 2 ? atoi(argv[2]) : 1024;
+    uint8_t *rec = malloc(sz);
+    uint8_t *cmp = malloc(sz);
+    uint8_t *out = malloc(sz);
+
+    srand(time(NULL));
+    make_record(rec, sz);
+    check_kernels();
+
+    for (size_t k = 0; k < sizeof(all) / sizeof(all[0]); ++k) {
+#ifdef __x86_64__
+        if (all[k].prefix == prefix_avx2 && !have_avx2())
+            continue;
+#endif
+        prefix = all[k].prefix;
+        suffix = all[k].suffix;
+
+        Comdb2RLE c = {.in = rec, .insz = sz, .out = cmp, .outsz = sz};
+        double start = now();
+        for (int i = 0; i < iter; ++i) {
+            c.outsz = sz;
+            if (compressComdb2RLE(&c) != 0) {
+                fprintf(stderr, "record didn't compress\n");
+                return EXIT_FAILURE;
+            }
+        }
+        double ctime = now() - start;
+
+        Comdb2RLE d = {.in = cmp, .insz = c.outsz, .out = out, .outsz = sz};
+        start = now();
+        for (int i = 0; i < iter; ++i) {
+            d.outsz = sz;
+            if (decompressComdb2RLE(&d) != 0) {
+                fprintf(stderr, "decompress failed\n");
+                return EXIT_FAILURE;
+            }
+        }
+        double dtime = now() - start;
+
+        if (d.outsz != sz || memcmp(rec, out, sz) != 0) {
+            fprintf(stderr, "%s: decompressed record doesn't match\n",
+                    all[k].name);
+            return EXIT_FAILURE;
+        }
+        double mb = (double)iter * sz / (1024 * 1024);
+        printf("%-8s %u -> %zu bytes  compress %8.1f MB/s  decompress "
+               "%8.1f MB/s\n",
+               all[k].name, sz, c.outsz, mb / ctime, mb / dtime);
+    }
+    free(rec);
+    free(cmp);
+    free(out);
+    return EXIT_SUCCESS;
+}
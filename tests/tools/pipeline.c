@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+#include <cdb2api.h>
+
+/* Submits statements with cdb2_submit() and checks that they complete in
+   submission order, each seeing the effects of the ones before it. */
+
+static int ncompleted = 0;
+static int nfailed = 0;
+
+struct stmt {
+    int idx;
+    int expect_rc;     /* 0, or nonzero for any failure */
+    long long expect;  /* for selects: the count, -1 for none */
+};
+
+static void fail(const char *msg, int idx, long long got, long long want)
+{
+    fprintf(stderr, "statement %d: %s: got %lld, expected %lld\n", idx, msg,
+            got, want);
+    nfailed++;
+}
+
+static void done(cdb2_hndl_tp *db, int rc, void *arg)
+{
+    struct stmt *s = arg;
+
+    if (s->idx != ncompleted)
+        fail("completed out of order", s->idx, s->idx, ncompleted);
+    ncompleted++;
+
+    if (s->expect_rc == 0 && rc != 0) {
+        fail(cdb2_errstr(db), s->idx, rc, 0);
+        return;
+    }
+    if (s->expect_rc != 0) {
+        if (rc == 0)
+            fail("expected an error", s->idx, rc, s->expect_rc);
+        return;
+    }
+    if (s->expect >= 0) {
+        if ((rc = cdb2_next_record(db)) != CDB2_OK) {
+            fail("no row", s->idx, rc, CDB2_OK);
+            return;
+        }
+        long long cnt = *(long long *)cdb2_column_value(db, 0);
+        if (cnt != s->expect)
+            fail("count", s->idx, cnt, s->expect);
+    }
+    while (cdb2_next_record(db) == CDB2_OK)
+        ;
+}
+
+int main(int argc, char *argv[])
+{
+    cdb2_hndl_tp *db = NULL;
+    struct stmt *stmts;
+    char sql[128];
+    int nstmts = 2000, rc, inserted = 1; /* the runit inserts 0 */
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <dbname>\n", argv[0]);
+        return 1;
+    }
+    char *conf = getenv("CDB2_CONFIG");
+    if (conf)
+        cdb2_set_comdb2db_config(conf);
+    if ((rc = cdb2_open(&db, argv[1], "default", 0)) != 0) {
+        fprintf(stderr, "cdb2_open rc %d\n", rc);
+        return 1;
+    }
+
+    if ((rc = cdb2_submit(db, "begin", NULL, NULL)) != CDB2ERR_NOTSUPPORTED) {
+        fprintf(stderr, "submit of begin rc %d\n", rc);
+        return 1;
+    }
+    if ((rc = cdb2_submit(db, "set transaction read committed", NULL,
+                          NULL)) != CDB2ERR_NOTSUPPORTED) {
+        fprintf(stderr, "submit of set rc %d\n", rc);
+        return 1;
+    }
+
+    stmts = calloc(nstmts, sizeof(struct stmt));
+    for (int i = 0; i < nstmts; i++) {
+        struct stmt *s = &stmts[i];
+        s->idx = i;
+        s->expect = -1;
+        if (i % 50 == 49) {
+            snprintf(sql, sizeof(sql), "select count(*) from t1");
+            s->expect = inserted;
+        } else if (i % 97 == 96) {
+            /* a duplicate fails alone */
+            snprintf(sql, sizeof(sql), "insert into t1 values (0)");
+            s->expect_rc = 1;
+        } else {
+            snprintf(sql, sizeof(sql), "insert into t1 values (%d)", i + 1);
+            inserted++;
+        }
+        if ((rc = cdb2_submit(db, sql, done, s)) != 0) {
+            fprintf(stderr, "submit %d rc %d %s\n", i, rc, cdb2_errstr(db));
+            return 1;
+        }
+
+        /* first half: drain as responses show up; second half all at once */
+        if (i < nstmts / 2) {
+            struct pollfd pfd = {.fd = cdb2_async_fd(db), .events = POLLIN};
+            while (poll(&pfd, 1, 0) == 1)
+                if (cdb2_async_process(db) < 0) {
+                    fprintf(stderr, "cdb2_async_process failed\n");
+                    return 1;
+                }
+        }
+    }
+    if ((rc = cdb2_async_wait(db)) != 0) {
+        fprintf(stderr, "cdb2_async_wait rc %d\n", rc);
+        return 1;
+    }
+    if (cdb2_async_pending(db) != 0 || ncompleted != nstmts) {
+        fprintf(stderr, "%d pending, %d of %d completed\n",
+                cdb2_async_pending(db), ncompleted, nstmts);
+        return 1;
+    }
+
+    /* cdb2_run_statement completes what's pending first */
+    struct stmt last = {.idx = ncompleted, .expect = -1};
+    cdb2_submit(db, "insert into t1 values (-1)", done, &last);
+    inserted++;
+    if ((rc = cdb2_run_statement(db, "select count(*) from t1")) != 0 ||
+        ncompleted != nstmts + 1 || cdb2_next_record(db) != CDB2_OK ||
+        *(long long *)cdb2_column_value(db, 0) != inserted) {
+        fprintf(stderr, "run after submit rc %d completed %d\n", rc,
+                ncompleted);
+        return 1;
+    }
+    while (cdb2_next_record(db) == CDB2_OK)
+        ;
+
+    cdb2_close(db);
+    free(stmts);
+    if (nfailed) {
+        fprintf(stderr, "%d statements failed\n", nfailed);
+        return 1;
+    }
+    printf("%d\n", inserted);
+    return 0;
+}
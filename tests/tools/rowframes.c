@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cdb2api.h>
+
+/* Reads the rows of a query whose last column is quote() of each of the
+   others, joined by ',', and checks every value it got against it.  Built
+   with an LZ4 enabled cdb2api, so the rows arrive in compressed frames
+   when the server sends frames. */
+
+static int quote(cdb2_hndl_tp *db, int col, char *out, size_t outlen)
+{
+    const unsigned char *v = cdb2_column_value(db, col);
+    int len = cdb2_column_size(db, col);
+    size_t n = 0;
+
+    if (v == NULL)
+        return snprintf(out, outlen, "NULL");
+
+    switch (cdb2_column_type(db, col)) {
+    case CDB2_INTEGER:
+        return snprintf(out, outlen, "%lld", *(const long long *)v);
+    case CDB2_CSTRING:
+        out[n++] = '\'';
+        for (int i = 0; i < len && v[i] && n + 3 < outlen; i++) {
+            if (v[i] == '\'')
+                out[n++] = '\'';
+            out[n++] = v[i];
+        }
+        out[n++] = '\'';
+        out[n] = 0;
+        return n;
+    case CDB2_BLOB:
+        n = snprintf(out, outlen, "X'");
+        for (int i = 0; i < len && n + 3 < outlen; i++)
+            n += snprintf(out + n, outlen - n, "%02X", v[i]);
+        n += snprintf(out + n, outlen - n, "'");
+        return n;
+    default:
+        return snprintf(out, outlen, "?type %d", cdb2_column_type(db, col));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static char got[1 << 20];
+    cdb2_hndl_tp *db = NULL;
+    long long nrows = 0, nnulls = 0;
+    int rc, ncols;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <dbname> <query>\n", argv[0]);
+        return 1;
+    }
+    char *conf = getenv("CDB2_CONFIG");
+    if (conf)
+        cdb2_set_comdb2db_config(conf);
+    if ((rc = cdb2_open(&db, argv[1], "default", 0)) != 0) {
+        fprintf(stderr, "cdb2_open rc %d\n", rc);
+        return 1;
+    }
+    if ((rc = cdb2_run_statement(db, argv[2])) != 0) {
+        fprintf(stderr, "run rc %d %s\n", rc, cdb2_errstr(db));
+        return 1;
+    }
+    ncols = cdb2_numcolumns(db);
+    while ((rc = cdb2_next_record(db)) == CDB2_OK) {
+        size_t n = 0;
+        for (int col = 0; col < ncols - 1; col++) {
+            if (col)
+                got[n++] = ',';
+            n += quote(db, col, got + n, sizeof(got) - n);
+            if (cdb2_column_value(db, col) == NULL)
+                nnulls++;
+        }
+        const char *want = cdb2_column_value(db, ncols - 1);
+        if (want == NULL || strcmp(got, want) != 0) {
+            fprintf(stderr, "row %lld: got %s\nexpected %s\n", nrows, got,
+                    want ? want : "NULL");
+            return 1;
+        }
+        nrows++;
+    }
+    if (rc != CDB2_OK_DONE) {
+        fprintf(stderr, "next rc %d %s\n", rc, cdb2_errstr(db));
+        return 1;
+    }
+    cdb2_close(db);
+    printf("%lld %lld\n", nrows, nnulls);
+    return 0;
+}